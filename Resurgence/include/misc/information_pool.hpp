@@ -0,0 +1,121 @@
+#pragma once
+
+#include <headers.hpp>
+#include <mutex>
+#include <unordered_map>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        class information_pool;
+
+        ///<summary>
+        /// A NtQuerySystemInformation result borrowed from the information_pool.
+        /// The buffer is handed back to the pool when the view is destroyed.
+        ///</summary>
+        class information_buffer
+        {
+        public:
+            information_buffer();
+            information_buffer(information_buffer&& rhs);
+            ~information_buffer();
+
+            information_buffer& operator=(information_buffer&& rhs);
+
+            ///<summary>
+            /// Gets the buffer.
+            ///</summary>
+            uint8_t* get() const { return _buffer; }
+
+            ///<summary>
+            /// Gets the number of bytes written by the query.
+            ///</summary>
+            size_t size() const { return _size; }
+
+            ///<summary>
+            /// Checks whether the query succeeded.
+            ///</summary>
+            bool is_valid() const { return _buffer != nullptr; }
+
+            explicit operator bool() const { return is_valid(); }
+
+            ///<summary>
+            /// Gets the buffer as a typed pointer.
+            ///</summary>
+            template<typename _Ty> _Ty* as() const { return reinterpret_cast<_Ty*>(_buffer); }
+
+            ///<summary>
+            /// Returns the buffer to the pool early.
+            ///</summary>
+            void release();
+
+        private:
+            friend class information_pool;
+            information_buffer(information_pool* pool, SYSTEM_INFORMATION_CLASS information, uint8_t* buffer, size_t capacity, size_t size);
+
+            information_buffer(const information_buffer&) = delete;
+            information_buffer& operator=(const information_buffer&) = delete;
+
+            information_pool*           _pool;
+            SYSTEM_INFORMATION_CLASS    _information;
+            uint8_t*                    _buffer;
+            size_t                      _capacity;
+            size_t                      _size;
+        };
+
+        ///<summary>
+        /// Keeps one NtQuerySystemInformation buffer per information class.
+        ///</summary>
+        ///<remarks>
+        /// Each class remembers the last successful size plus some headroom, so repeated
+        /// queries skip the size probe and usually succeed on the first call without
+        /// allocating. Nested queries of the same class get a fresh buffer; the larger
+        /// of the two is kept when they are released.
+        ///</remarks>
+        class information_pool
+        {
+        public:
+            ///<summary>
+            /// Gets the shared pool.
+            ///</summary>
+            static information_pool& instance();
+
+            ~information_pool();
+
+            ///<summary>
+            /// Query system information.
+            ///</summary>
+            ///<param name="information"> The information class. </param>
+            ///<returns>
+            /// A view over the result. The view is invalid on failure and the status
+            /// can be retrieved with get_last_ntstatus.
+            ///</returns>
+            information_buffer query(SYSTEM_INFORMATION_CLASS information);
+
+            ///<summary>
+            /// Frees every cached buffer. Size hints are kept.
+            ///</summary>
+            void trim();
+
+        private:
+            friend class information_buffer;
+
+            struct slot
+            {
+                uint8_t*    buffer;
+                size_t      capacity;
+                size_t      hint;
+            };
+
+            information_pool();
+            information_pool(const information_pool&) = delete;
+            information_pool& operator=(const information_pool&) = delete;
+
+            void release(SYSTEM_INFORMATION_CLASS information, uint8_t* buffer, size_t capacity);
+
+            std::mutex                      _lock;
+            std::unordered_map<int, slot>   _slots;
+        };
+    }
+}
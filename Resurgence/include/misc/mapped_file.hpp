@@ -0,0 +1,59 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        ///<summary>
+        /// A read-only view of a whole file. The view is unmapped when the object is destroyed.
+        ///</summary>
+        class mapped_file
+        {
+        public:
+            mapped_file();
+            mapped_file(mapped_file&& rhs);
+            ~mapped_file();
+
+            mapped_file& operator=(mapped_file&& rhs);
+
+            ///<summary>
+            /// Maps a file.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path);
+
+            ///<summary>
+            /// Unmaps the file.
+            ///</summary>
+            void close();
+
+            ///<summary>
+            /// Gets the view.
+            ///</summary>
+            const uint8_t* data() const { return _base; }
+
+            ///<summary>
+            /// Gets the file size.
+            ///</summary>
+            size_t size() const { return _size; }
+
+            ///<summary>
+            /// Checks whether a file is mapped.
+            ///</summary>
+            bool is_open() const { return _base != nullptr; }
+
+        private:
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            const uint8_t*  _base;
+            size_t          _size;
+        };
+    }
+}
@@ -28,6 +28,7 @@ namespace resurgence
             PIMAGE_NT_HEADERS64     nt_hdrs64;
             IMAGE_SECTION_HEADER*   sections;
             ULONG                   section_count;
+            bool                    sections_sorted;    // Sorted by RVA without overlap, searched by bisection
         } mapped_image;
 
         typedef std::function<NTSTATUS(POBJECT_DIRECTORY_INFORMATION)>          object_enumeration_callback;
@@ -86,6 +87,7 @@ namespace resurgence
         ///</returns>
         ///<remarks>
         /// The returned buffer, if not null, must be freed with free_local_buffer.
+        /// Repeated queries should go through misc::information_pool instead.
         ///</remarks>
         uint8_t* query_system_information(SYSTEM_INFORMATION_CLASS information);
 
@@ -138,6 +140,10 @@ namespace resurgence
         ///<returns> 
         /// The status code.
         ///</returns>
+        ///<remarks>
+        /// Entries come from misc::object_namespace, sorted by name. Call
+        /// misc::object_namespace::refresh to see objects created since the directory was cached.
+        ///</remarks>
         NTSTATUS enumerate_system_objects(const std::wstring& root, object_enumeration_callback callback);
 
         ///<summary>
@@ -206,6 +212,9 @@ namespace resurgence
         ///<returns> 
         /// The status code.
         ///</returns>
+        ///<remarks>
+        /// Answered from misc::object_namespace.
+        ///</remarks>
         NTSTATUS object_exists(const std::wstring& root, const std::wstring& object, bool* found);
 
         ///<summary>
@@ -244,6 +253,17 @@ namespace resurgence
         ///</returns>
         NTSTATUS write_file(const std::wstring& path, uint8_t* buffer, size_t length);
 
+        ///<summary>
+        /// Creates a file, or replaces an existing one, with the given contents.
+        ///</summary>
+        ///<param name="path">   The file path. </param>
+        ///<param name="buffer"> The contents. </param>
+        ///<param name="length"> The size of the contents. </param>
+        ///<returns> 
+        /// The status code.
+        ///</returns>
+        NTSTATUS create_file(const std::wstring& path, const uint8_t* buffer, size_t length);
+
         ///<summary>
         /// Queries the size of a file.
         ///</summary>
@@ -281,6 +301,9 @@ namespace resurgence
         ///<returns> 
         /// The DOS path (i.e "C:\Windows\system32\ntoskrnl.exe").
         ///</returns>
+        ///<remarks>
+        /// Device paths are resolved through the cached misc::path_translator table.
+        ///</remarks>
         std::wstring get_dos_path(const std::wstring& path);
 
         ///<summary>
@@ -458,6 +481,17 @@ namespace resurgence
         ///</returns>
         NTSTATUS open_process(PHANDLE handle, uint32_t pid, uint32_t access);
 
+        ///<summary>
+        /// Opens a thread.
+        ///</summary>
+        ///<param name="handle"> The returned handle. </param>
+        ///<param name="tid">    The thread id. </param>
+        ///<param name="access"> The desired access flags. </param>
+        ///<returns> 
+        /// The status code.
+        ///</returns>
+        NTSTATUS open_thread(PHANDLE handle, uint32_t tid, uint32_t access);
+
         ///<summary>
         /// Checks if the process is running under WOW64.
         ///</summary>
@@ -506,6 +540,35 @@ namespace resurgence
 
         PIMAGE_SECTION_HEADER mapped_image_rva_to_section(const mapped_image& image, ULONG rva);
         uintptr_t mapped_image_rva_to_va(const mapped_image& image, ULONG rva);
+
+        ///<summary>
+        /// Translates many RVAs of a mapped image at once.
+        ///</summary>
+        ///<param name="image"> The image. </param>
+        ///<param name="rvas">  The RVAs, in any order. </param>
+        ///<param name="count"> The number of RVAs. </param>
+        ///<param name="vas">   Receives the addresses in the view, 0 for RVAs outside every section. </param>
+        void mapped_image_rvas_to_vas(const mapped_image& image, const uint32_t* rvas, size_t count, uintptr_t* vas);
+
+        ///<summary>
+        /// Checks whether section headers are sorted by RVA and their raw data ranges don't overlap,
+        /// in which case image_rva_to_section can bisect them.
+        ///</summary>
+        ///<param name="sections"> The section headers. </param>
+        ///<param name="count">    The number of sections. </param>
+        bool image_sections_sorted(const IMAGE_SECTION_HEADER* sections, ULONG count);
+
+        ///<summary>
+        /// Finds the section whose raw data contains an RVA.
+        ///</summary>
+        ///<param name="sections"> The section headers. </param>
+        ///<param name="count">    The number of sections. </param>
+        ///<param name="sorted">   What image_sections_sorted returned for them. Unsorted headers are scanned in order. </param>
+        ///<param name="rva">      The RVA. </param>
+        ///<returns>
+        /// The first section containing the RVA, nullptr if none.
+        ///</returns>
+        const IMAGE_SECTION_HEADER* image_rva_to_section(const IMAGE_SECTION_HEADER* sections, ULONG count, bool sorted, ULONG rva);
     }
 }
 #define allocate_local_buffer(buffer, size)  \
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <headers.hpp>
+#include <iterator>
+#include <misc/information_pool.hpp>
+
+namespace resurgence
+{
+    namespace native
+    {
+        ///<summary>
+        /// A view over a contiguous array of native entries.
+        ///</summary>
+        template<typename _Ty>
+        class array_range
+        {
+        public:
+            typedef _Ty*        iterator;
+            typedef const _Ty*  const_iterator;
+            typedef _Ty         value_type;
+
+            array_range()
+                : _begin(nullptr), _end(nullptr)
+            {
+            }
+            array_range(_Ty* first, size_t count)
+                : _begin(first), _end(first + count)
+            {
+            }
+
+            iterator    begin() const { return _begin; }
+            iterator    end() const { return _end; }
+            size_t      size() const { return static_cast<size_t>(_end - _begin); }
+            bool        empty() const { return _begin == _end; }
+            _Ty&        operator[](size_t i) const { return _begin[i]; }
+
+        private:
+            _Ty* _begin;
+            _Ty* _end;
+        };
+
+        ///<summary>
+        /// Forward iterator over a SYSTEM_PROCESS_INFORMATION chain.
+        ///</summary>
+        class process_iterator
+        {
+        public:
+            typedef std::forward_iterator_tag       iterator_category;
+            typedef SYSTEM_PROCESS_INFORMATION      value_type;
+            typedef ptrdiff_t                       difference_type;
+            typedef SYSTEM_PROCESS_INFORMATION*     pointer;
+            typedef SYSTEM_PROCESS_INFORMATION&     reference;
+
+            process_iterator()
+                : _entry(nullptr)
+            {
+            }
+            explicit process_iterator(pointer entry)
+                : _entry(entry)
+            {
+            }
+
+            reference operator*() const { return *_entry; }
+            pointer   operator->() const { return _entry; }
+
+            process_iterator& operator++()
+            {
+                _entry = _entry->NextEntryDelta != 0
+                    ? reinterpret_cast<pointer>(PTR_ADD(_entry, _entry->NextEntryDelta))
+                    : nullptr;
+                return *this;
+            }
+            process_iterator operator++(int)
+            {
+                process_iterator copy(*this);
+                ++*this;
+                return copy;
+            }
+
+            bool operator==(const process_iterator& rhs) const { return _entry == rhs._entry; }
+            bool operator!=(const process_iterator& rhs) const { return _entry != rhs._entry; }
+
+        private:
+            pointer _entry;
+        };
+
+        ///<summary>
+        /// A view over a SystemProcessInformation/SystemExtendedProcessInformation buffer.
+        ///</summary>
+        class process_range
+        {
+        public:
+            typedef process_iterator iterator;
+
+            explicit process_range(const uint8_t* buffer)
+                : _first(reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(const_cast<uint8_t*>(buffer)))
+            {
+            }
+            explicit process_range(const misc::information_buffer& buffer)
+                : _first(buffer.as<SYSTEM_PROCESS_INFORMATION>())
+            {
+            }
+
+            iterator begin() const { return iterator(_first); }
+            iterator end() const { return iterator(); }
+            bool     empty() const { return _first == nullptr; }
+
+        private:
+            PSYSTEM_PROCESS_INFORMATION _first;
+        };
+
+        ///<summary>
+        /// Gets the threads of a process entry.
+        ///</summary>
+        ///<param name="entry">
+        /// The process entry. Must come from a SystemExtendedProcessInformation query.
+        ///</param>
+        inline array_range<SYSTEM_EXTENDED_THREAD_INFORMATION> thread_range(const SYSTEM_PROCESS_INFORMATION& entry)
+        {
+            auto first = reinterpret_cast<PSYSTEM_EXTENDED_THREAD_INFORMATION>(const_cast<PSYSTEM_THREAD_INFORMATION>(entry.Threads));
+            return array_range<SYSTEM_EXTENDED_THREAD_INFORMATION>(first, entry.ThreadCount);
+        }
+
+        ///<summary>
+        /// Gets the modules of a SystemModuleInformation buffer.
+        ///</summary>
+        inline array_range<RTL_PROCESS_MODULE_INFORMATION> system_module_range(const uint8_t* buffer)
+        {
+            auto modules = reinterpret_cast<PRTL_PROCESS_MODULES>(const_cast<uint8_t*>(buffer));
+            if(!modules)
+                return array_range<RTL_PROCESS_MODULE_INFORMATION>();
+            return array_range<RTL_PROCESS_MODULE_INFORMATION>(modules->Modules, modules->NumberOfModules);
+        }
+        inline array_range<RTL_PROCESS_MODULE_INFORMATION> system_module_range(const misc::information_buffer& buffer)
+        {
+            return system_module_range(buffer.get());
+        }
+
+        ///<summary>
+        /// Gets the handles of a SystemHandleInformation buffer.
+        ///</summary>
+        inline array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO> handle_range(const uint8_t* buffer)
+        {
+            auto handles = reinterpret_cast<PSYSTEM_HANDLE_INFORMATION>(const_cast<uint8_t*>(buffer));
+            if(!handles)
+                return array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO>();
+            return array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO>(handles->Handles, handles->NumberOfHandles);
+        }
+        inline array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO> handle_range(const misc::information_buffer& buffer)
+        {
+            return handle_range(buffer.get());
+        }
+
+        ///<summary>
+        /// Gets the handles of a SystemExtendedHandleInformation buffer.
+        ///</summary>
+        inline array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX> extended_handle_range(const uint8_t* buffer)
+        {
+            auto handles = reinterpret_cast<PSYSTEM_HANDLE_INFORMATION_EX>(const_cast<uint8_t*>(buffer));
+            if(!handles)
+                return array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX>();
+            return array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX>(handles->Handles, handles->NumberOfHandles);
+        }
+        inline array_range<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX> extended_handle_range(const misc::information_buffer& buffer)
+        {
+            return extended_handle_range(buffer.get());
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <headers.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        ///<summary>
+        /// Cache of the object manager namespace.
+        ///</summary>
+        ///<remarks>
+        /// Directories are loaded the first time they are looked at and kept as arrays
+        /// sorted by name, so lookups are a binary search without any syscall.
+        /// A directory only changes when it is refreshed. Symbolic link targets are
+        /// cached per full path.
+        ///</remarks>
+        class object_namespace
+        {
+        public:
+            struct entry
+            {
+                std::wstring name;
+                std::wstring type_name;
+            };
+
+            ///<summary>
+            /// Gets the shared cache.
+            ///</summary>
+            static object_namespace& instance();
+
+            ///<summary>
+            /// Gets the entries of a directory, sorted by name (case insensitive).
+            ///</summary>
+            ///<param name="directory"> The directory path (i.e "\Device"). </param>
+            ///<param name="entries">   Receives a copy of the entries. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS get_directory(const std::wstring& directory, std::vector<entry>& entries);
+
+            ///<summary>
+            /// Finds an object in a directory.
+            ///</summary>
+            ///<param name="directory"> The directory path. </param>
+            ///<param name="name">      The object name. </param>
+            ///<param name="result">    Receives a copy of the entry. </param>
+            ///<returns>
+            /// The status code. STATUS_NOT_FOUND if the directory has no such object.
+            ///</returns>
+            NTSTATUS find(const std::wstring& directory, const std::wstring& name, entry* result);
+
+            ///<summary>
+            /// Checks if a object exists.
+            ///</summary>
+            ///<param name="directory"> The directory path. </param>
+            ///<param name="name">      The object name. </param>
+            ///<param name="found">     Pointer to a variable that will hold the result. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS object_exists(const std::wstring& directory, const std::wstring& name, bool* found);
+
+            ///<summary>
+            /// Resolves a symbolic link.
+            ///</summary>
+            ///<param name="path">   The link path (i.e "\GLOBAL??\C:"). </param>
+            ///<param name="target"> The link target. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS resolve_symbolic_link(const std::wstring& path, std::wstring& target);
+
+            ///<summary>
+            /// Drops a cached directory, and the cached links it contains.
+            /// It will be reloaded the next time it is looked at.
+            ///</summary>
+            ///<param name="directory"> The directory path. </param>
+            void refresh(const std::wstring& directory);
+
+            ///<summary>
+            /// Drops everything.
+            ///</summary>
+            void refresh_all();
+
+        private:
+            typedef std::vector<entry> directory;
+
+            object_namespace();
+            object_namespace(const object_namespace&) = delete;
+            object_namespace& operator=(const object_namespace&) = delete;
+
+            static std::wstring make_key(const std::wstring& path);
+            static NTSTATUS     load_directory(const std::wstring& path, directory& entries);
+
+            NTSTATUS            get_directory_locked(const std::wstring& path, const directory** entries);
+
+            std::recursive_mutex                                        _lock;
+            std::unordered_map<std::wstring, std::unique_ptr<directory>> _directories;
+            std::unordered_map<std::wstring, std::wstring>              _links;
+        };
+    }
+}
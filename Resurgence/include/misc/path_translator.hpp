@@ -0,0 +1,87 @@
+#pragma once
+
+#include <headers.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        ///<summary>
+        /// Translates NT device paths (i.e "\Device\HarddiskVolume2\...") to DOS paths.
+        ///</summary>
+        ///<remarks>
+        /// The device to drive table is built once and kept in a prefix trie.
+        /// It is only rebuilt when invalidate() is called or when a lookup misses
+        /// and the set of mounted drives has changed since the last build.
+        ///</remarks>
+        class path_translator
+        {
+        public:
+            ///<summary>
+            /// Gets the shared translator.
+            ///</summary>
+            static path_translator& instance();
+
+            ///<summary>
+            /// Rebuilds the device prefix table.
+            ///</summary>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS refresh();
+
+            ///<summary>
+            /// Marks the prefix table as stale. The next translation will rebuild it.
+            /// Call this when a mount change is signaled (i.e WM_DEVICECHANGE).
+            ///</summary>
+            void invalidate();
+
+            ///<summary>
+            /// Translates a device path.
+            ///</summary>
+            ///<param name="path">   The device path. </param>
+            ///<param name="length"> The path length, in characters. </param>
+            ///<param name="result"> The translated path. </param>
+            ///<returns>
+            /// True if a device prefix matched, false otherwise.
+            ///</returns>
+            bool translate(const wchar_t* path, size_t length, std::wstring& result);
+
+            ///<summary>
+            /// Translates a device path.
+            ///</summary>
+            ///<param name="path">   The device path. </param>
+            ///<param name="result"> The translated path. </param>
+            ///<returns>
+            /// True if a device prefix matched, false otherwise.
+            ///</returns>
+            bool translate(const std::wstring& path, std::wstring& result);
+
+        private:
+            path_translator();
+            path_translator(const path_translator&) = delete;
+            path_translator& operator=(const path_translator&) = delete;
+
+            struct trie_node
+            {
+                wchar_t     ch;
+                uint32_t    first_child;
+                uint32_t    next_sibling;
+                int32_t     drive;          // Index into _drives, -1 if no prefix ends here
+            };
+
+            void        insert(const std::wstring& prefix, int32_t drive);
+            int32_t     match(const wchar_t* path, size_t length, size_t* matched) const;
+            NTSTATUS    rebuild();
+
+            std::mutex                  _lock;
+            std::vector<trie_node>      _nodes;
+            std::vector<std::wstring>   _drives;
+            uint32_t                    _driveMask;
+            bool                        _stale;
+        };
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <headers.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        ///<summary>
+        /// A fixed set of worker threads fed from a single queue.
+        ///</summary>
+        class thread_pool
+        {
+        public:
+            ///<summary>
+            /// Creates the pool.
+            ///</summary>
+            ///<param name="threads"> The number of workers, 0 for one per logical processor. </param>
+            explicit thread_pool(size_t threads = 0);
+            ~thread_pool();
+
+            ///<summary>
+            /// Gets the shared pool.
+            ///</summary>
+            static thread_pool& instance();
+
+            ///<summary>
+            /// Gets the number of workers.
+            ///</summary>
+            size_t size() const { return _workers.size(); }
+
+            ///<summary>
+            /// Queues a task.
+            ///</summary>
+            ///<param name="task"> The task. </param>
+            ///<returns>
+            /// A future for the task result.
+            ///</returns>
+            template<typename _Fn>
+            std::future<typename std::result_of<_Fn()>::type> submit(_Fn&& task)
+            {
+                typedef typename std::result_of<_Fn()>::type result_type;
+
+                auto packaged = std::make_shared<std::packaged_task<result_type()>>(std::forward<_Fn>(task));
+                auto future = packaged->get_future();
+                enqueue([packaged]() { (*packaged)(); });
+                return future;
+            }
+
+            ///<summary>
+            /// Runs body(0) ... body(count - 1) on the pool and waits for all of them.
+            ///</summary>
+            ///<param name="count"> The number of iterations. </param>
+            ///<param name="body">  The loop body. </param>
+            ///<remarks>
+            /// The calling thread takes part in the loop, so this may be called from
+            /// a pool task without deadlocking. Iterations must not throw.
+            ///</remarks>
+            void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+        private:
+            thread_pool(const thread_pool&) = delete;
+            thread_pool& operator=(const thread_pool&) = delete;
+
+            void enqueue(std::function<void()> task);
+            void worker();
+
+            std::vector<std::thread>            _workers;
+            std::deque<std::function<void()>>   _tasks;
+            std::mutex                          _lock;
+            std::condition_variable             _signal;
+            bool                                _stopping;
+        };
+    }
+}
@@ -5,6 +5,7 @@
 #include <misc/safe_handle.hpp>
 
 #include <system/driver/driver.hpp>
+#include <system/handle_snapshot.hpp>
 #include <system/portable_executable.hpp>
 #include <system/process.hpp>
 
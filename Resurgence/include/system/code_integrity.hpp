@@ -0,0 +1,168 @@
+#pragma once
+
+#include <headers.hpp>
+#include <vector>
+
+#include "image_file_view.hpp"
+#include "process_modules.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        class process;
+
+        enum code_range_state
+        {
+            code_range_modified,    // The bytes differ from the file
+            code_range_unreadable   // The pages couldn't be read
+        };
+
+        struct code_range
+        {
+            uint32_t            rva;
+            uint32_t            size;
+            uint32_t            section;    // Index in the sections
+            code_range_state    state;
+        };
+
+        struct code_section
+        {
+            char        name[IMAGE_SIZEOF_SHORT_NAME];  // Not terminated when 8 characters long
+            uint32_t    rva;
+            uint32_t    size;       // The bytes compared
+            uint32_t    modified;   // The bytes in modified ranges
+        };
+
+        ///<summary>
+        /// Compares the code sections of a loaded module with its file.
+        ///</summary>
+        ///<remarks>
+        /// The expected bytes are rebuilt from the file: each executable section is laid
+        /// out as the loader maps it and the base relocations are applied for the base
+        /// the module was actually loaded at. The IAT is left out when the linker merged
+        /// it into a code section, since the loader writes it. Anything else the loader
+        /// or the system changes (dynamic value relocations, hotpatches) and breakpoints
+        /// set by debuggers show up as modified.
+        ///</remarks>
+        class code_integrity_check
+        {
+        public:
+            code_integrity_check();
+
+            ///<summary>
+            /// Compares a module with its file.
+            ///</summary>
+            ///<param name="proc">   The process. </param>
+            ///<param name="module"> The module. </param>
+            ///<returns>
+            /// The status code. STATUS_IMAGE_CHECKSUM_MISMATCH if the file isn't the one loaded.
+            ///</returns>
+            NTSTATUS verify(process* proc, const process_module& module);
+
+            ///<summary>
+            /// Gets the code sections compared.
+            ///</summary>
+            const std::vector<code_section>& get_sections() const { return _sections; }
+
+            ///<summary>
+            /// Gets the ranges that differ or couldn't be read, sorted by RVA.
+            ///</summary>
+            const std::vector<code_range>& get_ranges() const { return _ranges; }
+
+            ///<summary>
+            /// Gets the number of bytes compared.
+            ///</summary>
+            uint64_t get_bytes_compared() const { return _bytes; }
+
+            ///<summary>
+            /// Checks whether every byte could be read and matches the file.
+            ///</summary>
+            bool is_intact() const { return _ranges.empty(); }
+
+        private:
+            struct excluded_range
+            {
+                uint32_t    begin;
+                uint32_t    end;
+            };
+
+            NTSTATUS    build_expected(const image_file_view& view, uint64_t base, std::vector<std::vector<uint8_t>>& expected);
+            void        exclude_iat(const image_file_view& view);
+            void        compare(process* proc, const uint8_t* base, uint32_t section, uint8_t* expected, std::vector<uint8_t>& buffer);
+            void        compare_chunk(uint32_t section, uint32_t rva, uint8_t* expected, const uint8_t* live, size_t size);
+            void        add_range(uint32_t section, uint32_t rva, uint32_t size, code_range_state state);
+
+            std::vector<code_section>   _sections;
+            std::vector<code_range>     _ranges;
+            std::vector<excluded_range> _excluded;
+            uint64_t                    _bytes;
+        };
+
+        struct code_integrity_result
+        {
+            process_module          module;
+            NTSTATUS                status;
+            code_integrity_check    check;
+        };
+
+        struct code_integrity_stats
+        {
+            uint64_t    modules;        // Modules compared
+            uint64_t    modified;       // Modules with modified or unreadable ranges
+            uint64_t    failures;       // Modules that couldn't be compared
+            uint64_t    bytes;          // Bytes compared
+            uint64_t    elapsed_ns;
+        };
+
+        ///<summary>
+        /// Compares the code sections of every module of a process with their files.
+        ///</summary>
+        ///<remarks>
+        /// Modules are compared on the shared thread pool, the largest first.
+        ///</remarks>
+        class code_integrity_scan
+        {
+        public:
+            code_integrity_scan();
+
+            ///<summary>
+            /// Compares every module loaded by a process.
+            ///</summary>
+            ///<param name="proc"> The process. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS verify(process* proc);
+
+            ///<summary>
+            /// Compares some modules of a process.
+            ///</summary>
+            ///<param name="proc">    The process. </param>
+            ///<param name="modules"> The modules. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS verify(process* proc, const std::vector<process_module>& modules);
+
+            ///<summary>
+            /// Gets the result of each module, in the order they were given.
+            ///</summary>
+            const std::vector<code_integrity_result>& get_results() const { return _results; }
+
+            ///<summary>
+            /// Gets the statistics of the last scan.
+            ///</summary>
+            const code_integrity_stats& get_stats() const { return _stats; }
+
+            ///<summary>
+            /// Gets the number of gigabytes compared per second by the last scan.
+            ///</summary>
+            double get_gigabytes_per_second() const;
+
+        private:
+            std::vector<code_integrity_result>  _results;
+            code_integrity_stats                _stats;
+        };
+    }
+}
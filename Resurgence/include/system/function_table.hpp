@@ -0,0 +1,104 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <vector>
+
+#include "image_file_view.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct function_table_entry
+        {
+            uint32_t    begin;
+            uint32_t    end;        // Past the last byte
+            uint32_t    unwind;     // RVA of the UNWIND_INFO
+            uint32_t    primary;    // Start of the function the entry belongs to, begin unless chained
+        };
+
+        ///<summary>
+        /// The runtime function table (.pdata) of an x64 image, for function boundary lookups.
+        ///</summary>
+        ///<remarks>
+        /// Entries are sorted by start address, so a lookup is a binary search. Chained
+        /// entries, which describe a fragment of another function (split by PGO, or
+        /// shrink-wrapped prologs), are followed at parse time: primary is the start of
+        /// the function that owns them. Indirect entries are resolved the same way.
+        /// Images of other machines parse to an empty table.
+        ///</remarks>
+        class function_table
+        {
+        public:
+            ///<summary>
+            /// Parses the function table of an image file.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const std::wstring& path);
+
+            ///<summary>
+            /// Parses the function table of an image read in memory (file layout, not loaded).
+            ///</summary>
+            ///<param name="image"> The file contents. </param>
+            ///<param name="size">  The file size. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const uint8_t* image, size_t size);
+
+            ///<summary>
+            /// Parses the function table of an image view whose headers were parsed.
+            ///</summary>
+            ///<param name="view"> The view. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const image_file_view& view);
+
+            ///<summary>
+            /// Finds the entry containing an RVA.
+            ///</summary>
+            ///<param name="rva"> The RVA. </param>
+            ///<returns>
+            /// The entry, nullptr if the RVA isn't in any function (or is in a leaf function without an entry).
+            ///</returns>
+            const function_table_entry* find(uint32_t rva) const;
+
+            ///<summary>
+            /// Finds the entry of the function that owns an RVA, following chained entries.
+            ///</summary>
+            ///<param name="rva"> The RVA. </param>
+            ///<returns>
+            /// The primary entry, nullptr if none.
+            ///</returns>
+            const function_table_entry* find_primary(uint32_t rva) const;
+
+            ///<summary>
+            /// Gets the entries, sorted by start address.
+            ///</summary>
+            const std::vector<function_table_entry>& get_entries() const { return _entries; }
+
+            ///<summary>
+            /// Gets the number of entries.
+            ///</summary>
+            size_t size() const { return _entries.size(); }
+
+            ///<summary>
+            /// Checks whether there are no entries.
+            ///</summary>
+            bool empty() const { return _entries.empty(); }
+
+            ///<summary>
+            /// Checks whether an entry starts a function, rather than being a fragment of one.
+            ///</summary>
+            static bool is_primary(const function_table_entry& entry) { return entry.primary == entry.begin; }
+
+        private:
+            std::vector<function_table_entry> _entries;
+        };
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <headers.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <misc/native_ranges.hpp>
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct handle_entry
+        {
+            uint32_t    pid;
+            uint32_t    handle;
+            uintptr_t   object;
+            uint32_t    granted_access;
+            uint16_t    type_index;
+            uint16_t    attributes;
+        };
+
+        ///<summary>
+        /// Cached object type table (ObjectTypesInformation), indexed by object type index.
+        ///</summary>
+        class object_types
+        {
+        public:
+            ///<summary>
+            /// Gets the type name of an object type index.
+            ///</summary>
+            ///<param name="index"> The object type index. </param>
+            ///<returns>
+            /// The type name, empty if the index is unknown.
+            ///</returns>
+            static std::wstring get_name(uint16_t index);
+
+            ///<summary>
+            /// Reloads the type table, including the indexes that didn't resolve before.
+            ///</summary>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            static NTSTATUS refresh();
+
+        private:
+            static NTSTATUS load();
+
+            static std::mutex                   s_lock;
+            static std::vector<std::wstring>    s_names;
+            static std::vector<bool>            s_missing;  // Indexes a load didn't resolve
+        };
+
+        struct handle_snapshot_diff
+        {
+            std::vector<handle_entry> opened;   // Present only in the newer snapshot
+            std::vector<handle_entry> closed;   // Present only in the older snapshot
+        };
+
+        ///<summary>
+        /// A snapshot of the system handle table, sorted and indexed by process id.
+        ///</summary>
+        class handle_snapshot
+        {
+        public:
+            handle_snapshot();
+
+            ///<summary>
+            /// Captures the system handle table.
+            ///</summary>
+            ///<returns>
+            /// The snapshot. On failure the snapshot is invalid and the status
+            /// can be retrieved with get_last_ntstatus.
+            ///</returns>
+            static handle_snapshot capture();
+
+            ///<summary>
+            /// Compares two snapshots.
+            ///</summary>
+            ///<param name="older"> The older snapshot. </param>
+            ///<param name="newer"> The newer snapshot. </param>
+            ///<returns>
+            /// The handles opened and closed between both snapshots. A handle value
+            /// reused for a different object is reported as closed and opened.
+            ///</returns>
+            static handle_snapshot_diff diff(const handle_snapshot& older, const handle_snapshot& newer);
+
+            ///<summary>
+            /// Checks whether the snapshot was captured.
+            ///</summary>
+            bool is_valid() const { return _valid; }
+
+            ///<summary>
+            /// Gets the number of handles.
+            ///</summary>
+            size_t size() const { return _entries.size(); }
+
+            ///<summary>
+            /// Gets every handle, sorted by process id then handle value.
+            ///</summary>
+            const std::vector<handle_entry>& get_all_handles() const { return _entries; }
+
+            ///<summary>
+            /// Gets the handles owned by a process.
+            ///</summary>
+            ///<param name="pid"> The process id. </param>
+            ///<returns>
+            /// The handles, sorted by handle value.
+            ///</returns>
+            native::array_range<const handle_entry> get_process_handles(uint32_t pid) const;
+
+            ///<summary>
+            /// Finds a handle.
+            ///</summary>
+            ///<param name="pid">    The process id. </param>
+            ///<param name="handle"> The handle value. </param>
+            ///<returns>
+            /// The entry, nullptr if not found.
+            ///</returns>
+            const handle_entry* find(uint32_t pid, uint32_t handle) const;
+
+            ///<summary>
+            /// Gets the object type name of a handle.
+            ///</summary>
+            std::wstring get_type_name(const handle_entry& entry) const;
+
+        private:
+            struct process_index
+            {
+                uint32_t pid;
+                uint32_t first;
+                uint32_t count;
+            };
+
+            void build_index();
+
+            bool                        _valid;
+            std::vector<handle_entry>   _entries;
+            std::vector<process_index>  _index;
+        };
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <headers.hpp>
+#include <vector>
+
+#include "image_exports.hpp"
+#include "image_imports.hpp"
+#include "process_modules.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        class process;
+
+        enum iat_slot_state
+        {
+            iat_slot_expected,      // Holds the address of the export the import resolves to
+            iat_slot_modified,      // Holds some other address
+            iat_slot_unbound,       // A delay-load import that wasn't called yet, the slot points into the module
+            iat_slot_unresolved,    // The export couldn't be found, e.g. the exporting module isn't loaded
+            iat_slot_unreadable     // The slot couldn't be read
+        };
+
+        struct iat_slot
+        {
+            uint32_t        import;     // Index in the import entries
+            uint64_t        value;      // The address in the slot
+            uint64_t        expected;   // The address of the export, 0 if unresolved
+            iat_slot_state  state;
+        };
+
+        ///<summary>
+        /// The IAT of a loaded module, checked against the exports its imports resolve to.
+        ///</summary>
+        ///<remarks>
+        /// The imports come from the module file. The IAT of the normal imports is read
+        /// from the target in a single read, and so are the delay-load slots. Each slot
+        /// is then resolved by name or ordinal in the export index of the exporting module
+        /// (following forwarders), looked up by name in the target. Imports from modules
+        /// that aren't loaded under their own name (API sets) are resolved in the module
+        /// the slot points into.
+        ///</remarks>
+        class iat_snapshot
+        {
+        public:
+            iat_snapshot();
+
+            ///<summary>
+            /// Takes the snapshot of a module.
+            ///</summary>
+            ///<param name="proc">   The process. </param>
+            ///<param name="module"> The module. </param>
+            ///<param name="cache">  The export indexes. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS take(process* proc, const process_module& module, image_export_cache& cache = image_export_cache::instance());
+
+            ///<summary>
+            /// Takes the snapshot of a module, reusing the module list of the process.
+            ///</summary>
+            ///<param name="proc">    The process. </param>
+            ///<param name="module">  The module. </param>
+            ///<param name="modules"> The modules loaded by the process. </param>
+            ///<param name="cache">   The export indexes. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS take(process* proc, const process_module& module, const std::vector<process_module>& modules, image_export_cache& cache = image_export_cache::instance());
+
+            ///<summary>
+            /// Gets the imports of the module.
+            ///</summary>
+            const image_imports& get_imports() const { return _imports; }
+
+            ///<summary>
+            /// Gets the slots, in the same order as the import entries.
+            ///</summary>
+            const std::vector<iat_slot>& get_slots() const { return _slots; }
+
+            ///<summary>
+            /// Gets the number of slots in a state.
+            ///</summary>
+            ///<param name="state"> The state. </param>
+            size_t count(iat_slot_state state) const;
+
+        private:
+            struct loaded_module
+            {
+                std::wstring    name;   // Lower case
+                uintptr_t       base;
+                size_t          size;
+                std::wstring    path;
+            };
+
+            const loaded_module*    find_module(const char* name) const;
+            const loaded_module*    find_module(uint64_t address) const;
+            uint64_t                resolve(image_export_cache& cache, const char* module, const char* name, uint16_t ordinal, bool byOrdinal, uint64_t value, int depth) const;
+            NTSTATUS                read_slots(process* proc, const process_module& module, bool delayed);
+
+            image_imports               _imports;
+            std::vector<iat_slot>       _slots;
+            std::vector<loaded_module>  _byName;
+            std::vector<loaded_module>  _byBase;
+        };
+    }
+}
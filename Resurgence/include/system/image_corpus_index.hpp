@@ -0,0 +1,233 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <vector>
+
+#include <misc/mapped_file.hpp>
+#include "image_debug_info.hpp"
+
+#define IMAGE_CORPUS_FILE_64BIT         0x0001
+#define IMAGE_CORPUS_FILE_PDB           0x0002  // The pdb fields are set
+#define IMAGE_CORPUS_FILE_REPRODUCIBLE  0x0004  // Timestamps are hashes (/Brepro)
+
+#define IMAGE_CORPUS_IMPORT_ORDINAL     0x0001
+#define IMAGE_CORPUS_IMPORT_DELAYED     0x0002
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct image_corpus_file
+        {
+            uint32_t        path;           // Offset of the path, see image_corpus_index::get_string
+            NTSTATUS        status;         // The first parse failure, STATUS_SUCCESS if none
+            uint64_t        file_size;
+            uint32_t        timestamp;
+            uint32_t        image_size;
+            uint16_t        machine;
+            uint16_t        flags;          // IMAGE_CORPUS_FILE_*
+            pdb_identity    pdb;
+            uint32_t        pdb_name;       // Offset of the PDB file name
+            uint32_t        first_section;
+            uint32_t        section_count;
+            uint32_t        first_import;
+            uint32_t        import_count;
+            uint32_t        first_export;
+            uint32_t        export_count;
+        };
+
+        struct image_corpus_section
+        {
+            char            name[IMAGE_SIZEOF_SHORT_NAME];  // Not terminated when 8 characters long
+            uint32_t        rva;
+            uint32_t        virtual_size;
+            uint32_t        raw_size;
+            uint32_t        characteristics;
+        };
+
+        struct image_corpus_import
+        {
+            uint32_t        module;         // Offset of the DLL name, in lower case
+            uint32_t        name;           // Offset of the function name, 0 if imported by ordinal
+            uint16_t        ordinal;        // The ordinal if imported by ordinal, otherwise the hint
+            uint16_t        flags;          // IMAGE_CORPUS_IMPORT_*
+        };
+
+        struct image_corpus_export
+        {
+            uint32_t        name;           // Offset of the name, 0 if exported by ordinal only
+            uint32_t        rva;            // 0 for forwarders
+            uint32_t        forwarder;      // Offset of the forwarder, 0 if not forwarded
+            uint16_t        ordinal;
+        };
+
+        struct image_corpus_stats
+        {
+            uint64_t        files;          // Files indexed
+            uint64_t        images;         // Files parsed without a failure
+            uint64_t        bytes;          // Size of the files
+            uint64_t        elapsed_ms;     // Time spent parsing and writing the index
+        };
+
+        ///<summary>
+        /// Indexes the images of directory trees: headers, sections, imports, exports and
+        /// debug ids, written to one index file that image_corpus_index reads back.
+        ///</summary>
+        ///<remarks>
+        /// Files are mapped and parsed on the shared thread pool, the largest first so
+        /// no worker is left with a big file at the end. Files are taken as they are on
+        /// disk and nothing is loaded, so the images don't need to match the running
+        /// system: a copy of another machine's system directory can be indexed too.
+        ///</remarks>
+        class image_corpus_indexer
+        {
+        public:
+            image_corpus_indexer();
+
+            ///<summary>
+            /// Adds the images of a directory, by extension (.exe, .dll, .sys ...).
+            ///</summary>
+            ///<param name="directory"> The directory. </param>
+            ///<param name="recursive"> Adds the subdirectories too. Junctions and links aren't followed. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS add_directory(const std::wstring& directory, bool recursive = true);
+
+            ///<summary>
+            /// Adds a file, whatever its extension.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<param name="size"> The file size if known, used to parse the largest files first. </param>
+            void add_file(const std::wstring& path, uint64_t size = 0);
+
+            ///<summary>
+            /// Gets the number of files added.
+            ///</summary>
+            size_t size() const { return _files.size(); }
+
+            ///<summary>
+            /// Parses every file added and writes the index.
+            ///</summary>
+            ///<param name="path"> The index file path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS build(const std::wstring& path);
+
+            ///<summary>
+            /// Gets the statistics of the last build.
+            ///</summary>
+            const image_corpus_stats& get_stats() const { return _stats; }
+
+            ///<summary>
+            /// Gets the number of files indexed per second by the last build.
+            ///</summary>
+            double get_files_per_second() const;
+
+        private:
+            struct queued_file
+            {
+                std::wstring    path;
+                uint64_t        size;
+            };
+
+            std::vector<queued_file>    _files;
+            image_corpus_stats          _stats;
+        };
+
+        ///<summary>
+        /// An index written by image_corpus_indexer.
+        ///</summary>
+        ///<remarks>
+        /// The index is mapped and used in place. Every field is stored as a column, one
+        /// array per field, so a query only reads the fields it looks at. Strings are
+        /// stored once (UTF-8), offset 0 is an empty string. Files are sorted by path;
+        /// the sections, imports and exports of a file are contiguous.
+        ///</remarks>
+        class image_corpus_index
+        {
+        public:
+            image_corpus_index();
+
+            ///<summary>
+            /// Opens an index.
+            ///</summary>
+            ///<param name="path"> The index path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path);
+
+            ///<summary>
+            /// Closes the index.
+            ///</summary>
+            void close();
+
+            size_t get_file_count() const { return _fileCount; }
+            size_t get_section_count() const { return _sectionCount; }
+            size_t get_import_count() const { return _importCount; }
+            size_t get_export_count() const { return _exportCount; }
+
+            ///<summary>
+            /// Gets a string, "" if the offset is out of range.
+            ///</summary>
+            const char* get_string(uint32_t offset) const;
+
+            image_corpus_file       get_file(size_t index) const;
+            image_corpus_section    get_section(size_t index) const;
+            image_corpus_import     get_import(size_t index) const;
+            image_corpus_export     get_export(size_t index) const;
+
+            ///<summary>
+            /// Gets the file an import belongs to.
+            ///</summary>
+            size_t get_import_file(size_t index) const;
+
+            ///<summary>
+            /// Gets the file an export belongs to.
+            ///</summary>
+            size_t get_export_file(size_t index) const;
+
+            ///<summary>
+            /// Finds the exports with a name, in every file.
+            ///</summary>
+            ///<param name="name">    The export name, case sensitive. </param>
+            ///<param name="exports"> Receives the export indexes. </param>
+            void find_exports(const char* name, std::vector<uint32_t>& exports) const;
+
+            ///<summary>
+            /// Finds the imports of a function, in every file.
+            ///</summary>
+            ///<param name="module"> The DLL name, case insensitive. </param>
+            ///<param name="name">   The function name, case sensitive. nullptr for every import of the DLL. </param>
+            ///<param name="imports"> Receives the import indexes. </param>
+            void find_imports(const char* module, const char* name, std::vector<uint32_t>& imports) const;
+
+        private:
+            image_corpus_index(const image_corpus_index&) = delete;
+            image_corpus_index& operator=(const image_corpus_index&) = delete;
+
+            size_t find_range(int column, size_t index) const;
+
+            template<typename T>
+            T read(int column, size_t index) const
+            {
+                T value;
+                memcpy(&value, _columns[column] + index * sizeof(T), sizeof(T));
+                return value;
+            }
+
+            misc::mapped_file           _file;
+            std::vector<const uint8_t*> _columns;
+            const char*                 _strings;
+            uint32_t                    _stringsSize;
+            uint32_t                    _fileCount;
+            uint32_t                    _sectionCount;
+            uint32_t                    _importCount;
+            uint32_t                    _exportCount;
+            uint32_t                    _namedExportCount;
+        };
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <vector>
+
+#include "image_file_view.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct image_debug_entry
+        {
+            uint32_t    type;           // IMAGE_DEBUG_TYPE_*
+            uint32_t    timestamp;
+            uint16_t    major_version;
+            uint16_t    minor_version;
+            uint32_t    rva;            // 0 if the data isn't mapped
+            uint32_t    offset;         // The file offset of the data
+            uint32_t    size;
+        };
+
+        ///<summary>
+        /// The identity of a PDB, as recorded in an image or in the PDB itself.
+        ///</summary>
+        struct pdb_identity
+        {
+            GUID        guid;           // All zeroes for NB10 PDBs
+            uint32_t    signature;      // The NB10 timestamp, 0 for RSDS PDBs
+            uint32_t    age;
+        };
+
+        struct image_pogo_entry
+        {
+            uint32_t    rva;
+            uint32_t    size;
+            uint32_t    name;           // Offset of the section name, see image_debug_info::get_name
+        };
+
+        ///<summary>
+        /// The debug directory of an image file: its entries, the PDB the image was
+        /// linked with (CodeView RSDS or NB10), the POGO section contributions and the
+        /// hash of reproducible builds.
+        ///</summary>
+        ///<remarks>
+        /// Everything is copied, so the file can be closed once parsed.
+        ///</remarks>
+        class image_debug_info
+        {
+        public:
+            image_debug_info();
+
+            ///<summary>
+            /// Parses the debug directory of an image file.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const std::wstring& path);
+
+            ///<summary>
+            /// Parses the debug directory of an image read in memory (file layout, not loaded).
+            ///</summary>
+            ///<param name="image"> The file contents. </param>
+            ///<param name="size">  The file size. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const uint8_t* image, size_t size);
+
+            ///<summary>
+            /// Parses the debug directory of an image view whose headers were parsed.
+            ///</summary>
+            ///<param name="view"> The view. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const image_file_view& view);
+
+            ///<summary>
+            /// Removes everything parsed.
+            ///</summary>
+            void clear();
+
+            ///<summary>
+            /// Gets the debug directory entries, in file order.
+            ///</summary>
+            const std::vector<image_debug_entry>& get_entries() const { return _entries; }
+
+            ///<summary>
+            /// Checks whether the image has a CodeView record naming its PDB.
+            ///</summary>
+            bool has_pdb() const { return _pdbPath != 0; }
+
+            ///<summary>
+            /// Gets the identity of the PDB. Only valid if has_pdb is true.
+            ///</summary>
+            const pdb_identity& get_pdb_identity() const { return _pdb; }
+
+            ///<summary>
+            /// Gets the path the linker wrote the PDB to (UTF-8), empty if none.
+            ///</summary>
+            const char* get_pdb_path() const { return &_strings[_pdbPath]; }
+
+            ///<summary>
+            /// Gets the file name of the PDB, empty if none.
+            ///</summary>
+            std::wstring get_pdb_name() const;
+
+            ///<summary>
+            /// Gets the POGO section contributions, in file order.
+            ///</summary>
+            const std::vector<image_pogo_entry>& get_pogo_entries() const { return _pogo; }
+
+            ///<summary>
+            /// Gets the POGO signature ('PGU' or 'LTCG'), 0 if the image has no POGO entry.
+            ///</summary>
+            uint32_t get_pogo_signature() const { return _pogoSignature; }
+
+            ///<summary>
+            /// Gets the name of a POGO entry.
+            ///</summary>
+            const char* get_name(const image_pogo_entry& entry) const { return &_strings[entry.name]; }
+
+            ///<summary>
+            /// Checks whether the image comes from a reproducible build (/Brepro).
+            /// Its timestamps are then hashes, not times.
+            ///</summary>
+            bool is_reproducible() const { return _reproducible; }
+
+            ///<summary>
+            /// Gets the hash of a reproducible build, empty if the image has none.
+            ///</summary>
+            const std::vector<uint8_t>& get_repro_hash() const { return _reproHash; }
+
+        private:
+            uint32_t    add_string(const char* string, size_t length);
+            void        parse_codeview(const uint8_t* data, uint32_t size);
+            void        parse_pogo(const uint8_t* data, uint32_t size);
+            void        parse_repro(const uint8_t* data, uint32_t size);
+
+            std::vector<image_debug_entry>  _entries;
+            std::vector<image_pogo_entry>   _pogo;
+            std::vector<uint8_t>            _reproHash;
+            std::vector<char>               _strings;   // Offset 0 is an empty string
+            pdb_identity                    _pdb;
+            uint32_t                        _pdbPath;
+            uint32_t                        _pogoSignature;
+            bool                            _reproducible;
+        };
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <headers.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image_file_view.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct image_export_entry
+        {
+            uint32_t    rva;        // 0 for forwarders
+            uint32_t    forwarder;  // Offset of "module.function" or "module.#ordinal", 0 if not forwarded
+        };
+
+        ///<summary>
+        /// An index of the exports of an image file, by name and by ordinal.
+        ///</summary>
+        ///<remarks>
+        /// Names are copied and sorted, so lookups are binary searches and don't rely on
+        /// the export name table being sorted. Nothing changes after parsing, so an index
+        /// can be shared between threads.
+        ///</remarks>
+        class image_exports
+        {
+        public:
+            image_exports();
+
+            ///<summary>
+            /// Indexes the exports of an image file.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const std::wstring& path);
+
+            ///<summary>
+            /// Indexes the exports of an image read in memory (file layout, not loaded).
+            ///</summary>
+            ///<param name="image"> The file contents. </param>
+            ///<param name="size">  The file size. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const uint8_t* image, size_t size);
+
+            ///<summary>
+            /// Indexes the exports of an image view whose headers were parsed.
+            ///</summary>
+            ///<param name="view"> The view. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const image_file_view& view);
+
+            ///<summary>
+            /// Finds an export by name.
+            ///</summary>
+            ///<param name="name"> The name. </param>
+            ///<param name="hint"> The hint from the import, the index in the export name table tried first. </param>
+            ///<returns>
+            /// The export, nullptr if none.
+            ///</returns>
+            const image_export_entry* find_by_name(const char* name, uint16_t hint = 0) const;
+
+            ///<summary>
+            /// Finds an export by ordinal.
+            ///</summary>
+            ///<param name="ordinal"> The ordinal, biased (as imported). </param>
+            ///<returns>
+            /// The export, nullptr if none.
+            ///</returns>
+            const image_export_entry* find_by_ordinal(uint16_t ordinal) const;
+
+            ///<summary>
+            /// Gets the forwarder of an export, nullptr if it isn't forwarded.
+            ///</summary>
+            const char* get_forwarder(const image_export_entry& entry) const { return entry.forwarder ? &_strings[entry.forwarder] : nullptr; }
+
+            ///<summary>
+            /// Gets the number of exported functions, with or without a name.
+            ///</summary>
+            size_t size() const { return _functions.size(); }
+
+            ///<summary>
+            /// Gets the exported functions, indexed by ordinal minus the ordinal base.
+            /// Unused ordinals have neither an RVA nor a forwarder.
+            ///</summary>
+            const std::vector<image_export_entry>& get_functions() const { return _functions; }
+
+            ///<summary>
+            /// Gets the ordinal of the first exported function.
+            ///</summary>
+            uint32_t get_ordinal_base() const { return _base; }
+
+            ///<summary>
+            /// Gets the number of names.
+            ///</summary>
+            size_t get_name_count() const { return _names.size(); }
+
+            ///<summary>
+            /// Gets a name, names are sorted.
+            ///</summary>
+            ///<param name="index"> The index of the name, below get_name_count. </param>
+            const char* get_name(size_t index) const { return &_strings[_names[index].name]; }
+
+            ///<summary>
+            /// Gets the index in get_functions of the function a name exports.
+            ///</summary>
+            ///<param name="index"> The index of the name, below get_name_count. </param>
+            uint32_t get_name_function(size_t index) const { return _names[index].function; }
+
+            ///<summary>
+            /// Gets the memory used by the index, in bytes.
+            ///</summary>
+            size_t get_memory_usage() const;
+
+        private:
+            struct named_export
+            {
+                uint32_t    name;       // Offset in _strings
+                uint32_t    function;   // Index in _functions
+            };
+
+            uint32_t add_string(const char* string);
+
+            std::vector<image_export_entry> _functions;     // By ordinal - base
+            std::vector<named_export>       _names;         // Sorted by name
+            std::vector<uint32_t>           _hints;         // Name table index -> index in _names
+            std::vector<char>               _strings;       // Starts with an empty string, so offset 0 is ""
+            uint32_t                        _base;
+        };
+
+        ///<summary>
+        /// Export indexes shared by path, each image is parsed once.
+        ///</summary>
+        ///<remarks>
+        /// Images are identified by their lower case path. An index never changes or
+        /// moves once added, so it stays valid for the lifetime of the cache.
+        ///</remarks>
+        class image_export_cache
+        {
+        public:
+            ///<summary>
+            /// Gets the shared cache.
+            ///</summary>
+            static image_export_cache& instance();
+
+            ///<summary>
+            /// Gets the export index of an image file, parsing it the first time.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The index, nullptr if the file can't be read or isn't an image.
+            ///</returns>
+            const image_exports* get(const std::wstring& path);
+
+            ///<summary>
+            /// Gets the number of images cached, with or without an index.
+            ///</summary>
+            size_t size();
+
+        private:
+            std::mutex                                                      _lock;
+            std::unordered_map<std::wstring, std::unique_ptr<image_exports>> _exports;    // nullptr for files that failed to parse
+        };
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <headers.hpp>
+#include <misc/native.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// An image in file layout (read from disk, not loaded).
+        ///</summary>
+        ///<remarks>
+        /// Every lookup is bounds checked, the file isn't trusted: a lookup that falls
+        /// outside the file or the raw data of its section returns nullptr. The view
+        /// doesn't own the data, which must outlive it.
+        ///</remarks>
+        class image_file_view
+        {
+        public:
+            image_file_view(const uint8_t* data, size_t size)
+                : _data(data), _size(size), _sections(nullptr), _sectionCount(0), _sorted(true),
+                _dirs(nullptr), _dirCount(0), _machine(0), _timestamp(0), _imageSize(0), _imageBase(0), _is64(false)
+            {
+            }
+
+            ///<summary>
+            /// Reads the DOS, NT and section headers. Must succeed before any RVA lookup.
+            ///</summary>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse_headers()
+            {
+                auto dosHdr = at_offset<IMAGE_DOS_HEADER>(0);
+                if(!dosHdr || dosHdr->e_magic != IMAGE_DOS_SIGNATURE || dosHdr->e_lfanew < 0)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+
+                auto ntHdrs = at_offset<IMAGE_NT_HEADERS32>(dosHdr->e_lfanew);
+                if(!ntHdrs || ntHdrs->Signature != IMAGE_NT_SIGNATURE)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+
+                if(ntHdrs->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+                    auto ntHdrs64 = at_offset<IMAGE_NT_HEADERS64>(dosHdr->e_lfanew);
+                    if(!ntHdrs64)
+                        return STATUS_INVALID_IMAGE_FORMAT;
+                    _dirs = ntHdrs64->OptionalHeader.DataDirectory;
+                    _dirCount = ntHdrs64->OptionalHeader.NumberOfRvaAndSizes;
+                    _imageSize = ntHdrs64->OptionalHeader.SizeOfImage;
+                    _imageBase = ntHdrs64->OptionalHeader.ImageBase;
+                    _is64 = true;
+                } else if(ntHdrs->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+                    _dirs = ntHdrs->OptionalHeader.DataDirectory;
+                    _dirCount = ntHdrs->OptionalHeader.NumberOfRvaAndSizes;
+                    _imageSize = ntHdrs->OptionalHeader.SizeOfImage;
+                    _imageBase = ntHdrs->OptionalHeader.ImageBase;
+                    _is64 = false;
+                } else {
+                    return STATUS_INVALID_IMAGE_FORMAT;
+                }
+                _dirCount = std::min<uint32_t>(_dirCount, IMAGE_NUMBEROF_DIRECTORY_ENTRIES);
+                _machine = ntHdrs->FileHeader.Machine;
+                _timestamp = ntHdrs->FileHeader.TimeDateStamp;
+
+                auto sections = at_offset<IMAGE_SECTION_HEADER>(
+                    static_cast<uint64_t>(dosHdr->e_lfanew) + FIELD_OFFSET(IMAGE_NT_HEADERS32, OptionalHeader) + ntHdrs->FileHeader.SizeOfOptionalHeader,
+                    ntHdrs->FileHeader.NumberOfSections);
+                if(!sections)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+                set_sections(sections, ntHdrs->FileHeader.NumberOfSections);
+                return STATUS_SUCCESS;
+            }
+
+            void set_sections(const IMAGE_SECTION_HEADER* sections, uint32_t count)
+            {
+                _sections = sections;
+                _sectionCount = count;
+                _sorted = native::image_sections_sorted(sections, count);
+            }
+
+            ///<summary>
+            /// Gets a data directory.
+            ///</summary>
+            ///<param name="index"> The directory index (IMAGE_DIRECTORY_ENTRY_*). </param>
+            ///<returns>
+            /// The directory, nullptr if the image doesn't have it or it is empty.
+            ///</returns>
+            const IMAGE_DATA_DIRECTORY* get_data_directory(uint32_t index) const
+            {
+                if(index >= _dirCount || _dirs[index].VirtualAddress == 0)
+                    return nullptr;
+                return &_dirs[index];
+            }
+
+            uint16_t get_machine() const { return _machine; }
+            uint32_t get_timestamp() const { return _timestamp; }
+            uint32_t get_image_size() const { return _imageSize; }
+            uint64_t get_image_base() const { return _imageBase; }
+            bool     is_64bit() const { return _is64; }
+
+            const IMAGE_SECTION_HEADER* get_sections() const { return _sections; }
+            uint32_t                    get_section_count() const { return _sectionCount; }
+
+            template<typename T>
+            const T* at_offset(uint64_t offset, uint64_t count = 1) const
+            {
+                if(offset > _size || count > (_size - offset) / sizeof(T))
+                    return nullptr;
+                return reinterpret_cast<const T*>(_data + offset);
+            }
+
+            template<typename T>
+            const T* at_rva(uint32_t rva, uint64_t count = 1) const
+            {
+                auto section = native::image_rva_to_section(_sections, _sectionCount, _sorted, rva);
+                if(!section)
+                    return nullptr;
+
+                uint64_t offset = rva - section->VirtualAddress;
+                if(count * sizeof(T) > section->SizeOfRawData - offset)
+                    return nullptr;
+                return at_offset<T>(section->PointerToRawData + offset, count);
+            }
+
+            const char* string_at_rva(uint32_t rva) const
+            {
+                auto section = native::image_rva_to_section(_sections, _sectionCount, _sorted, rva);
+                if(!section)
+                    return nullptr;
+
+                uint64_t offset = section->PointerToRawData + static_cast<uint64_t>(rva - section->VirtualAddress);
+                uint64_t end = std::min<uint64_t>(section->PointerToRawData + static_cast<uint64_t>(section->SizeOfRawData), _size);
+                if(offset >= end)
+                    return nullptr;
+
+                auto string = reinterpret_cast<const char*>(_data + offset);
+                return memchr(string, 0, static_cast<size_t>(end - offset)) ? string : nullptr;
+            }
+
+        private:
+            const uint8_t*              _data;
+            size_t                      _size;
+            const IMAGE_SECTION_HEADER* _sections;
+            uint32_t                    _sectionCount;
+            bool                        _sorted;
+            const IMAGE_DATA_DIRECTORY* _dirs;
+            uint32_t                    _dirCount;
+            uint16_t                    _machine;
+            uint32_t                    _timestamp;
+            uint32_t                    _imageSize;
+            uint64_t                    _imageBase;
+            bool                        _is64;
+        };
+    }
+}
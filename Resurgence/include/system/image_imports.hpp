@@ -0,0 +1,118 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <vector>
+
+#include "image_file_view.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct image_import_entry
+        {
+            uint32_t    module;     // Offset of the DLL name, see image_imports::get_module_name
+            uint32_t    name;       // Offset of the function name, 0 if imported by ordinal
+            uint32_t    iat_rva;    // The IAT slot the loader writes the address to
+            uint16_t    ordinal;    // The ordinal if imported by ordinal, otherwise the hint
+            bool        by_ordinal;
+            bool        delayed;    // From the delay-load directory
+        };
+
+        ///<summary>
+        /// The imports of an image file, normal and delay-loaded.
+        ///</summary>
+        ///<remarks>
+        /// Names are copied, so the file can be closed once parsed. Imports are kept in
+        /// directory order: the normal ones first, then the delay-loaded ones.
+        ///</remarks>
+        class image_imports
+        {
+        public:
+            image_imports();
+
+            ///<summary>
+            /// Parses the imports of an image file.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const std::wstring& path);
+
+            ///<summary>
+            /// Parses the imports of an image read in memory (file layout, not loaded).
+            ///</summary>
+            ///<param name="image"> The file contents. </param>
+            ///<param name="size">  The file size. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const uint8_t* image, size_t size);
+
+            ///<summary>
+            /// Parses the imports of an image view whose headers were parsed.
+            ///</summary>
+            ///<param name="view"> The view. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS parse(const image_file_view& view);
+
+            ///<summary>
+            /// Removes every import.
+            ///</summary>
+            void clear();
+
+            ///<summary>
+            /// Gets the imports.
+            ///</summary>
+            const std::vector<image_import_entry>& get_entries() const { return _entries; }
+
+            ///<summary>
+            /// Gets the number of imports.
+            ///</summary>
+            size_t size() const { return _entries.size(); }
+
+            ///<summary>
+            /// Checks whether there are no imports.
+            ///</summary>
+            bool empty() const { return _entries.empty(); }
+
+            ///<summary>
+            /// Gets the DLL an import comes from, as written in the image.
+            ///</summary>
+            const char* get_module_name(const image_import_entry& entry) const { return &_strings[entry.module]; }
+
+            ///<summary>
+            /// Gets the name of an import, nullptr if it is imported by ordinal.
+            ///</summary>
+            const char* get_name(const image_import_entry& entry) const { return entry.by_ordinal ? nullptr : &_strings[entry.name]; }
+
+            ///<summary>
+            /// Gets the size of an IAT slot: 8 for PE32+ images, 4 otherwise.
+            ///</summary>
+            uint32_t get_slot_size() const { return _slotSize; }
+
+            ///<summary>
+            /// Gets the RVA range spanned by the IAT slots of one kind of import.
+            ///</summary>
+            ///<param name="delayed"> Whether to get the delay-load slots. </param>
+            ///<param name="begin">   Receives the first slot RVA. </param>
+            ///<param name="end">     Receives the RVA past the last slot. </param>
+            ///<returns>
+            /// false if there are no imports of that kind.
+            ///</returns>
+            bool get_iat_range(bool delayed, uint32_t* begin, uint32_t* end) const;
+
+        private:
+            uint32_t add_string(const char* string);
+            void     add_thunks(const image_file_view& view, uint32_t module, uint32_t names, uint32_t iat, bool delayed);
+
+            std::vector<image_import_entry> _entries;
+            std::vector<char>               _strings;   // Starts with an empty string, so offset 0 is ""
+            uint32_t                        _slotSize;
+        };
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <headers.hpp>
+#include <system/symbols/field_layout.hpp>
 
 namespace resurgence
 {
@@ -24,6 +25,16 @@ namespace resurgence
             template<typename _Ty> std::string  read_string(_Ty address, size_t length);
             template<typename _Ty> std::wstring read_unicode_string(_Ty address, size_t length);
 
+            ///<summary>
+            /// Reads a structure field, with its layout from a type_table or a generated header.
+            ///</summary>
+            ///<param name="base">  The address of the structure. </param>
+            ///<param name="field"> The field layout. </param>
+            ///<returns>
+            /// The value. Only the smaller of the field and _Ty is read, bitfields are shifted and masked.
+            ///</returns>
+            template<typename _Ty> _Ty          read_field(const uint8_t* base, const field_layout& field);
+
         private:
             friend class process;
             process_memory();
@@ -59,5 +70,20 @@ namespace resurgence
             delete[] buffer;
             return str;
         }
+        template<typename _Ty> _Ty process_memory::read_field(const uint8_t* base, const field_layout& field)
+        {
+            _Ty buffer = _Ty();
+            if(field.bit_length == 0) {
+                read_bytes(base + field.offset, (uint8_t*)&buffer, field.size < sizeof(_Ty) ? field.size : sizeof(_Ty));
+                return buffer;
+            }
+            uint64_t bits = 0;
+            read_bytes(base + field.offset, (uint8_t*)&bits, field.size < sizeof(bits) ? field.size : sizeof(bits));
+            bits >>= field.bit_position;
+            if(field.bit_length < 64)
+                bits &= (1ull << field.bit_length) - 1;
+            memcpy(&buffer, &bits, sizeof(_Ty) < sizeof(bits) ? sizeof(_Ty) : sizeof(bits));
+            return buffer;
+        }
     }
 }
@@ -61,6 +61,11 @@ namespace resurgence
             ///</summary>
             size_t get_size() const { return _size; }
 
+            ///<summary>
+            /// Gets the link timestamp recorded by the loader, 0 for system modules.
+            ///</summary>
+            uint32_t get_timestamp() const { return _timestamp; }
+
             ///<summary>
             /// Gets the module name.
             ///</summary>
@@ -94,6 +99,7 @@ namespace resurgence
             process*            _process;
             uint8_t*            _base;
             size_t              _size;
+            uint32_t            _timestamp;
             std::wstring        _name;
             std::wstring        _path;
             portable_executable _pe;
@@ -14,6 +14,16 @@ namespace resurgence
         public:
             process_thread(process* owner, PSYSTEM_EXTENDED_THREAD_INFORMATION exThread);
 
+            ///<summary>
+            /// Gets the thread id.
+            ///</summary>
+            uint32_t get_id() const { return _id; }
+
+            ///<summary>
+            /// Gets the thread start address.
+            ///</summary>
+            uintptr_t get_start_address() const { return _startAddress; }
+
         private:
             process*    _process;
             uint32_t    _id;
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <headers.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "process_modules.hpp"
+#include "sampling_target.hpp"
+#include "stack_unwinder.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        class process;
+
+        struct call_tree_node
+        {
+            uint32_t    frame;      // Index in the frame addresses, the root has none
+            uint32_t    parent;
+            uint64_t    self;       // Samples that stopped in this node
+            uint64_t    total;      // Samples that went through this node
+        };
+
+        ///<summary>
+        /// Stack samples merged into a trie, from the outermost frame to the innermost.
+        ///</summary>
+        ///<remarks>
+        /// Frames are stored once, as an index in the address table, and stacks sharing
+        /// callers share their nodes. Node 0 is the root, above every thread entry point.
+        ///</remarks>
+        class call_tree
+        {
+        public:
+            call_tree();
+
+            ///<summary>
+            /// Adds a stack.
+            ///</summary>
+            ///<param name="frames"> The frame addresses, innermost first (the order stacks are unwound in). </param>
+            ///<param name="count">  The number of frames. </param>
+            ///<param name="weight"> The number of samples the stack stands for. </param>
+            void add(const uint64_t* frames, size_t count, uint64_t weight = 1);
+
+            ///<summary>
+            /// Removes every sample.
+            ///</summary>
+            void clear();
+
+            ///<summary>
+            /// Gets the nodes. A node always comes after its parent.
+            ///</summary>
+            const std::vector<call_tree_node>& get_nodes() const { return _nodes; }
+
+            ///<summary>
+            /// Gets the frame addresses, each one appears once.
+            ///</summary>
+            const std::vector<uint64_t>& get_frames() const { return _frames; }
+
+            ///<summary>
+            /// Gets the number of samples.
+            ///</summary>
+            uint64_t get_samples() const { return _nodes[0].total; }
+
+            ///<summary>
+            /// Writes the stacks in the folded format of flame graph tools: one line per
+            /// stack, outermost frame first, separated by semicolons, then the sample count.
+            ///</summary>
+            ///<param name="names"> The name of each frame, indexed like the frame addresses. </param>
+            ///<param name="out">   The string the lines are appended to. </param>
+            void write_folded(const std::vector<std::wstring>& names, std::wstring& out) const;
+
+        private:
+            std::vector<call_tree_node>             _nodes;
+            std::vector<uint64_t>                   _frames;
+            std::unordered_map<uint64_t, uint32_t>  _frameIndex;    // Address -> frame
+            std::unordered_map<uint64_t, uint32_t>  _children;      // Parent node << 32 | frame -> node
+        };
+
+        struct sampling_overhead
+        {
+            uint64_t    samples;    // Threads sampled
+            uint64_t    failures;   // Threads that couldn't be suspended, captured or unwound
+            uint64_t    total_ns;   // Time the threads were suspended
+            uint64_t    max_ns;
+        };
+
+        ///<summary>
+        /// A sampling profiler for x64 processes.
+        ///</summary>
+        ///<remarks>
+        /// Each sample suspends every thread of the target in turn, captures its registers
+        /// and unwinds its stack before resuming it. The time each thread is kept
+        /// suspended is recorded as the sampling overhead. Threads are suspended and read
+        /// through a sampling_target, so the profiler itself doesn't depend on how.
+        ///
+        /// Stacks only hold addresses while sampling. Names are looked up once per frame,
+        /// from the shared symbol service, when the folded stacks are written.
+        ///</remarks>
+        class sampling_profiler
+        {
+        public:
+            ///<summary>
+            /// Creates a profiler.
+            ///</summary>
+            ///<param name="proc"> The target process, opened with PROCESS_VM_READ access. </param>
+            explicit sampling_profiler(process* proc);
+
+            ///<summary>
+            /// Creates a profiler.
+            ///</summary>
+            ///<param name="target"> The target, which must outlive the profiler. </param>
+            explicit sampling_profiler(sampling_target& target);
+            ~sampling_profiler();
+
+            ///<summary>
+            /// Starts sampling on a background thread. Modules are read again on each start.
+            ///</summary>
+            ///<param name="interval"> The time between samples, in milliseconds. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS start(uint32_t interval = 1);
+
+            ///<summary>
+            /// Stops sampling and waits for the background thread.
+            ///</summary>
+            void stop();
+
+            ///<summary>
+            /// Takes one sample of every thread, without the background thread.
+            ///</summary>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS sample();
+
+            ///<summary>
+            /// Removes every sample and the overhead counters.
+            ///</summary>
+            void clear();
+
+            ///<summary>
+            /// Gets the samples. Only valid while stopped.
+            ///</summary>
+            const call_tree& get_tree() const { return _tree; }
+
+            ///<summary>
+            /// Gets the overhead of every thread sampled, by thread id. Only valid while stopped.
+            ///</summary>
+            const std::unordered_map<uint32_t, sampling_overhead>& get_thread_overhead() const { return _overhead; }
+
+            ///<summary>
+            /// Gets the overhead of all threads.
+            ///</summary>
+            sampling_overhead get_overhead();
+
+            ///<summary>
+            /// Symbolizes the samples and writes them as folded stacks.
+            ///</summary>
+            ///<returns>
+            /// The folded stacks.
+            ///</returns>
+            std::wstring get_folded_stacks();
+
+        private:
+            sampling_profiler(const sampling_profiler&) = delete;
+            sampling_profiler& operator=(const sampling_profiler&) = delete;
+
+            NTSTATUS    prepare();
+            NTSTATUS    sample_thread(uint32_t id);
+            void        run(uint32_t interval);
+
+            std::unique_ptr<sampling_target>                    _ownTarget; // Set when created from a process
+            sampling_target&                                    _target;
+            std::unique_ptr<stack_unwinder>                     _unwinder;
+            std::vector<process_module>                         _modules;   // Sorted by base
+            std::vector<uint32_t>                               _threads;
+            std::unordered_map<uint32_t, sampling_overhead>     _overhead;
+            std::vector<unwind_frame>                           _frames;
+            std::vector<uint64_t>                               _stack;
+            call_tree                                           _tree;
+
+            std::mutex                  _lock;      // Guards everything above while sampling
+            std::thread                 _sampler;
+            std::condition_variable     _signal;
+            bool                        _stopping;
+        };
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <headers.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <misc/safe_handle.hpp>
+#include "process_modules.hpp"
+#include "stack_unwinder.hpp"
+#include "unwind_memory.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        class process;
+
+        ///<summary>
+        /// What the sampling profiler needs from the process it samples.
+        ///</summary>
+        ///<remarks>
+        /// A sample lists the threads, then for each one suspends it, captures its registers
+        /// and reads its stack before resuming it. Implementations only deal with the
+        /// operating system; unwinding and the call tree are left to the profiler.
+        /// Calls come from one thread at a time.
+        ///</remarks>
+        class sampling_target
+        {
+        public:
+            virtual ~sampling_target() {}
+
+            ///<summary>
+            /// Checks the target can be sampled and reads its modules. Called on each start.
+            ///</summary>
+            ///<param name="modules"> Receives the modules. </param>
+            ///<returns>
+            /// The status code, STATUS_NOT_SUPPORTED if the target can't be sampled.
+            ///</returns>
+            virtual NTSTATUS get_modules(std::vector<process_module>& modules) = 0;
+
+            ///<summary>
+            /// Lists the threads. Whatever is held for threads no longer listed can be released.
+            ///</summary>
+            ///<param name="threads"> Receives the thread ids. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            virtual NTSTATUS get_threads(std::vector<uint32_t>& threads) = 0;
+
+            ///<summary>
+            /// Suspends a thread.
+            ///</summary>
+            ///<param name="thread"> The thread id. </param>
+            ///<returns>
+            /// The status code. The thread must be resumed only if it succeeds.
+            ///</returns>
+            virtual NTSTATUS suspend(uint32_t thread) = 0;
+
+            ///<summary>
+            /// Captures the registers of a suspended thread.
+            ///</summary>
+            ///<param name="thread">  The thread id. </param>
+            ///<param name="context"> Receives the registers. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            virtual NTSTATUS capture(uint32_t thread, unwind_context& context) = 0;
+
+            ///<summary>
+            /// Resumes a suspended thread.
+            ///</summary>
+            ///<param name="thread"> The thread id. </param>
+            virtual void resume(uint32_t thread) = 0;
+
+            ///<summary>
+            /// Gets the memory stacks are read from.
+            ///</summary>
+            virtual unwind_memory_source& get_memory() = 0;
+
+            ///<summary>
+            /// Checks whether the target exited.
+            ///</summary>
+            virtual bool has_exited() = 0;
+        };
+
+        ///<summary>
+        /// Samples a process through the native API.
+        ///</summary>
+        ///<remarks>
+        /// Thread handles are opened when a thread is first listed and kept until it no
+        /// longer is. Threads that can't be opened are tried again on the next list.
+        /// Only x64 processes can be sampled, from an x64 build, and never the current
+        /// process: a suspended thread may hold a lock (the heap's, for one) the sampling
+        /// thread needs.
+        ///</remarks>
+        class process_sampling_target : public sampling_target
+        {
+        public:
+            ///<summary>
+            /// Creates a target.
+            ///</summary>
+            ///<param name="proc"> The process, opened with PROCESS_VM_READ access. </param>
+            explicit process_sampling_target(process* proc);
+
+            NTSTATUS                get_modules(std::vector<process_module>& modules) override;
+            NTSTATUS                get_threads(std::vector<uint32_t>& threads) override;
+            NTSTATUS                suspend(uint32_t thread) override;
+            NTSTATUS                capture(uint32_t thread, unwind_context& context) override;
+            void                    resume(uint32_t thread) override;
+            unwind_memory_source&   get_memory() override { return _memory; }
+            bool                    has_exited() override;
+
+        private:
+            HANDLE  get_thread(uint32_t thread) const;
+
+            process*                                                                _process;
+            process_unwind_memory                                                   _memory;
+            std::unordered_map<uint32_t, std::unique_ptr<misc::safe_generic_handle>> _threads;   // Open thread handles by id
+        };
+    }
+}
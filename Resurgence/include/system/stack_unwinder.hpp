@@ -0,0 +1,185 @@
+#pragma once
+
+#include <headers.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <misc/mapped_file.hpp>
+#include "function_table.hpp"
+#include "image_file_view.hpp"
+#include "process_modules.hpp"
+#include "unwind_memory.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// The x64 integer registers an unwind needs.
+        ///</summary>
+        struct unwind_context
+        {
+            uint64_t    rip;
+            uint64_t    regs[16];   // In encoding order: rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8 ... r15
+        };
+
+        struct unwind_frame
+        {
+            uint64_t    rip;            // The return address, the instruction pointer in the first frame
+            uint64_t    rsp;            // The stack pointer on entry to the frame
+            bool        interrupted;    // rip was popped from a machine frame: the interrupted instruction, not a return address
+        };
+
+        ///<summary>
+        /// A module's function table and unwind info, read from its file.
+        ///</summary>
+        class unwind_module
+        {
+        public:
+            ///<summary>
+            /// Loads a module file.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path);
+
+            ///<summary>
+            /// Gets the file view, for the unwind info and the code of epilogs.
+            ///</summary>
+            const image_file_view& get_view() const { return *_view; }
+
+            ///<summary>
+            /// Gets the function table.
+            ///</summary>
+            const function_table& get_functions() const { return _functions; }
+
+        private:
+            misc::mapped_file               _file;
+            std::unique_ptr<image_file_view> _view;
+            function_table                  _functions;
+        };
+
+        ///<summary>
+        /// Unwind modules shared by path, each file is loaded once.
+        ///</summary>
+        ///<remarks>
+        /// A module never changes or moves once added, so it stays valid for the lifetime
+        /// of the cache. Files stay mapped as long as the cache.
+        ///</remarks>
+        class unwind_module_cache
+        {
+        public:
+            ///<summary>
+            /// Gets the shared cache.
+            ///</summary>
+            static unwind_module_cache& instance();
+
+            ///<summary>
+            /// Gets a module, loading it the first time.
+            ///</summary>
+            ///<param name="path"> The image path. </param>
+            ///<returns>
+            /// The module, nullptr if the file can't be read or isn't an image.
+            ///</returns>
+            const unwind_module* get(const std::wstring& path);
+
+        private:
+            std::mutex                                                      _lock;
+            std::unordered_map<std::wstring, std::unique_ptr<unwind_module>> _modules;    // nullptr for files that failed to load
+        };
+
+        ///<summary>
+        /// Unwinds x64 stacks from the unwind info of the modules (.pdata and .xdata).
+        ///</summary>
+        ///<remarks>
+        /// Each frame is unwound the way RtlVirtualUnwind does it: epilogs are detected
+        /// from the code at the instruction pointer, prologs only undo the instructions
+        /// that ran, chained unwind info is followed and machine frames are popped.
+        /// Functions without unwind info are leaves, whose return address is at rsp.
+        ///
+        /// Stack memory is read a page at a time and kept for the next reads of the
+        /// same unwind, instead of a read for every word. Modules must all be added
+        /// before unwinding; after that any number of threads can unwind at once.
+        ///</remarks>
+        class stack_unwinder
+        {
+        public:
+            ///<summary>
+            /// Creates an unwinder.
+            ///</summary>
+            ///<param name="memory"> The memory stacks are read from. </param>
+            ///<param name="cache">  The unwind modules. </param>
+            explicit stack_unwinder(unwind_memory_source& memory, unwind_module_cache& cache = unwind_module_cache::instance());
+
+            ///<summary>
+            /// Adds a module.
+            ///</summary>
+            ///<param name="base"> The address the module is loaded at. </param>
+            ///<param name="size"> The size of the module. </param>
+            ///<param name="path"> The module file. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS add_module(uint64_t base, size_t size, const std::wstring& path);
+
+            ///<summary>
+            /// Adds the modules of a process. Modules that can't be loaded are skipped.
+            ///</summary>
+            ///<param name="modules"> The modules. </param>
+            void add_modules(const std::vector<process_module>& modules);
+
+            ///<summary>
+            /// Unwinds a stack.
+            ///</summary>
+            ///<param name="context">   The registers of the thread. </param>
+            ///<param name="frames">    Receives the frames, starting with the context itself. </param>
+            ///<param name="maxFrames"> The maximum number of frames. </param>
+            ///<returns>
+            /// The status code. The frames unwound before a failure are kept.
+            ///</returns>
+            NTSTATUS unwind(const unwind_context& context, std::vector<unwind_frame>& frames, size_t maxFrames = 256) const;
+
+            ///<summary>
+            /// Unwinds many stacks at once, on the shared thread pool.
+            ///</summary>
+            ///<param name="contexts">  The registers of the threads. </param>
+            ///<param name="stacks">    Receives the frames of each context, in the same order. </param>
+            ///<param name="maxFrames"> The maximum number of frames per stack. </param>
+            void unwind_all(const std::vector<unwind_context>& contexts, std::vector<std::vector<unwind_frame>>& stacks, size_t maxFrames = 256) const;
+
+        #ifdef _WIN64
+            ///<summary>
+            /// Captures the registers of a suspended thread.
+            ///</summary>
+            ///<param name="thread">  The thread handle, with THREAD_GET_CONTEXT access. </param>
+            ///<param name="context"> Receives the registers. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            static NTSTATUS capture(HANDLE thread, unwind_context& context);
+        #endif
+
+        private:
+            class stack_reader;
+
+            struct loaded_module
+            {
+                uint64_t                base;
+                size_t                  size;
+                const unwind_module*    module;
+            };
+
+            const loaded_module*    find_module(uint64_t address) const;
+            NTSTATUS                step(stack_reader& stack, unwind_context& context, bool& machineFrame) const;
+
+            unwind_memory_source&       _memory;
+            unwind_module_cache&        _cache;
+            std::vector<loaded_module>  _modules;   // Sorted by base
+        };
+    }
+}
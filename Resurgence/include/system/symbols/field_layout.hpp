@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Where a structure field lives. Generated layout headers are made of these.
+        ///</summary>
+        struct field_layout
+        {
+            uint32_t    offset;
+            uint32_t    size;           // Size of the field, or of the bitfield's storage unit
+            uint8_t     bit_position;
+            uint8_t     bit_length;     // 0 if not a bitfield
+            uint16_t    reserved;
+        };
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+
+#include "symbol_table.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Builds symbol tables from an image file alone, for modules without a PDB.
+        ///</summary>
+        ///<remarks>
+        /// On x64 the function boundaries come from the runtime function table (.pdata);
+        /// chained entries are folded into the function that owns them. Each function is
+        /// named after the nearest export at or below its start (Export, Export+0x40),
+        /// or sub_RVA when no export precedes it. Exports themselves are added too, which
+        /// is all there is for images without .pdata.
+        ///</remarks>
+        class image_symbols
+        {
+        public:
+            ///<summary>
+            /// Builds the table of an image file.
+            ///</summary>
+            ///<param name="path">  The image path. </param>
+            ///<param name="table"> The table, finalized on success. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            static NTSTATUS build(const std::wstring& path, symbol_table& table);
+
+            ///<summary>
+            /// Builds the table of an image read in memory (file layout, not loaded).
+            ///</summary>
+            ///<param name="image"> The file contents. </param>
+            ///<param name="size">  The file size. </param>
+            ///<param name="table"> The table, finalized on success. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            static NTSTATUS build(const uint8_t* image, size_t size, symbol_table& table);
+        };
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pdb_file.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct line_table_entry
+        {
+            uint32_t    rva;
+            uint32_t    file;       // File index
+            uint32_t    line;       // 0 where a range of lines ends
+        };
+
+        ///<summary>
+        /// The source lines of a module, by RVA.
+        ///</summary>
+        ///<remarks>
+        /// Each entry starts a run of code belonging to one line, up to the next entry.
+        /// Runs that end without another line following (the end of a function) get an
+        /// entry with line 0, so addresses in padding or data don't borrow a line.
+        /// File names are interned: entries hold an index, each name is stored once.
+        ///</remarks>
+        class line_table
+        {
+        public:
+            line_table();
+
+            ///<summary>
+            /// Reads the C13 line information of every compiland of a PDB.
+            /// Any lines already in the table are dropped.
+            ///</summary>
+            ///<param name="pdb"> The PDB. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS build(pdb_file& pdb);
+
+            ///<summary>
+            /// Interns a file name.
+            ///</summary>
+            ///<param name="name">   The name (UTF-8). </param>
+            ///<param name="length"> The name length. </param>
+            ///<returns>
+            /// The file index.
+            ///</returns>
+            uint32_t add_file(const char* name, size_t length);
+
+            ///<summary>
+            /// Adds a line. Call finalize once all lines are added.
+            ///</summary>
+            ///<param name="rva">  The first byte of the line. </param>
+            ///<param name="file"> The file index, from add_file. </param>
+            ///<param name="line"> The line number, 0 to end the previous line there. </param>
+            void add(uint32_t rva, uint32_t file, uint32_t line);
+
+            ///<summary>
+            /// Sorts the lines and drops redundant ones.
+            ///</summary>
+            void finalize();
+
+            ///<summary>
+            /// Gets the number of entries.
+            ///</summary>
+            size_t size() const { return _entries.size(); }
+
+            ///<summary>
+            /// Checks whether the table is empty.
+            ///</summary>
+            bool empty() const { return _entries.empty(); }
+
+            ///<summary>
+            /// Gets the entries, sorted by RVA.
+            ///</summary>
+            const std::vector<line_table_entry>& get_entries() const { return _entries; }
+
+            ///<summary>
+            /// Gets the number of files.
+            ///</summary>
+            size_t get_file_count() const { return _files.size(); }
+
+            ///<summary>
+            /// Gets the name of a file.
+            ///</summary>
+            const char* get_file(uint32_t file) const { return file < _files.size() ? _strings.data() + _files[file] : ""; }
+
+            ///<summary>
+            /// Gets the memory used by the table, in bytes.
+            ///</summary>
+            size_t get_memory_usage() const;
+
+            ///<summary>
+            /// Finds the line containing an address.
+            ///</summary>
+            ///<param name="rva"> The RVA. </param>
+            ///<returns>
+            /// The line, nullptr if none.
+            ///</returns>
+            const line_table_entry* find(uint32_t rva) const;
+
+            ///<summary>
+            /// Finds the lines of many addresses at once.
+            ///</summary>
+            ///<param name="rvas">    The RVAs, sorted in ascending order. </param>
+            ///<param name="count">   The number of RVAs. </param>
+            ///<param name="results"> Receives the lines (nullptr if none), in the same order as the RVAs. </param>
+            void find_sorted(const uint32_t* rvas, size_t count, const line_table_entry** results) const;
+
+        private:
+            void clear();
+
+            std::vector<line_table_entry>               _entries;
+            std::vector<uint32_t>                       _files;     // Name offsets in _strings
+            std::vector<char>                           _strings;
+            std::unordered_map<std::string, uint32_t>   _interned;  // Only used while building
+        };
+    }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <headers.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <misc/mapped_file.hpp>
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct pdb_symbol
+        {
+            uint32_t    rva;
+            uint16_t    segment;    // 1-based section index
+            uint32_t    offset;     // Offset in the section
+            const char* name;       // Points into the PDB, valid as long as the pdb_file
+        };
+
+        struct pdb_module
+        {
+            std::string name;
+            std::string object_name;
+            uint16_t    stream;         // Symbol stream, 0xFFFF if none
+            uint32_t    symbols_size;
+            uint32_t    c11_size;
+            uint32_t    c13_size;
+            uint16_t    section;        // First section contribution
+            uint32_t    offset;
+            uint32_t    size;
+        };
+
+        struct pdb_section_map_entry
+        {
+            uint16_t    flags;
+            uint16_t    overlay;
+            uint16_t    group;
+            uint16_t    frame;
+            uint16_t    name;
+            uint16_t    class_name;
+            uint32_t    offset;
+            uint32_t    length;
+        };
+
+        ///<summary>
+        /// Reads a program database without dbghelp.
+        ///</summary>
+        ///<remarks>
+        /// The file is mapped and only the MSF stream directory is read when it is opened.
+        /// The DBI stream, module list, section headers, publics and globals are parsed on
+        /// first use. Streams whose blocks are contiguous in the file are used in place,
+        /// others are copied once. All queries are safe to call from several threads.
+        ///</remarks>
+        class pdb_file
+        {
+        public:
+            pdb_file();
+            ~pdb_file();
+
+            ///<summary>
+            /// Opens a PDB.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path);
+
+            ///<summary>
+            /// Checks whether a PDB is open.
+            ///</summary>
+            bool is_open() const { return _file.is_open(); }
+
+            ///<summary>
+            /// Gets the PDB GUID, all zeroes for old NB10 PDBs.
+            ///</summary>
+            const GUID& get_guid() const { return _guid; }
+
+            ///<summary>
+            /// Gets the PDB age.
+            ///</summary>
+            uint32_t get_age() const { return _age; }
+
+            ///<summary>
+            /// Gets the PDB signature (timestamp).
+            ///</summary>
+            uint32_t get_signature() const { return _signature; }
+
+            ///<summary>
+            /// Gets the target machine (IMAGE_FILE_MACHINE_*).
+            ///</summary>
+            uint16_t get_machine();
+
+            ///<summary>
+            /// Gets the compilands.
+            ///</summary>
+            const std::vector<pdb_module>& get_modules();
+
+            ///<summary>
+            /// Gets the section map.
+            ///</summary>
+            const std::vector<pdb_section_map_entry>& get_section_map();
+
+            ///<summary>
+            /// Gets the image section headers stored in the PDB.
+            ///</summary>
+            const std::vector<IMAGE_SECTION_HEADER>& get_sections();
+
+            ///<summary>
+            /// Gets the public symbols, sorted by RVA.
+            ///</summary>
+            const std::vector<pdb_symbol>& get_public_symbols();
+
+            ///<summary>
+            /// Converts a section:offset pair to a RVA.
+            ///</summary>
+            ///<param name="segment"> The 1-based section index. </param>
+            ///<param name="offset">  The offset in the section. </param>
+            ///<returns>
+            /// The RVA, 0 if the section is unknown.
+            ///</returns>
+            uint32_t section_offset_to_rva(uint16_t segment, uint32_t offset);
+
+            ///<summary>
+            /// Finds the public symbol containing an address.
+            ///</summary>
+            ///<param name="rva">          The RVA. </param>
+            ///<param name="symbol">       The returned symbol. </param>
+            ///<param name="displacement"> The distance between the symbol and the RVA. </param>
+            ///<returns>
+            /// True if a symbol precedes the RVA in its section.
+            ///</returns>
+            bool find_symbol_by_rva(uint32_t rva, pdb_symbol& symbol, uint32_t* displacement);
+
+            ///<summary>
+            /// Finds a symbol by name.
+            ///</summary>
+            ///<param name="name">   The name, decorated as stored in the PDB. </param>
+            ///<param name="symbol"> The returned symbol. </param>
+            ///<returns>
+            /// True if found in the publics or globals.
+            ///</returns>
+            bool find_symbol_by_name(const std::string& name, pdb_symbol& symbol);
+
+            ///<summary>
+            /// Reads a whole stream.
+            ///</summary>
+            ///<param name="index"> The stream index. </param>
+            ///<param name="data">  The returned data, valid as long as the pdb_file. </param>
+            ///<param name="size">  The returned size. </param>
+            ///<returns>
+            /// False if the stream doesn't exist.
+            ///</returns>
+            bool read_stream(uint32_t index, const uint8_t** data, uint32_t* size);
+
+            ///<summary>
+            /// Finds a named stream (e.g. /names) in the info stream.
+            ///</summary>
+            ///<param name="name">  The stream name. </param>
+            ///<param name="index"> The returned stream index. </param>
+            ///<returns>
+            /// True if found.
+            ///</returns>
+            bool find_named_stream(const char* name, uint32_t* index);
+
+            ///<summary>
+            /// Gets the memory used by the PDB, in bytes: the streams copied out of the file
+            /// and the parsed tables. The mapped file itself isn't counted.
+            ///</summary>
+            size_t get_memory_usage();
+
+        private:
+            struct stream_view
+            {
+                const uint8_t*          data;
+                uint32_t                size;
+                std::vector<uint8_t>    copy;   // Used when the blocks are not contiguous
+            };
+
+            struct hash_table
+            {
+                const uint8_t*  records;        // {int32 offset + 1; int32 ref}
+                uint32_t        record_count;
+                const uint32_t* bitmap;         // One bit per non empty bucket
+                const uint32_t* buckets;        // Chain starts of the non empty buckets
+                uint32_t        bucket_count;
+            };
+
+            pdb_file(const pdb_file&) = delete;
+            pdb_file& operator=(const pdb_file&) = delete;
+
+            const stream_view*  get_stream(uint32_t index);
+            bool                read_hash_table(const uint8_t* data, uint32_t size, hash_table& table);
+            bool                find_in_hash_table(const hash_table& table, const std::string& name, pdb_symbol& symbol);
+            bool                read_symbol_record(uint32_t offset, pdb_symbol& symbol);
+            bool                resolve_procedure(uint16_t module, uint32_t offset, pdb_symbol& symbol);
+
+            void                load_dbi();
+            void                load_sections();
+            void                load_publics();
+            void                load_globals();
+
+            misc::mapped_file                           _file;
+            uint32_t                                    _blockSize;
+            std::vector<uint32_t>                       _streamSizes;
+            std::vector<uint32_t>                       _directoryBlocks;
+            std::vector<const uint32_t*>                _streamBlocks;
+            std::vector<std::unique_ptr<stream_view>>   _streams;
+            std::mutex                                  _streamLock;
+
+            GUID                                        _guid;
+            uint32_t                                    _age;
+            uint32_t                                    _signature;
+
+            std::once_flag                              _dbiOnce;
+            uint16_t                                    _machine;
+            uint16_t                                    _globalsStream;
+            uint16_t                                    _publicsStream;
+            uint16_t                                    _recordsStream;
+            uint16_t                                    _sectionsStream;
+            std::vector<pdb_module>                     _modules;
+            std::vector<pdb_section_map_entry>          _sectionMap;
+
+            std::once_flag                              _sectionsOnce;
+            std::vector<IMAGE_SECTION_HEADER>           _sections;
+
+            std::once_flag                              _publicsOnce;
+            hash_table                                  _publicsHash;
+            std::vector<pdb_symbol>                     _publics;
+
+            std::once_flag                              _globalsOnce;
+            hash_table                                  _globalsHash;
+        };
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+
+#include "symbol_table.hpp"
+#include "type_table.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// A directory of saved symbol tables, one file per module build.
+        ///</summary>
+        ///<remarks>
+        /// Tables are keyed like a symbol store: by PDB GUID and age when the image has a
+        /// CodeView record, by image timestamp and size otherwise. Files are named
+        /// name.id.source.rsym (e.g. ntkrnlmp.pdb.3844DBB920174967BE7AA4A2C20430FA2.publics.rsym),
+        /// so a directory can be filled offline from PDBs and shared between machines.
+        /// Type tables live next to them as name.id.types.rtyp.
+        ///</remarks>
+        class symbol_database
+        {
+        public:
+            symbol_database();
+            explicit symbol_database(const std::wstring& directory);
+
+            ///<summary>
+            /// Sets the directory. It must already exist; an empty path disables the database.
+            ///</summary>
+            ///<param name="directory"> The directory. </param>
+            void set_directory(const std::wstring& directory) { _directory = directory; }
+
+            ///<summary>
+            /// Gets the directory.
+            ///</summary>
+            const std::wstring& get_directory() const { return _directory; }
+
+            ///<summary>
+            /// Checks whether a directory is set.
+            ///</summary>
+            bool is_enabled() const { return !_directory.empty(); }
+
+            ///<summary>
+            /// Gets the path of a table.
+            ///</summary>
+            ///<param name="name"> The PDB or image file name. </param>
+            ///<param name="key">  The key. </param>
+            ///<returns>
+            /// The path.
+            ///</returns>
+            std::wstring get_path(const std::wstring& name, const symbol_key& key) const;
+
+            ///<summary>
+            /// Gets the path of a type table.
+            ///</summary>
+            ///<param name="name"> The PDB or image file name. </param>
+            ///<param name="key">  The key. The source is ignored. </param>
+            ///<returns>
+            /// The path.
+            ///</returns>
+            std::wstring get_types_path(const std::wstring& name, const symbol_key& key) const;
+
+            ///<summary>
+            /// Opens a saved table.
+            ///</summary>
+            ///<param name="name">  The PDB or image file name. </param>
+            ///<param name="key">   The key. </param>
+            ///<param name="table"> The table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS load(const std::wstring& name, const symbol_key& key, symbol_table& table) const;
+
+            ///<summary>
+            /// Saves a finalized table.
+            ///</summary>
+            ///<param name="name">  The PDB or image file name. </param>
+            ///<param name="key">   The key. </param>
+            ///<param name="table"> The table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS store(const std::wstring& name, const symbol_key& key, const symbol_table& table) const;
+
+            ///<summary>
+            /// Opens a saved type table.
+            ///</summary>
+            ///<param name="name">  The PDB or image file name. </param>
+            ///<param name="key">   The key. The source is ignored. </param>
+            ///<param name="types"> The type table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS load_types(const std::wstring& name, const symbol_key& key, type_table& types) const;
+
+            ///<summary>
+            /// Saves a type table.
+            ///</summary>
+            ///<param name="name">  The PDB or image file name. </param>
+            ///<param name="key">   The key. The source is ignored. </param>
+            ///<param name="types"> The type table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS store_types(const std::wstring& name, const symbol_key& key, const type_table& types) const;
+
+            ///<summary>
+            /// Builds and saves the tables of a PDB (its public symbols and types), without the image.
+            ///</summary>
+            ///<param name="pdbPath"> The PDB path. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS build(const std::wstring& pdbPath) const;
+
+            ///<summary>
+            /// Gets the key of an image file from its headers and CodeView record.
+            ///</summary>
+            ///<param name="imagePath"> The image path. </param>
+            ///<param name="name">      Receives the PDB file name, or the image file name when keyed by image. </param>
+            ///<param name="key">       Receives the key. The source is left 0. </param>
+            ///<param name="machine">   Optionally receives the image machine (IMAGE_FILE_MACHINE_*). </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            static NTSTATUS get_image_key(const std::wstring& imagePath, std::wstring& name, symbol_key& key, uint16_t* machine = nullptr);
+
+        private:
+            std::wstring get_base_path(const std::wstring& name, const symbol_key& key) const;
+            symbol_key   get_types_key(const symbol_key& key) const;
+
+            std::wstring _directory;
+        };
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <headers.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "symbol_table.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Finds the symbols of a symbol_table by name, with wildcards.
+        ///</summary>
+        ///<remarks>
+        /// Two structures are built on first use: the symbols sorted by name, which turns
+        /// a pattern's literal prefix into a range, and a trigram index (every three
+        /// character sequence of every name, with the symbols containing it) for patterns
+        /// that start with a wildcard. Candidates are then checked against the pattern.
+        /// Matching ignores ASCII case. The table must outlive the index.
+        ///</remarks>
+        class symbol_name_index
+        {
+        public:
+            symbol_name_index(const symbol_table& table);
+
+            ///<summary>
+            /// Finds the symbols whose name matches a pattern.
+            ///</summary>
+            ///<param name="pattern"> The pattern (UTF-8). * matches any run of characters, ? any single one. </param>
+            ///<param name="matches"> Receives the indices of the matching symbols in the table. </param>
+            ///<remarks>
+            /// Safe to call from several threads.
+            ///</remarks>
+            void search(const std::string& pattern, std::vector<uint32_t>& matches);
+
+            ///<summary>
+            /// Matches a name against a pattern.
+            ///</summary>
+            ///<param name="pattern">    The pattern. * matches any run of characters, ? any single one. </param>
+            ///<param name="name">       The name. </param>
+            ///<param name="ignoreCase"> Whether ASCII case is ignored. </param>
+            ///<returns>
+            /// True if the name matches.
+            ///</returns>
+            static bool match(const std::string& pattern, const char* name, bool ignoreCase);
+
+            ///<summary>
+            /// Gets the memory used by the index, in bytes.
+            ///</summary>
+            ///<remarks>
+            /// Not safe to call while another thread searches for the first time.
+            ///</remarks>
+            size_t get_memory_usage() const;
+
+        private:
+            symbol_name_index(const symbol_name_index&) = delete;
+            symbol_name_index& operator=(const symbol_name_index&) = delete;
+
+            void build_sorted();
+            void build_trigrams();
+
+            void find_prefix(const std::string& prefix, const uint32_t** first, const uint32_t** last) const;
+            bool find_trigram(uint32_t trigram, const uint32_t** first, const uint32_t** last) const;
+
+            const symbol_table&     _table;
+
+            std::once_flag          _sortedOnce;
+            std::vector<uint32_t>   _sorted;            // Symbol indices, by name
+
+            std::once_flag          _trigramsOnce;
+            std::vector<uint32_t>   _trigrams;          // Distinct trigrams, sorted
+            std::vector<uint32_t>   _trigramOffsets;    // Start of each trigram's postings, plus the end
+            std::vector<uint32_t>   _postings;          // Symbol indices, ascending for each trigram
+        };
+    }
+}
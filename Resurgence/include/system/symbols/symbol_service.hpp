@@ -0,0 +1,162 @@
+#pragma once
+
+#include <headers.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../process_modules.hpp"
+#include "symbol_database.hpp"
+#include "symbol_system.hpp"
+#include "symbol_table.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Module symbol tables shared between threads and processes.
+        ///</summary>
+        ///<remarks>
+        /// Unlike symbol_system, which belongs to one process and one thread, a single
+        /// symbol_service can be used by any number of threads at once. A module is
+        /// identified by its path, size and link timestamp, so every process that loads
+        /// the same image uses the same table and a rebuilt one gets a new table.
+        ///
+        /// Tables are built once with the built-in PDB reader (dbghelp is single
+        /// threaded), and never change or move once published. They stay valid for
+        /// the lifetime of the service. Modules are spread over shards by hash. Each
+        /// shard publishes an open addressed array of tables, so a lookup is a few
+        /// atomic loads and takes no lock. The shard lock is only taken to load a
+        /// module and publish its table; a full array is replaced by a bigger copy and
+        /// kept until the service is destroyed, since readers may still be using it.
+        ///</remarks>
+        class symbol_service
+        {
+        public:
+            ///<summary>
+            /// Creates a service.
+            ///</summary>
+            ///<param name="shards"> The number of shards, rounded up to a power of two. </param>
+            explicit symbol_service(size_t shards = 16);
+            ~symbol_service();
+
+            ///<summary>
+            /// Gets the shared service.
+            ///</summary>
+            static symbol_service& instance();
+
+            ///<summary>
+            /// Sets a directory searched for PDBs before the module directory.
+            /// Only modules loaded afterwards are affected.
+            ///</summary>
+            ///<param name="path"> The directory. </param>
+            void set_search_path(const std::wstring& path);
+
+            ///<summary>
+            /// Sets the directory of the symbol database. Empty (the default) disables it.
+            /// Only modules loaded afterwards are affected.
+            ///</summary>
+            ///<param name="path"> The directory, it must exist. </param>
+            void set_database_path(const std::wstring& path);
+
+            ///<summary>
+            /// Gets the symbol table of a module, loading it the first time.
+            ///</summary>
+            ///<param name="module"> The module. </param>
+            ///<returns>
+            /// The table, nullptr if the module has no symbols. Valid as long as the service.
+            ///</returns>
+            const symbol_table* get_table(const process_module& module);
+
+            ///<summary>
+            /// Finds the symbol containing an address.
+            ///</summary>
+            ///<param name="module">       The module the address is in. </param>
+            ///<param name="address">      The address. </param>
+            ///<param name="displacement"> Receives the offset from the symbol, or from the module base if none. </param>
+            ///<returns>
+            /// The raw (UTF-8, possibly decorated) symbol name, nullptr if none.
+            ///</returns>
+            const char* find(const process_module& module, uintptr_t address, uint64_t* displacement);
+
+            ///<summary>
+            /// Finds the symbols of many addresses of a module at once.
+            ///</summary>
+            ///<param name="module">    The module the addresses are in. </param>
+            ///<param name="addresses"> The addresses, sorted in ascending order. </param>
+            ///<param name="count">     The number of addresses. </param>
+            ///<param name="results">   Receives the symbols (nullptr if none), in the same order as the addresses. </param>
+            void find_sorted(const process_module& module, const uintptr_t* addresses, size_t count, const symbol_table_entry** results);
+
+            ///<summary>
+            /// Formats an address as module!symbol+0x10 or module+0x10.
+            ///</summary>
+            ///<param name="module">  The module the address is in. </param>
+            ///<param name="address"> The address. </param>
+            ///<param name="out">     The string the name is appended to. </param>
+            void format(const process_module& module, uintptr_t address, std::wstring& out);
+
+            ///<summary>
+            /// Gets the symbol of an address as a symbol_info.
+            ///</summary>
+            ///<param name="proc">    The process the module belongs to. </param>
+            ///<param name="module">  The module the address is in. </param>
+            ///<param name="address"> The address. </param>
+            symbol_info get_symbol_info(process* proc, const process_module& module, uintptr_t address);
+
+            ///<summary>
+            /// Gets the number of modules loaded, with or without symbols.
+            ///</summary>
+            size_t size() const { return _count.load(std::memory_order_relaxed); }
+
+        private:
+            symbol_service(const symbol_service&) = delete;
+            symbol_service& operator=(const symbol_service&) = delete;
+
+            //
+            // Published once, then read by any thread without a lock
+            //
+            struct module_tables
+            {
+                std::wstring    path;
+                size_t          size;
+                uint32_t        timestamp;
+                size_t          hash;
+                bool            decorated;  // x86 PDB names (_name@8)
+                symbol_table    table;
+            };
+
+            struct slot_array
+            {
+                size_t                                              capacity;   // A power of two
+                std::unique_ptr<std::atomic<const module_tables*>[]> slots;
+            };
+
+            struct shard
+            {
+                std::atomic<const slot_array*>              current;
+                std::mutex                                  lock;       // Guards everything below, and loading
+                size_t                                      count;
+                std::vector<std::unique_ptr<slot_array>>    arrays;     // Every array published, readers may still hold old ones
+                std::vector<std::unique_ptr<module_tables>> tables;
+            };
+
+            static size_t               get_hash(const process_module& module);
+            static const char*          find(const module_tables* tables, const process_module& module, uintptr_t address, uint64_t* displacement);
+            const module_tables*        find_tables(const process_module& module, size_t hash) const;
+            const module_tables*        load_tables(const process_module& module, size_t hash);
+            const module_tables*        get_tables(const process_module& module);
+            void                        publish(shard& target, const module_tables* tables);
+
+            std::unique_ptr<shard[]>    _shards;
+            size_t                      _shardCount;
+            std::atomic<size_t>         _count;
+            std::mutex                  _settingsLock;
+            std::wstring                _searchPath;
+            symbol_database             _database;
+        };
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <unordered_map>
+
+#include "../image_debug_info.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// An index of the PDBs on disk, by file name and identity (GUID and age).
+        ///</summary>
+        ///<remarks>
+        /// Symbol store directories (name.pdb\id\name.pdb, with or without index2.txt
+        /// prefixes) are indexed from their directory names alone, loose directories
+        /// of PDBs by reading each PDB header. The index is meant to be built once at
+        /// startup: stores and directories must all be added before looking up, after
+        /// that any number of threads can look up at once.
+        ///</remarks>
+        class symbol_store_index
+        {
+        public:
+            ///<summary>
+            /// Gets the shared index, used by the symbol system and service to find PDBs.
+            ///</summary>
+            static symbol_store_index& instance();
+
+            ///<summary>
+            /// Adds the PDBs of a symbol store.
+            ///</summary>
+            ///<param name="root"> The store directory. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS add_store(const std::wstring& root);
+
+            ///<summary>
+            /// Adds the PDBs of a directory, reading their headers. Subdirectories are ignored.
+            ///</summary>
+            ///<param name="directory"> The directory. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS add_directory(const std::wstring& directory);
+
+            ///<summary>
+            /// Finds a PDB.
+            ///</summary>
+            ///<param name="name">     The PDB file name, case insensitive. </param>
+            ///<param name="identity"> The PDB identity. </param>
+            ///<returns>
+            /// The PDB path, nullptr if not indexed.
+            ///</returns>
+            const std::wstring* find(const std::wstring& name, const pdb_identity& identity) const;
+
+            ///<summary>
+            /// Finds the PDB of an image.
+            ///</summary>
+            ///<param name="debug"> The debug information of the image. </param>
+            ///<returns>
+            /// The PDB path, nullptr if the image has no CodeView record or its PDB isn't indexed.
+            ///</returns>
+            const std::wstring* find(const image_debug_info& debug) const;
+
+            ///<summary>
+            /// Removes every PDB.
+            ///</summary>
+            void clear() { _entries.clear(); }
+
+            ///<summary>
+            /// Gets the number of PDBs.
+            ///</summary>
+            size_t size() const { return _entries.size(); }
+
+            ///<summary>
+            /// Checks whether the index is empty.
+            ///</summary>
+            bool empty() const { return _entries.empty(); }
+
+        private:
+            struct key
+            {
+                std::wstring    name;       // Lower case
+                pdb_identity    identity;
+            };
+
+            struct key_hash
+            {
+                size_t operator()(const key& value) const;
+            };
+
+            struct key_equal
+            {
+                bool operator()(const key& lhs, const key& rhs) const;
+            };
+
+            void add(const std::wstring& name, const pdb_identity& identity, std::wstring path);
+            void add_store_entries(const std::wstring& directory, const std::wstring& name);
+
+            std::unordered_map<key, std::wstring, key_hash, key_equal> _entries;   // The first PDB added for a key wins
+        };
+    }
+}
@@ -1,11 +1,20 @@
 #pragma once
 
 #include <headers.hpp>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
 #include "../process_modules.hpp"
+#include "line_table.hpp"
+#include "pdb_file.hpp"
+#include "symbol_database.hpp"
+#include "symbol_name_index.hpp"
+#include "symbol_table.hpp"
+#include "type_table.hpp"
 
 typedef struct _SYMBOL_INFOW *PSYMBOL_INFOW;
 
@@ -15,10 +24,78 @@ namespace resurgence
     {
         class process;
 
+        enum symbol_backend
+        {
+            symbol_backend_dbghelp = 0,     // dbghelp.dll
+            symbol_backend_pdb              // Built-in PDB reader (pdb_file)
+        };
+
+        ///<summary>
+        /// A resolved address, as ids into the symbol_system that produced it.
+        /// Use symbol_system::format or symbol_system::to_symbol_info to get the names.
+        /// Ids stay valid when the module is evicted from the cache, it is loaded again.
+        ///</summary>
+        struct symbol_ref
+        {
+            static const uint32_t invalid_id = 0xFFFFFFFF;
+
+            uint32_t    module;         // Module id, invalid_id if the address isn't in a module
+            uint32_t    symbol;         // Index in the module symbol table, invalid_id if none
+            uint64_t    displacement;   // From the symbol, else from the module base, else the address
+
+            bool has_module() const { return module != invalid_id; }
+            bool has_symbol() const { return symbol != invalid_id; }
+        };
+
+        enum symbol_match_rank
+        {
+            symbol_match_exact = 0,             // The name is the pattern
+            symbol_match_exact_ignore_case,     // The name is the pattern, ignoring case
+            symbol_match_pattern,               // The name matches the pattern
+            symbol_match_pattern_ignore_case    // The name matches the pattern, ignoring case
+        };
+
+        struct symbol_cache_stats
+        {
+            uint64_t    hits;           // Module lookups that found the symbols loaded
+            uint64_t    misses;         // Module lookups that had to load them
+            uint64_t    evictions;
+            uint64_t    fallbacks;      // Module lookups answered without symbols while a preload was running
+            size_t      memory_usage;   // Bytes held by the loaded modules
+            size_t      budget;         // 0 if unbounded
+            uint32_t    loaded_modules;
+            uint32_t    pinned_modules;
+        };
+
+        ///<summary>
+        /// Called by preload as each module is done, from the thread pool.
+        ///</summary>
+        ///<param name="module"> The module. </param>
+        ///<param name="loaded"> Whether symbols were found for it. </param>
+        ///<param name="done">   The number of modules done so far. </param>
+        ///<param name="total">  The number of modules being preloaded. </param>
+        typedef std::function<void(const process_module& module, bool loaded, size_t done, size_t total)> preload_callback;
+
+        struct source_line
+        {
+            std::string file;           // UTF-8, empty if unknown
+            uint32_t    line;           // 0 if unknown
+            uint32_t    displacement;   // From the first byte of the line
+        };
+
+        struct symbol_match
+        {
+            symbol_ref          symbol;
+            symbol_match_rank   rank;
+            uint32_t            length;     // Name length
+        };
+
         class symbol_info
         {
         public:
+            symbol_info();
             symbol_info(process* proc, PSYMBOL_INFOW info, uintptr_t displacement);
+            symbol_info(process* proc, const process_module& module, uint64_t address, const std::wstring& name, uint64_t displacement);
 
             const std::wstring&     get_name() const { return _name; }
             uint64_t                get_address() const { return _address; }
@@ -27,7 +104,7 @@ namespace resurgence
             const process_module&   get_module() const { return _module; }
 
         private:
-            void build_name(PSYMBOL_INFOW info, uintptr_t displacement);
+            void build_name(const wchar_t* symbolName, size_t length, uint64_t displacement);
 
         private:
             process*        _process;
@@ -40,23 +117,354 @@ namespace resurgence
 
         class symbol_system
         {
+            friend class symbol_service;
+
         public:
-            symbol_system(process* proc);
+            symbol_system(process* proc, symbol_backend backend = symbol_backend_dbghelp);
             ~symbol_system();
 
+            symbol_system& operator=(symbol_system&& rhs);
+
             bool is_initialized();
             void initialize();
             void cleanup();
 
+            ///<summary>
+            /// Gets the symbol backend.
+            ///</summary>
+            symbol_backend get_backend() const { return _backend; }
+
+            ///<summary>
+            /// Changes the symbol backend. Loaded modules are dropped.
+            ///</summary>
+            ///<param name="backend"> The backend. </param>
+            void set_backend(symbol_backend backend);
+
+            ///<summary>
+            /// Sets a directory searched for PDBs before the module directory.
+            /// Only used by the pdb backend.
+            ///</summary>
+            ///<param name="path"> The directory. </param>
+            void set_search_path(const std::wstring& path) { _searchPath = path; }
+
+            ///<summary>
+            /// Sets the directory of the symbol database. Empty (the default) disables it.
+            ///</summary>
+            ///<param name="path"> The directory, it must exist. </param>
+            ///<remarks>
+            /// Module symbol tables are opened from the database when it has them, without
+            /// opening the PDB. Otherwise they are saved after being read from the PDB;
+            /// modules whose PDB isn't found aren't saved. See symbol_database.
+            ///</remarks>
+            void set_database_path(const std::wstring& path) { _database.set_directory(path); }
+
+            ///<summary>
+            /// Bounds the memory held by module symbols. 0 (the default) means unbounded.
+            ///</summary>
+            ///<param name="bytes"> The budget, in bytes. </param>
+            ///<remarks>
+            /// Past the budget, the least recently used modules that aren't pinned are
+            /// unloaded at the end of each call; the module used last is always kept.
+            /// A batch call keeps every module it touches until it returns, so it can go
+            /// over the budget for its duration. Counted are the tables and indexes built
+            /// for a module and the memory mapped tables it uses; dbghelp's own memory
+            /// can't be measured, but is released too.
+            ///</remarks>
+            void set_cache_budget(size_t bytes);
+
+            ///<summary>
+            /// Gets the cache budget.
+            ///</summary>
+            size_t get_cache_budget() const { return _cacheBudget; }
+
+            ///<summary>
+            /// Loads the symbols of a module and keeps them loaded until unpin_module.
+            ///</summary>
+            ///<param name="module"> The module. </param>
+            ///<returns>
+            /// False if the module is invalid.
+            ///</returns>
+            ///<remarks>
+            /// Pins are counted. Pointers returned for a module (get_type_table, get_line_table)
+            /// are only guaranteed to stay valid while it is pinned.
+            ///</remarks>
+            bool pin_module(const process_module& module);
+
+            ///<summary>
+            /// Releases a pin taken with pin_module.
+            ///</summary>
+            ///<param name="module"> The module. </param>
+            void unpin_module(const process_module& module);
+
+            ///<summary>
+            /// Gets the cache counters and memory usage.
+            ///</summary>
+            symbol_cache_stats get_cache_stats();
+
+            ///<summary>
+            /// Resets the hit, miss, eviction and fallback counters.
+            ///</summary>
+            void reset_cache_stats();
+
+            ///<summary>
+            /// Loads the symbols of some modules in the background, on the shared thread pool.
+            ///</summary>
+            ///<param name="modules">  The modules. </param>
+            ///<param name="progress"> Called as each module is done, may be empty. </param>
+            ///<returns>
+            /// One future per module, in the same order, telling whether symbols were found.
+            ///</returns>
+            ///<remarks>
+            /// Modules start loading by priority: the main module first, then the modules
+            /// used most recently, then the others in the given order. Modules already
+            /// loaded get a ready future.
+            ///
+            /// Until a module is done, lookups in it don't wait: they answer module+offset,
+            /// and search skips it. get_type_table, get_line_table and pin_module do wait,
+            /// since they need the module's PDB. With the dbghelp backend, which isn't
+            /// thread safe, lookups still wait while dbghelp itself loads a module.
+            ///
+            /// The search path and database path are read when preload is called.
+            /// cleanup, set_backend and the destructor wait for the preloads in progress.
+            ///</remarks>
+            std::vector<std::shared_future<bool>> preload(const std::vector<process_module>& modules, const preload_callback& progress = preload_callback());
+
+            ///<summary>
+            /// Loads the symbols of every module of the process in the background. See preload.
+            ///</summary>
+            ///<param name="progress"> Called as each module is done, may be empty. </param>
+            std::vector<std::shared_future<bool>> preload_all(const preload_callback& progress = preload_callback());
+
+            ///<summary>
+            /// Waits for the preloads in progress.
+            ///</summary>
+            void wait_for_preload();
+
             DWORD64     load_module_from_address(uintptr_t address);
             symbol_info get_symbol_info_from_address(uintptr_t address);
             symbol_info get_symbol_info_from_name(const std::wstring& name);
 
+            ///<summary>
+            /// Symbolizes many addresses at once.
+            ///</summary>
+            ///<param name="addresses"> The addresses, sorted in ascending order. </param>
+            ///<param name="count">     The number of addresses. </param>
+            ///<returns>
+            /// The symbols, in the same order as the addresses.
+            ///</returns>
+            ///<remarks>
+            /// The symbols of each module are loaded once into a symbol_table, and the
+            /// addresses falling in that module are resolved in a single merge pass.
+            ///</remarks>
+            std::vector<symbol_info> symbolize_sorted(const uintptr_t* addresses, size_t count);
+
+            ///<summary>
+            /// Symbolizes many addresses at once, using the shared thread pool.
+            ///</summary>
+            ///<param name="addresses"> The addresses, in any order. </param>
+            ///<param name="count">     The number of addresses. </param>
+            ///<returns>
+            /// The symbols, in the same order as the addresses.
+            ///</returns>
+            ///<remarks>
+            /// Addresses are grouped by module and every module's symbols are loaded once.
+            /// With the pdb backend the tables are also built concurrently; dbghelp isn't
+            /// thread safe, so with that backend they are built on the calling thread first.
+            ///</remarks>
+            std::vector<symbol_info> symbolize(const uintptr_t* addresses, size_t count);
+            std::vector<symbol_info> symbolize(const std::vector<uintptr_t>& addresses) { return symbolize(addresses.data(), addresses.size()); }
+
+            ///<summary>
+            /// Resolves an address without formatting anything.
+            ///</summary>
+            ///<param name="address"> The address. </param>
+            ///<returns>
+            /// The symbol reference.
+            ///</returns>
+            symbol_ref resolve(uintptr_t address);
+
+            ///<summary>
+            /// Resolves many addresses at once, like symbolize, without formatting anything.
+            ///</summary>
+            ///<param name="addresses"> The addresses, in any order. </param>
+            ///<param name="count">     The number of addresses. </param>
+            ///<returns>
+            /// The symbol references, in the same order as the addresses.
+            ///</returns>
+            std::vector<symbol_ref> resolve(const uintptr_t* addresses, size_t count);
+
+            ///<summary>
+            /// Searches the symbols of every module of the process by name.
+            ///</summary>
+            ///<param name="pattern">    The pattern. * matches any run of characters, ? any single one; case is ignored. </param>
+            ///<param name="maxResults"> The maximum number of results, 0 for all. </param>
+            ///<returns>
+            /// The matches, best first: by rank, then shortest name.
+            ///</returns>
+            ///<remarks>
+            /// Modules are searched in parallel on the shared thread pool, each through a
+            /// symbol_name_index built on its first search. Names are matched as stored:
+            /// the pdb backend keeps decorated names, dbghelp undecorates them.
+            ///</remarks>
+            std::vector<symbol_match> search(const std::wstring& pattern, size_t maxResults = 0);
+
+            ///<summary>
+            /// Formats a symbol reference as module!symbol+0x10, module+0x10 or 0x10.
+            ///</summary>
+            ///<param name="ref"> The symbol reference. </param>
+            ///<param name="out"> The string the name is appended to. </param>
+            void format(const symbol_ref& ref, std::wstring& out);
+            std::wstring format(const symbol_ref& ref) { std::wstring out; format(ref, out); return out; }
+
+            ///<summary>
+            /// Gets the address of a symbol reference.
+            ///</summary>
+            uint64_t get_address(const symbol_ref& ref);
+
+            ///<summary>
+            /// Gets the module of a symbol reference, nullptr if none.
+            ///</summary>
+            const process_module* get_module(const symbol_ref& ref);
+
+            ///<summary>
+            /// Gets the raw (UTF-8, possibly decorated) symbol name of a symbol reference, nullptr if none.
+            ///</summary>
+            const char* get_symbol_name(const symbol_ref& ref);
+
+            ///<summary>
+            /// Converts a symbol reference to a symbol_info.
+            ///</summary>
+            symbol_info to_symbol_info(const symbol_ref& ref);
+
+            ///<summary>
+            /// Gets the structure layouts of a module, from its PDB or the symbol database.
+            ///</summary>
+            ///<param name="module"> The module. </param>
+            ///<returns>
+            /// The type table, nullptr if the module has no PDB or the PDB has no types.
+            ///</returns>
+            ///<remarks>
+            /// Works with both backends, the PDB is always read with pdb_file.
+            ///</remarks>
+            const type_table* get_type_table(const process_module& module);
+
+            ///<summary>
+            /// Gets the source line of an address.
+            ///</summary>
+            ///<param name="address"> The address. </param>
+            ///<returns>
+            /// The line, with an empty file if the address has none.
+            ///</returns>
+            source_line get_line_from_address(uintptr_t address);
+
+            ///<summary>
+            /// Gets the source lines of many addresses at once.
+            ///</summary>
+            ///<param name="addresses"> The addresses, in any order. </param>
+            ///<param name="count">     The number of addresses. </param>
+            ///<returns>
+            /// The lines, in the same order as the addresses.
+            ///</returns>
+            ///<remarks>
+            /// Like resolve: addresses are grouped by module, each module's lines are loaded
+            /// once and every group is looked up in a single pass, on the shared thread pool.
+            /// File names are copied, the lines stay valid once modules are unloaded.
+            ///</remarks>
+            std::vector<source_line> get_lines(const uintptr_t* addresses, size_t count);
+            std::vector<source_line> get_lines(const std::vector<uintptr_t>& addresses) { return get_lines(addresses.data(), addresses.size()); }
+
+            ///<summary>
+            /// Gets the line table of a module, e.g. to check its size with get_memory_usage.
+            ///</summary>
+            ///<param name="module"> The module. </param>
+            ///<returns>
+            /// The line table, nullptr if the module has no line information.
+            ///</returns>
+            const line_table* get_line_table(const process_module& module);
+
+        private:
+            //
+            // Everything a module costs, dropped when it is evicted
+            //
+            struct module_symbols
+            {
+                DWORD64                             dbghelp_base;   // 0 if not loaded in dbghelp
+                bool                                pdb_opened;     // Opened on the first use, saved tables don't need it
+                pdb_file                            pdb;
+                uint16_t                            machine;        // Of the PDB the table came from, x86 names are decorated
+                bool                                table_loaded;
+                symbol_table                        table;
+                std::unique_ptr<symbol_name_index>  names;      // Built on the first search
+                bool                                types_loaded;
+                type_table                          types;
+                bool                                lines_loaded;
+                line_table                          lines;
+            };
+
+            struct module_entry
+            {
+                uint32_t                            id;
+                process_module                      module;
+                uintptr_t                           base;
+                size_t                              size;
+                uint64_t                            last_used;
+                uint32_t                            pins;
+                std::unique_ptr<module_symbols>     symbols;        // nullptr while evicted, empty while preloading
+                std::shared_future<bool>            preload;        // Valid until the preloaded symbols are taken
+                std::unique_ptr<module_symbols>     preloaded;      // Set by the preload task before it completes
+            };
+
+            struct address_group
+            {
+                module_entry*   entry;  // nullptr if the addresses aren't in a module
+                size_t          first;
+                size_t          count;
+            };
+
+            symbol_system(const symbol_system&) = delete;
+            symbol_system& operator=(const symbol_system&) = delete;
+
+            std::vector<address_group>  group_by_module(const uintptr_t* addresses, size_t count);
+            std::vector<symbol_ref>     resolve_batch(const uintptr_t* addresses, size_t count);
+            void                        resolve_group(module_entry* entry, const uintptr_t* addresses, size_t count, const size_t* slots, symbol_ref* results);
+            DWORD64                     load_dbghelp_module(const process_module& module);
+            module_entry*               get_module_entry(uintptr_t address);
+            module_entry*               find_module_entry(const process_module& module);
+            module_entry*               load_module_entry(const process_module& module, bool wait = false);
+            void                        acquire_module(module_entry* entry);
+            bool                        adopt_preload(module_entry* entry, bool wait);
+            std::unique_ptr<module_symbols> load_module_symbols(const process_module& module);
+            void                        unload_module(module_entry* entry);
+            size_t                      get_memory_usage(module_entry* entry);
+            void                        trim_cache();
+            static void                 open_module_pdb(const process_module& module, const std::wstring& searchPath, pdb_file& pdb);
+            static pdb_file&            get_module_pdb(const process_module& module, const std::wstring& searchPath, module_symbols& symbols);
+            void                        load_symbol_tables(const std::vector<module_entry*>& entries);
+            const symbol_table*         get_symbol_table(module_entry* entry);
+            void                        build_symbol_table(const process_module& module, const std::wstring& searchPath, const symbol_database& database, module_symbols& symbols);
+            static void                 add_pdb_symbols(pdb_file& pdb, symbol_table& table);
+            static void                 build_module_table(const process_module& module, const symbol_database& database, symbol_backend source,
+                                                           symbol_table& table, uint16_t& machine, const std::function<bool(symbol_table&)>& read);
+            const symbol_table*         get_ref_table(const symbol_ref& ref, module_entry** entry);
+            const line_table*           load_line_table(module_entry* entry);
+            void                        append_symbol_name(module_entry* entry, const char* name, std::wstring& out);
+            static void                 append_name(const char* name, bool decorated, std::wstring& out);
+            symbol_info                 get_pdb_symbol_from_address(uintptr_t address);
+            symbol_info                 get_pdb_symbol_from_name(const std::wstring& name);
+
         private:
-            process*                _process;
-            bool                    _initialized;
-            HANDLE                  _symbolHandle;
-            std::vector<DWORD64>    _loadedModules;
+            process*                                        _process;
+            symbol_backend                                  _backend;
+            bool                                            _initialized;
+            HANDLE                                          _symbolHandle;
+            std::mutex                                      _dbghelpLock;   // dbghelp is single threaded, preload tasks call it too
+            std::vector<DWORD64>                            _loadedModules;
+            std::wstring                                    _searchPath;
+            symbol_database                                 _database;
+            std::vector<std::unique_ptr<module_entry>>      _modules;
+            size_t                                          _cacheBudget;
+            uint64_t                                        _cacheTick;
+            symbol_cache_stats                              _cacheStats;
         };
     }
-}
\ No newline at end of file
+}
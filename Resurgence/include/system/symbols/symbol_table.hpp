@@ -0,0 +1,162 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <misc/mapped_file.hpp>
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct symbol_table_entry
+        {
+            uint32_t rva;
+            uint32_t size;      // 0 if unknown, the symbol then extends to the next one
+            uint32_t name;      // Offset in the name blob
+        };
+
+        ///<summary>
+        /// Identifies the binary a saved symbol table was built for.
+        ///</summary>
+        struct symbol_key
+        {
+            GUID        guid;           // PDB GUID, zero when keyed by image
+            uint32_t    age;            // PDB age
+            uint32_t    timestamp;      // Image timestamp, 0 when keyed by PDB
+            uint32_t    image_size;     // Image size, 0 when keyed by PDB
+            uint32_t    source;         // What the symbols were read from (symbol_backend)
+        };
+
+        ///<summary>
+        /// The symbols of one module, sorted by RVA.
+        ///</summary>
+        ///<remarks>
+        /// Entries are kept in a flat array and their names in a single blob of
+        /// zero terminated UTF-8 strings, each distinct name stored once. Lookups
+        /// search a copy of the RVAs stored in Eytzinger (breadth-first) order,
+        /// which is branchless and touches one cache line per four levels of the tree.
+        ///
+        /// A finalized table can be saved to a file and opened again later. Opened
+        /// tables are used straight from the mapped file, nothing is parsed or copied.
+        ///</remarks>
+        class symbol_table
+        {
+        public:
+            symbol_table();
+
+            ///<summary>
+            /// Adds a symbol. The table can't be searched until finalize is called.
+            ///</summary>
+            ///<param name="rva">    The symbol RVA. </param>
+            ///<param name="size">   The symbol size, 0 if unknown. </param>
+            ///<param name="name">   The symbol name (UTF-8). </param>
+            ///<param name="length"> The name length. </param>
+            void add(uint32_t rva, uint32_t size, const char* name, size_t length);
+
+            ///<summary>
+            /// Sorts the symbols and builds the search tree.
+            ///</summary>
+            ///<param name="limit">
+            /// End of the address range covered by the table (usually the image size).
+            /// Symbols of unknown size end at the next symbol or at the limit.
+            ///</param>
+            void finalize(uint32_t limit);
+
+            ///<summary>
+            /// Opens a table saved with save. Any symbols already in the table are dropped.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<param name="key">  The key the table must have been saved with. </param>
+            ///<returns>
+            /// The status code. STATUS_OBJECT_TYPE_MISMATCH if the key doesn't match.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path, const symbol_key& key);
+
+            ///<summary>
+            /// Saves a finalized table.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<param name="key">  The key stored with the table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS save(const std::wstring& path, const symbol_key& key) const;
+
+            ///<summary>
+            /// Gets the number of symbols.
+            ///</summary>
+            size_t size() const { return _count; }
+
+            ///<summary>
+            /// Checks whether the table is empty.
+            ///</summary>
+            bool empty() const { return _count == 0; }
+
+            ///<summary>
+            /// Checks whether the table was opened from a file.
+            ///</summary>
+            bool is_mapped() const { return _file.is_open(); }
+
+            ///<summary>
+            /// Gets the memory used by the table, in bytes, counting the mapped file if any.
+            ///</summary>
+            size_t get_memory_usage() const;
+
+            ///<summary>
+            /// Gets the symbols, sorted by RVA.
+            ///</summary>
+            const symbol_table_entry* get_entries() const { return _entryData; }
+
+            ///<summary>
+            /// Gets the name of a symbol.
+            ///</summary>
+            const char* get_name(const symbol_table_entry& entry) const { return entry.name < _namesSize ? _nameData + entry.name : ""; }
+
+            ///<summary>
+            /// Finds the symbol containing an address.
+            ///</summary>
+            ///<param name="rva"> The RVA. </param>
+            ///<returns>
+            /// The symbol, nullptr if none.
+            ///</returns>
+            const symbol_table_entry* find(uint32_t rva) const;
+
+            ///<summary>
+            /// Finds the symbols of many addresses in a single pass.
+            ///</summary>
+            ///<param name="rvas">    The RVAs, sorted in ascending order. </param>
+            ///<param name="count">   The number of RVAs. </param>
+            ///<param name="results"> Receives the symbol of each RVA, nullptr if none. </param>
+            void find_sorted(const uint32_t* rvas, size_t count, const symbol_table_entry** results) const;
+
+        private:
+            symbol_table(const symbol_table&) = delete;
+            symbol_table& operator=(const symbol_table&) = delete;
+
+            void build_tree(uint32_t& next, uint32_t node);
+            void set_views();
+
+            const symbol_table_entry* contains(uint32_t index, uint32_t rva) const;
+
+            std::vector<symbol_table_entry>             _entries;
+            std::vector<char>                           _names;
+            std::unordered_map<std::string, uint32_t>   _interned;  // Name offsets, only used until finalize
+            std::vector<uint32_t>                       _keys;      // RVAs in Eytzinger order, 1-based
+            std::vector<uint32_t>                       _ranks;     // Index in _entries of each key
+            misc::mapped_file                           _file;
+
+            //
+            // What the searches use: either the vectors above or the mapped file
+            //
+            uint32_t                                    _count;
+            uint32_t                                    _namesSize;
+            const symbol_table_entry*                   _entryData;
+            const char*                                 _nameData;
+            const uint32_t*                             _keyData;
+            const uint32_t*                             _rankData;
+        };
+    }
+}
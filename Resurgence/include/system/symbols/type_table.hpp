@@ -0,0 +1,179 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <misc/mapped_file.hpp>
+
+#include "field_layout.hpp"
+#include "pdb_file.hpp"
+#include "symbol_table.hpp"
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct type_table_entry
+        {
+            uint32_t    name;           // Offset in the string blob
+            uint32_t    size;
+            uint32_t    first_field;
+            uint32_t    field_count;
+        };
+
+        struct type_table_field
+        {
+            uint32_t        name;       // Offset in the string blob
+            uint32_t        type_name;  // Offset in the string blob
+            field_layout    layout;
+        };
+
+        ///<summary>
+        /// The structure, class and union layouts of a PDB.
+        ///</summary>
+        ///<remarks>
+        /// Layouts are read from the TPI stream. Base classes are flattened into the
+        /// derived type, and members of unnamed nested structures and unions are added
+        /// as parent.member next to the parent member itself. Static members, methods
+        /// and virtual bases have no fixed offset and are left out.
+        ///
+        /// Types are found by name through a hash table, so a lookup costs the same
+        /// with ten types or fifty thousand. Like symbol_table, a table can be saved
+        /// and opened again straight from the mapped file.
+        ///</remarks>
+        class type_table
+        {
+        public:
+            type_table();
+
+            ///<summary>
+            /// Reads the layouts of a PDB. Any layouts already in the table are dropped.
+            ///</summary>
+            ///<param name="pdb"> The PDB. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS build(pdb_file& pdb);
+
+            ///<summary>
+            /// Opens a table saved with save. Any layouts already in the table are dropped.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<param name="key">  The key the table must have been saved with. </param>
+            ///<returns>
+            /// The status code. STATUS_OBJECT_TYPE_MISMATCH if the key doesn't match.
+            ///</returns>
+            NTSTATUS open(const std::wstring& path, const symbol_key& key);
+
+            ///<summary>
+            /// Saves the table.
+            ///</summary>
+            ///<param name="path"> The file path. </param>
+            ///<param name="key">  The key stored with the table. </param>
+            ///<returns>
+            /// The status code.
+            ///</returns>
+            NTSTATUS save(const std::wstring& path, const symbol_key& key) const;
+
+            ///<summary>
+            /// Gets the number of types.
+            ///</summary>
+            size_t size() const { return _typeCount; }
+
+            ///<summary>
+            /// Checks whether the table is empty.
+            ///</summary>
+            bool empty() const { return _typeCount == 0; }
+
+            ///<summary>
+            /// Gets the memory used by the table, in bytes, counting the mapped file if any.
+            ///</summary>
+            size_t get_memory_usage() const;
+
+            ///<summary>
+            /// Gets the types.
+            ///</summary>
+            const type_table_entry* get_types() const { return _typeData; }
+
+            ///<summary>
+            /// Gets the fields of a type.
+            ///</summary>
+            const type_table_field* get_fields(const type_table_entry& type) const { return _fieldData + type.first_field; }
+
+            ///<summary>
+            /// Gets a string (type or field name).
+            ///</summary>
+            const char* get_string(uint32_t offset) const { return offset < _stringsSize ? _stringData + offset : ""; }
+
+            ///<summary>
+            /// Finds a type by name.
+            ///</summary>
+            ///<param name="name"> The name, e.g. _EPROCESS. </param>
+            ///<returns>
+            /// The type, nullptr if none.
+            ///</returns>
+            const type_table_entry* find(const char* name) const;
+
+            ///<summary>
+            /// Finds a field of a type by name.
+            ///</summary>
+            ///<param name="type"> The type. </param>
+            ///<param name="name"> The field name, e.g. Pcb or u.Flags. </param>
+            ///<returns>
+            /// The field, nullptr if none.
+            ///</returns>
+            const type_table_field* find_field(const type_table_entry& type, const char* name) const;
+
+            ///<summary>
+            /// Gets the layout of a field.
+            ///</summary>
+            ///<param name="type">   The type name. </param>
+            ///<param name="field">  The field name. </param>
+            ///<param name="layout"> The returned layout. </param>
+            ///<returns>
+            /// True if found.
+            ///</returns>
+            bool get_field_layout(const char* type, const char* field, field_layout& layout) const;
+
+            ///<summary>
+            /// Writes a C++ header with the layouts of some types as constexpr field_layout values.
+            ///</summary>
+            ///<param name="types">      The type names, empty for all of them. </param>
+            ///<param name="nameSpace">  The namespace the types are put in. </param>
+            ///<param name="out">        The string the header is appended to. </param>
+            ///<returns>
+            /// The status code. STATUS_NOT_FOUND if a type isn't in the table, then nothing is written.
+            ///</returns>
+            NTSTATUS generate_header(const std::vector<std::string>& types, const std::string& nameSpace, std::string& out) const;
+
+        private:
+            type_table(const type_table&) = delete;
+            type_table& operator=(const type_table&) = delete;
+
+            uint32_t add_string(const std::string& value);
+            void     build_buckets();
+            void     set_views();
+            void     clear();
+
+            std::vector<type_table_entry>               _types;
+            std::vector<type_table_field>               _fields;
+            std::vector<uint32_t>                       _buckets;   // Type index + 1, 0 if empty
+            std::vector<char>                           _strings;
+            std::unordered_map<std::string, uint32_t>   _interned;  // String offsets, only used while building
+            misc::mapped_file                           _file;
+
+            //
+            // What the lookups use: either the vectors above or the mapped file
+            //
+            uint32_t                                    _typeCount;
+            uint32_t                                    _bucketCount;
+            uint32_t                                    _stringsSize;
+            const type_table_entry*                     _typeData;
+            const type_table_field*                     _fieldData;
+            const uint32_t*                             _bucketData;
+            const char*                                 _stringData;
+        };
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+//
+// x64 unwind data (UNWIND_INFO, UNWIND_CODE), shared by the function table and the stack unwinder
+//
+#define UWOP_PUSH_NONVOL            0
+#define UWOP_ALLOC_LARGE            1
+#define UWOP_ALLOC_SMALL            2
+#define UWOP_SET_FPREG              3
+#define UWOP_SAVE_NONVOL            4
+#define UWOP_SAVE_NONVOL_FAR        5
+#define UWOP_EPILOG                 6   // UWOP_SAVE_XMM in version 1
+#define UWOP_SPARE                  7   // UWOP_SAVE_XMM_FAR in version 1
+#define UWOP_SAVE_XMM128            8
+#define UWOP_SAVE_XMM128_FAR        9
+#define UWOP_PUSH_MACHFRAME         10
+
+#define UNWIND_FLAG_CHAININFO       0x04
+#define RUNTIME_FUNCTION_INDIRECT   0x01    // In UnwindInfoAddress, the entry points to another entry
+#define MAX_UNWIND_CHAIN            32      // Chained entries followed at most, the chain may loop
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <headers.hpp>
+#include <vector>
+
+namespace resurgence
+{
+    namespace system
+    {
+        class process;
+
+        ///<summary>
+        /// The memory a stack is unwound from.
+        ///</summary>
+        ///<remarks>
+        /// Sources are read by every thread unwinding at once, so read must be thread safe.
+        ///</remarks>
+        class unwind_memory_source
+        {
+        public:
+            virtual ~unwind_memory_source() {}
+
+            ///<summary>
+            /// Reads memory.
+            ///</summary>
+            ///<param name="address"> The address. </param>
+            ///<param name="buffer">  The buffer. </param>
+            ///<param name="size">    The number of bytes. </param>
+            ///<returns>
+            /// The status code. Nothing is read unless the whole range is.
+            ///</returns>
+            virtual NTSTATUS read(uint64_t address, void* buffer, size_t size) = 0;
+        };
+
+        ///<summary>
+        /// Reads the memory of a live process.
+        ///</summary>
+        class process_unwind_memory : public unwind_memory_source
+        {
+        public:
+            explicit process_unwind_memory(process* proc);
+
+            NTSTATUS read(uint64_t address, void* buffer, size_t size) override;
+
+        private:
+            process*    _process;
+        };
+
+        ///<summary>
+        /// Reads recorded memory, e.g. stack snapshots saved from another machine.
+        ///</summary>
+        class snapshot_unwind_memory : public unwind_memory_source
+        {
+        public:
+            ///<summary>
+            /// Adds a recorded region. Regions must not overlap, and can't be added while reading.
+            ///</summary>
+            ///<param name="address"> The address of the region. </param>
+            ///<param name="data">    The contents. </param>
+            ///<param name="size">    The size of the region. </param>
+            void add_region(uint64_t address, const void* data, size_t size);
+
+            NTSTATUS read(uint64_t address, void* buffer, size_t size) override;
+
+        private:
+            struct region
+            {
+                uint64_t                address;
+                std::vector<uint8_t>    data;
+            };
+
+            std::vector<region> _regions;   // Sorted by address
+        };
+    }
+}
@@ -0,0 +1,164 @@
+#include <misc/information_pool.hpp>
+#include <misc/native.hpp>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        //
+        // Sizes are rounded to the allocation granularity and get 1/8 extra
+        // so small growth between two queries doesn't force a reallocation.
+        //
+        static size_t grow_size(size_t required)
+        {
+            const size_t granularity = 0x10000;
+
+            required += required / 8;
+            return (required / granularity + 1) * granularity;
+        }
+
+        information_buffer::information_buffer()
+            : _pool(nullptr), _information(SystemBasicInformation), _buffer(nullptr), _capacity(0), _size(0)
+        {
+        }
+        information_buffer::information_buffer(information_pool* pool, SYSTEM_INFORMATION_CLASS information, uint8_t* buffer, size_t capacity, size_t size)
+            : _pool(pool), _information(information), _buffer(buffer), _capacity(capacity), _size(size)
+        {
+        }
+        information_buffer::information_buffer(information_buffer&& rhs)
+            : _pool(rhs._pool), _information(rhs._information), _buffer(rhs._buffer), _capacity(rhs._capacity), _size(rhs._size)
+        {
+            rhs._buffer = nullptr;
+        }
+        information_buffer::~information_buffer()
+        {
+            release();
+        }
+        information_buffer& information_buffer::operator=(information_buffer&& rhs)
+        {
+            if(this != &rhs) {
+                release();
+                _pool = rhs._pool;
+                _information = rhs._information;
+                _buffer = rhs._buffer;
+                _capacity = rhs._capacity;
+                _size = rhs._size;
+                rhs._buffer = nullptr;
+            }
+            return *this;
+        }
+        void information_buffer::release()
+        {
+            if(_buffer) {
+                _pool->release(_information, _buffer, _capacity);
+                _buffer = nullptr;
+                _size = 0;
+            }
+        }
+
+        //-----------------------------------------------------------------------
+
+        information_pool::information_pool()
+        {
+        }
+        information_pool::~information_pool()
+        {
+            trim();
+        }
+        information_pool& information_pool::instance()
+        {
+            static information_pool pool;
+            return pool;
+        }
+        information_buffer information_pool::query(SYSTEM_INFORMATION_CLASS information)
+        {
+            uint8_t*    buffer = nullptr;
+            size_t      capacity = 0;
+            ULONG       required = 0;
+            NTSTATUS    status;
+
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+
+                auto& entry = _slots[information];
+                if(entry.buffer) {
+                    buffer = entry.buffer;
+                    capacity = entry.capacity;
+                    entry.buffer = nullptr;
+                    entry.capacity = 0;
+                } else {
+                    capacity = entry.hint;
+                }
+            }
+
+            if(!buffer) {
+                if(capacity == 0)
+                    capacity = grow_size(native::query_required_size(information));
+                allocate_local_buffer(&buffer, capacity);
+                if(!buffer) {
+                    set_last_ntstatus(STATUS_NO_MEMORY);
+                    return information_buffer();
+                }
+            }
+
+            do {
+                status = NtQuerySystemInformation(information, buffer, (ULONG)capacity, &required);
+                if(status != STATUS_INFO_LENGTH_MISMATCH)
+                    break;
+
+                free_local_buffer(buffer);
+                buffer = nullptr;
+
+                //
+                // Some classes don't report the required size
+                //
+                capacity = required > capacity ? grow_size(required) : capacity * 2;
+
+                allocate_local_buffer(&buffer, capacity);
+                if(!buffer) {
+                    set_last_ntstatus(STATUS_NO_MEMORY);
+                    return information_buffer();
+                }
+            } while(true);
+
+            if(!NT_SUCCESS(status)) {
+                release(information, buffer, capacity);
+                set_last_ntstatus(status);
+                return information_buffer();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _slots[information].hint = grow_size(required);
+            }
+            return information_buffer(this, information, buffer, capacity, required);
+        }
+        void information_pool::trim()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            for(auto& entry : _slots) {
+                if(entry.second.buffer) {
+                    free_local_buffer(entry.second.buffer);
+                    entry.second.buffer = nullptr;
+                    entry.second.capacity = 0;
+                }
+            }
+        }
+        void information_pool::release(SYSTEM_INFORMATION_CLASS information, uint8_t* buffer, size_t capacity)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            auto& entry = _slots[information];
+            if(entry.buffer && entry.capacity >= capacity) {
+                free_local_buffer(buffer);
+                return;
+            }
+            if(entry.buffer)
+                free_local_buffer(entry.buffer);
+
+            entry.buffer = buffer;
+            entry.capacity = capacity;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#include <misc/mapped_file.hpp>
+#include <misc/native.hpp>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        mapped_file::mapped_file()
+            : _base(nullptr), _size(0)
+        {
+        }
+
+        mapped_file::mapped_file(mapped_file&& rhs)
+            : _base(rhs._base), _size(rhs._size)
+        {
+            rhs._base = nullptr;
+            rhs._size = 0;
+        }
+
+        mapped_file::~mapped_file()
+        {
+            close();
+        }
+
+        mapped_file& mapped_file::operator=(mapped_file&& rhs)
+        {
+            if(this != &rhs) {
+                close();
+                _base = rhs._base;
+                _size = rhs._size;
+                rhs._base = nullptr;
+                rhs._size = 0;
+            }
+            return *this;
+        }
+
+        ///<summary>
+        /// Maps a file.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS mapped_file::open(const std::wstring& path)
+        {
+            NTSTATUS        status;
+            HANDLE          fileHandle;
+            HANDLE          sectionHandle;
+            LARGE_INTEGER   fileSize;
+            PVOID           viewBase = nullptr;
+            SIZE_T          viewSize = 0;
+
+            close();
+
+            status = native::open_file(path, FILE_READ_ATTRIBUTES | FILE_READ_DATA | SYNCHRONIZE, &fileHandle);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            status = native::get_file_size(fileHandle, nullptr, &fileSize);
+            if(NT_SUCCESS(status) && fileSize.QuadPart == 0)
+                status = STATUS_MAPPED_FILE_SIZE_ZERO;
+
+            if(NT_SUCCESS(status)) {
+                status = NtCreateSection(
+                    &sectionHandle,
+                    SECTION_MAP_READ | SECTION_QUERY,
+                    NULL,
+                    &fileSize,
+                    PAGE_READONLY,
+                    SEC_COMMIT,
+                    fileHandle);
+
+                if(NT_SUCCESS(status)) {
+                    status = NtMapViewOfSection(
+                        sectionHandle,
+                        NtCurrentProcess(),
+                        &viewBase,
+                        0,
+                        0,
+                        NULL,
+                        &viewSize,
+                        ViewShare,
+                        0,
+                        PAGE_READONLY);
+
+                    if(NT_SUCCESS(status)) {
+                        _base = static_cast<const uint8_t*>(viewBase);
+                        _size = static_cast<size_t>(fileSize.QuadPart);
+                    }
+                    NtClose(sectionHandle);
+                }
+            }
+            NtClose(fileHandle);
+            return status;
+        }
+
+        ///<summary>
+        /// Unmaps the file.
+        ///</summary>
+        void mapped_file::close()
+        {
+            if(_base) {
+                NtUnmapViewOfSection(NtCurrentProcess(), const_cast<uint8_t*>(_base));
+                _base = nullptr;
+                _size = 0;
+            }
+        }
+    }
+}
@@ -1,6 +1,10 @@
 #include <misc/native.hpp>
 #include <misc/safe_handle.hpp>
 #include <misc/exceptions.hpp>
+#include <misc/information_pool.hpp>
+#include <misc/native_ranges.hpp>
+#include <misc/object_namespace.hpp>
+#include <misc/path_translator.hpp>
 #include <system/process.hpp>
 
 #include <algorithm>
@@ -222,18 +226,13 @@ namespace resurgence
         {
             if(!callback) return STATUS_INVALID_PARAMETER_1;
 
-            uint8_t*    buffer = nullptr;
             NTSTATUS    status = STATUS_SUCCESS;
 
-            buffer = query_system_information(SystemModuleInformation);
-            if(buffer) {
-                auto pSysModules = (PRTL_PROCESS_MODULES)buffer;
-                for(ULONG i = 0; i < pSysModules->NumberOfModules; i++) {
-                    status = callback(&pSysModules->Modules[i]);
-                    if(NT_SUCCESS(status))
-                        break;
-                }
-                free_local_buffer(buffer);
+            auto buffer = misc::information_pool::instance().query(SystemModuleInformation);
+            for(auto& module : system_module_range(buffer)) {
+                status = callback(&module);
+                if(NT_SUCCESS(status))
+                    break;
             }
             return status;
         }
@@ -256,51 +255,28 @@ namespace resurgence
             if(root.empty()) return STATUS_INVALID_PARAMETER_1;
             if(!callback)    return STATUS_INVALID_PARAMETER_2;
 
-            OBJECT_ATTRIBUTES   objAttr;
-            UNICODE_STRING      usDirectoryName;
-            NTSTATUS            status;
-            HANDLE              hDirectory;
-            ULONG               uEnumCtx = 0;
-            size_t              uBufferSize = 0x100;
-            POBJECT_DIRECTORY_INFORMATION   pObjBuffer = nullptr;
-
-            RtlSecureZeroMemory(&usDirectoryName, sizeof(usDirectoryName));
-            RtlInitUnicodeString(&usDirectoryName, std::data(root));
-            InitializeObjectAttributes(&objAttr, &usDirectoryName, OBJ_CASE_INSENSITIVE, nullptr, nullptr);
-
-            status = NtOpenDirectoryObject(&hDirectory, DIRECTORY_QUERY, &objAttr);
+            //
+            // Work on a copy, the callback is free to refresh the directory.
+            //
+            std::vector<misc::object_namespace::entry> entries;
 
-            if(!NT_SUCCESS(status) || !hDirectory) {
+            NTSTATUS status = misc::object_namespace::instance().get_directory(root, entries);
+            if(!NT_SUCCESS(status))
                 return status;
-            }
-
-            pObjBuffer = (POBJECT_DIRECTORY_INFORMATION)RtlAllocateHeap(NtCurrentPeb()->ProcessHeap, 0, uBufferSize);
-
-            do {
-                status = NtQueryDirectoryObject(hDirectory, pObjBuffer, (ULONG)uBufferSize, TRUE, FALSE, &uEnumCtx, (PULONG)&uBufferSize);
-                if(!NT_SUCCESS(status)) {
-                    if(status == STATUS_BUFFER_TOO_SMALL || status == STATUS_INFO_LENGTH_MISMATCH) {
-                        if(pObjBuffer != nullptr)
-                            RtlFreeHeap(NtCurrentPeb()->ProcessHeap, 0, pObjBuffer);
-                        uBufferSize = uBufferSize * 2;
-                        pObjBuffer = (POBJECT_DIRECTORY_INFORMATION)RtlAllocateHeap(NtCurrentPeb()->ProcessHeap, 0, uBufferSize);
-                        continue;
-                    }
-                    break;
-                }
-
-                if(!pObjBuffer) break;
-
-                status = callback(pObjBuffer);
-                if(NT_SUCCESS(status))
-                    break;
-            } while(true);
 
-            if(pObjBuffer != nullptr)
-                RtlFreeHeap(NtCurrentPeb()->ProcessHeap, 0, pObjBuffer);
+            OBJECT_DIRECTORY_INFORMATION info;
+            for(auto& entry : entries) {
+                info.Name.Buffer            = const_cast<PWSTR>(entry.name.c_str());
+                info.Name.Length            = static_cast<USHORT>(entry.name.size() * sizeof(wchar_t));
+                info.Name.MaximumLength     = info.Name.Length + sizeof(wchar_t);
+                info.TypeName.Buffer        = const_cast<PWSTR>(entry.type_name.c_str());
+                info.TypeName.Length        = static_cast<USHORT>(entry.type_name.size() * sizeof(wchar_t));
+                info.TypeName.MaximumLength = info.TypeName.Length + sizeof(wchar_t);
 
-            NtClose(hDirectory);
-            return status;
+                if(NT_SUCCESS(callback(&info)))
+                    return STATUS_SUCCESS;
+            }
+            return STATUS_NO_MORE_ENTRIES;
         }
 
         ///<summary>
@@ -317,19 +293,13 @@ namespace resurgence
         {
             if(!callback) return STATUS_INVALID_PARAMETER_1;
 
-            uint8_t*   buffer = nullptr;
             NTSTATUS   status = STATUS_SUCCESS;
 
-            buffer = query_system_information(SystemExtendedProcessInformation);
-            if(buffer) {
-                auto pProcessEntry = (PSYSTEM_PROCESS_INFORMATION)buffer;
-                while(pProcessEntry->NextEntryDelta) {
-                    status = callback((PSYSTEM_PROCESS_INFORMATION)pProcessEntry);
-                    if(NT_SUCCESS(status))
-                        break;
-                    pProcessEntry = (PSYSTEM_PROCESS_INFORMATION)((PUCHAR)pProcessEntry + pProcessEntry->NextEntryDelta);
-                }
-                free_local_buffer(buffer);
+            auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+            for(auto& entry : process_range(buffer)) {
+                status = callback(&entry);
+                if(NT_SUCCESS(status))
+                    break;
             }
             return status;
         }
@@ -351,17 +321,20 @@ namespace resurgence
         {
             if(!callback) return STATUS_INVALID_PARAMETER_2;
             
-            return enumerate_processes([=](PSYSTEM_PROCESS_INFORMATION entry) {
-                if(pid == reinterpret_cast<uint32_t>(entry->UniqueProcessId)) {
-                    for(auto i = 0ul; i < entry->ThreadCount; i++) {
-                        auto status = callback((PSYSTEM_EXTENDED_THREAD_INFORMATION)&entry->Threads[i]);
-                        if(NT_SUCCESS(status))
+            auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+            if(!buffer)
+                return get_last_ntstatus();
+
+            for(auto& entry : process_range(buffer)) {
+                if(pid == reinterpret_cast<uint32_t>(entry.UniqueProcessId)) {
+                    for(auto& thread : thread_range(entry)) {
+                        if(NT_SUCCESS(callback(&thread)))
                             break;
                     }
                     return STATUS_SUCCESS;
                 }
-                return STATUS_NOT_FOUND;
-            });
+            }
+            return STATUS_NOT_FOUND;
         }
 
         ///<summary>
@@ -538,18 +511,7 @@ namespace resurgence
         ///</returns>
         NTSTATUS object_exists(const std::wstring& root, const std::wstring& object, bool* found)
         {
-            UNICODE_STRING  uName;
-
-            RtlInitUnicodeString(&uName, std::data(object));
-
-            NTSTATUS status = enumerate_system_objects(root, [&](POBJECT_DIRECTORY_INFORMATION entry) -> NTSTATUS {
-                if(RtlEqualUnicodeString(&uName, &entry->Name, TRUE)) {
-                    *found = true;
-                    return STATUS_SUCCESS;
-                }
-                return STATUS_NOT_FOUND;
-            });
-            return status;
+            return misc::object_namespace::instance().object_exists(root, object, found);
         }
 
         ///<summary>
@@ -612,6 +574,7 @@ namespace resurgence
                 nullptr, 
                 0);
 
+            RtlFreeUnicodeString(&usFilePath);
             return status;
         }
 
@@ -640,6 +603,57 @@ namespace resurgence
             return status;
         }
 
+        ///<summary>
+        /// Creates a file, or replaces an existing one, with the given contents.
+        ///</summary>
+        ///<param name="path">   The file path. </param>
+        ///<param name="buffer"> The contents. </param>
+        ///<param name="length"> The size of the contents. </param>
+        ///<returns> 
+        /// The status code.
+        ///</returns>
+        NTSTATUS create_file(const std::wstring& path, const uint8_t* buffer, size_t length)
+        {
+            UNICODE_STRING      usFilePath;
+            OBJECT_ATTRIBUTES   objAttr;
+            IO_STATUS_BLOCK     ioStatus;
+            HANDLE              handle;
+            NTSTATUS            status;
+
+            if(length > MAXULONG)
+                return STATUS_INVALID_PARAMETER;
+
+            if(!RtlDosPathNameToNtPathName_U(
+                std::data(path),
+                &usFilePath,
+                NULL,
+                NULL))
+                return STATUS_OBJECT_NAME_NOT_FOUND;
+
+            InitializeObjectAttributes(&objAttr, &usFilePath, OBJ_CASE_INSENSITIVE, NULL, NULL);
+
+            status = NtCreateFile(
+                &handle,
+                FILE_GENERIC_WRITE,
+                &objAttr,
+                &ioStatus,
+                0,
+                FILE_ATTRIBUTE_NORMAL,
+                0,
+                FILE_OVERWRITE_IF,
+                FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+                nullptr,
+                0);
+
+            RtlFreeUnicodeString(&usFilePath);
+
+            if(NT_SUCCESS(status)) {
+                status = NtWriteFile(handle, NULL, NULL, NULL, &ioStatus, const_cast<uint8_t*>(buffer), static_cast<uint32_t>(length), NULL, NULL);
+                NtClose(handle);
+            }
+            return status;
+        }
+
         NTSTATUS get_file_size(HANDLE handle, size_t* size, LARGE_INTEGER* li)
         {
             NTSTATUS                    status;
@@ -706,39 +720,20 @@ namespace resurgence
         ///</returns>
         std::wstring get_dos_path(const std::wstring& path)
         {
-            auto startsWith = [](const std::wstring& str1, const std::wstring& str2, bool ignoreCasing) {
-                if(ignoreCasing) {
-                    std::wstring copy1 = str1, copy2 = str2;
-                    std::transform(copy1.begin(), copy1.end(), copy1.begin(), ::tolower);
-                    std::transform(copy2.begin(), copy2.end(), copy2.begin(), ::tolower);
-                    return copy1.compare(0, copy2.size(), copy2) == 0;
-                } else {
-                    return str1.compare(0, str2.size(), str2) == 0;
-                }
-            };
-
-            std::wstring dosPath = path;
-
-            auto idx = dosPath.find(L"\\??\\");
-            if(startsWith(dosPath, L"\\??\\", false)) {
-                return dosPath.substr(idx + 4);
-            } else if(startsWith(dosPath, L"\\SystemRoot", true)) {
-                return std::wstring(USER_SHARED_DATA->NtSystemRoot) + dosPath.substr(11);
-            } else if(startsWith(dosPath, L"system32\\", true)) {
-                return std::wstring(USER_SHARED_DATA->NtSystemRoot) + L"\\system32" + dosPath.substr(8);
-            } else if(startsWith(dosPath, L"\\Device", true)) {
-                std::vector<std::wstring> drives;
-                query_mounted_drives(drives);
-                for(auto& drive : drives) {
-                    std::wstring sym;
-                    get_symbolic_link_from_drive(drive, sym);
-                    if(startsWith(dosPath, sym, false)) {
-                        dosPath.replace(0, sym.size(), drive);
-                        break;
-                    }
-                }
+            auto str = std::data(path);
+
+            if(!wcsncmp(str, L"\\??\\", 4)) {
+                return path.substr(4);
+            } else if(!_wcsnicmp(str, L"\\SystemRoot", 11)) {
+                return std::wstring(USER_SHARED_DATA->NtSystemRoot) + path.substr(11);
+            } else if(!_wcsnicmp(str, L"system32\\", 9)) {
+                return std::wstring(USER_SHARED_DATA->NtSystemRoot) + L"\\system32" + path.substr(8);
+            } else if(!_wcsnicmp(str, L"\\Device", 7)) {
+                std::wstring dosPath;
+                if(misc::path_translator::instance().translate(path, dosPath))
+                    return dosPath;
             }
-            return dosPath;
+            return path;
         }
 
         ///<summary>
@@ -780,45 +775,13 @@ namespace resurgence
         ///</returns>
         NTSTATUS get_symbolic_link_from_drive(const std::wstring& drive, std::wstring& deviceLink)
         {
-            HANDLE              linkHandle;
-            OBJECT_ATTRIBUTES   oa;
-            UNICODE_STRING      deviceName;
-            UNICODE_STRING      devicePrefix;
+            if(drive.empty()) return STATUS_INVALID_PARAMETER_1;
 
             wchar_t deviceNameBuffer[] = L"\\??\\ :";
 
             deviceNameBuffer[4] = drive[0];
 
-            deviceName.Buffer = deviceNameBuffer;
-            deviceName.Length = 6 * sizeof(wchar_t);
-            deviceName.MaximumLength = 7 * sizeof(wchar_t);
-
-            InitializeObjectAttributes(
-                &oa,
-                &deviceName,
-                OBJ_CASE_INSENSITIVE,
-                NULL,
-                NULL
-            );
-
-            devicePrefix.Length = MAX_PATH * sizeof(WCHAR);
-            devicePrefix.MaximumLength = MAX_PATH * sizeof(WCHAR);
-            devicePrefix.Buffer = nullptr;
-            allocate_local_buffer(&devicePrefix.Buffer, MAX_PATH * sizeof(WCHAR));
-            
-            ZeroMemory(devicePrefix.Buffer, MAX_PATH * sizeof(WCHAR));
-            //devicePrefix.Buffer = (PWSTR)RtlAllocateHeap(NtCurrentPeb()->ProcessHeap, 0, MAX_PATH * sizeof(WCHAR));
-
-            auto status = NtOpenSymbolicLinkObject(&linkHandle, SYMBOLIC_LINK_QUERY, &oa);
-            if(NT_SUCCESS(status)) {
-                status = NtQuerySymbolicLinkObject(linkHandle, &devicePrefix, NULL);
-                if(NT_SUCCESS(status)) {
-                    deviceLink = std::wstring(devicePrefix.Buffer, devicePrefix.Length / sizeof(wchar_t));
-                }
-                NtClose(linkHandle);
-            }
-            free_local_buffer(devicePrefix.Buffer);
-            return status;
+            return misc::object_namespace::instance().resolve_symbolic_link(deviceNameBuffer, deviceLink);
         }
 
         ///<summary>
@@ -879,7 +842,15 @@ namespace resurgence
 
             CloseServiceHandle(schService);
 
-            return success ? STATUS_SUCCESS : get_last_ntstatus();
+            if(!success)
+                return get_last_ntstatus();
+
+            //
+            // The driver is likely to have created device objects
+            //
+            misc::object_namespace::instance().refresh(L"\\Device");
+            misc::object_namespace::instance().refresh(L"\\Driver");
+            return STATUS_SUCCESS;
         }
 
         ///<summary>
@@ -917,6 +888,9 @@ namespace resurgence
 
             if(iRetryCount == 0)
                 return get_last_ntstatus();
+
+            misc::object_namespace::instance().refresh(L"\\Device");
+            misc::object_namespace::instance().refresh(L"\\Driver");
             return STATUS_SUCCESS;
         }
 
@@ -1165,6 +1139,27 @@ namespace resurgence
             return NtOpenProcess(handle, access, &objAttr, &cid);
         }
 
+        ///<summary>
+        /// Opens a thread.
+        ///</summary>
+        ///<param name="handle"> The returned handle. </param>
+        ///<param name="tid">    The thread id. </param>
+        ///<param name="access"> The desired access flags. </param>
+        ///<returns> 
+        /// The status code.
+        ///</returns>
+        NTSTATUS open_thread(PHANDLE handle, uint32_t tid, uint32_t access)
+        {
+            OBJECT_ATTRIBUTES objAttr;
+
+            InitializeObjectAttributes(&objAttr, NULL, NULL, NULL, NULL);
+            CLIENT_ID cid;
+            cid.UniqueProcess = 0;
+            cid.UniqueThread = reinterpret_cast<HANDLE>(tid);
+
+            return NtOpenThread(handle, access, &objAttr, &cid);
+        }
+
         ///<summary>
         /// Checks if the process is running under WOW64.
         ///</summary>
@@ -1282,6 +1277,7 @@ namespace resurgence
                                 }
                                 image.section_count = nthdrs->FileHeader.NumberOfSections;
                                 image.sections = (IMAGE_SECTION_HEADER*)((uintptr_t)&nthdrs->OptionalHeader + nthdrs->FileHeader.SizeOfOptionalHeader);
+                                image.sections_sorted = image_sections_sorted(image.sections, image.section_count);
                             }
                         }
                         NtClose(sectionHandle);
@@ -1303,16 +1299,7 @@ namespace resurgence
 
         PIMAGE_SECTION_HEADER mapped_image_rva_to_section(const mapped_image& image, ULONG rva)
         {
-            ULONG i;
-
-            for(i = 0; i < image.section_count; i++) {
-                if((rva >= image.sections[i].VirtualAddress) &&
-                   (rva < image.sections[i].VirtualAddress + image.sections[i].SizeOfRawData)) {
-                    return &image.sections[i];
-                }
-            }
-
-            return NULL;
+            return const_cast<PIMAGE_SECTION_HEADER>(image_rva_to_section(image.sections, image.section_count, image.sections_sorted, rva));
         }
 
         uintptr_t mapped_image_rva_to_va(const mapped_image& image, ULONG rva)
@@ -1326,5 +1313,82 @@ namespace resurgence
 
             return (uintptr_t)(image.view_base + (rva - section->VirtualAddress) + section->PointerToRawData);
         }
+
+        ///<summary>
+        /// Translates many RVAs of a mapped image at once.
+        ///</summary>
+        ///<param name="image"> The image. </param>
+        ///<param name="rvas">  The RVAs, in any order. </param>
+        ///<param name="count"> The number of RVAs. </param>
+        ///<param name="vas">   Receives the addresses in the view, 0 for RVAs outside every section. </param>
+        void mapped_image_rvas_to_vas(const mapped_image& image, const uint32_t* rvas, size_t count, uintptr_t* vas)
+        {
+            PIMAGE_SECTION_HEADER section = nullptr;
+
+            for(size_t i = 0; i < count; i++) {
+                //
+                // Tables and what they point to (export names, import thunks) mostly sit in one
+                // section, so try the last one first. Only sorted sections can't both contain an RVA.
+                //
+                if(!section || !image.sections_sorted || rvas[i] - section->VirtualAddress >= section->SizeOfRawData)
+                    section = mapped_image_rva_to_section(image, rvas[i]);
+
+                vas[i] = section ? image.view_base + (rvas[i] - section->VirtualAddress) + section->PointerToRawData : 0;
+            }
+        }
+
+        ///<summary>
+        /// Checks whether section headers are sorted by RVA and their raw data ranges don't overlap,
+        /// in which case image_rva_to_section can bisect them.
+        ///</summary>
+        ///<param name="sections"> The section headers. </param>
+        ///<param name="count">    The number of sections. </param>
+        bool image_sections_sorted(const IMAGE_SECTION_HEADER* sections, ULONG count)
+        {
+            for(ULONG i = 1; i < count; i++) {
+                if(static_cast<uint64_t>(sections[i - 1].VirtualAddress) + sections[i - 1].SizeOfRawData > sections[i].VirtualAddress)
+                    return false;
+            }
+            return true;
+        }
+
+        ///<summary>
+        /// Finds the section whose raw data contains an RVA.
+        ///</summary>
+        ///<param name="sections"> The section headers. </param>
+        ///<param name="count">    The number of sections. </param>
+        ///<param name="sorted">   What image_sections_sorted returned for them. Unsorted headers are scanned in order. </param>
+        ///<param name="rva">      The RVA. </param>
+        ///<returns>
+        /// The first section containing the RVA, nullptr if none.
+        ///</returns>
+        const IMAGE_SECTION_HEADER* image_rva_to_section(const IMAGE_SECTION_HEADER* sections, ULONG count, bool sorted, ULONG rva)
+        {
+            if(!sorted) {
+                for(ULONG i = 0; i < count; i++) {
+                    if(rva >= sections[i].VirtualAddress && rva - sections[i].VirtualAddress < sections[i].SizeOfRawData)
+                        return &sections[i];
+                }
+                return nullptr;
+            }
+
+            //
+            // Only the last section starting at or below the RVA can contain it
+            //
+            ULONG low = 0;
+            ULONG high = count;
+            while(low < high) {
+                ULONG middle = low + (high - low) / 2;
+                if(sections[middle].VirtualAddress <= rva)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            if(low == 0)
+                return nullptr;
+
+            auto section = &sections[low - 1];
+            return rva - section->VirtualAddress < section->SizeOfRawData ? section : nullptr;
+        }
     }
 }
@@ -0,0 +1,282 @@
+#include <misc/object_namespace.hpp>
+#include <misc/native.hpp>
+
+#include <algorithm>
+#include <cwctype>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        static bool entry_less(const object_namespace::entry& lhs, const object_namespace::entry& rhs)
+        {
+            return _wcsicmp(lhs.name.c_str(), rhs.name.c_str()) < 0;
+        }
+
+        object_namespace::object_namespace()
+        {
+        }
+
+        ///<summary>
+        /// Gets the shared cache.
+        ///</summary>
+        object_namespace& object_namespace::instance()
+        {
+            static object_namespace cache;
+            return cache;
+        }
+
+        ///<summary>
+        /// Gets the entries of a directory, sorted by name (case insensitive).
+        ///</summary>
+        ///<param name="directory"> The directory path (i.e "\Device"). </param>
+        ///<param name="entries">   Receives a copy of the entries. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS object_namespace::get_directory(const std::wstring& directory, std::vector<entry>& entries)
+        {
+            if(directory.empty()) return STATUS_INVALID_PARAMETER_1;
+
+            const std::vector<entry>* cached;
+
+            //
+            // Copied under the lock, a refresh from another thread frees the cached directory
+            //
+            std::lock_guard<std::recursive_mutex> lock(_lock);
+
+            NTSTATUS status = get_directory_locked(directory, &cached);
+            if(NT_SUCCESS(status))
+                entries = *cached;
+            return status;
+        }
+
+        ///<summary>
+        /// Finds an object in a directory.
+        ///</summary>
+        ///<param name="directory"> The directory path. </param>
+        ///<param name="name">      The object name. </param>
+        ///<param name="result">    Receives a copy of the entry. </param>
+        ///<returns>
+        /// The status code. STATUS_NOT_FOUND if the directory has no such object.
+        ///</returns>
+        NTSTATUS object_namespace::find(const std::wstring& directory, const std::wstring& name, entry* result)
+        {
+            if(!result) return STATUS_INVALID_PARAMETER_3;
+
+            const std::vector<entry>* entries;
+
+            //
+            // Copied under the lock, like get_directory
+            //
+            std::lock_guard<std::recursive_mutex> lock(_lock);
+
+            NTSTATUS status = get_directory_locked(directory, &entries);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto it = std::lower_bound(entries->begin(), entries->end(), name, [](const entry& lhs, const std::wstring& rhs) {
+                return _wcsicmp(lhs.name.c_str(), rhs.c_str()) < 0;
+            });
+
+            if(it == entries->end() || _wcsicmp(it->name.c_str(), name.c_str()))
+                return STATUS_NOT_FOUND;
+
+            *result = *it;
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Checks if a object exists.
+        ///</summary>
+        ///<param name="directory"> The directory path. </param>
+        ///<param name="name">      The object name. </param>
+        ///<param name="found">     Pointer to a variable that will hold the result. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS object_namespace::object_exists(const std::wstring& directory, const std::wstring& name, bool* found)
+        {
+            if(!found) return STATUS_INVALID_PARAMETER_3;
+
+            entry result;
+
+            NTSTATUS status = find(directory, name, &result);
+            *found = NT_SUCCESS(status);
+            return status == STATUS_NOT_FOUND ? STATUS_SUCCESS : status;
+        }
+
+        ///<summary>
+        /// Resolves a symbolic link.
+        ///</summary>
+        ///<param name="path">   The link path (i.e "\GLOBAL??\C:"). </param>
+        ///<param name="target"> The link target. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS object_namespace::resolve_symbolic_link(const std::wstring& path, std::wstring& target)
+        {
+            if(path.empty()) return STATUS_INVALID_PARAMETER_1;
+
+            auto key = make_key(path);
+
+            std::lock_guard<std::recursive_mutex> lock(_lock);
+
+            auto it = _links.find(key);
+            if(it != _links.end()) {
+                target = it->second;
+                return STATUS_SUCCESS;
+            }
+
+            //
+            // Links are opened directly rather than through their directory,
+            // \?? is a per-session view and doesn't list global links.
+            //
+            HANDLE              linkHandle;
+            OBJECT_ATTRIBUTES   objAttr;
+            UNICODE_STRING      usLinkName;
+            UNICODE_STRING      usTarget;
+            wchar_t             buffer[MAX_PATH];
+
+            RtlInitUnicodeString(&usLinkName, path.c_str());
+            InitializeObjectAttributes(&objAttr, &usLinkName, OBJ_CASE_INSENSITIVE, nullptr, nullptr);
+
+            NTSTATUS status = NtOpenSymbolicLinkObject(&linkHandle, SYMBOLIC_LINK_QUERY, &objAttr);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            usTarget.Buffer = buffer;
+            usTarget.Length = 0;
+            usTarget.MaximumLength = sizeof(buffer);
+
+            status = NtQuerySymbolicLinkObject(linkHandle, &usTarget, nullptr);
+            if(NT_SUCCESS(status)) {
+                target.assign(usTarget.Buffer, usTarget.Length / sizeof(wchar_t));
+                _links.emplace(std::move(key), target);
+            }
+            NtClose(linkHandle);
+            return status;
+        }
+
+        ///<summary>
+        /// Drops a cached directory, and the cached links it contains.
+        ///</summary>
+        ///<param name="directory"> The directory path. </param>
+        void object_namespace::refresh(const std::wstring& directory)
+        {
+            auto key = make_key(directory);
+
+            std::lock_guard<std::recursive_mutex> lock(_lock);
+
+            _directories.erase(key);
+
+            if(key.empty() || key.back() != L'\\')
+                key.push_back(L'\\');
+
+            for(auto it = _links.begin(); it != _links.end(); ) {
+                if(it->first.compare(0, key.size(), key) == 0 && it->first.find(L'\\', key.size()) == std::wstring::npos)
+                    it = _links.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        ///<summary>
+        /// Drops everything.
+        ///</summary>
+        void object_namespace::refresh_all()
+        {
+            std::lock_guard<std::recursive_mutex> lock(_lock);
+
+            _directories.clear();
+            _links.clear();
+        }
+
+        std::wstring object_namespace::make_key(const std::wstring& path)
+        {
+            std::wstring key(path);
+            std::transform(key.begin(), key.end(), key.begin(), towupper);
+
+            //
+            // "\Device\" and "\Device" are the same directory
+            //
+            if(key.size() > 1 && key.back() == L'\\')
+                key.pop_back();
+            return key;
+        }
+
+        NTSTATUS object_namespace::get_directory_locked(const std::wstring& path, const directory** entries)
+        {
+            auto key = make_key(path);
+
+            auto it = _directories.find(key);
+            if(it != _directories.end()) {
+                *entries = it->second.get();
+                return STATUS_SUCCESS;
+            }
+
+            std::unique_ptr<directory> loaded(new directory());
+
+            NTSTATUS status = load_directory(path, *loaded);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            *entries = loaded.get();
+            _directories.emplace(std::move(key), std::move(loaded));
+            return STATUS_SUCCESS;
+        }
+
+        NTSTATUS object_namespace::load_directory(const std::wstring& path, directory& entries)
+        {
+            OBJECT_ATTRIBUTES   objAttr;
+            UNICODE_STRING      usDirectoryName;
+            NTSTATUS            status;
+            HANDLE              hDirectory;
+            ULONG               uEnumCtx = 0;
+            ULONG               uLength = 0;
+            BOOLEAN             bRestart = TRUE;
+            size_t              uBufferSize = 0x10000;
+            uint8_t*            buffer = nullptr;
+
+            RtlInitUnicodeString(&usDirectoryName, path.c_str());
+            InitializeObjectAttributes(&objAttr, &usDirectoryName, OBJ_CASE_INSENSITIVE, nullptr, nullptr);
+
+            status = NtOpenDirectoryObject(&hDirectory, DIRECTORY_QUERY, &objAttr);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            allocate_local_buffer(&buffer, uBufferSize);
+            if(!buffer) {
+                NtClose(hDirectory);
+                return STATUS_NO_MEMORY;
+            }
+
+            //
+            // Pull as many entries as fit in the buffer per call instead of one by one.
+            //
+            do {
+                status = NtQueryDirectoryObject(hDirectory, buffer, (ULONG)uBufferSize, FALSE, bRestart, &uEnumCtx, &uLength);
+                if(!NT_SUCCESS(status))
+                    break;
+
+                bRestart = FALSE;
+
+                for(auto info = (POBJECT_DIRECTORY_INFORMATION)buffer; info->Name.Buffer != nullptr; info++) {
+                    entries.push_back(entry{
+                        std::wstring(info->Name.Buffer, info->Name.Length / sizeof(wchar_t)),
+                        std::wstring(info->TypeName.Buffer, info->TypeName.Length / sizeof(wchar_t))
+                    });
+                }
+            } while(status == STATUS_MORE_ENTRIES);
+
+            free_local_buffer(buffer);
+            NtClose(hDirectory);
+
+            if(status == STATUS_NO_MORE_ENTRIES || NT_SUCCESS(status)) {
+                std::sort(entries.begin(), entries.end(), entry_less);
+                return STATUS_SUCCESS;
+            }
+            return status;
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#include <misc/path_translator.hpp>
+#include <misc/native.hpp>
+#include <misc/object_namespace.hpp>
+
+#include <cwctype>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        path_translator::path_translator()
+            : _driveMask(0), _stale(true)
+        {
+        }
+
+        ///<summary>
+        /// Gets the shared translator.
+        ///</summary>
+        path_translator& path_translator::instance()
+        {
+            static path_translator translator;
+            return translator;
+        }
+
+        ///<summary>
+        /// Rebuilds the device prefix table.
+        ///</summary>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS path_translator::refresh()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return rebuild();
+        }
+
+        ///<summary>
+        /// Marks the prefix table as stale. The next translation will rebuild it.
+        ///</summary>
+        void path_translator::invalidate()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stale = true;
+        }
+
+        ///<summary>
+        /// Translates a device path.
+        ///</summary>
+        ///<param name="path">   The device path. </param>
+        ///<param name="length"> The path length, in characters. </param>
+        ///<param name="result"> The translated path. </param>
+        ///<returns>
+        /// True if a device prefix matched, false otherwise.
+        ///</returns>
+        bool path_translator::translate(const wchar_t* path, size_t length, std::wstring& result)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            if(_stale)
+                rebuild();
+
+            size_t  matched = 0;
+            int32_t drive = match(path, length, &matched);
+
+            //
+            // A miss might mean a volume was mounted since the table was built.
+            // Only pay for a rebuild if the drive set actually changed.
+            //
+            if(drive < 0 && GetLogicalDrives() != _driveMask) {
+                rebuild();
+                drive = match(path, length, &matched);
+            }
+
+            if(drive < 0)
+                return false;
+
+            const std::wstring& letter = _drives[drive];
+
+            result.reserve(letter.size() + length - matched);
+            result.assign(letter);
+            result.append(path + matched, length - matched);
+            return true;
+        }
+
+        ///<summary>
+        /// Translates a device path.
+        ///</summary>
+        ///<param name="path">   The device path. </param>
+        ///<param name="result"> The translated path. </param>
+        ///<returns>
+        /// True if a device prefix matched, false otherwise.
+        ///</returns>
+        bool path_translator::translate(const std::wstring& path, std::wstring& result)
+        {
+            return translate(std::data(path), path.size(), result);
+        }
+
+        void path_translator::insert(const std::wstring& prefix, int32_t drive)
+        {
+            uint32_t node = 0;
+
+            for(auto c : prefix) {
+                wchar_t  ch = static_cast<wchar_t>(towupper(c));
+                uint32_t child = _nodes[node].first_child;
+
+                while(child != 0 && _nodes[child].ch != ch)
+                    child = _nodes[child].next_sibling;
+
+                if(child == 0) {
+                    child = static_cast<uint32_t>(_nodes.size());
+                    _nodes.push_back(trie_node{ch, 0, _nodes[node].first_child, -1});
+                    _nodes[node].first_child = child;
+                }
+                node = child;
+            }
+            _nodes[node].drive = drive;
+        }
+
+        int32_t path_translator::match(const wchar_t* path, size_t length, size_t* matched) const
+        {
+            uint32_t node = 0;
+            int32_t  drive = -1;
+
+            for(size_t i = 0; i < length; i++) {
+                wchar_t  ch = static_cast<wchar_t>(towupper(path[i]));
+                uint32_t child = _nodes[node].first_child;
+
+                while(child != 0 && _nodes[child].ch != ch)
+                    child = _nodes[child].next_sibling;
+
+                if(child == 0)
+                    break;
+
+                node = child;
+
+                //
+                // Only accept prefixes that end on a component boundary,
+                // so \Device\HarddiskVolume1 doesn't match \Device\HarddiskVolume10.
+                //
+                if(_nodes[node].drive >= 0 && (i + 1 == length || path[i + 1] == L'\\')) {
+                    drive = _nodes[node].drive;
+                    *matched = i + 1;
+                }
+            }
+            return drive;
+        }
+
+        NTSTATUS path_translator::rebuild()
+        {
+            std::vector<std::wstring> letters;
+
+            _nodes.clear();
+            _drives.clear();
+            _nodes.push_back(trie_node{0, 0, 0, -1});
+            _driveMask = GetLogicalDrives();
+            _stale = false;
+
+            //
+            // Drive links may have been remapped since they were cached
+            //
+            misc::object_namespace::instance().refresh(L"\\??");
+
+            NTSTATUS status = native::query_mounted_drives(letters);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            for(auto& letter : letters) {
+                std::wstring device;
+                if(NT_SUCCESS(native::get_symbolic_link_from_drive(letter, device)) && !device.empty()) {
+                    _drives.push_back(letter);
+                    insert(device, static_cast<int32_t>(_drives.size() - 1));
+                }
+            }
+            return STATUS_SUCCESS;
+        }
+    }
+}
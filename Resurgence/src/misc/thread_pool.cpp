@@ -0,0 +1,125 @@
+#include <misc/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace resurgence
+{
+    namespace misc
+    {
+        ///<summary>
+        /// Creates the pool.
+        ///</summary>
+        ///<param name="threads"> The number of workers, 0 for one per logical processor. </param>
+        thread_pool::thread_pool(size_t threads)
+            : _stopping(false)
+        {
+            if(threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+
+            _workers.reserve(threads);
+            for(size_t i = 0; i < threads; i++)
+                _workers.emplace_back(&thread_pool::worker, this);
+        }
+
+        thread_pool::~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stopping = true;
+            }
+            _signal.notify_all();
+
+            for(auto& worker : _workers)
+                worker.join();
+        }
+
+        ///<summary>
+        /// Gets the shared pool.
+        ///</summary>
+        thread_pool& thread_pool::instance()
+        {
+            static thread_pool pool;
+            return pool;
+        }
+
+        ///<summary>
+        /// Runs body(0) ... body(count - 1) on the pool and waits for all of them.
+        ///</summary>
+        ///<param name="count"> The number of iterations. </param>
+        ///<param name="body">  The loop body. </param>
+        void thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& body)
+        {
+            struct loop_state
+            {
+                std::atomic<size_t>     next;
+                std::atomic<size_t>     done;
+                std::mutex              lock;
+                std::condition_variable finished;
+            };
+
+            if(count == 0)
+                return;
+
+            if(count == 1 || _workers.empty()) {
+                for(size_t i = 0; i < count; i++)
+                    body(i);
+                return;
+            }
+
+            auto state = std::make_shared<loop_state>();
+            state->next = 0;
+            state->done = 0;
+
+            //
+            // Workers and the caller all pull iterations from the same counter.
+            // Helpers that start after the loop is over just return.
+            //
+            auto run = [state, count, &body]() {
+                size_t completed = 0;
+                for(size_t i = state->next++; i < count; i = state->next++) {
+                    body(i);
+                    completed++;
+                }
+                if(completed != 0 && (state->done += completed) == count) {
+                    std::lock_guard<std::mutex> lock(state->lock);
+                    state->finished.notify_all();
+                }
+            };
+
+            auto helpers = std::min(_workers.size(), count - 1);
+            for(size_t i = 0; i < helpers; i++)
+                enqueue(run);
+
+            run();
+
+            std::unique_lock<std::mutex> lock(state->lock);
+            state->finished.wait(lock, [&]() { return state->done == count; });
+        }
+
+        void thread_pool::enqueue(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _tasks.push_back(std::move(task));
+            }
+            _signal.notify_one();
+        }
+
+        void thread_pool::worker()
+        {
+            for(;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(_lock);
+                    _signal.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+                    if(_stopping && _tasks.empty())
+                        return;
+                    task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                }
+                task();
+            }
+        }
+    }
+}
@@ -0,0 +1,417 @@
+#include <system/code_integrity.hpp>
+#include <system/image_imports.hpp>
+#include <system/process.hpp>
+#include <misc/mapped_file.hpp>
+#include <misc/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <intrin.h>
+#include <numeric>
+
+#define CODE_READ_CHUNK     0x100000    // Bytes read from the target at once
+#define CODE_RANGE_GAP      8           // Modified ranges closer than this are merged
+
+namespace resurgence
+{
+    namespace system
+    {
+        //
+        // The offset of the first byte that differs, size if none
+        //
+        static size_t find_difference(const uint8_t* lhs, const uint8_t* rhs, size_t size)
+        {
+            size_t i = 0;
+
+            for(; i + 64 <= size; i += 64) {
+                auto a = _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i))),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i + 16))));
+                auto b = _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i + 32))),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i + 48)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i + 48))));
+                if(_mm_movemask_epi8(_mm_and_si128(a, b)) != 0xFFFF)
+                    break;
+            }
+
+            for(; i + 16 <= size; i += 16) {
+                auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i))));
+                if(mask != 0xFFFF) {
+                    unsigned long bit;
+                    _BitScanForward(&bit, ~mask & 0xFFFF);
+                    return i + bit;
+                }
+            }
+
+            for(; i < size; i++) {
+                if(lhs[i] != rhs[i])
+                    return i;
+            }
+            return size;
+        }
+
+        static void apply_fixup(uint8_t* bytes, size_t size, uint32_t offset, uint32_t width, uint64_t value)
+        {
+            if(offset >= size)
+                return;
+
+            //
+            // A fixup crossing the end of the section only changes the bytes in it. Carries
+            // go towards the high bytes, so the low ones come out right on their own.
+            //
+            width = static_cast<uint32_t>(std::min<size_t>(width, size - offset));
+
+            uint64_t current = 0;
+            memcpy(&current, bytes + offset, width);
+            current += value;
+            memcpy(bytes + offset, &current, width);
+        }
+
+        code_integrity_check::code_integrity_check()
+            : _bytes(0)
+        {
+        }
+
+        ///<summary>
+        /// Compares a module with its file.
+        ///</summary>
+        ///<param name="proc">   The process. </param>
+        ///<param name="module"> The module. </param>
+        ///<returns>
+        /// The status code. STATUS_IMAGE_CHECKSUM_MISMATCH if the file isn't the one loaded.
+        ///</returns>
+        NTSTATUS code_integrity_check::verify(process* proc, const process_module& module)
+        {
+            misc::mapped_file file;
+
+            _sections.clear();
+            _ranges.clear();
+            _excluded.clear();
+            _bytes = 0;
+
+            if(!module.is_valid())
+                return STATUS_INVALID_PARAMETER;
+
+            auto status = file.open(module.get_path());
+            if(!NT_SUCCESS(status))
+                return status;
+
+            image_file_view view(file.data(), file.size());
+            status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+
+            //
+            // The file may have been replaced since the module was loaded
+            //
+            if(view.get_image_size() != module.get_size())
+                return STATUS_IMAGE_CHECKSUM_MISMATCH;
+
+            std::vector<std::vector<uint8_t>> expected;
+            status = build_expected(view, reinterpret_cast<uintptr_t>(module.get_base()), expected);
+            if(!NT_SUCCESS(status))
+                return status;
+            exclude_iat(view);
+
+            std::vector<uint8_t> buffer;
+            for(uint32_t i = 0; i < _sections.size(); i++)
+                compare(proc, module.get_base(), i, expected[i].data(), buffer);
+            return STATUS_SUCCESS;
+        }
+
+        NTSTATUS code_integrity_check::build_expected(const image_file_view& view, uint64_t base, std::vector<std::vector<uint8_t>>& expected)
+        {
+            auto sections = view.get_sections();
+            auto imageSize = view.get_image_size();
+
+            for(uint32_t i = 0; i < view.get_section_count(); i++) {
+                auto& section = sections[i];
+                if(!(section.Characteristics & IMAGE_SCN_MEM_EXECUTE) || section.VirtualAddress >= imageSize)
+                    continue;
+
+                uint32_t size = section.Misc.VirtualSize ? section.Misc.VirtualSize : section.SizeOfRawData;
+                size = std::min(size, imageSize - section.VirtualAddress);
+                if(size == 0)
+                    continue;
+
+                //
+                // The loader maps the raw data and zeroes the rest of the section
+                //
+                std::vector<uint8_t> bytes(size, 0);
+                auto raw = std::min(size, static_cast<uint32_t>(section.SizeOfRawData));
+                if(raw != 0) {
+                    auto data = view.at_offset<uint8_t>(section.PointerToRawData, raw);
+                    if(!data)
+                        return STATUS_INVALID_IMAGE_FORMAT;
+                    memcpy(bytes.data(), data, raw);
+                }
+
+                code_section entry;
+                memcpy(entry.name, section.Name, IMAGE_SIZEOF_SHORT_NAME);
+                entry.rva = section.VirtualAddress;
+                entry.size = size;
+                entry.modified = 0;
+                _sections.push_back(entry);
+                expected.push_back(std::move(bytes));
+            }
+
+            auto delta = base - view.get_image_base();
+            auto dir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_BASERELOC);
+            if(delta == 0 || !dir || _sections.empty())
+                return STATUS_SUCCESS;
+
+            auto relocs = view.at_rva<uint8_t>(dir->VirtualAddress, dir->Size);
+            if(!relocs)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            uint32_t offset = 0;
+            uint32_t last = 0;
+            while(dir->Size - offset >= sizeof(IMAGE_BASE_RELOCATION)) {
+                IMAGE_BASE_RELOCATION block;
+                memcpy(&block, relocs + offset, sizeof(block));
+                if(block.SizeOfBlock < sizeof(block) || block.SizeOfBlock > dir->Size - offset)
+                    break;
+
+                auto entries = relocs + offset + sizeof(block);
+                auto count = (block.SizeOfBlock - sizeof(block)) / sizeof(uint16_t);
+                for(size_t i = 0; i < count; i++) {
+                    uint16_t entry;
+                    memcpy(&entry, entries + i * sizeof(uint16_t), sizeof(entry));
+
+                    auto type = entry >> 12;
+                    auto rva = block.VirtualAddress + (entry & 0xFFF);
+                    if(type == IMAGE_REL_BASED_ABSOLUTE)
+                        continue;
+
+                    //
+                    // Blocks cover a page, which is usually in the same section as the last one
+                    //
+                    if(rva - _sections[last].rva >= _sections[last].size) {
+                        auto it = std::find_if(_sections.begin(), _sections.end(), [rva](const code_section& section) {
+                            return rva - section.rva < section.size;
+                        });
+                        if(it == _sections.end()) {
+                            if(type == IMAGE_REL_BASED_HIGHADJ)
+                                i++;
+                            continue;
+                        }
+                        last = static_cast<uint32_t>(it - _sections.begin());
+                    }
+
+                    auto& bytes = expected[last];
+                    auto target = rva - _sections[last].rva;
+                    switch(type) {
+                        case IMAGE_REL_BASED_HIGH:
+                            apply_fixup(bytes.data(), bytes.size(), target, sizeof(uint16_t), static_cast<uint16_t>(delta >> 16));
+                            break;
+                        case IMAGE_REL_BASED_LOW:
+                            apply_fixup(bytes.data(), bytes.size(), target, sizeof(uint16_t), static_cast<uint16_t>(delta));
+                            break;
+                        case IMAGE_REL_BASED_HIGHLOW:
+                            apply_fixup(bytes.data(), bytes.size(), target, sizeof(uint32_t), static_cast<uint32_t>(delta));
+                            break;
+                        case IMAGE_REL_BASED_DIR64:
+                            apply_fixup(bytes.data(), bytes.size(), target, sizeof(uint64_t), delta);
+                            break;
+                        case IMAGE_REL_BASED_HIGHADJ: {
+                            //
+                            // The low half of the 32-bit value is in the next entry
+                            //
+                            if(++i >= count || target + sizeof(uint16_t) > bytes.size())
+                                break;
+
+                            uint16_t high, low;
+                            memcpy(&high, &bytes[target], sizeof(high));
+                            memcpy(&low, entries + i * sizeof(uint16_t), sizeof(low));
+                            auto value = (static_cast<uint32_t>(high) << 16) + static_cast<int16_t>(low) + static_cast<uint32_t>(delta) + 0x8000;
+                            high = static_cast<uint16_t>(value >> 16);
+                            memcpy(&bytes[target], &high, sizeof(high));
+                            break;
+                        }
+                        default:
+                            //
+                            // Machine specific fixups (ARM, MIPS) aren't rebuilt, they show up as modified
+                            //
+                            break;
+                    }
+                }
+                offset += block.SizeOfBlock;
+            }
+            return STATUS_SUCCESS;
+        }
+
+        void code_integrity_check::exclude_iat(const image_file_view& view)
+        {
+            auto iat = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_IAT);
+            if(iat && iat->Size != 0 && iat->VirtualAddress + iat->Size > iat->VirtualAddress)
+                _excluded.push_back(excluded_range{iat->VirtualAddress, iat->VirtualAddress + iat->Size});
+
+            //
+            // The IAT directory is optional and doesn't cover delay-load slots
+            //
+            image_imports imports;
+            if(NT_SUCCESS(imports.parse(view))) {
+                uint32_t begin, end;
+                if(imports.get_iat_range(false, &begin, &end))
+                    _excluded.push_back(excluded_range{begin, end});
+                if(imports.get_iat_range(true, &begin, &end))
+                    _excluded.push_back(excluded_range{begin, end});
+            }
+        }
+
+        void code_integrity_check::compare(process* proc, const uint8_t* base, uint32_t section, uint8_t* expected, std::vector<uint8_t>& buffer)
+        {
+            auto& entry = _sections[section];
+
+            buffer.resize(std::min<size_t>(entry.size, CODE_READ_CHUNK));
+            for(uint32_t offset = 0; offset < entry.size; offset += CODE_READ_CHUNK) {
+                auto length = std::min<uint32_t>(CODE_READ_CHUNK, entry.size - offset);
+                auto rva = entry.rva + offset;
+                if(NT_SUCCESS(proc->memory()->read_bytes(base + rva, buffer.data(), length))) {
+                    compare_chunk(section, rva, expected + offset, buffer.data(), length);
+                    continue;
+                }
+
+                //
+                // Some pages can't be read (guard pages, decommitted by a packer), compare the others.
+                // Sections aren't page aligned when the section alignment is smaller than a page,
+                // so the reads follow the real page boundaries.
+                //
+                for(uint32_t page = 0, pageLength; page < length; page += pageLength) {
+                    auto address = reinterpret_cast<uintptr_t>(base + rva + page);
+                    pageLength = std::min<uint32_t>(PAGE_SIZE - static_cast<uint32_t>(address & (PAGE_SIZE - 1)), length - page);
+                    if(NT_SUCCESS(proc->memory()->read_bytes(base + rva + page, buffer.data() + page, pageLength)))
+                        compare_chunk(section, rva + page, expected + offset + page, buffer.data() + page, pageLength);
+                    else
+                        add_range(section, rva + page, pageLength, code_range_unreadable);
+                }
+            }
+        }
+
+        void code_integrity_check::compare_chunk(uint32_t section, uint32_t rva, uint8_t* expected, const uint8_t* live, size_t size)
+        {
+            auto end = rva + static_cast<uint32_t>(size);
+            for(auto& range : _excluded) {
+                if(range.end <= rva || range.begin >= end)
+                    continue;
+
+                auto first = std::max(range.begin, rva);
+                auto last = std::min(range.end, end);
+                memcpy(expected + (first - rva), live + (first - rva), last - first);
+            }
+
+            size_t offset = 0;
+            while((offset += find_difference(expected + offset, live + offset, size - offset)) < size) {
+                //
+                // The range ends at the first CODE_RANGE_GAP bytes in a row that match
+                //
+                auto rangeEnd = offset + 1;
+                for(size_t i = rangeEnd, equal = 0; i < size && equal < CODE_RANGE_GAP; i++) {
+                    if(expected[i] == live[i]) {
+                        equal++;
+                    } else {
+                        equal = 0;
+                        rangeEnd = i + 1;
+                    }
+                }
+                add_range(section, rva + static_cast<uint32_t>(offset), static_cast<uint32_t>(rangeEnd - offset), code_range_modified);
+                offset = rangeEnd;
+            }
+            _bytes += size;
+        }
+
+        void code_integrity_check::add_range(uint32_t section, uint32_t rva, uint32_t size, code_range_state state)
+        {
+            //
+            // Ranges are found in order, one may continue the last one across a chunk
+            //
+            if(!_ranges.empty()) {
+                auto& last = _ranges.back();
+                auto lastEnd = last.rva + last.size;
+                if(last.section == section && last.state == state && rva >= lastEnd && rva - lastEnd < (state == code_range_modified ? CODE_RANGE_GAP : 1u)) {
+                    if(state == code_range_modified)
+                        _sections[section].modified += rva + size - lastEnd;
+                    last.size = rva + size - last.rva;
+                    return;
+                }
+            }
+
+            if(state == code_range_modified)
+                _sections[section].modified += size;
+            _ranges.push_back(code_range{rva, size, section, state});
+        }
+
+        code_integrity_scan::code_integrity_scan()
+        {
+            memset(&_stats, 0, sizeof(_stats));
+        }
+
+        ///<summary>
+        /// Compares every module loaded by a process.
+        ///</summary>
+        ///<param name="proc"> The process. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS code_integrity_scan::verify(process* proc)
+        {
+            return verify(proc, proc->modules()->get_all_modules());
+        }
+
+        ///<summary>
+        /// Compares some modules of a process.
+        ///</summary>
+        ///<param name="proc">    The process. </param>
+        ///<param name="modules"> The modules. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS code_integrity_scan::verify(process* proc, const std::vector<process_module>& modules)
+        {
+            auto begin = std::chrono::steady_clock::now();
+
+            memset(&_stats, 0, sizeof(_stats));
+            _results.clear();
+            _results.resize(modules.size());
+            for(size_t i = 0; i < modules.size(); i++) {
+                _results[i].module = modules[i];
+                _results[i].status = STATUS_SUCCESS;
+            }
+
+            std::vector<size_t> order(modules.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&modules](size_t lhs, size_t rhs) {
+                return modules[lhs].get_size() > modules[rhs].get_size();
+            });
+
+            misc::thread_pool::instance().parallel_for(order.size(), [&](size_t i) {
+                auto& result = _results[order[i]];
+                result.status = result.check.verify(proc, result.module);
+            });
+
+            for(auto& result : _results) {
+                if(!NT_SUCCESS(result.status)) {
+                    _stats.failures++;
+                    continue;
+                }
+                _stats.modules++;
+                _stats.bytes += result.check.get_bytes_compared();
+                if(!result.check.is_intact())
+                    _stats.modified++;
+            }
+            _stats.elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Gets the number of gigabytes compared per second by the last scan.
+        ///</summary>
+        double code_integrity_scan::get_gigabytes_per_second() const
+        {
+            if(_stats.elapsed_ns == 0)
+                return 0.0;
+            return static_cast<double>(_stats.bytes) / _stats.elapsed_ns;
+        }
+    }
+}
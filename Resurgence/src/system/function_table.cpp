@@ -0,0 +1,166 @@
+#include <system/function_table.hpp>
+#include <system/unwind_codes.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+
+namespace resurgence
+{
+    namespace system
+    {
+        static void resolve_entry(const image_file_view& view, const IMAGE_RUNTIME_FUNCTION_ENTRY& function, function_table_entry& entry)
+        {
+            entry.begin = function.BeginAddress;
+            entry.end = function.EndAddress;
+            entry.unwind = 0;
+            entry.primary = function.BeginAddress;
+
+            //
+            // Follow indirect and chained entries to the one that starts the function.
+            // The unwind info of the entry itself is the first one that isn't indirect.
+            //
+            auto current = &function;
+            for(int depth = 0; depth < MAX_UNWIND_CHAIN; depth++) {
+                if(current->UnwindData & RUNTIME_FUNCTION_INDIRECT) {
+                    auto next = view.at_rva<IMAGE_RUNTIME_FUNCTION_ENTRY>(current->UnwindData & ~RUNTIME_FUNCTION_INDIRECT);
+                    if(!next)
+                        break;
+                    current = next;
+                    continue;
+                }
+
+                if(!entry.unwind)
+                    entry.unwind = current->UnwindData;
+
+                auto unwind = view.at_rva<uint8_t>(current->UnwindData, 4);
+                if(!unwind || !((unwind[0] >> 3) & UNWIND_FLAG_CHAININFO))
+                    break;
+
+                //
+                // The parent entry follows the unwind codes, which are padded to an even count
+                //
+                uint32_t codes = (unwind[2] + 1u) & ~1u;
+                auto next = view.at_rva<IMAGE_RUNTIME_FUNCTION_ENTRY>(current->UnwindData + 4 + codes * 2);
+                if(!next)
+                    break;
+                current = next;
+            }
+            entry.primary = current->BeginAddress;
+        }
+
+        ///<summary>
+        /// Parses the function table of an image file.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS function_table::parse(const std::wstring& path)
+        {
+            misc::mapped_file file;
+
+            auto status = file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(file.data(), file.size());
+        }
+
+        ///<summary>
+        /// Parses the function table of an image read in memory (file layout, not loaded).
+        ///</summary>
+        ///<param name="image"> The file contents. </param>
+        ///<param name="size">  The file size. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS function_table::parse(const uint8_t* image, size_t size)
+        {
+            image_file_view view(image, size);
+
+            auto status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(view);
+        }
+
+        ///<summary>
+        /// Parses the function table of an image view whose headers were parsed.
+        ///</summary>
+        ///<param name="view"> The view. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS function_table::parse(const image_file_view& view)
+        {
+            _entries.clear();
+
+            //
+            // ARM64 entries are packed differently and x86 images don't have a table
+            //
+            auto dir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_EXCEPTION);
+            if(view.get_machine() != IMAGE_FILE_MACHINE_AMD64 || !dir)
+                return STATUS_SUCCESS;
+
+            auto count = dir->Size / sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY);
+            auto functions = view.at_rva<IMAGE_RUNTIME_FUNCTION_ENTRY>(dir->VirtualAddress, count);
+            if(!functions)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            _entries.reserve(count);
+            for(size_t i = 0; i < count; i++) {
+                if(functions[i].EndAddress <= functions[i].BeginAddress)
+                    continue;
+
+                function_table_entry entry;
+                resolve_entry(view, functions[i], entry);
+                _entries.push_back(entry);
+            }
+
+            //
+            // The loader requires the table sorted, but a file can still have it otherwise
+            //
+            auto less = [](const function_table_entry& lhs, const function_table_entry& rhs) {
+                return lhs.begin < rhs.begin;
+            };
+            if(!std::is_sorted(_entries.begin(), _entries.end(), less))
+                std::sort(_entries.begin(), _entries.end(), less);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Finds the entry containing an RVA.
+        ///</summary>
+        ///<param name="rva"> The RVA. </param>
+        ///<returns>
+        /// The entry, nullptr if the RVA isn't in any function (or is in a leaf function without an entry).
+        ///</returns>
+        const function_table_entry* function_table::find(uint32_t rva) const
+        {
+            auto it = std::upper_bound(_entries.begin(), _entries.end(), rva, [](uint32_t value, const function_table_entry& entry) {
+                return value < entry.begin;
+            });
+            if(it == _entries.begin())
+                return nullptr;
+
+            --it;
+            return rva < it->end ? &*it : nullptr;
+        }
+
+        ///<summary>
+        /// Finds the entry of the function that owns an RVA, following chained entries.
+        ///</summary>
+        ///<param name="rva"> The RVA. </param>
+        ///<returns>
+        /// The primary entry, nullptr if none.
+        ///</returns>
+        const function_table_entry* function_table::find_primary(uint32_t rva) const
+        {
+            auto entry = find(rva);
+            if(!entry || is_primary(*entry))
+                return entry;
+
+            entry = find(entry->primary);
+            return entry && is_primary(*entry) ? entry : nullptr;
+        }
+    }
+}
@@ -0,0 +1,270 @@
+#include <system/handle_snapshot.hpp>
+#include <misc/information_pool.hpp>
+#include <misc/native.hpp>
+
+#include <algorithm>
+
+#define MAX_OBJECT_TYPES 0x100
+
+namespace resurgence
+{
+    namespace system
+    {
+        std::mutex                  object_types::s_lock;
+        std::vector<std::wstring>   object_types::s_names;
+        std::vector<bool>           object_types::s_missing;
+
+        static bool handle_less(const handle_entry& lhs, const handle_entry& rhs)
+        {
+            if(lhs.pid != rhs.pid)
+                return lhs.pid < rhs.pid;
+            return lhs.handle < rhs.handle;
+        }
+
+        static bool handle_equal(const handle_entry& lhs, const handle_entry& rhs)
+        {
+            return lhs.pid == rhs.pid && lhs.handle == rhs.handle && lhs.object == rhs.object;
+        }
+
+        ///<summary>
+        /// Gets the type name of an object type index.
+        ///</summary>
+        ///<param name="index"> The object type index. </param>
+        ///<returns>
+        /// The type name, empty if the index is unknown.
+        ///</returns>
+        std::wstring object_types::get_name(uint16_t index)
+        {
+            if(index >= MAX_OBJECT_TYPES)
+                return std::wstring();
+
+            std::lock_guard<std::mutex> lock(s_lock);
+
+            //
+            // Types are almost always created at boot, so the table is loaded
+            // once and only reloaded when an index we never saw shows up.
+            // Indexes the reload doesn't resolve either are remembered and not
+            // queried again until the next refresh.
+            //
+            if(s_missing.empty())
+                s_missing.resize(MAX_OBJECT_TYPES);
+
+            if((index >= s_names.size() || s_names[index].empty()) && !s_missing[index]) {
+                load();
+                if(index >= s_names.size() || s_names[index].empty())
+                    s_missing[index] = true;
+            }
+
+            //
+            // Copied under the lock, a reload from another thread may fill the slot
+            //
+            if(index < s_names.size())
+                return s_names[index];
+            return std::wstring();
+        }
+
+        ///<summary>
+        /// Reloads the type table, including the indexes that didn't resolve before.
+        ///</summary>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS object_types::refresh()
+        {
+            std::lock_guard<std::mutex> lock(s_lock);
+            s_missing.assign(s_missing.size(), false);
+            return load();
+        }
+
+        NTSTATUS object_types::load()
+        {
+            ULONG       size = 0x8000;
+            uint8_t*    buffer = nullptr;
+            NTSTATUS    status;
+
+            do {
+                allocate_local_buffer(&buffer, size);
+                if(!buffer)
+                    return STATUS_NO_MEMORY;
+
+                status = NtQueryObject(nullptr, ObjectTypesInformation, buffer, size, &size);
+                if(status != STATUS_INFO_LENGTH_MISMATCH)
+                    break;
+
+                free_local_buffer(buffer);
+                buffer = nullptr;
+                size = size * 2;
+            } while(true);
+
+            if(NT_SUCCESS(status)) {
+                auto types = (POBJECT_TYPES_INFORMATION)buffer;
+                auto entry = (POBJECT_TYPE_INFORMATION_8)&types->TypeInformation;
+
+                //
+                // Slots already named are kept, a type index is never reused while the system runs
+                //
+                if(s_names.empty())
+                    s_names.resize(MAX_OBJECT_TYPES);
+
+                for(ULONG i = 0; i < types->NumberOfTypes; i++) {
+                    //
+                    // Windows 8.1+ reports the index, older versions start at 2
+                    //
+                    uint16_t index = entry->TypeIndex != 0 ? entry->TypeIndex : static_cast<uint16_t>(i + 2);
+
+                    if(index < s_names.size() && s_names[index].empty())
+                        s_names[index].assign(entry->TypeName.Buffer, entry->TypeName.Length / sizeof(wchar_t));
+
+                    entry = (POBJECT_TYPE_INFORMATION_8)ALIGN_UP(
+                        PTR_ADD(entry, sizeof(OBJECT_TYPE_INFORMATION) + entry->TypeName.MaximumLength),
+                        sizeof(ULONG_PTR));
+                }
+            }
+
+            free_local_buffer(buffer);
+            return status;
+        }
+
+        //-----------------------------------------------------------------------
+
+        handle_snapshot::handle_snapshot()
+            : _valid(false)
+        {
+        }
+
+        ///<summary>
+        /// Captures the system handle table.
+        ///</summary>
+        ///<returns>
+        /// The snapshot. On failure the snapshot is invalid and the status
+        /// can be retrieved with get_last_ntstatus.
+        ///</returns>
+        handle_snapshot handle_snapshot::capture()
+        {
+            handle_snapshot snapshot;
+
+            auto buffer = misc::information_pool::instance().query(SystemExtendedHandleInformation);
+            if(!buffer)
+                return snapshot;
+
+            auto handles = native::extended_handle_range(buffer);
+
+            snapshot._entries.resize(handles.size());
+
+            auto out = snapshot._entries.data();
+            for(auto& handle : handles) {
+                out->pid            = static_cast<uint32_t>(handle.UniqueProcessId);
+                out->handle         = static_cast<uint32_t>(handle.HandleValue);
+                out->object         = reinterpret_cast<uintptr_t>(handle.Object);
+                out->granted_access = handle.GrantedAccess;
+                out->type_index     = handle.ObjectTypeIndex;
+                out->attributes     = static_cast<uint16_t>(handle.HandleAttributes);
+                out++;
+            }
+
+            //
+            // The kernel walks handle tables process by process, so the
+            // buffer is usually sorted already.
+            //
+            if(!std::is_sorted(snapshot._entries.begin(), snapshot._entries.end(), handle_less))
+                std::sort(snapshot._entries.begin(), snapshot._entries.end(), handle_less);
+
+            snapshot.build_index();
+            snapshot._valid = true;
+            return snapshot;
+        }
+
+        ///<summary>
+        /// Compares two snapshots.
+        ///</summary>
+        ///<param name="older"> The older snapshot. </param>
+        ///<param name="newer"> The newer snapshot. </param>
+        ///<returns>
+        /// The handles opened and closed between both snapshots.
+        ///</returns>
+        handle_snapshot_diff handle_snapshot::diff(const handle_snapshot& older, const handle_snapshot& newer)
+        {
+            handle_snapshot_diff result;
+
+            auto lhs = older._entries.begin();
+            auto rhs = newer._entries.begin();
+
+            while(lhs != older._entries.end() && rhs != newer._entries.end()) {
+                if(handle_less(*lhs, *rhs)) {
+                    result.closed.push_back(*lhs++);
+                } else if(handle_less(*rhs, *lhs)) {
+                    result.opened.push_back(*rhs++);
+                } else {
+                    if(!handle_equal(*lhs, *rhs)) {
+                        result.closed.push_back(*lhs);
+                        result.opened.push_back(*rhs);
+                    }
+                    ++lhs;
+                    ++rhs;
+                }
+            }
+            result.closed.insert(result.closed.end(), lhs, older._entries.end());
+            result.opened.insert(result.opened.end(), rhs, newer._entries.end());
+            return result;
+        }
+
+        ///<summary>
+        /// Gets the handles owned by a process.
+        ///</summary>
+        ///<param name="pid"> The process id. </param>
+        ///<returns>
+        /// The handles, sorted by handle value.
+        ///</returns>
+        native::array_range<const handle_entry> handle_snapshot::get_process_handles(uint32_t pid) const
+        {
+            auto it = std::lower_bound(_index.begin(), _index.end(), pid, [](const process_index& index, uint32_t value) {
+                return index.pid < value;
+            });
+
+            if(it == _index.end() || it->pid != pid)
+                return native::array_range<const handle_entry>();
+
+            return native::array_range<const handle_entry>(_entries.data() + it->first, it->count);
+        }
+
+        ///<summary>
+        /// Finds a handle.
+        ///</summary>
+        ///<param name="pid">    The process id. </param>
+        ///<param name="handle"> The handle value. </param>
+        ///<returns>
+        /// The entry, nullptr if not found.
+        ///</returns>
+        const handle_entry* handle_snapshot::find(uint32_t pid, uint32_t handle) const
+        {
+            auto handles = get_process_handles(pid);
+
+            auto it = std::lower_bound(handles.begin(), handles.end(), handle, [](const handle_entry& entry, uint32_t value) {
+                return entry.handle < value;
+            });
+
+            if(it == handles.end() || it->handle != handle)
+                return nullptr;
+            return it;
+        }
+
+        ///<summary>
+        /// Gets the object type name of a handle.
+        ///</summary>
+        std::wstring handle_snapshot::get_type_name(const handle_entry& entry) const
+        {
+            return object_types::get_name(entry.type_index);
+        }
+
+        void handle_snapshot::build_index()
+        {
+            _index.clear();
+
+            for(uint32_t i = 0; i < _entries.size(); i++) {
+                if(_index.empty() || _index.back().pid != _entries[i].pid)
+                    _index.push_back(process_index{_entries[i].pid, i, 0});
+                _index.back().count++;
+            }
+        }
+    }
+}
@@ -0,0 +1,216 @@
+#include <system/iat_snapshot.hpp>
+#include <system/process.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+
+#define MAX_FORWARDER_DEPTH 8
+
+namespace resurgence
+{
+    namespace system
+    {
+        iat_snapshot::iat_snapshot()
+        {
+        }
+
+        ///<summary>
+        /// Takes the snapshot of a module.
+        ///</summary>
+        ///<param name="proc">   The process. </param>
+        ///<param name="module"> The module. </param>
+        ///<param name="cache">  The export indexes. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS iat_snapshot::take(process* proc, const process_module& module, image_export_cache& cache)
+        {
+            return take(proc, module, proc->modules()->get_all_modules(), cache);
+        }
+
+        ///<summary>
+        /// Takes the snapshot of a module, reusing the module list of the process.
+        ///</summary>
+        ///<param name="proc">    The process. </param>
+        ///<param name="module">  The module. </param>
+        ///<param name="modules"> The modules loaded by the process. </param>
+        ///<param name="cache">   The export indexes. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS iat_snapshot::take(process* proc, const process_module& module, const std::vector<process_module>& modules, image_export_cache& cache)
+        {
+            _slots.clear();
+            _byName.clear();
+            _byBase.clear();
+
+            if(!module.is_valid())
+                return STATUS_INVALID_PARAMETER;
+
+            auto status = _imports.parse(module.get_path());
+            if(!NT_SUCCESS(status))
+                return status;
+
+            for(auto& loaded : modules) {
+                if(!loaded.is_valid())
+                    continue;
+
+                std::wstring name(loaded.get_name());
+                std::transform(name.begin(), name.end(), name.begin(), towlower);
+                _byName.push_back(loaded_module{name, reinterpret_cast<uintptr_t>(loaded.get_base()), loaded.get_size(), loaded.get_path()});
+            }
+            _byBase = _byName;
+            std::sort(_byName.begin(), _byName.end(), [](const loaded_module& lhs, const loaded_module& rhs) {
+                return lhs.name < rhs.name;
+            });
+            std::sort(_byBase.begin(), _byBase.end(), [](const loaded_module& lhs, const loaded_module& rhs) {
+                return lhs.base < rhs.base;
+            });
+
+            auto& entries = _imports.get_entries();
+            _slots.resize(entries.size());
+            for(size_t i = 0; i < entries.size(); i++)
+                _slots[i] = iat_slot{static_cast<uint32_t>(i), 0, 0, iat_slot_unreadable};
+
+            //
+            // A failed read leaves its slots unreadable, the other kind is still worth having
+            //
+            auto normalStatus = read_slots(proc, module, false);
+            auto delayedStatus = read_slots(proc, module, true);
+            if(!NT_SUCCESS(normalStatus) && !NT_SUCCESS(delayedStatus))
+                return normalStatus;
+
+            auto base = reinterpret_cast<uintptr_t>(module.get_base());
+            for(auto& slot : _slots) {
+                if(slot.state == iat_slot_unreadable)
+                    continue;
+
+                auto& entry = entries[slot.import];
+                if(entry.delayed && slot.value >= base && slot.value - base < module.get_size()) {
+                    slot.state = iat_slot_unbound;
+                    continue;
+                }
+
+                slot.expected = resolve(cache, _imports.get_module_name(entry), _imports.get_name(entry), entry.ordinal, entry.by_ordinal, slot.value, 0);
+                if(!slot.expected)
+                    slot.state = iat_slot_unresolved;
+                else
+                    slot.state = slot.value == slot.expected ? iat_slot_expected : iat_slot_modified;
+            }
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Gets the number of slots in a state.
+        ///</summary>
+        ///<param name="state"> The state. </param>
+        size_t iat_snapshot::count(iat_slot_state state) const
+        {
+            return static_cast<size_t>(std::count_if(_slots.begin(), _slots.end(), [state](const iat_slot& slot) {
+                return slot.state == state;
+            }));
+        }
+
+        const iat_snapshot::loaded_module* iat_snapshot::find_module(const char* name) const
+        {
+            //
+            // Forwarders name the module without its extension
+            //
+            std::wstring key;
+            for(auto c = name; *c; c++)
+                key.push_back(static_cast<wchar_t>(towlower(static_cast<unsigned char>(*c))));
+            if(key.find(L'.') == std::wstring::npos)
+                key.append(L".dll");
+
+            auto it = std::lower_bound(_byName.begin(), _byName.end(), key, [](const loaded_module& loaded, const std::wstring& value) {
+                return loaded.name < value;
+            });
+            return it != _byName.end() && it->name == key ? &*it : nullptr;
+        }
+
+        const iat_snapshot::loaded_module* iat_snapshot::find_module(uint64_t address) const
+        {
+            auto it = std::upper_bound(_byBase.begin(), _byBase.end(), address, [](uint64_t value, const loaded_module& loaded) {
+                return value < loaded.base;
+            });
+            if(it == _byBase.begin())
+                return nullptr;
+
+            --it;
+            return address - it->base < it->size ? &*it : nullptr;
+        }
+
+        uint64_t iat_snapshot::resolve(image_export_cache& cache, const char* module, const char* name, uint16_t ordinal, bool byOrdinal, uint64_t value, int depth) const
+        {
+            if(depth > MAX_FORWARDER_DEPTH)
+                return 0;
+
+            auto target = find_module(module);
+            if(!target)
+                target = find_module(value);
+            if(!target)
+                return 0;
+
+            auto exports = cache.get(target->path);
+            if(!exports)
+                return 0;
+
+            auto entry = byOrdinal ? exports->find_by_ordinal(ordinal) : exports->find_by_name(name, ordinal);
+            if(!entry)
+                return 0;
+
+            //
+            // "module.function" or "module.#ordinal", module names may have dots of their own
+            //
+            auto forwarder = exports->get_forwarder(*entry);
+            if(forwarder) {
+                auto dot = strrchr(forwarder, '.');
+                if(!dot || dot == forwarder)
+                    return 0;
+
+                std::string forwardModule(forwarder, dot);
+                if(dot[1] == '#')
+                    return resolve(cache, forwardModule.c_str(), nullptr, static_cast<uint16_t>(atoi(dot + 2)), true, value, depth + 1);
+                return resolve(cache, forwardModule.c_str(), dot + 1, 0, false, value, depth + 1);
+            }
+            return entry->rva ? target->base + entry->rva : 0;
+        }
+
+        NTSTATUS iat_snapshot::read_slots(process* proc, const process_module& module, bool delayed)
+        {
+            uint32_t begin, end;
+            if(!_imports.get_iat_range(delayed, &begin, &end))
+                return STATUS_SUCCESS;
+            if(end > module.get_size())
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            //
+            // One read for every slot of this kind, they are usually contiguous
+            //
+            std::vector<uint8_t> buffer(end - begin);
+            auto status = proc->memory()->read_bytes(module.get_base() + begin, buffer.data(), buffer.size());
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto& entries = _imports.get_entries();
+            auto slotSize = _imports.get_slot_size();
+            for(auto& slot : _slots) {
+                auto& entry = entries[slot.import];
+                if(entry.delayed != delayed)
+                    continue;
+
+                if(slotSize == sizeof(uint64_t)) {
+                    memcpy(&slot.value, &buffer[entry.iat_rva - begin], sizeof(uint64_t));
+                } else {
+                    uint32_t value;
+                    memcpy(&value, &buffer[entry.iat_rva - begin], sizeof(uint32_t));
+                    slot.value = value;
+                }
+                slot.state = iat_slot_unresolved;
+            }
+            return STATUS_SUCCESS;
+        }
+    }
+}
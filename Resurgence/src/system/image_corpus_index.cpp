@@ -0,0 +1,794 @@
+#include <system/image_corpus_index.hpp>
+#include <system/image_exports.hpp>
+#include <system/image_imports.hpp>
+#include <misc/native.hpp>
+#include <misc/thread_pool.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <numeric>
+#include <unordered_map>
+
+#define CORPUS_FILE_MAGIC       0x58444952  // "RIDX"
+#define CORPUS_FILE_VERSION     1
+
+namespace resurgence
+{
+    namespace system
+    {
+        enum corpus_column
+        {
+            COLUMN_FILE_PATH,
+            COLUMN_FILE_STATUS,
+            COLUMN_FILE_SIZE,
+            COLUMN_FILE_TIMESTAMP,
+            COLUMN_FILE_IMAGE_SIZE,
+            COLUMN_FILE_MACHINE,
+            COLUMN_FILE_FLAGS,
+            COLUMN_FILE_PDB_GUID,
+            COLUMN_FILE_PDB_SIGNATURE,
+            COLUMN_FILE_PDB_AGE,
+            COLUMN_FILE_PDB_NAME,
+            COLUMN_FILE_FIRST_SECTION,
+            COLUMN_FILE_FIRST_IMPORT,
+            COLUMN_FILE_FIRST_EXPORT,
+            COLUMN_SECTION_NAME,
+            COLUMN_SECTION_RVA,
+            COLUMN_SECTION_VIRTUAL_SIZE,
+            COLUMN_SECTION_RAW_SIZE,
+            COLUMN_SECTION_CHARACTERISTICS,
+            COLUMN_IMPORT_MODULE,
+            COLUMN_IMPORT_NAME,
+            COLUMN_IMPORT_ORDINAL,
+            COLUMN_IMPORT_FLAGS,
+            COLUMN_EXPORT_NAME,
+            COLUMN_EXPORT_RVA,
+            COLUMN_EXPORT_FORWARDER,
+            COLUMN_EXPORT_ORDINAL,
+            COLUMN_EXPORT_BY_NAME,
+            COLUMN_COUNT
+        };
+
+        enum corpus_rows
+        {
+            ROWS_FILES,
+            ROWS_FILE_RANGES,       // file_count + 1, the last one is the table size
+            ROWS_SECTIONS,
+            ROWS_IMPORTS,
+            ROWS_EXPORTS,
+            ROWS_NAMED_EXPORTS
+        };
+
+        static const struct
+        {
+            corpus_rows rows;
+            uint32_t    width;
+        } corpus_columns[COLUMN_COUNT] = {
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILES, sizeof(NTSTATUS) },
+            { ROWS_FILES, sizeof(uint64_t) },
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILES, sizeof(uint16_t) },
+            { ROWS_FILES, sizeof(uint16_t) },
+            { ROWS_FILES, sizeof(GUID) },
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILES, sizeof(uint32_t) },
+            { ROWS_FILE_RANGES, sizeof(uint32_t) },
+            { ROWS_FILE_RANGES, sizeof(uint32_t) },
+            { ROWS_FILE_RANGES, sizeof(uint32_t) },
+            { ROWS_SECTIONS, IMAGE_SIZEOF_SHORT_NAME },
+            { ROWS_SECTIONS, sizeof(uint32_t) },
+            { ROWS_SECTIONS, sizeof(uint32_t) },
+            { ROWS_SECTIONS, sizeof(uint32_t) },
+            { ROWS_SECTIONS, sizeof(uint32_t) },
+            { ROWS_IMPORTS, sizeof(uint32_t) },
+            { ROWS_IMPORTS, sizeof(uint32_t) },
+            { ROWS_IMPORTS, sizeof(uint16_t) },
+            { ROWS_IMPORTS, sizeof(uint16_t) },
+            { ROWS_EXPORTS, sizeof(uint32_t) },
+            { ROWS_EXPORTS, sizeof(uint32_t) },
+            { ROWS_EXPORTS, sizeof(uint32_t) },
+            { ROWS_EXPORTS, sizeof(uint16_t) },
+            { ROWS_NAMED_EXPORTS, sizeof(uint32_t) },   // Named exports sorted by name, then by file
+        };
+
+        //
+        // Layout of an index: the header, then one array per column, then the
+        // strings. Every array starts on an 8 byte boundary.
+        //
+        struct corpus_file_header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            uint32_t    file_count;
+            uint32_t    section_count;
+            uint32_t    import_count;
+            uint32_t    export_count;
+            uint32_t    named_export_count;
+            uint32_t    strings_size;
+            uint64_t    column_offsets[COLUMN_COUNT];
+            uint64_t    strings_offset;
+            uint64_t    file_size;
+        };
+
+        //
+        // The files indexed by default. Any file can be added with add_file.
+        //
+        static const wchar_t* image_extensions[] = {
+            L".exe", L".dll", L".sys", L".drv", L".ocx", L".cpl", L".scr", L".efi", L".mui", L".winmd", L".pyd"
+        };
+
+        struct parsed_file
+        {
+            NTSTATUS                            status;
+            uint64_t                            file_size;
+            uint32_t                            timestamp;
+            uint32_t                            image_size;
+            uint16_t                            machine;
+            uint16_t                            flags;
+            std::vector<IMAGE_SECTION_HEADER>   sections;
+            image_imports                       imports;
+            image_exports                       exports;
+            image_debug_info                    debug;
+        };
+
+        static uint64_t align_file_offset(uint64_t offset)
+        {
+            return (offset + 7) & ~7ull;
+        }
+
+        static bool file_range_valid(const corpus_file_header* header, uint64_t offset, uint64_t length)
+        {
+            return (offset & 7) == 0 && offset >= sizeof(corpus_file_header) &&
+                offset <= header->file_size && length <= header->file_size - offset;
+        }
+
+        static uint64_t column_rows(const corpus_file_header* header, int column)
+        {
+            switch(corpus_columns[column].rows) {
+                case ROWS_FILES:        return header->file_count;
+                case ROWS_FILE_RANGES:  return header->file_count + 1ull;
+                case ROWS_SECTIONS:     return header->section_count;
+                case ROWS_IMPORTS:      return header->import_count;
+                case ROWS_EXPORTS:      return header->export_count;
+                default:                return header->named_export_count;
+            }
+        }
+
+        static bool is_image_name(const wchar_t* name)
+        {
+            auto length = wcslen(name);
+            for(auto extension : image_extensions) {
+                auto extensionLength = wcslen(extension);
+                if(length > extensionLength && _wcsicmp(name + length - extensionLength, extension) == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        static std::string to_utf8(const std::wstring& value)
+        {
+            if(value.empty())
+                return std::string();
+
+            auto length = WideCharToMultiByte(CP_UTF8, 0, value.c_str(), static_cast<int>(value.size()), nullptr, 0, nullptr, nullptr);
+            if(length <= 0)
+                return std::string();
+
+            std::string utf8(length, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, value.c_str(), static_cast<int>(value.size()), &utf8[0], length, nullptr, nullptr);
+            return utf8;
+        }
+
+        static void parse_file(const std::wstring& path, parsed_file& parsed)
+        {
+            misc::mapped_file file;
+
+            parsed.status = file.open(path);
+            if(!NT_SUCCESS(parsed.status))
+                return;
+            parsed.file_size = file.size();
+
+            image_file_view view(file.data(), file.size());
+            parsed.status = view.parse_headers();
+            if(!NT_SUCCESS(parsed.status))
+                return;
+
+            parsed.timestamp = view.get_timestamp();
+            parsed.image_size = view.get_image_size();
+            parsed.machine = view.get_machine();
+            parsed.flags = view.is_64bit() ? IMAGE_CORPUS_FILE_64BIT : 0;
+            parsed.sections.assign(view.get_sections(), view.get_sections() + view.get_section_count());
+
+            //
+            // A bad directory doesn't make the rest of the file useless: keep what
+            // parsed and report the first failure
+            //
+            NTSTATUS status[] = {
+                parsed.imports.parse(view),
+                parsed.exports.parse(view),
+                parsed.debug.parse(view)
+            };
+            for(auto s : status) {
+                if(!NT_SUCCESS(s)) {
+                    parsed.status = s;
+                    break;
+                }
+            }
+
+            if(parsed.debug.has_pdb())
+                parsed.flags |= IMAGE_CORPUS_FILE_PDB;
+            if(parsed.debug.is_reproducible())
+                parsed.flags |= IMAGE_CORPUS_FILE_REPRODUCIBLE;
+        }
+
+        //
+        // Builds the columns and the strings of an index
+        //
+        class corpus_writer
+        {
+        public:
+            corpus_writer()
+                : _columns(COLUMN_COUNT), _strings(1, '\0')
+            {
+            }
+
+            template<typename T>
+            void append(int column, const T& value)
+            {
+                auto bytes = reinterpret_cast<const uint8_t*>(&value);
+                _columns[column].insert(_columns[column].end(), bytes, bytes + sizeof(T));
+            }
+
+            void append_bytes(int column, const void* data, size_t length)
+            {
+                auto bytes = static_cast<const uint8_t*>(data);
+                _columns[column].insert(_columns[column].end(), bytes, bytes + length);
+            }
+
+            uint32_t add_string(const std::string& string)
+            {
+                if(string.empty())
+                    return 0;
+
+                auto it = _interned.find(string);
+                if(it != _interned.end())
+                    return it->second;
+
+                auto offset = static_cast<uint32_t>(_strings.size());
+                _strings.insert(_strings.end(), string.begin(), string.end());
+                _strings.push_back('\0');
+                _interned.emplace(string, offset);
+                return offset;
+            }
+
+            uint32_t get_export_name(uint32_t index) const
+            {
+                uint32_t name;
+                memcpy(&name, _columns[COLUMN_EXPORT_NAME].data() + index * sizeof(uint32_t), sizeof(name));
+                return name;
+            }
+
+            const char* get_string(uint32_t offset) const { return &_strings[offset]; }
+
+            NTSTATUS save(const std::wstring& path, corpus_file_header& header) const
+            {
+                header.magic = CORPUS_FILE_MAGIC;
+                header.version = CORPUS_FILE_VERSION;
+                header.strings_size = static_cast<uint32_t>(_strings.size());
+
+                uint64_t offset = sizeof(corpus_file_header);
+                for(int i = 0; i < COLUMN_COUNT; i++) {
+                    header.column_offsets[i] = align_file_offset(offset);
+                    offset = header.column_offsets[i] + _columns[i].size();
+                }
+                header.strings_offset = align_file_offset(offset);
+                header.file_size = header.strings_offset + _strings.size();
+
+                if(header.file_size > MAXULONG)
+                    return STATUS_FILE_TOO_LARGE;
+
+                std::vector<uint8_t> buffer(static_cast<size_t>(header.file_size), 0);
+                memcpy(buffer.data(), &header, sizeof(header));
+                for(int i = 0; i < COLUMN_COUNT; i++) {
+                    if(!_columns[i].empty())
+                        memcpy(buffer.data() + header.column_offsets[i], _columns[i].data(), _columns[i].size());
+                }
+                memcpy(buffer.data() + header.strings_offset, _strings.data(), _strings.size());
+
+                return native::create_file(path, buffer.data(), buffer.size());
+            }
+
+        private:
+            std::vector<std::vector<uint8_t>>           _columns;
+            std::vector<char>                           _strings;   // Offset 0 is an empty string
+            std::unordered_map<std::string, uint32_t>   _interned;
+        };
+
+        image_corpus_indexer::image_corpus_indexer()
+        {
+            memset(&_stats, 0, sizeof(_stats));
+        }
+
+        ///<summary>
+        /// Adds the images of a directory, by extension (.exe, .dll, .sys ...).
+        ///</summary>
+        ///<param name="directory"> The directory. </param>
+        ///<param name="recursive"> Adds the subdirectories too. Junctions and links aren't followed. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_corpus_indexer::add_directory(const std::wstring& directory, bool recursive)
+        {
+            WIN32_FIND_DATAW data;
+
+            auto find = FindFirstFileExW((directory + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+            if(find == INVALID_HANDLE_VALUE)
+                return STATUS_OBJECT_PATH_NOT_FOUND;
+
+            do {
+                if(wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+                    continue;
+
+                auto path = directory + L"\\" + data.cFileName;
+                if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    if(recursive && !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                        add_directory(path, true);
+                } else if(is_image_name(data.cFileName)) {
+                    add_file(path, (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow);
+                }
+            } while(FindNextFileW(find, &data));
+
+            FindClose(find);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Adds a file, whatever its extension.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<param name="size"> The file size if known, used to parse the largest files first. </param>
+        void image_corpus_indexer::add_file(const std::wstring& path, uint64_t size)
+        {
+            _files.push_back(queued_file{path, size});
+        }
+
+        ///<summary>
+        /// Parses every file added and writes the index.
+        ///</summary>
+        ///<param name="path"> The index file path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_corpus_indexer::build(const std::wstring& path)
+        {
+            auto begin = std::chrono::steady_clock::now();
+
+            memset(&_stats, 0, sizeof(_stats));
+            if(_files.size() > MAXLONG)
+                return STATUS_FILE_TOO_LARGE;
+
+            //
+            // Rows are sorted by path, files are parsed largest first
+            //
+            std::sort(_files.begin(), _files.end(), [](const queued_file& lhs, const queued_file& rhs) {
+                return lhs.path < rhs.path;
+            });
+
+            std::vector<size_t> order(_files.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs) {
+                return _files[lhs].size > _files[rhs].size;
+            });
+
+            std::vector<parsed_file> parsed(_files.size());
+            misc::thread_pool::instance().parallel_for(order.size(), [&](size_t i) {
+                auto& file = parsed[order[i]];
+                file.status = STATUS_SUCCESS;
+                file.file_size = 0;
+                file.timestamp = 0;
+                file.image_size = 0;
+                file.machine = 0;
+                file.flags = 0;
+                parse_file(_files[order[i]].path, file);
+            });
+
+            //
+            // The columns are built on one thread so strings are interned in row order
+            // and the index is the same whatever the number of workers
+            //
+            corpus_writer writer;
+            corpus_file_header header = {};
+            std::vector<uint32_t> named;
+
+            for(size_t i = 0; i < parsed.size(); i++) {
+                auto& file = parsed[i];
+                auto& debug = file.debug;
+                auto pdbPath = debug.get_pdb_path();
+                auto backslash = strrchr(pdbPath, '\\');
+                auto slash = strrchr(pdbPath, '/');
+                auto pdbName = !backslash ? slash : !slash ? backslash : std::max(backslash, slash);
+
+                writer.append(COLUMN_FILE_PATH, writer.add_string(to_utf8(_files[i].path)));
+                writer.append(COLUMN_FILE_STATUS, file.status);
+                writer.append(COLUMN_FILE_SIZE, file.file_size);
+                writer.append(COLUMN_FILE_TIMESTAMP, file.timestamp);
+                writer.append(COLUMN_FILE_IMAGE_SIZE, file.image_size);
+                writer.append(COLUMN_FILE_MACHINE, file.machine);
+                writer.append(COLUMN_FILE_FLAGS, file.flags);
+                writer.append(COLUMN_FILE_PDB_GUID, debug.get_pdb_identity().guid);
+                writer.append(COLUMN_FILE_PDB_SIGNATURE, debug.get_pdb_identity().signature);
+                writer.append(COLUMN_FILE_PDB_AGE, debug.get_pdb_identity().age);
+                writer.append(COLUMN_FILE_PDB_NAME, writer.add_string(pdbName ? pdbName + 1 : pdbPath));
+                writer.append(COLUMN_FILE_FIRST_SECTION, header.section_count);
+                writer.append(COLUMN_FILE_FIRST_IMPORT, header.import_count);
+                writer.append(COLUMN_FILE_FIRST_EXPORT, header.export_count);
+
+                for(auto& section : file.sections) {
+                    writer.append_bytes(COLUMN_SECTION_NAME, section.Name, IMAGE_SIZEOF_SHORT_NAME);
+                    writer.append(COLUMN_SECTION_RVA, static_cast<uint32_t>(section.VirtualAddress));
+                    writer.append(COLUMN_SECTION_VIRTUAL_SIZE, static_cast<uint32_t>(section.Misc.VirtualSize));
+                    writer.append(COLUMN_SECTION_RAW_SIZE, static_cast<uint32_t>(section.SizeOfRawData));
+                    writer.append(COLUMN_SECTION_CHARACTERISTICS, static_cast<uint32_t>(section.Characteristics));
+                }
+                header.section_count += static_cast<uint32_t>(file.sections.size());
+
+                //
+                // DLL names are stored in lower case, the loader doesn't care and
+                // the same DLL is then one string
+                //
+                for(auto& entry : file.imports.get_entries()) {
+                    std::string module(file.imports.get_module_name(entry));
+                    std::transform(module.begin(), module.end(), module.begin(), [](char c) {
+                        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+                    });
+
+                    auto name = file.imports.get_name(entry);
+                    uint16_t flags = (entry.by_ordinal ? IMAGE_CORPUS_IMPORT_ORDINAL : 0) | (entry.delayed ? IMAGE_CORPUS_IMPORT_DELAYED : 0);
+                    writer.append(COLUMN_IMPORT_MODULE, writer.add_string(module));
+                    writer.append(COLUMN_IMPORT_NAME, name ? writer.add_string(name) : 0u);
+                    writer.append(COLUMN_IMPORT_ORDINAL, entry.ordinal);
+                    writer.append(COLUMN_IMPORT_FLAGS, flags);
+                }
+                header.import_count += static_cast<uint32_t>(file.imports.size());
+
+                //
+                // Exports are kept by ordinal, unused ordinals are skipped
+                //
+                auto& exports = file.exports;
+                auto& functions = exports.get_functions();
+                std::vector<uint32_t> names(functions.size(), 0);
+                for(size_t n = 0; n < exports.get_name_count(); n++) {
+                    //
+                    // Names that couldn't be read or whose ordinal is out of the table export nothing
+                    //
+                    auto function = exports.get_name_function(n);
+                    if(function >= functions.size())
+                        continue;
+
+                    auto& name = names[function];
+                    if(name == 0)
+                        name = writer.add_string(exports.get_name(n));
+                }
+
+                for(size_t f = 0; f < functions.size(); f++) {
+                    if(!functions[f].rva && !functions[f].forwarder)
+                        continue;
+
+                    //
+                    // Imports can only name 16-bit ordinals, anything above can't be used
+                    //
+                    auto ordinal = static_cast<uint64_t>(exports.get_ordinal_base()) + f;
+                    if(ordinal > 0xFFFF)
+                        break;
+
+                    auto forwarder = exports.get_forwarder(functions[f]);
+                    if(names[f])
+                        named.push_back(header.export_count);
+                    writer.append(COLUMN_EXPORT_NAME, names[f]);
+                    writer.append(COLUMN_EXPORT_RVA, functions[f].rva);
+                    writer.append(COLUMN_EXPORT_FORWARDER, forwarder ? writer.add_string(forwarder) : 0u);
+                    writer.append(COLUMN_EXPORT_ORDINAL, static_cast<uint16_t>(ordinal));
+                    header.export_count++;
+                }
+
+                _stats.bytes += file.file_size;
+                if(NT_SUCCESS(file.status))
+                    _stats.images++;
+            }
+            header.file_count = static_cast<uint32_t>(parsed.size());
+            writer.append(COLUMN_FILE_FIRST_SECTION, header.section_count);
+            writer.append(COLUMN_FILE_FIRST_IMPORT, header.import_count);
+            writer.append(COLUMN_FILE_FIRST_EXPORT, header.export_count);
+            parsed.clear();
+
+            //
+            // Exports were added by file, so a stable sort keeps equal names in file order
+            //
+            std::stable_sort(named.begin(), named.end(), [&writer](uint32_t lhs, uint32_t rhs) {
+                return strcmp(writer.get_string(writer.get_export_name(lhs)), writer.get_string(writer.get_export_name(rhs))) < 0;
+            });
+            for(auto index : named)
+                writer.append(COLUMN_EXPORT_BY_NAME, index);
+            header.named_export_count = static_cast<uint32_t>(named.size());
+
+            auto status = writer.save(path, header);
+
+            _stats.files = header.file_count;
+            _stats.elapsed_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count());
+            return status;
+        }
+
+        ///<summary>
+        /// Gets the number of files indexed per second by the last build.
+        ///</summary>
+        double image_corpus_indexer::get_files_per_second() const
+        {
+            if(_stats.elapsed_ms == 0)
+                return 0.0;
+            return _stats.files * 1000.0 / _stats.elapsed_ms;
+        }
+
+        image_corpus_index::image_corpus_index()
+            : _columns(COLUMN_COUNT, nullptr), _strings(nullptr), _stringsSize(0),
+            _fileCount(0), _sectionCount(0), _importCount(0), _exportCount(0), _namedExportCount(0)
+        {
+        }
+
+        ///<summary>
+        /// Opens an index.
+        ///</summary>
+        ///<param name="path"> The index path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_corpus_index::open(const std::wstring& path)
+        {
+            close();
+
+            auto status = _file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto header = reinterpret_cast<const corpus_file_header*>(_file.data());
+
+            if(_file.size() < sizeof(corpus_file_header) || header->magic != CORPUS_FILE_MAGIC) {
+                status = STATUS_INVALID_IMAGE_FORMAT;
+            } else if(header->version != CORPUS_FILE_VERSION) {
+                status = STATUS_REVISION_MISMATCH;
+            } else if(header->file_size != _file.size() ||
+                !file_range_valid(header, header->strings_offset, header->strings_size) ||
+                header->strings_size == 0 || _file.data()[header->strings_offset + header->strings_size - 1] != '\0') {
+                status = STATUS_FILE_CORRUPT_ERROR;
+            } else {
+                for(int i = 0; i < COLUMN_COUNT; i++) {
+                    if(!file_range_valid(header, header->column_offsets[i], column_rows(header, i) * corpus_columns[i].width)) {
+                        status = STATUS_FILE_CORRUPT_ERROR;
+                        break;
+                    }
+                }
+            }
+
+            if(NT_SUCCESS(status)) {
+                for(int i = 0; i < COLUMN_COUNT; i++)
+                    _columns[i] = _file.data() + header->column_offsets[i];
+                _strings = reinterpret_cast<const char*>(_file.data() + header->strings_offset);
+                _stringsSize = header->strings_size;
+                _fileCount = header->file_count;
+                _sectionCount = header->section_count;
+                _importCount = header->import_count;
+                _exportCount = header->export_count;
+                _namedExportCount = header->named_export_count;
+
+                //
+                // The counts of a file are the difference of two ranges, which must
+                // then never go down. Everything else is bounded when read.
+                //
+                int ranges[] = { COLUMN_FILE_FIRST_SECTION, COLUMN_FILE_FIRST_IMPORT, COLUMN_FILE_FIRST_EXPORT };
+                uint32_t totals[] = { _sectionCount, _importCount, _exportCount };
+                for(int r = 0; r < 3 && NT_SUCCESS(status); r++) {
+                    uint32_t previous = 0;
+                    for(size_t i = 0; i <= _fileCount; i++) {
+                        auto first = read<uint32_t>(ranges[r], i);
+                        if(first < previous || (i == _fileCount && first != totals[r])) {
+                            status = STATUS_FILE_CORRUPT_ERROR;
+                            break;
+                        }
+                        previous = first;
+                    }
+                }
+            }
+
+            if(!NT_SUCCESS(status))
+                close();
+            return status;
+        }
+
+        ///<summary>
+        /// Closes the index.
+        ///</summary>
+        void image_corpus_index::close()
+        {
+            _file.close();
+            std::fill(_columns.begin(), _columns.end(), nullptr);
+            _strings = nullptr;
+            _stringsSize = 0;
+            _fileCount = 0;
+            _sectionCount = 0;
+            _importCount = 0;
+            _exportCount = 0;
+            _namedExportCount = 0;
+        }
+
+        ///<summary>
+        /// Gets a string, "" if the offset is out of range.
+        ///</summary>
+        const char* image_corpus_index::get_string(uint32_t offset) const
+        {
+            return offset < _stringsSize ? _strings + offset : "";
+        }
+
+        image_corpus_file image_corpus_index::get_file(size_t index) const
+        {
+            image_corpus_file file;
+
+            file.path = read<uint32_t>(COLUMN_FILE_PATH, index);
+            file.status = read<NTSTATUS>(COLUMN_FILE_STATUS, index);
+            file.file_size = read<uint64_t>(COLUMN_FILE_SIZE, index);
+            file.timestamp = read<uint32_t>(COLUMN_FILE_TIMESTAMP, index);
+            file.image_size = read<uint32_t>(COLUMN_FILE_IMAGE_SIZE, index);
+            file.machine = read<uint16_t>(COLUMN_FILE_MACHINE, index);
+            file.flags = read<uint16_t>(COLUMN_FILE_FLAGS, index);
+            file.pdb.guid = read<GUID>(COLUMN_FILE_PDB_GUID, index);
+            file.pdb.signature = read<uint32_t>(COLUMN_FILE_PDB_SIGNATURE, index);
+            file.pdb.age = read<uint32_t>(COLUMN_FILE_PDB_AGE, index);
+            file.pdb_name = read<uint32_t>(COLUMN_FILE_PDB_NAME, index);
+            file.first_section = read<uint32_t>(COLUMN_FILE_FIRST_SECTION, index);
+            file.section_count = read<uint32_t>(COLUMN_FILE_FIRST_SECTION, index + 1) - file.first_section;
+            file.first_import = read<uint32_t>(COLUMN_FILE_FIRST_IMPORT, index);
+            file.import_count = read<uint32_t>(COLUMN_FILE_FIRST_IMPORT, index + 1) - file.first_import;
+            file.first_export = read<uint32_t>(COLUMN_FILE_FIRST_EXPORT, index);
+            file.export_count = read<uint32_t>(COLUMN_FILE_FIRST_EXPORT, index + 1) - file.first_export;
+            return file;
+        }
+
+        image_corpus_section image_corpus_index::get_section(size_t index) const
+        {
+            image_corpus_section section;
+
+            memcpy(section.name, _columns[COLUMN_SECTION_NAME] + index * IMAGE_SIZEOF_SHORT_NAME, IMAGE_SIZEOF_SHORT_NAME);
+            section.rva = read<uint32_t>(COLUMN_SECTION_RVA, index);
+            section.virtual_size = read<uint32_t>(COLUMN_SECTION_VIRTUAL_SIZE, index);
+            section.raw_size = read<uint32_t>(COLUMN_SECTION_RAW_SIZE, index);
+            section.characteristics = read<uint32_t>(COLUMN_SECTION_CHARACTERISTICS, index);
+            return section;
+        }
+
+        image_corpus_import image_corpus_index::get_import(size_t index) const
+        {
+            image_corpus_import entry;
+
+            entry.module = read<uint32_t>(COLUMN_IMPORT_MODULE, index);
+            entry.name = read<uint32_t>(COLUMN_IMPORT_NAME, index);
+            entry.ordinal = read<uint16_t>(COLUMN_IMPORT_ORDINAL, index);
+            entry.flags = read<uint16_t>(COLUMN_IMPORT_FLAGS, index);
+            return entry;
+        }
+
+        image_corpus_export image_corpus_index::get_export(size_t index) const
+        {
+            image_corpus_export entry;
+
+            entry.name = read<uint32_t>(COLUMN_EXPORT_NAME, index);
+            entry.rva = read<uint32_t>(COLUMN_EXPORT_RVA, index);
+            entry.forwarder = read<uint32_t>(COLUMN_EXPORT_FORWARDER, index);
+            entry.ordinal = read<uint16_t>(COLUMN_EXPORT_ORDINAL, index);
+            return entry;
+        }
+
+        ///<summary>
+        /// Gets the file an import belongs to.
+        ///</summary>
+        size_t image_corpus_index::get_import_file(size_t index) const
+        {
+            return find_range(COLUMN_FILE_FIRST_IMPORT, index);
+        }
+
+        ///<summary>
+        /// Gets the file an export belongs to.
+        ///</summary>
+        size_t image_corpus_index::get_export_file(size_t index) const
+        {
+            return find_range(COLUMN_FILE_FIRST_EXPORT, index);
+        }
+
+        ///<summary>
+        /// Finds the exports with a name, in every file.
+        ///</summary>
+        ///<param name="name">    The export name, case sensitive. </param>
+        ///<param name="exports"> Receives the export indexes. </param>
+        void image_corpus_index::find_exports(const char* name, std::vector<uint32_t>& exports) const
+        {
+            exports.clear();
+
+            auto export_name = [this](size_t rank) {
+                auto index = read<uint32_t>(COLUMN_EXPORT_BY_NAME, rank);
+                return index < _exportCount ? get_string(read<uint32_t>(COLUMN_EXPORT_NAME, index)) : "";
+            };
+
+            size_t low = 0;
+            size_t high = _namedExportCount;
+            while(low < high) {
+                auto middle = low + (high - low) / 2;
+                if(strcmp(export_name(middle), name) < 0)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+
+            for(; low < _namedExportCount && strcmp(export_name(low), name) == 0; low++)
+                exports.push_back(read<uint32_t>(COLUMN_EXPORT_BY_NAME, low));
+        }
+
+        ///<summary>
+        /// Finds the imports of a function, in every file.
+        ///</summary>
+        ///<param name="module"> The DLL name, case insensitive. </param>
+        ///<param name="name">   The function name, case sensitive. nullptr for every import of the DLL. </param>
+        ///<param name="imports"> Receives the import indexes. </param>
+        void image_corpus_index::find_imports(const char* module, const char* name, std::vector<uint32_t>& imports) const
+        {
+            imports.clear();
+
+            //
+            // Strings are stored once, so the imports of a DLL all share one offset
+            // and the names only need comparing when the offset changes
+            //
+            uint32_t lastModule = MAXULONG;
+            uint32_t lastName = MAXULONG;
+            bool moduleMatch = false;
+            bool nameMatch = false;
+
+            for(uint32_t i = 0; i < _importCount; i++) {
+                auto moduleOffset = read<uint32_t>(COLUMN_IMPORT_MODULE, i);
+                if(moduleOffset != lastModule) {
+                    lastModule = moduleOffset;
+                    moduleMatch = _stricmp(get_string(moduleOffset), module) == 0;
+                }
+                if(!moduleMatch)
+                    continue;
+
+                if(name) {
+                    auto nameOffset = read<uint32_t>(COLUMN_IMPORT_NAME, i);
+                    if(nameOffset != lastName) {
+                        lastName = nameOffset;
+                        nameMatch = nameOffset != 0 && strcmp(get_string(nameOffset), name) == 0;
+                    }
+                    if(!nameMatch)
+                        continue;
+                }
+                imports.push_back(i);
+            }
+        }
+
+        size_t image_corpus_index::find_range(int column, size_t index) const
+        {
+            //
+            // The last file whose first row is at or before the index
+            //
+            size_t low = 0;
+            size_t high = _fileCount + 1;
+            while(low < high) {
+                auto middle = low + (high - low) / 2;
+                if(read<uint32_t>(column, middle) <= index)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+            return low ? low - 1 : 0;
+        }
+    }
+}
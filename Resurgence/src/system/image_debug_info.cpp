@@ -0,0 +1,249 @@
+#include <system/image_debug_info.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+
+#define CODEVIEW_RSDS_SIGNATURE     0x53445352  // "RSDS"
+#define CODEVIEW_NB10_SIGNATURE     0x3031424E  // "NB10"
+#define MAX_DEBUG_ENTRIES           64
+
+#ifndef IMAGE_DEBUG_TYPE_POGO
+#define IMAGE_DEBUG_TYPE_POGO       13
+#endif
+#ifndef IMAGE_DEBUG_TYPE_REPRO
+#define IMAGE_DEBUG_TYPE_REPRO      16
+#endif
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct codeview_rsds_header
+        {
+            uint32_t    signature;
+            GUID        guid;
+            uint32_t    age;
+        };
+
+        struct codeview_nb10_header
+        {
+            uint32_t    signature;
+            uint32_t    offset;
+            uint32_t    timestamp;
+            uint32_t    age;
+        };
+
+        image_debug_info::image_debug_info()
+        {
+            clear();
+        }
+
+        ///<summary>
+        /// Parses the debug directory of an image file.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_debug_info::parse(const std::wstring& path)
+        {
+            misc::mapped_file file;
+
+            auto status = file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(file.data(), file.size());
+        }
+
+        ///<summary>
+        /// Parses the debug directory of an image read in memory (file layout, not loaded).
+        ///</summary>
+        ///<param name="image"> The file contents. </param>
+        ///<param name="size">  The file size. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_debug_info::parse(const uint8_t* image, size_t size)
+        {
+            image_file_view view(image, size);
+
+            auto status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(view);
+        }
+
+        ///<summary>
+        /// Parses the debug directory of an image view whose headers were parsed.
+        ///</summary>
+        ///<param name="view"> The view. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_debug_info::parse(const image_file_view& view)
+        {
+            clear();
+
+            auto dir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_DEBUG);
+            if(!dir)
+                return STATUS_SUCCESS;
+
+            auto count = std::min<uint32_t>(dir->Size / sizeof(IMAGE_DEBUG_DIRECTORY), MAX_DEBUG_ENTRIES);
+            auto debug = view.at_rva<IMAGE_DEBUG_DIRECTORY>(dir->VirtualAddress, count);
+            if(!debug)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            _entries.reserve(count);
+            for(uint32_t i = 0; i < count; i++) {
+                _entries.push_back(image_debug_entry{
+                    debug[i].Type, debug[i].TimeDateStamp, debug[i].MajorVersion, debug[i].MinorVersion,
+                    debug[i].AddressOfRawData, debug[i].PointerToRawData, debug[i].SizeOfData
+                });
+
+                //
+                // The data is found through its file offset, which is set even when it isn't mapped
+                //
+                const uint8_t* data = nullptr;
+                if(debug[i].PointerToRawData)
+                    data = view.at_offset<uint8_t>(debug[i].PointerToRawData, debug[i].SizeOfData);
+                else if(debug[i].AddressOfRawData)
+                    data = view.at_rva<uint8_t>(debug[i].AddressOfRawData, debug[i].SizeOfData);
+
+                if(debug[i].Type == IMAGE_DEBUG_TYPE_REPRO) {
+                    //
+                    // Older toolsets write the entry without data, the timestamps are still hashes
+                    //
+                    _reproducible = true;
+                    if(data)
+                        parse_repro(data, debug[i].SizeOfData);
+                }
+                if(!data)
+                    continue;
+
+                if(debug[i].Type == IMAGE_DEBUG_TYPE_CODEVIEW && !has_pdb())
+                    parse_codeview(data, debug[i].SizeOfData);
+                else if(debug[i].Type == IMAGE_DEBUG_TYPE_POGO && !_pogoSignature)
+                    parse_pogo(data, debug[i].SizeOfData);
+            }
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Removes everything parsed.
+        ///</summary>
+        void image_debug_info::clear()
+        {
+            _entries.clear();
+            _pogo.clear();
+            _reproHash.clear();
+            _strings.assign(1, '\0');
+            memset(&_pdb, 0, sizeof(_pdb));
+            _pdbPath = 0;
+            _pogoSignature = 0;
+            _reproducible = false;
+        }
+
+        ///<summary>
+        /// Gets the file name of the PDB, empty if none.
+        ///</summary>
+        std::wstring image_debug_info::get_pdb_name() const
+        {
+            auto path = get_pdb_path();
+            auto slash = std::max(strrchr(path, '\\'), strrchr(path, '/'));
+            auto name = slash ? slash + 1 : path;
+            auto nameLength = static_cast<int>(strlen(name));
+            if(nameLength == 0)
+                return std::wstring();
+
+            std::wstring wide(nameLength, L'\0');
+            auto length = MultiByteToWideChar(CP_UTF8, 0, name, nameLength, &wide[0], nameLength);
+            wide.resize(length > 0 ? length : 0);
+            return wide;
+        }
+
+        uint32_t image_debug_info::add_string(const char* string, size_t length)
+        {
+            auto offset = static_cast<uint32_t>(_strings.size());
+            _strings.insert(_strings.end(), string, string + length);
+            _strings.push_back('\0');
+            return offset;
+        }
+
+        void image_debug_info::parse_codeview(const uint8_t* data, uint32_t size)
+        {
+            uint32_t signature;
+            size_t   header;
+
+            if(size < sizeof(signature))
+                return;
+            memcpy(&signature, data, sizeof(signature));
+
+            if(signature == CODEVIEW_RSDS_SIGNATURE && size >= sizeof(codeview_rsds_header)) {
+                codeview_rsds_header rsds;
+                memcpy(&rsds, data, sizeof(rsds));
+                _pdb.guid = rsds.guid;
+                _pdb.age = rsds.age;
+                header = sizeof(rsds);
+            } else if(signature == CODEVIEW_NB10_SIGNATURE && size >= sizeof(codeview_nb10_header)) {
+                codeview_nb10_header nb10;
+                memcpy(&nb10, data, sizeof(nb10));
+                _pdb.signature = nb10.timestamp;
+                _pdb.age = nb10.age;
+                header = sizeof(nb10);
+            } else {
+                return;
+            }
+
+            //
+            // The path may not be terminated when the record is cut short
+            //
+            auto path = reinterpret_cast<const char*>(data + header);
+            auto length = strnlen(path, size - header);
+            if(length == 0) {
+                memset(&_pdb, 0, sizeof(_pdb));
+                return;
+            }
+            _pdbPath = add_string(path, length);
+        }
+
+        void image_debug_info::parse_pogo(const uint8_t* data, uint32_t size)
+        {
+            if(size < sizeof(uint32_t))
+                return;
+            memcpy(&_pogoSignature, data, sizeof(uint32_t));
+
+            //
+            // Each entry is the RVA, the size and the section name, padded to 4 bytes
+            //
+            uint32_t offset = sizeof(uint32_t);
+            while(size - offset > 2 * sizeof(uint32_t)) {
+                image_pogo_entry entry;
+                memcpy(&entry.rva, data + offset, sizeof(uint32_t));
+                memcpy(&entry.size, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+
+                auto name = reinterpret_cast<const char*>(data + offset + 2 * sizeof(uint32_t));
+                auto length = strnlen(name, size - offset - 2 * sizeof(uint32_t));
+                if(length == size - offset - 2 * sizeof(uint32_t) || (entry.rva == 0 && entry.size == 0 && length == 0))
+                    break;
+
+                entry.name = add_string(name, length);
+                _pogo.push_back(entry);
+                offset += 2 * sizeof(uint32_t) + ((static_cast<uint32_t>(length) + 4) & ~3u);
+                if(offset > size)
+                    break;
+            }
+        }
+
+        void image_debug_info::parse_repro(const uint8_t* data, uint32_t size)
+        {
+            uint32_t length;
+
+            if(size < sizeof(length))
+                return;
+            memcpy(&length, data, sizeof(length));
+            if(length > size - sizeof(length))
+                return;
+            _reproHash.assign(data + sizeof(length), data + sizeof(length) + length);
+        }
+    }
+}
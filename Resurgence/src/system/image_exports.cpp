@@ -0,0 +1,241 @@
+#include <system/image_exports.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+#include <cwctype>
+
+namespace resurgence
+{
+    namespace system
+    {
+        image_exports::image_exports()
+            : _strings(1, '\0'), _base(0)
+        {
+        }
+
+        ///<summary>
+        /// Indexes the exports of an image file.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_exports::parse(const std::wstring& path)
+        {
+            misc::mapped_file file;
+
+            auto status = file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(file.data(), file.size());
+        }
+
+        ///<summary>
+        /// Indexes the exports of an image read in memory (file layout, not loaded).
+        ///</summary>
+        ///<param name="image"> The file contents. </param>
+        ///<param name="size">  The file size. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_exports::parse(const uint8_t* image, size_t size)
+        {
+            image_file_view view(image, size);
+
+            auto status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(view);
+        }
+
+        ///<summary>
+        /// Indexes the exports of an image view whose headers were parsed.
+        ///</summary>
+        ///<param name="view"> The view. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_exports::parse(const image_file_view& view)
+        {
+            _functions.clear();
+            _names.clear();
+            _hints.clear();
+            _strings.assign(1, '\0');
+            _base = 0;
+
+            auto dir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_EXPORT);
+            if(!dir)
+                return STATUS_SUCCESS;
+
+            auto exportDir = view.at_rva<IMAGE_EXPORT_DIRECTORY>(dir->VirtualAddress);
+            if(!exportDir)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            //
+            // Mixed mode and ReadyToRun assemblies may have a directory with no table at all
+            //
+            if(exportDir->NumberOfFunctions == 0)
+                return STATUS_SUCCESS;
+
+            auto functions = view.at_rva<uint32_t>(exportDir->AddressOfFunctions, exportDir->NumberOfFunctions);
+            if(!functions)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            _base = exportDir->Base;
+            _functions.resize(exportDir->NumberOfFunctions);
+            for(uint32_t i = 0; i < exportDir->NumberOfFunctions; i++) {
+                auto rva = functions[i];
+
+                //
+                // Forwarders point back into the export directory
+                //
+                if(rva >= dir->VirtualAddress && rva - dir->VirtualAddress < dir->Size) {
+                    auto forwarder = view.string_at_rva(rva);
+                    _functions[i] = image_export_entry{0, forwarder ? add_string(forwarder) : 0};
+                } else {
+                    _functions[i] = image_export_entry{rva, 0};
+                }
+            }
+
+            auto names = view.at_rva<uint32_t>(exportDir->AddressOfNames, exportDir->NumberOfNames);
+            auto ordinals = view.at_rva<uint16_t>(exportDir->AddressOfNameOrdinals, exportDir->NumberOfNames);
+            if(!names || !ordinals)
+                return STATUS_SUCCESS;
+
+            _names.reserve(exportDir->NumberOfNames);
+            for(uint32_t i = 0; i < exportDir->NumberOfNames; i++) {
+                auto name = view.string_at_rva(names[i]);
+                if(name && ordinals[i] < _functions.size())
+                    _names.push_back(named_export{add_string(name), ordinals[i]});
+                else
+                    _names.push_back(named_export{0, UINT32_MAX});
+            }
+
+            //
+            // Remember where each name table entry went, hints index the name table
+            //
+            std::vector<uint32_t> order(_names.size());
+            for(uint32_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+                return strcmp(&_strings[_names[lhs].name], &_strings[_names[rhs].name]) < 0;
+            });
+
+            std::vector<named_export> sorted(_names.size());
+            _hints.resize(_names.size());
+            for(uint32_t i = 0; i < order.size(); i++) {
+                sorted[i] = _names[order[i]];
+                _hints[order[i]] = i;
+            }
+            _names.swap(sorted);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Finds an export by name.
+        ///</summary>
+        ///<param name="name"> The name. </param>
+        ///<param name="hint"> The hint from the import, the index in the export name table tried first. </param>
+        ///<returns>
+        /// The export, nullptr if none.
+        ///</returns>
+        const image_export_entry* image_exports::find_by_name(const char* name, uint16_t hint) const
+        {
+            if(hint < _hints.size()) {
+                auto& named = _names[_hints[hint]];
+                if(named.function != UINT32_MAX && strcmp(&_strings[named.name], name) == 0)
+                    return &_functions[named.function];
+            }
+
+            auto it = std::lower_bound(_names.begin(), _names.end(), name, [this](const named_export& named, const char* value) {
+                return strcmp(&_strings[named.name], value) < 0;
+            });
+            if(it == _names.end() || it->function == UINT32_MAX || strcmp(&_strings[it->name], name) != 0)
+                return nullptr;
+            return &_functions[it->function];
+        }
+
+        ///<summary>
+        /// Finds an export by ordinal.
+        ///</summary>
+        ///<param name="ordinal"> The ordinal, biased (as imported). </param>
+        ///<returns>
+        /// The export, nullptr if none.
+        ///</returns>
+        const image_export_entry* image_exports::find_by_ordinal(uint16_t ordinal) const
+        {
+            if(ordinal < _base || ordinal - _base >= _functions.size())
+                return nullptr;
+
+            auto& entry = _functions[ordinal - _base];
+            return entry.rva || entry.forwarder ? &entry : nullptr;
+        }
+
+        ///<summary>
+        /// Gets the memory used by the index, in bytes.
+        ///</summary>
+        size_t image_exports::get_memory_usage() const
+        {
+            return sizeof(*this) +
+                _functions.capacity() * sizeof(image_export_entry) +
+                _names.capacity() * sizeof(named_export) +
+                _hints.capacity() * sizeof(uint32_t) +
+                _strings.capacity();
+        }
+
+        uint32_t image_exports::add_string(const char* string)
+        {
+            auto offset = static_cast<uint32_t>(_strings.size());
+            _strings.insert(_strings.end(), string, string + strlen(string) + 1);
+            return offset;
+        }
+
+        ///<summary>
+        /// Gets the shared cache.
+        ///</summary>
+        image_export_cache& image_export_cache::instance()
+        {
+            static image_export_cache cache;
+            return cache;
+        }
+
+        ///<summary>
+        /// Gets the export index of an image file, parsing it the first time.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The index, nullptr if the file can't be read or isn't an image.
+        ///</returns>
+        const image_exports* image_export_cache::get(const std::wstring& path)
+        {
+            std::wstring key(path);
+            std::transform(key.begin(), key.end(), key.begin(), towlower);
+
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                auto it = _exports.find(key);
+                if(it != _exports.end())
+                    return it->second.get();
+            }
+
+            //
+            // Parsed without the lock, if another thread got there first its index is kept
+            //
+            std::unique_ptr<image_exports> exports(new image_exports());
+            if(!NT_SUCCESS(exports->parse(path)))
+                exports.reset();
+
+            std::lock_guard<std::mutex> lock(_lock);
+            return _exports.emplace(std::move(key), std::move(exports)).first->second.get();
+        }
+
+        ///<summary>
+        /// Gets the number of images cached, with or without an index.
+        ///</summary>
+        size_t image_export_cache::size()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _exports.size();
+        }
+    }
+}
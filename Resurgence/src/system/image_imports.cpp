@@ -0,0 +1,195 @@
+#include <system/image_imports.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+
+#define MAX_IMPORT_THUNKS   0x10000
+
+namespace resurgence
+{
+    namespace system
+    {
+        image_imports::image_imports()
+            : _strings(1, '\0'), _slotSize(sizeof(uint32_t))
+        {
+        }
+
+        ///<summary>
+        /// Parses the imports of an image file.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_imports::parse(const std::wstring& path)
+        {
+            misc::mapped_file file;
+
+            auto status = file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(file.data(), file.size());
+        }
+
+        ///<summary>
+        /// Parses the imports of an image read in memory (file layout, not loaded).
+        ///</summary>
+        ///<param name="image"> The file contents. </param>
+        ///<param name="size">  The file size. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_imports::parse(const uint8_t* image, size_t size)
+        {
+            image_file_view view(image, size);
+
+            auto status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+            return parse(view);
+        }
+
+        ///<summary>
+        /// Parses the imports of an image view whose headers were parsed.
+        ///</summary>
+        ///<param name="view"> The view. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_imports::parse(const image_file_view& view)
+        {
+            clear();
+            _slotSize = view.is_64bit() ? sizeof(uint64_t) : sizeof(uint32_t);
+
+            auto importDir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_IMPORT);
+            for(uint32_t rva = importDir ? importDir->VirtualAddress : 0; rva; rva += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+                auto descriptor = view.at_rva<IMAGE_IMPORT_DESCRIPTOR>(rva);
+                if(!descriptor || descriptor->Name == 0 || descriptor->FirstThunk == 0)
+                    break;
+
+                auto name = view.string_at_rva(descriptor->Name);
+                if(!name)
+                    continue;
+
+                //
+                // Old linkers leave out the name table, the IAT holds the names until the image is loaded.
+                // Bound images have addresses in the IAT of the file, so the name table comes first.
+                //
+                auto names = descriptor->OriginalFirstThunk ? descriptor->OriginalFirstThunk : descriptor->FirstThunk;
+                add_thunks(view, add_string(name), names, descriptor->FirstThunk, false);
+            }
+
+            auto delayDir = view.get_data_directory(IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT);
+            for(uint32_t rva = delayDir ? delayDir->VirtualAddress : 0; rva; rva += sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)) {
+                auto descriptor = view.at_rva<IMAGE_DELAYLOAD_DESCRIPTOR>(rva);
+                if(!descriptor || descriptor->DllNameRVA == 0)
+                    break;
+
+                //
+                // Descriptors from before VC7 hold addresses instead of RVAs, only ever in PE32 images
+                //
+                uint32_t bias = 0;
+                if(!descriptor->Attributes.RvaBased) {
+                    if(view.is_64bit())
+                        continue;
+                    bias = static_cast<uint32_t>(view.get_image_base());
+                }
+
+                auto name = view.string_at_rva(descriptor->DllNameRVA - bias);
+                if(!name || descriptor->ImportNameTableRVA == 0 || descriptor->ImportAddressTableRVA == 0)
+                    continue;
+                add_thunks(view, add_string(name), descriptor->ImportNameTableRVA - bias, descriptor->ImportAddressTableRVA - bias, true);
+            }
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Removes every import.
+        ///</summary>
+        void image_imports::clear()
+        {
+            _entries.clear();
+            _strings.assign(1, '\0');
+        }
+
+        ///<summary>
+        /// Gets the RVA range spanned by the IAT slots of one kind of import.
+        ///</summary>
+        ///<param name="delayed"> Whether to get the delay-load slots. </param>
+        ///<param name="begin">   Receives the first slot RVA. </param>
+        ///<param name="end">     Receives the RVA past the last slot. </param>
+        ///<returns>
+        /// false if there are no imports of that kind.
+        ///</returns>
+        bool image_imports::get_iat_range(bool delayed, uint32_t* begin, uint32_t* end) const
+        {
+            uint32_t low = UINT32_MAX;
+            uint32_t high = 0;
+
+            for(auto& entry : _entries) {
+                if(entry.delayed != delayed)
+                    continue;
+                low = std::min(low, entry.iat_rva);
+                high = std::max(high, entry.iat_rva + _slotSize);
+            }
+            if(low >= high)
+                return false;
+
+            *begin = low;
+            *end = high;
+            return true;
+        }
+
+        uint32_t image_imports::add_string(const char* string)
+        {
+            auto offset = static_cast<uint32_t>(_strings.size());
+            _strings.insert(_strings.end(), string, string + strlen(string) + 1);
+            return offset;
+        }
+
+        void image_imports::add_thunks(const image_file_view& view, uint32_t module, uint32_t names, uint32_t iat, bool delayed)
+        {
+            for(uint32_t i = 0; i < MAX_IMPORT_THUNKS; i++) {
+                uint64_t thunk;
+                bool     byOrdinal;
+
+                if(_slotSize == sizeof(uint64_t)) {
+                    auto value = view.at_rva<uint64_t>(names + i * _slotSize);
+                    if(!value)
+                        break;
+                    thunk = *value;
+                    byOrdinal = (thunk & IMAGE_ORDINAL_FLAG64) != 0;
+                } else {
+                    auto value = view.at_rva<uint32_t>(names + i * _slotSize);
+                    if(!value)
+                        break;
+                    thunk = *value;
+                    byOrdinal = (thunk & IMAGE_ORDINAL_FLAG32) != 0;
+                }
+                if(thunk == 0)
+                    break;
+
+                image_import_entry entry;
+                entry.module = module;
+                entry.name = 0;
+                entry.iat_rva = iat + i * _slotSize;
+                entry.ordinal = static_cast<uint16_t>(thunk);
+                entry.by_ordinal = byOrdinal;
+                entry.delayed = delayed;
+
+                //
+                // By name, the thunk is the RVA of the hint followed by the name
+                //
+                if(!byOrdinal) {
+                    auto hint = view.at_rva<uint16_t>(static_cast<uint32_t>(thunk));
+                    auto name = view.string_at_rva(static_cast<uint32_t>(thunk) + sizeof(uint16_t));
+                    if(!hint || !name)
+                        continue;
+                    entry.ordinal = *hint;
+                    entry.name = add_string(name);
+                }
+                _entries.push_back(entry);
+            }
+        }
+    }
+}
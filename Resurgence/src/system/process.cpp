@@ -1,6 +1,7 @@
 #include <system/process.hpp>
 #include <misc/exceptions.hpp>
 #include <misc/native.hpp>
+#include <misc/native_ranges.hpp>
 
 #include <bitset>
 #include <Shlwapi.h>
@@ -134,10 +135,10 @@ namespace resurgence
         {
             std::vector<process> processes;
 
-            native::enumerate_processes([&](PSYSTEM_PROCESS_INFORMATION info) -> NTSTATUS {
-                processes.push_back(process((uint32_t)info->UniqueProcessId));
-                return STATUS_NOT_FOUND;
-            });
+            auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+            for(auto& info : native::process_range(buffer)) {
+                processes.push_back(process((uint32_t)info.UniqueProcessId));
+            }
 
             return processes;
         }
@@ -149,11 +150,11 @@ namespace resurgence
         {
             std::vector<process> processes;
 
-            native::enumerate_processes([&](PSYSTEM_PROCESS_INFORMATION info) -> NTSTATUS {
-                if(info->ImageName.Length > 0 && !_wcsicmp(std::data(name), info->ImageName.Buffer))
-                    processes.emplace_back(static_cast<uint32_t>((ULONG_PTR)info->UniqueProcessId));
-                return STATUS_NOT_FOUND;
-            });
+            auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+            for(auto& info : native::process_range(buffer)) {
+                if(info.ImageName.Length > 0 && !_wcsicmp(std::data(name), info.ImageName.Buffer))
+                    processes.emplace_back(static_cast<uint32_t>((ULONG_PTR)info.UniqueProcessId));
+            }
 
             return processes;
         }
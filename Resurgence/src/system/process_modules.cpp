@@ -50,11 +50,13 @@ namespace resurgence
             if(proc->is_current_process()) {
                 _base = (uint8_t*)entry->DllBase;
                 _size = (size_t)entry->SizeOfImage;
+                _timestamp = entry->TimeDateStamp;
                 _name = entry->BaseDllName.Buffer;
                 _path = entry->FullDllName.Buffer;
             } else {
                 _base = (uint8_t*)entry->DllBase;
                 _size = (size_t)entry->SizeOfImage;
+                _timestamp = entry->TimeDateStamp;
                 _name = proc->memory()->read_unicode_string(entry->BaseDllName.Buffer, entry->BaseDllName.Length / sizeof(wchar_t));
                 _path = proc->memory()->read_unicode_string(entry->FullDllName.Buffer, entry->FullDllName.Length / sizeof(wchar_t));
             }
@@ -70,6 +72,7 @@ namespace resurgence
             _process = proc;
             _base = (uint8_t*)entry->DllBase;
             _size = (size_t)entry->SizeOfImage;
+            _timestamp = entry->TimeDateStamp;
             _name = proc->memory()->read_unicode_string(entry->BaseDllName.Buffer, entry->BaseDllName.Length / sizeof(wchar_t));
             _path = proc->memory()->read_unicode_string(entry->FullDllName.Buffer, entry->FullDllName.Length / sizeof(wchar_t));
 
@@ -93,6 +96,7 @@ namespace resurgence
             _process = proc;
             _base = (uint8_t*)entry->ImageBase;
             _size = (size_t)entry->ImageSize;
+            _timestamp = 0;
             _name = (path + entry->OffsetToFileName);
             _path = native::get_dos_path(path);
         }
@@ -153,8 +157,11 @@ namespace resurgence
                 auto ordinal_table  = reinterpret_cast<uint16_t*>(native::mapped_image_rva_to_va(image, exportDir->AddressOfNameOrdinals));
 
                 if(name_table && address_table && ordinal_table) {
+                    std::vector<uintptr_t> names(exportDir->NumberOfNames);
+                    native::mapped_image_rvas_to_vas(image, name_table, names.size(), names.data());
+
                     for(ULONG i = 0; i < exportDir->NumberOfNames; i++) {
-                        PCSTR szName = (PCSTR)native::mapped_image_rva_to_va(image, name_table[i]);
+                        PCSTR szName = (PCSTR)names[i];
                         uint16_t ordinal = ordinal_table[i];
 
                         if(ordinal >= exportDir->NumberOfFunctions)
@@ -163,7 +170,7 @@ namespace resurgence
                         //
                         //Compare it to the name we are looking for
                         // 
-                        if(szName == name) {
+                        if(szName && szName == name) {
                             auto rva = address_table[ordinal];
                             if((rva >= exportDataDirectory->VirtualAddress) &&
                                 (rva < exportDataDirectory->VirtualAddress + exportDataDirectory->Size)
@@ -2,6 +2,7 @@
 #include <system/process.hpp>
 
 #include <misc/native.hpp>
+#include <misc/native_ranges.hpp>
 
 namespace resurgence
 {
@@ -26,10 +27,17 @@ namespace resurgence
         std::vector<process_thread> process_threads::get_all_threads()
         {
             std::vector<process_thread> threads;
-            native::enumerate_process_threads(_process->get_pid(), [&](PSYSTEM_EXTENDED_THREAD_INFORMATION entry) {
-                threads.emplace_back(_process, entry);
-                return STATUS_NOT_FOUND;
-            });
+
+            auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+            for(auto& entry : native::process_range(buffer)) {
+                if(reinterpret_cast<uint32_t>(entry.UniqueProcessId) == (uint32_t)_process->get_pid()) {
+                    auto range = native::thread_range(entry);
+                    threads.reserve(range.size());
+                    for(auto& thread : range)
+                        threads.emplace_back(_process, &thread);
+                    break;
+                }
+            }
             return threads;
         }
     }
@@ -0,0 +1,296 @@
+#include <system/sampling_profiler.hpp>
+#include <system/symbols/symbol_service.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#define CALL_TREE_NO_FRAME      0xFFFFFFFF
+
+namespace resurgence
+{
+    namespace system
+    {
+        call_tree::call_tree()
+        {
+            clear();
+        }
+
+        ///<summary>
+        /// Adds a stack.
+        ///</summary>
+        ///<param name="frames"> The frame addresses, innermost first (the order stacks are unwound in). </param>
+        ///<param name="count">  The number of frames. </param>
+        ///<param name="weight"> The number of samples the stack stands for. </param>
+        void call_tree::add(const uint64_t* frames, size_t count, uint64_t weight)
+        {
+            uint32_t node = 0;
+
+            _nodes[0].total += weight;
+            for(size_t i = count; i-- > 0;) {
+                auto frame = _frameIndex.emplace(frames[i], static_cast<uint32_t>(_frames.size()));
+                if(frame.second)
+                    _frames.push_back(frames[i]);
+
+                auto key = (static_cast<uint64_t>(node) << 32) | frame.first->second;
+                auto child = _children.emplace(key, static_cast<uint32_t>(_nodes.size()));
+                if(child.second)
+                    _nodes.push_back(call_tree_node{frame.first->second, node, 0, 0});
+
+                node = child.first->second;
+                _nodes[node].total += weight;
+            }
+            _nodes[node].self += weight;
+        }
+
+        ///<summary>
+        /// Removes every sample.
+        ///</summary>
+        void call_tree::clear()
+        {
+            _nodes.assign(1, call_tree_node{CALL_TREE_NO_FRAME, 0, 0, 0});
+            _frames.clear();
+            _frameIndex.clear();
+            _children.clear();
+        }
+
+        ///<summary>
+        /// Writes the stacks in the folded format of flame graph tools: one line per
+        /// stack, outermost frame first, separated by semicolons, then the sample count.
+        ///</summary>
+        ///<param name="names"> The name of each frame, indexed like the frame addresses. </param>
+        ///<param name="out">   The string the lines are appended to. </param>
+        void call_tree::write_folded(const std::vector<std::wstring>& names, std::wstring& out) const
+        {
+            std::vector<uint32_t> path;
+
+            for(uint32_t i = 1; i < _nodes.size(); i++) {
+                if(_nodes[i].self == 0)
+                    continue;
+
+                path.clear();
+                for(auto node = i; node != 0; node = _nodes[node].parent)
+                    path.push_back(_nodes[node].frame);
+
+                for(size_t j = path.size(); j-- > 0;) {
+                    out.append(names[path[j]]);
+                    out.push_back(j != 0 ? L';' : L' ');
+                }
+                out.append(std::to_wstring(_nodes[i].self));
+                out.push_back(L'\n');
+            }
+        }
+
+        ///<summary>
+        /// Creates a profiler.
+        ///</summary>
+        ///<param name="proc"> The target process, opened with PROCESS_VM_READ access. </param>
+        sampling_profiler::sampling_profiler(process* proc)
+            : _ownTarget(new process_sampling_target(proc)), _target(*_ownTarget), _stopping(false)
+        {
+        }
+
+        ///<summary>
+        /// Creates a profiler.
+        ///</summary>
+        ///<param name="target"> The target, which must outlive the profiler. </param>
+        sampling_profiler::sampling_profiler(sampling_target& target)
+            : _target(target), _stopping(false)
+        {
+        }
+
+        sampling_profiler::~sampling_profiler()
+        {
+            stop();
+        }
+
+        ///<summary>
+        /// Starts sampling on a background thread. Modules are read again on each start.
+        ///</summary>
+        ///<param name="interval"> The time between samples, in milliseconds. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS sampling_profiler::start(uint32_t interval)
+        {
+            stop();
+
+            std::lock_guard<std::mutex> lock(_lock);
+            _unwinder.reset();
+
+            auto status = prepare();
+            if(!NT_SUCCESS(status))
+                return status;
+
+            _stopping = false;
+            _sampler = std::thread(&sampling_profiler::run, this, interval);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Stops sampling and waits for the background thread.
+        ///</summary>
+        void sampling_profiler::stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stopping = true;
+            }
+            _signal.notify_all();
+
+            if(_sampler.joinable())
+                _sampler.join();
+        }
+
+        ///<summary>
+        /// Takes one sample of every thread, without the background thread.
+        ///</summary>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS sampling_profiler::sample()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            if(!_unwinder) {
+                auto status = prepare();
+                if(!NT_SUCCESS(status))
+                    return status;
+            }
+
+            auto status = _target.get_threads(_threads);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            for(auto id : _threads)
+                sample_thread(id);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Removes every sample and the overhead counters.
+        ///</summary>
+        void sampling_profiler::clear()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _tree.clear();
+            _overhead.clear();
+        }
+
+        ///<summary>
+        /// Gets the overhead of all threads.
+        ///</summary>
+        sampling_overhead sampling_profiler::get_overhead()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            sampling_overhead total = {0, 0, 0, 0};
+            for(auto& entry : _overhead) {
+                total.samples += entry.second.samples;
+                total.failures += entry.second.failures;
+                total.total_ns += entry.second.total_ns;
+                total.max_ns = std::max(total.max_ns, entry.second.max_ns);
+            }
+            return total;
+        }
+
+        ///<summary>
+        /// Symbolizes the samples and writes them as folded stacks.
+        ///</summary>
+        ///<returns>
+        /// The folded stacks.
+        ///</returns>
+        std::wstring sampling_profiler::get_folded_stacks()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            //
+            // Each frame is named once, however many stacks it is in
+            //
+            auto& frames = _tree.get_frames();
+            std::vector<std::wstring> names(frames.size());
+            for(size_t i = 0; i < frames.size(); i++) {
+                auto address = static_cast<uintptr_t>(frames[i]);
+                auto it = std::upper_bound(_modules.begin(), _modules.end(), address, [](uintptr_t value, const process_module& module) {
+                    return value < reinterpret_cast<uintptr_t>(module.get_base());
+                });
+                if(it != _modules.begin() && address - reinterpret_cast<uintptr_t>((it - 1)->get_base()) < (it - 1)->get_size()) {
+                    symbol_service::instance().format(*(it - 1), address, names[i]);
+                } else {
+                    wchar_t buffer[24];
+                    swprintf_s(buffer, L"0x%llX", frames[i]);
+                    names[i] = buffer;
+                }
+            }
+
+            std::wstring out;
+            _tree.write_folded(names, out);
+            return out;
+        }
+
+        NTSTATUS sampling_profiler::prepare()
+        {
+            auto status = _target.get_modules(_modules);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            std::sort(_modules.begin(), _modules.end(), [](const process_module& lhs, const process_module& rhs) {
+                return lhs.get_base() < rhs.get_base();
+            });
+
+            _unwinder.reset(new stack_unwinder(_target.get_memory()));
+            _unwinder->add_modules(_modules);
+            return STATUS_SUCCESS;
+        }
+
+        NTSTATUS sampling_profiler::sample_thread(uint32_t id)
+        {
+            auto& overhead = _overhead[id];
+            auto begin = std::chrono::steady_clock::now();
+
+            auto status = _target.suspend(id);
+            if(!NT_SUCCESS(status)) {
+                overhead.failures++;
+                return status;
+            }
+
+            //
+            // The stack is unwound before resuming, it would change under us otherwise
+            //
+            unwind_context context;
+            status = _target.capture(id, context);
+            if(NT_SUCCESS(status))
+                _unwinder->unwind(context, _frames);
+            _target.resume(id);
+
+            auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+            overhead.total_ns += elapsed;
+            overhead.max_ns = std::max(overhead.max_ns, elapsed);
+            if(!NT_SUCCESS(status) || _frames.empty()) {
+                overhead.failures++;
+                return status;
+            }
+            overhead.samples++;
+
+            //
+            // Return addresses point past the call, which may be the start of the next function.
+            // The first frame and those popped from machine frames are where the code stopped.
+            //
+            _stack.resize(_frames.size());
+            for(size_t i = 0; i < _frames.size(); i++)
+                _stack[i] = i == 0 || _frames[i].interrupted ? _frames[i].rip : _frames[i].rip - 1;
+            _tree.add(_stack.data(), _stack.size());
+            return STATUS_SUCCESS;
+        }
+
+        void sampling_profiler::run(uint32_t interval)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            while(!_stopping && !_target.has_exited()) {
+                lock.unlock();
+                sample();
+                lock.lock();
+                _signal.wait_for(lock, std::chrono::milliseconds(interval), [this] { return _stopping; });
+            }
+        }
+    }
+}
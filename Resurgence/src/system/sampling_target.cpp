@@ -0,0 +1,103 @@
+#include <system/sampling_target.hpp>
+#include <system/process.hpp>
+
+#include <misc/native.hpp>
+
+#define SAMPLER_THREAD_ACCESS   THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Creates a target.
+        ///</summary>
+        ///<param name="proc"> The process, opened with PROCESS_VM_READ access. </param>
+        process_sampling_target::process_sampling_target(process* proc)
+            : _process(proc), _memory(proc)
+        {
+        }
+
+        NTSTATUS process_sampling_target::get_modules(std::vector<process_module>& modules)
+        {
+        #ifdef _WIN64
+            if(_process->is_current_process() || _process->get_platform() != platform_x64)
+                return STATUS_NOT_SUPPORTED;
+
+            modules = _process->modules()->get_all_modules();
+            return STATUS_SUCCESS;
+        #else
+            //
+            // Contexts are captured with the x64 layout, and only x64 stacks can be unwound
+            //
+            UNREFERENCED_PARAMETER(modules);
+            return STATUS_NOT_SUPPORTED;
+        #endif
+        }
+
+        NTSTATUS process_sampling_target::get_threads(std::vector<uint32_t>& threads)
+        {
+            std::unordered_map<uint32_t, std::unique_ptr<misc::safe_generic_handle>> handles;
+
+            threads.clear();
+            for(auto& thread : _process->threads()->get_all_threads()) {
+                auto id = thread.get_id();
+                auto it = _threads.find(id);
+                if(it != _threads.end()) {
+                    handles.emplace(id, std::move(it->second));
+                } else {
+                    HANDLE handle;
+                    if(NT_SUCCESS(native::open_thread(&handle, id, SAMPLER_THREAD_ACCESS)))
+                        handles.emplace(id, std::unique_ptr<misc::safe_generic_handle>(new misc::safe_generic_handle(handle)));
+                }
+                threads.push_back(id);
+            }
+
+            //
+            // The handles of threads that exited are closed with the old map
+            //
+            _threads.swap(handles);
+            return STATUS_SUCCESS;
+        }
+
+        NTSTATUS process_sampling_target::suspend(uint32_t thread)
+        {
+            auto handle = get_thread(thread);
+            if(!handle)
+                return STATUS_INVALID_HANDLE;
+            return NtSuspendThread(handle, nullptr);
+        }
+
+        NTSTATUS process_sampling_target::capture(uint32_t thread, unwind_context& context)
+        {
+        #ifdef _WIN64
+            auto handle = get_thread(thread);
+            if(!handle)
+                return STATUS_INVALID_HANDLE;
+            return stack_unwinder::capture(handle, context);
+        #else
+            UNREFERENCED_PARAMETER(thread);
+            UNREFERENCED_PARAMETER(context);
+            return STATUS_NOT_SUPPORTED;
+        #endif
+        }
+
+        void process_sampling_target::resume(uint32_t thread)
+        {
+            auto handle = get_thread(thread);
+            if(handle)
+                NtResumeThread(handle, nullptr);
+        }
+
+        bool process_sampling_target::has_exited()
+        {
+            return _process->has_exited();
+        }
+
+        HANDLE process_sampling_target::get_thread(uint32_t thread) const
+        {
+            auto it = _threads.find(thread);
+            return it != _threads.end() ? it->second->get() : nullptr;
+        }
+    }
+}
@@ -0,0 +1,533 @@
+#include <system/stack_unwinder.hpp>
+#include <system/unwind_codes.hpp>
+#include <misc/thread_pool.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+#define MAX_EPILOG_POPS             16
+
+#define REGISTER_RSP                4
+
+#define STACK_CHUNK_SIZE            0x4000
+#define STACK_CHUNK_COUNT           4
+
+namespace resurgence
+{
+    namespace system
+    {
+        //
+        // Stack reads of one unwind. Memory is read in chunks that start at the page of the
+        // address and go up, towards the stack base: the pages below the stack pointer may
+        // not be committed, the ones above are. A chunk that can't be read whole is retried
+        // as a single page, then as the word alone.
+        //
+        class stack_unwinder::stack_reader
+        {
+        public:
+            explicit stack_reader(unwind_memory_source& memory)
+                : _memory(memory), _data(STACK_CHUNK_SIZE * STACK_CHUNK_COUNT), _next(0)
+            {
+                for(auto& chunk : _chunks)
+                    chunk.size = 0;
+            }
+
+            bool read(uint64_t address, uint64_t& value)
+            {
+                for(size_t i = 0; i < STACK_CHUNK_COUNT; i++) {
+                    auto& chunk = _chunks[i];
+                    if(address >= chunk.address && address - chunk.address + sizeof(value) <= chunk.size) {
+                        memcpy(&value, &_data[i * STACK_CHUNK_SIZE + (address - chunk.address)], sizeof(value));
+                        return true;
+                    }
+                }
+
+                auto i = _next;
+                _next = (_next + 1) % STACK_CHUNK_COUNT;
+
+                auto& chunk = _chunks[i];
+                auto buffer = &_data[i * STACK_CHUNK_SIZE];
+                chunk.address = address & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+                chunk.size = 0;
+                if(NT_SUCCESS(_memory.read(chunk.address, buffer, STACK_CHUNK_SIZE)))
+                    chunk.size = STACK_CHUNK_SIZE;
+                else if(NT_SUCCESS(_memory.read(chunk.address, buffer, PAGE_SIZE)))
+                    chunk.size = PAGE_SIZE;
+
+                if(address - chunk.address + sizeof(value) <= chunk.size) {
+                    memcpy(&value, buffer + (address - chunk.address), sizeof(value));
+                    return true;
+                }
+                return NT_SUCCESS(_memory.read(address, &value, sizeof(value)));
+            }
+
+        private:
+            struct chunk
+            {
+                uint64_t    address;
+                size_t      size;
+            };
+
+            unwind_memory_source&   _memory;
+            std::vector<uint8_t>    _data;
+            chunk                   _chunks[STACK_CHUNK_COUNT];
+            size_t                  _next;
+        };
+
+        static int get_code_slots(uint8_t op, uint8_t info, uint8_t version)
+        {
+            switch(op) {
+            case UWOP_PUSH_NONVOL:
+            case UWOP_ALLOC_SMALL:
+            case UWOP_SET_FPREG:
+            case UWOP_PUSH_MACHFRAME:
+                return 1;
+            case UWOP_ALLOC_LARGE:
+                return info == 0 ? 2 : 3;
+            case UWOP_SAVE_NONVOL:
+            case UWOP_SAVE_XMM128:
+                return 2;
+            case UWOP_SAVE_NONVOL_FAR:
+            case UWOP_SAVE_XMM128_FAR:
+                return 3;
+            case UWOP_EPILOG:
+                return version >= 2 ? 1 : 2;
+            case UWOP_SPARE:
+                return version >= 2 ? 0 : 3;
+            default:
+                return 0;
+            }
+        }
+
+        //
+        // Epilogs have no unwind codes. Like RtlVirtualUnwind, we recognize one from its code:
+        // an optional add rsp or lea rsp, pops, then a return or a jump out of the function.
+        // When rip is in one, the rest of the epilog is emulated.
+        //
+        template<typename _Read>
+        static bool unwind_epilog(const image_file_view& view, const function_table_entry& entry, uint32_t rva, uint8_t frameRegister,
+            unwind_context& context, _Read read)
+        {
+            uint8_t code[16];
+            auto fetch = [&](uint32_t offset, size_t size) {
+                auto bytes = view.at_rva<uint8_t>(rva + offset, size);
+                if(!bytes)
+                    return false;
+                memcpy(code, bytes, size);
+                return true;
+            };
+
+            uint32_t offset = 0;
+            int64_t  adjust = 0;
+            int      adjustRegister = REGISTER_RSP;
+
+            //
+            // add rsp, imm8 / add rsp, imm32 / lea rsp, [frame + disp8] / lea rsp, [frame + disp32]
+            //
+            if(fetch(0, 4) && code[0] == 0x48 && code[1] == 0x83 && code[2] == 0xC4) {
+                adjust = static_cast<int8_t>(code[3]);
+                offset = 4;
+            } else if(fetch(0, 7) && code[0] == 0x48 && code[1] == 0x81 && code[2] == 0xC4) {
+                adjust = static_cast<int32_t>(code[3] | (code[4] << 8) | (code[5] << 16) | (static_cast<uint32_t>(code[6]) << 24));
+                offset = 7;
+            } else if(frameRegister && fetch(0, 3) && (code[0] & 0xFE) == 0x48 && code[1] == 0x8D && ((code[2] >> 3) & 7) == REGISTER_RSP &&
+                ((code[2] & 7) | ((code[0] & 1) << 3)) == frameRegister && (code[2] & 7) != REGISTER_RSP) {
+                adjustRegister = frameRegister;
+                if((code[2] >> 6) == 1 && fetch(0, 4)) {
+                    adjust = static_cast<int8_t>(code[3]);
+                    offset = 4;
+                } else if((code[2] >> 6) == 2 && fetch(0, 7)) {
+                    adjust = static_cast<int32_t>(code[3] | (code[4] << 8) | (code[5] << 16) | (static_cast<uint32_t>(code[6]) << 24));
+                    offset = 7;
+                } else {
+                    return false;
+                }
+            }
+
+            //
+            // pop reg / pop r8-r15
+            //
+            int pops[MAX_EPILOG_POPS];
+            int popCount = 0;
+            for(; popCount < MAX_EPILOG_POPS; popCount++) {
+                if(fetch(offset, 1) && (code[0] & 0xF8) == 0x58) {
+                    pops[popCount] = code[0] & 7;
+                    offset += 1;
+                } else if(fetch(offset, 2) && code[0] == 0x41 && (code[1] & 0xF8) == 0x58) {
+                    pops[popCount] = 8 + (code[1] & 7);
+                    offset += 2;
+                } else {
+                    break;
+                }
+            }
+
+            //
+            // ret / rep ret / jmp rel32 out of the function / rex jmp [rip + disp32]
+            //
+            bool end = false;
+            if(fetch(offset, 1) && code[0] == 0xC3) {
+                end = true;
+            } else if(fetch(offset, 2) && code[0] == 0xF3 && code[1] == 0xC3) {
+                end = true;
+            } else if(fetch(offset, 5) && code[0] == 0xE9) {
+                auto target = static_cast<int64_t>(rva) + offset + 5 + static_cast<int32_t>(code[1] | (code[2] << 8) | (code[3] << 16) | (static_cast<uint32_t>(code[4]) << 24));
+                end = target < entry.begin || target >= entry.end;
+            } else if(fetch(offset, 3) && code[0] == 0x48 && code[1] == 0xFF && code[2] == 0x25) {
+                end = true;
+            } else if(fetch(offset, 2) && code[0] == 0xFF && code[1] == 0x25) {
+                end = true;
+            }
+            if(!end)
+                return false;
+
+            auto& rsp = context.regs[REGISTER_RSP];
+            if(offset != 0)
+                rsp = context.regs[adjustRegister] + adjust;
+            for(int i = 0; i < popCount; i++) {
+                if(!read(rsp, context.regs[pops[i]]))
+                    return false;
+                rsp += 8;
+            }
+            if(!read(rsp, context.rip))
+                return false;
+            rsp += 8;
+            return true;
+        }
+
+        ///<summary>
+        /// Loads a module file.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS unwind_module::open(const std::wstring& path)
+        {
+            auto status = _file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            _view.reset(new image_file_view(_file.data(), _file.size()));
+            status = _view->parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+            if(_view->get_machine() != IMAGE_FILE_MACHINE_AMD64)
+                return STATUS_NOT_SUPPORTED;
+            return _functions.parse(*_view);
+        }
+
+        ///<summary>
+        /// Gets the shared cache.
+        ///</summary>
+        unwind_module_cache& unwind_module_cache::instance()
+        {
+            static unwind_module_cache cache;
+            return cache;
+        }
+
+        ///<summary>
+        /// Gets a module, loading it the first time.
+        ///</summary>
+        ///<param name="path"> The image path. </param>
+        ///<returns>
+        /// The module, nullptr if the file can't be read or isn't an image.
+        ///</returns>
+        const unwind_module* unwind_module_cache::get(const std::wstring& path)
+        {
+            std::wstring key(path);
+            std::transform(key.begin(), key.end(), key.begin(), towlower);
+
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                auto it = _modules.find(key);
+                if(it != _modules.end())
+                    return it->second.get();
+            }
+
+            //
+            // Loaded without the lock, if another thread got there first its module is kept
+            //
+            std::unique_ptr<unwind_module> module(new unwind_module());
+            if(!NT_SUCCESS(module->open(path)))
+                module.reset();
+
+            std::lock_guard<std::mutex> lock(_lock);
+            return _modules.emplace(std::move(key), std::move(module)).first->second.get();
+        }
+
+        ///<summary>
+        /// Creates an unwinder.
+        ///</summary>
+        ///<param name="memory"> The memory stacks are read from. </param>
+        ///<param name="cache">  The unwind modules. </param>
+        stack_unwinder::stack_unwinder(unwind_memory_source& memory, unwind_module_cache& cache)
+            : _memory(memory), _cache(cache)
+        {
+        }
+
+        ///<summary>
+        /// Adds a module.
+        ///</summary>
+        ///<param name="base"> The address the module is loaded at. </param>
+        ///<param name="size"> The size of the module. </param>
+        ///<param name="path"> The module file. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS stack_unwinder::add_module(uint64_t base, size_t size, const std::wstring& path)
+        {
+            auto module = _cache.get(path);
+            if(!module)
+                return STATUS_INVALID_IMAGE_FORMAT;
+
+            auto it = std::upper_bound(_modules.begin(), _modules.end(), base, [](uint64_t value, const loaded_module& loaded) {
+                return value < loaded.base;
+            });
+            _modules.insert(it, loaded_module{base, size, module});
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Adds the modules of a process. Modules that can't be loaded are skipped.
+        ///</summary>
+        ///<param name="modules"> The modules. </param>
+        void stack_unwinder::add_modules(const std::vector<process_module>& modules)
+        {
+            for(auto& module : modules) {
+                if(module.is_valid())
+                    add_module(reinterpret_cast<uintptr_t>(module.get_base()), module.get_size(), module.get_path());
+            }
+        }
+
+        ///<summary>
+        /// Unwinds a stack.
+        ///</summary>
+        ///<param name="context">   The registers of the thread. </param>
+        ///<param name="frames">    Receives the frames, starting with the context itself. </param>
+        ///<param name="maxFrames"> The maximum number of frames. </param>
+        ///<returns>
+        /// The status code. The frames unwound before a failure are kept.
+        ///</returns>
+        NTSTATUS stack_unwinder::unwind(const unwind_context& context, std::vector<unwind_frame>& frames, size_t maxFrames) const
+        {
+            stack_reader  stack(_memory);
+            unwind_context current = context;
+            bool interrupted = false;
+
+            frames.clear();
+            while(frames.size() < maxFrames) {
+                frames.push_back(unwind_frame{current.rip, current.regs[REGISTER_RSP], interrupted});
+
+                auto status = step(stack, current, interrupted);
+                if(!NT_SUCCESS(status))
+                    return status;
+
+                //
+                // The stack only grows towards lower addresses, a caller below its callee means we got lost
+                //
+                if(current.rip == 0 || current.regs[REGISTER_RSP] <= frames.back().rsp)
+                    break;
+            }
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Unwinds many stacks at once, on the shared thread pool.
+        ///</summary>
+        ///<param name="contexts">  The registers of the threads. </param>
+        ///<param name="stacks">    Receives the frames of each context, in the same order. </param>
+        ///<param name="maxFrames"> The maximum number of frames per stack. </param>
+        void stack_unwinder::unwind_all(const std::vector<unwind_context>& contexts, std::vector<std::vector<unwind_frame>>& stacks, size_t maxFrames) const
+        {
+            stacks.resize(contexts.size());
+            misc::thread_pool::instance().parallel_for(contexts.size(), [&](size_t i) {
+                unwind(contexts[i], stacks[i], maxFrames);
+            });
+        }
+
+    #ifdef _WIN64
+        ///<summary>
+        /// Captures the registers of a suspended thread.
+        ///</summary>
+        ///<param name="thread">  The thread handle, with THREAD_GET_CONTEXT access. </param>
+        ///<param name="context"> Receives the registers. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS stack_unwinder::capture(HANDLE thread, unwind_context& context)
+        {
+            CONTEXT threadContext;
+            threadContext.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+
+            auto status = NtGetContextThread(thread, &threadContext);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            context.rip = threadContext.Rip;
+            memcpy(context.regs, &threadContext.Rax, sizeof(context.regs));
+            return STATUS_SUCCESS;
+        }
+    #endif
+
+        const stack_unwinder::loaded_module* stack_unwinder::find_module(uint64_t address) const
+        {
+            auto it = std::upper_bound(_modules.begin(), _modules.end(), address, [](uint64_t value, const loaded_module& loaded) {
+                return value < loaded.base;
+            });
+            if(it == _modules.begin())
+                return nullptr;
+
+            --it;
+            return address - it->base < it->size ? &*it : nullptr;
+        }
+
+        NTSTATUS stack_unwinder::step(stack_reader& stack, unwind_context& context, bool& machineFrame) const
+        {
+            auto& rsp = context.regs[REGISTER_RSP];
+            auto read = [&stack](uint64_t address, uint64_t& value) {
+                return stack.read(address, value);
+            };
+
+            auto loaded = find_module(context.rip);
+            auto rva = loaded ? static_cast<uint32_t>(context.rip - loaded->base) : 0;
+            auto entry = loaded ? loaded->module->get_functions().find(rva) : nullptr;
+
+            machineFrame = false;
+
+            //
+            // Leaf functions don't touch rsp or nonvolatile registers, and have no unwind info
+            //
+            if(!entry) {
+                if(!read(rsp, context.rip))
+                    return STATUS_PARTIAL_COPY;
+                rsp += 8;
+                return STATUS_SUCCESS;
+            }
+
+            auto& view = loaded->module->get_view();
+            auto prologOffset = rva - entry->begin;
+            auto unwindRva = entry->unwind;
+
+            for(int depth = 0; depth < MAX_UNWIND_CHAIN; depth++) {
+                auto header = view.at_rva<uint8_t>(unwindRva, 4);
+                if(!header)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+
+                uint8_t version = header[0] & 7;
+                uint8_t flags = header[0] >> 3;
+                uint8_t prologSize = header[1];
+                uint8_t count = header[2];
+                uint8_t frameRegister = header[3] & 0xF;
+                uint8_t frameOffset = header[3] >> 4;
+
+                auto codes = count ? view.at_rva<uint16_t>(unwindRva + 4, count) : nullptr;
+                if(count && !codes)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+
+                //
+                // Only the function rip is in can be in its prolog or an epilog, its callers
+                // (the chained entries) are past theirs
+                //
+                bool first = depth == 0;
+                bool inProlog = first && prologOffset < prologSize;
+                if(first && !inProlog && unwind_epilog(view, *entry, rva, frameRegister, context, read))
+                    return STATUS_SUCCESS;
+
+                //
+                // The frame register is only set once the prolog instruction setting it ran
+                //
+                uint64_t frame = rsp;
+                if(frameRegister) {
+                    bool established = !inProlog;
+                    for(uint8_t i = 0; !established && i < count; i++) {
+                        if(((codes[i] >> 8) & 0xF) == UWOP_SET_FPREG && (codes[i] & 0xFF) <= prologOffset)
+                            established = true;
+                    }
+                    if(established)
+                        frame = context.regs[frameRegister] - frameOffset * 16ull;
+                }
+
+                for(uint8_t i = 0; i < count;) {
+                    uint8_t codeOffset = codes[i] & 0xFF;
+                    uint8_t op = (codes[i] >> 8) & 0xF;
+                    uint8_t info = codes[i] >> 12;
+
+                    auto slots = get_code_slots(op, info, version);
+                    if(slots == 0 || i + slots > count)
+                        return STATUS_INVALID_IMAGE_FORMAT;
+
+                    //
+                    // Codes of prolog instructions that didn't run yet are skipped
+                    //
+                    if(inProlog && codeOffset > prologOffset) {
+                        i += slots;
+                        continue;
+                    }
+
+                    switch(op) {
+                    case UWOP_PUSH_NONVOL:
+                        if(!read(rsp, context.regs[info]))
+                            return STATUS_PARTIAL_COPY;
+                        rsp += 8;
+                        break;
+                    case UWOP_ALLOC_LARGE:
+                        rsp += info == 0 ? codes[i + 1] * 8ull : codes[i + 1] | (static_cast<uint64_t>(codes[i + 2]) << 16);
+                        break;
+                    case UWOP_ALLOC_SMALL:
+                        rsp += info * 8ull + 8;
+                        break;
+                    case UWOP_SET_FPREG:
+                        rsp = context.regs[frameRegister] - frameOffset * 16ull;
+                        break;
+                    case UWOP_SAVE_NONVOL:
+                        if(!read(frame + codes[i + 1] * 8ull, context.regs[info]))
+                            return STATUS_PARTIAL_COPY;
+                        break;
+                    case UWOP_SAVE_NONVOL_FAR:
+                        if(!read(frame + (codes[i + 1] | (static_cast<uint64_t>(codes[i + 2]) << 16)), context.regs[info]))
+                            return STATUS_PARTIAL_COPY;
+                        break;
+                    case UWOP_PUSH_MACHFRAME: {
+                        //
+                        // An interrupt or exception frame: rip, cs, eflags, rsp, ss, with an error code first if info is 1
+                        //
+                        uint64_t machine = rsp + (info ? 8 : 0);
+                        if(!read(machine, context.rip) || !read(machine + 24, rsp))
+                            return STATUS_PARTIAL_COPY;
+                        machineFrame = true;
+                        break;
+                    }
+                    default:
+                        //
+                        // Epilog descriptors, and XMM registers we don't track
+                        //
+                        break;
+                    }
+                    i += slots;
+                }
+
+                if(!(flags & UNWIND_FLAG_CHAININFO))
+                    break;
+
+                //
+                // The parent entry follows the unwind codes, which are padded to an even count
+                //
+                auto parent = view.at_rva<IMAGE_RUNTIME_FUNCTION_ENTRY>(unwindRva + 4 + ((count + 1u) & ~1u) * 2);
+                while(parent && (parent->UnwindData & RUNTIME_FUNCTION_INDIRECT))
+                    parent = depth++ < MAX_UNWIND_CHAIN ? view.at_rva<IMAGE_RUNTIME_FUNCTION_ENTRY>(parent->UnwindData & ~RUNTIME_FUNCTION_INDIRECT) : nullptr;
+                if(!parent)
+                    return STATUS_INVALID_IMAGE_FORMAT;
+                unwindRva = parent->UnwindData;
+            }
+
+            if(machineFrame)
+                return STATUS_SUCCESS;
+
+            if(!read(rsp, context.rip))
+                return STATUS_PARTIAL_COPY;
+            rsp += 8;
+            return STATUS_SUCCESS;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include <system/symbols/image_symbols.hpp>
+#include <system/function_table.hpp>
+#include <system/image_exports.hpp>
+#include <system/image_file_view.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct image_export
+        {
+            uint32_t    rva;
+            const char* name;       // nullptr for exports by ordinal only, points into the image_exports
+            uint32_t    ordinal;
+        };
+
+        static void read_exports(const image_exports& index, std::vector<image_export>& exports)
+        {
+            //
+            // A function exported under several names takes the first one in name order
+            //
+            auto& functions = index.get_functions();
+            std::vector<const char*> functionNames(functions.size(), nullptr);
+            for(size_t i = 0; i < index.get_name_count(); i++) {
+                auto function = index.get_name_function(i);
+                if(function < functionNames.size() && !functionNames[function])
+                    functionNames[function] = index.get_name(i);
+            }
+
+            //
+            // Forwarders and unused ordinals have no RVA
+            //
+            for(uint32_t i = 0; i < functions.size(); i++) {
+                if(functions[i].rva != 0)
+                    exports.push_back(image_export{functions[i].rva, functionNames[i], index.get_ordinal_base() + i});
+            }
+
+            std::sort(exports.begin(), exports.end(), [](const image_export& lhs, const image_export& rhs) {
+                return lhs.rva < rhs.rva;
+            });
+        }
+
+        static void add_function(symbol_table& table, const std::vector<image_export>& exports, uint32_t rva, uint32_t begin, uint32_t size)
+        {
+            char name[512];
+            int length;
+
+            auto it = std::upper_bound(exports.begin(), exports.end(), begin, [](uint32_t value, const image_export& exp) {
+                return value < exp.rva;
+            });
+
+            if(it == exports.begin()) {
+                length = sprintf_s(name, "sub_%X", begin);
+            } else {
+                --it;
+                if(it->rva == begin && it->name)
+                    length = sprintf_s(name, "%.480s", it->name);
+                else if(it->rva == begin)
+                    length = sprintf_s(name, "Ordinal%u", it->ordinal);
+                else if(it->name)
+                    length = sprintf_s(name, "%.480s+0x%X", it->name, begin - it->rva);
+                else
+                    length = sprintf_s(name, "Ordinal%u+0x%X", it->ordinal, begin - it->rva);
+            }
+
+            if(length > 0)
+                table.add(rva, size, name, static_cast<size_t>(length));
+        }
+
+        ///<summary>
+        /// Builds the table of an image file.
+        ///</summary>
+        ///<param name="path">  The image path. </param>
+        ///<param name="table"> The table, finalized on success. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_symbols::build(const std::wstring& path, symbol_table& table)
+        {
+            misc::mapped_file file;
+
+            auto status = file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+            return build(file.data(), file.size(), table);
+        }
+
+        ///<summary>
+        /// Builds the table of an image read in memory (file layout, not loaded).
+        ///</summary>
+        ///<param name="image"> The file contents. </param>
+        ///<param name="size">  The file size. </param>
+        ///<param name="table"> The table, finalized on success. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS image_symbols::build(const uint8_t* image, size_t size, symbol_table& table)
+        {
+            image_file_view view(image, size);
+
+            auto status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+
+            //
+            // The export names point into the index, which must outlive the table.add calls below
+            //
+            image_exports index;
+            std::vector<image_export> exports;
+            if(NT_SUCCESS(index.parse(view)))
+                read_exports(index, exports);
+
+            //
+            // Only x64 images have a function table we understand
+            //
+            function_table functions;
+            status = functions.parse(view);
+            if(NT_SUCCESS(status)) {
+                for(auto& function : functions.get_entries())
+                    add_function(table, exports, function.begin, function.primary, function.end - function.begin);
+            }
+
+            //
+            // Added last so that a function and an export at the same address keep the function's size
+            //
+            for(auto& exp : exports)
+                add_function(table, exports, exp.rva, exp.rva, 0);
+
+            table.finalize(view.get_image_size());
+            return STATUS_SUCCESS;
+        }
+    }
+}
@@ -0,0 +1,326 @@
+#include <system/symbols/line_table.hpp>
+
+#include <algorithm>
+
+#define PDB_INVALID_STREAM          0xFFFF
+#define PDB_STRING_TABLE_SIGNATURE  0xEFFEEFFE
+
+#define DEBUG_S_LINES               0xF2
+#define DEBUG_S_FILECHKSMS          0xF4
+#define CV_LINES_HAVE_COLUMNS       0x0001
+
+//
+// Line numbers the compiler uses for code that has no source line
+//
+#define CV_LINE_HIDDEN              0xFEEFEE
+#define CV_LINE_HIDDEN2             0xF00F00
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct string_table_header
+        {
+            uint32_t    signature;
+            uint32_t    version;
+            uint32_t    size;
+        };
+
+        struct c13_subsection_header
+        {
+            uint32_t    kind;
+            uint32_t    length;
+        };
+
+        struct c13_lines_header
+        {
+            uint32_t    offset;
+            uint16_t    segment;
+            uint16_t    flags;
+            uint32_t    code_size;
+        };
+
+        struct c13_file_block
+        {
+            uint32_t    file;       // Offset of the file in the checksums subsection
+            uint32_t    count;
+            uint32_t    size;       // Including this header
+        };
+
+        struct c13_line
+        {
+            uint32_t    offset;
+            uint32_t    flags;      // Line start:24, end delta:7, statement:1
+        };
+
+        struct c13_file_checksum
+        {
+            uint32_t    name;       // Offset in the /names string table
+            uint8_t     checksum_size;
+            uint8_t     checksum_kind;
+        };
+
+        line_table::line_table()
+        {
+        }
+
+        ///<summary>
+        /// Reads the C13 line information of every compiland of a PDB.
+        /// Any lines already in the table are dropped.
+        ///</summary>
+        ///<param name="pdb"> The PDB. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS line_table::build(pdb_file& pdb)
+        {
+            const uint8_t*  names;
+            uint32_t        namesSize;
+            uint32_t        namesStream;
+
+            clear();
+
+            //
+            // File names are stored once for the whole PDB, in the /names string table
+            //
+            if(!pdb.find_named_stream("/names", &namesStream) || !pdb.read_stream(namesStream, &names, &namesSize))
+                return STATUS_NOT_FOUND;
+
+            auto namesHeader = reinterpret_cast<const string_table_header*>(names);
+            if(namesSize < sizeof(string_table_header) || namesHeader->signature != PDB_STRING_TABLE_SIGNATURE ||
+               namesHeader->size > namesSize - sizeof(string_table_header))
+                return STATUS_FILE_CORRUPT_ERROR;
+
+            auto strings = reinterpret_cast<const char*>(names + sizeof(string_table_header));
+            auto stringsSize = namesHeader->size;
+
+            //
+            // Compilands share headers, so map /names offsets to files once for all of them
+            //
+            std::unordered_map<uint32_t, uint32_t> files;
+
+            for(auto& module : pdb.get_modules()) {
+                const uint8_t*  data;
+                uint32_t        size;
+
+                if(module.stream == PDB_INVALID_STREAM || module.c13_size == 0 || !pdb.read_stream(module.stream, &data, &size))
+                    continue;
+
+                uint64_t c13Offset = static_cast<uint64_t>(module.symbols_size) + module.c11_size;
+                if(c13Offset + module.c13_size > size)
+                    continue;
+
+                auto c13 = data + c13Offset;
+                auto c13End = c13 + module.c13_size;
+
+                //
+                // Line blocks refer to files by their offset in the checksums subsection, find it first
+                //
+                const uint8_t* checksums = nullptr;
+                uint32_t checksumsSize = 0;
+
+                for(auto p = c13; c13End - p >= static_cast<ptrdiff_t>(sizeof(c13_subsection_header)); ) {
+                    auto header = reinterpret_cast<const c13_subsection_header*>(p);
+                    if(header->length > static_cast<size_t>(c13End - p) - sizeof(c13_subsection_header))
+                        break;
+                    if(header->kind == DEBUG_S_FILECHKSMS) {
+                        checksums = p + sizeof(c13_subsection_header);
+                        checksumsSize = header->length;
+                        break;
+                    }
+                    p += sizeof(c13_subsection_header) + std::min<size_t>((header->length + 3) & ~3u, c13End - p - sizeof(c13_subsection_header));
+                }
+
+                if(!checksums)
+                    continue;
+
+                auto get_file = [&](uint32_t checksum, uint32_t* file) {
+                    if(checksum > checksumsSize || checksumsSize - checksum < sizeof(c13_file_checksum))
+                        return false;
+
+                    uint32_t name = reinterpret_cast<const c13_file_checksum*>(checksums + checksum)->name;
+                    if(name >= stringsSize)
+                        return false;
+
+                    auto it = files.find(name);
+                    if(it == files.end())
+                        it = files.emplace(name, add_file(strings + name, strnlen(strings + name, stringsSize - name))).first;
+                    *file = it->second;
+                    return true;
+                };
+
+                for(auto p = c13; c13End - p >= static_cast<ptrdiff_t>(sizeof(c13_subsection_header)); ) {
+                    auto header = reinterpret_cast<const c13_subsection_header*>(p);
+                    if(header->length > static_cast<size_t>(c13End - p) - sizeof(c13_subsection_header))
+                        break;
+
+                    auto subsection = p + sizeof(c13_subsection_header);
+                    auto subsectionEnd = subsection + header->length;
+                    p += sizeof(c13_subsection_header) + std::min<size_t>((header->length + 3) & ~3u, c13End - subsection);
+
+                    if(header->kind != DEBUG_S_LINES || header->length < sizeof(c13_lines_header))
+                        continue;
+
+                    auto lines = reinterpret_cast<const c13_lines_header*>(subsection);
+                    auto base = pdb.section_offset_to_rva(lines->segment, lines->offset);
+                    if(base == 0)
+                        continue;
+
+                    auto lineSize = sizeof(c13_line) + ((lines->flags & CV_LINES_HAVE_COLUMNS) ? sizeof(uint32_t) : 0);
+
+                    for(auto block = subsection + sizeof(c13_lines_header); subsectionEnd - block >= static_cast<ptrdiff_t>(sizeof(c13_file_block)); ) {
+                        auto fileBlock = reinterpret_cast<const c13_file_block*>(block);
+                        if(fileBlock->size < sizeof(c13_file_block) || fileBlock->size > static_cast<size_t>(subsectionEnd - block) ||
+                           fileBlock->count > (fileBlock->size - sizeof(c13_file_block)) / lineSize)
+                            break;
+
+                        uint32_t file;
+                        if(get_file(fileBlock->file, &file)) {
+                            auto entries = reinterpret_cast<const c13_line*>(fileBlock + 1);
+                            for(uint32_t i = 0; i < fileBlock->count; i++) {
+                                auto number = entries[i].flags & 0x00FFFFFF;
+                                if(number == 0 || number == CV_LINE_HIDDEN || number == CV_LINE_HIDDEN2)
+                                    continue;
+                                add(base + entries[i].offset, file, number);
+                            }
+                        }
+                        block += fileBlock->size;
+                    }
+
+                    //
+                    // Whatever follows the contribution isn't part of its last line
+                    //
+                    add(base + lines->code_size, 0, 0);
+                }
+            }
+
+            finalize();
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Interns a file name.
+        ///</summary>
+        ///<param name="name">   The name (UTF-8). </param>
+        ///<param name="length"> The name length. </param>
+        ///<returns>
+        /// The file index.
+        ///</returns>
+        uint32_t line_table::add_file(const char* name, size_t length)
+        {
+            auto inserted = _interned.emplace(std::string(name, length), static_cast<uint32_t>(_files.size()));
+            if(inserted.second) {
+                _files.push_back(static_cast<uint32_t>(_strings.size()));
+                _strings.insert(_strings.end(), name, name + length);
+                _strings.push_back('\0');
+            }
+            return inserted.first->second;
+        }
+
+        ///<summary>
+        /// Adds a line. Call finalize once all lines are added.
+        ///</summary>
+        ///<param name="rva">  The first byte of the line. </param>
+        ///<param name="file"> The file index, from add_file. </param>
+        ///<param name="line"> The line number, 0 to end the previous line there. </param>
+        void line_table::add(uint32_t rva, uint32_t file, uint32_t line)
+        {
+            _entries.push_back(line_table_entry{rva, line != 0 ? file : 0, line});
+        }
+
+        ///<summary>
+        /// Sorts the lines and drops redundant ones.
+        ///</summary>
+        void line_table::finalize()
+        {
+            //
+            // At a given RVA a real line wins over the end of the previous range
+            //
+            std::stable_sort(_entries.begin(), _entries.end(), [](const line_table_entry& lhs, const line_table_entry& rhs) {
+                if(lhs.rva != rhs.rva)
+                    return lhs.rva < rhs.rva;
+                return lhs.line != 0 && rhs.line == 0;
+            });
+
+            //
+            // Keep one entry per RVA, and only where the line actually changes
+            //
+            size_t kept = 0;
+            for(size_t i = 0; i < _entries.size(); i++) {
+                auto& entry = _entries[i];
+                if(kept != 0) {
+                    auto& last = _entries[kept - 1];
+                    if(last.rva == entry.rva || (last.line == entry.line && last.file == entry.file))
+                        continue;
+                }
+                if(kept == 0 && entry.line == 0)
+                    continue;
+                _entries[kept++] = entry;
+            }
+            _entries.resize(kept);
+            _entries.shrink_to_fit();
+
+            _files.shrink_to_fit();
+            _strings.shrink_to_fit();
+            _interned = std::unordered_map<std::string, uint32_t>();
+        }
+
+        ///<summary>
+        /// Gets the memory used by the table, in bytes.
+        ///</summary>
+        size_t line_table::get_memory_usage() const
+        {
+            return sizeof(*this) +
+                _entries.capacity() * sizeof(line_table_entry) +
+                _files.capacity() * sizeof(uint32_t) +
+                _strings.capacity();
+        }
+
+        ///<summary>
+        /// Finds the line containing an address.
+        ///</summary>
+        ///<param name="rva"> The RVA. </param>
+        ///<returns>
+        /// The line, nullptr if none.
+        ///</returns>
+        const line_table_entry* line_table::find(uint32_t rva) const
+        {
+            auto it = std::upper_bound(_entries.begin(), _entries.end(), rva, [](uint32_t value, const line_table_entry& entry) {
+                return value < entry.rva;
+            });
+            if(it == _entries.begin() || (--it)->line == 0)
+                return nullptr;
+            return &*it;
+        }
+
+        ///<summary>
+        /// Finds the lines of many addresses at once.
+        ///</summary>
+        ///<param name="rvas">    The RVAs, sorted in ascending order. </param>
+        ///<param name="count">   The number of RVAs. </param>
+        ///<param name="results"> Receives the lines (nullptr if none), in the same order as the RVAs. </param>
+        void line_table::find_sorted(const uint32_t* rvas, size_t count, const line_table_entry** results) const
+        {
+            auto first = _entries.begin();
+
+            for(size_t i = 0; i < count; i++) {
+                //
+                // Each search starts where the previous one stopped
+                //
+                first = std::upper_bound(first, _entries.end(), rvas[i], [](uint32_t value, const line_table_entry& entry) {
+                    return value < entry.rva;
+                });
+                auto it = first;
+                results[i] = it == _entries.begin() || (--it)->line == 0 ? nullptr : &*it;
+            }
+        }
+
+        void line_table::clear()
+        {
+            _entries = std::vector<line_table_entry>();
+            _files = std::vector<uint32_t>();
+            _strings = std::vector<char>();
+            _interned = std::unordered_map<std::string, uint32_t>();
+        }
+    }
+}
@@ -0,0 +1,873 @@
+#include <system/symbols/pdb_file.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#define MSF_INVALID_STREAM_SIZE     0xFFFFFFFF
+#define PDB_INFO_STREAM             1
+#define PDB_DBI_STREAM              3
+#define PDB_INVALID_STREAM          0xFFFF
+#define DBG_SECTION_HEADERS         5
+#define GSI_HASH_SIGNATURE          0xFFFFFFFF
+#define GSI_HASH_BUCKETS            4096
+
+#define S_LDATA32                   0x110C
+#define S_GDATA32                   0x110D
+#define S_PUB32                     0x110E
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_LTHREAD32                 0x1112
+#define S_GTHREAD32                 0x1113
+#define S_PROCREF                   0x1125
+#define S_LPROCREF                  0x1127
+#define S_LPROC32_ID                0x1146
+#define S_GPROC32_ID                0x1147
+
+namespace resurgence
+{
+    namespace system
+    {
+        static const char msf_magic[] = "Microsoft C/C++ MSF 7.00\r\n\x1A" "DS\0\0";
+
+    #pragma pack(push, 1)
+        struct msf_super_block
+        {
+            char        magic[32];
+            uint32_t    block_size;
+            uint32_t    free_block_map;
+            uint32_t    block_count;
+            uint32_t    directory_size;
+            uint32_t    reserved;
+            uint32_t    block_map;
+        };
+
+        struct pdb_info_header
+        {
+            uint32_t    version;
+            uint32_t    signature;
+            uint32_t    age;
+            GUID        guid;
+        };
+
+        struct dbi_header
+        {
+            int32_t     signature;
+            uint32_t    version;
+            uint32_t    age;
+            uint16_t    globals_stream;
+            uint16_t    build_number;
+            uint16_t    publics_stream;
+            uint16_t    dll_version;
+            uint16_t    records_stream;
+            uint16_t    dll_build;
+            int32_t     modules_size;
+            int32_t     contributions_size;
+            int32_t     section_map_size;
+            int32_t     source_info_size;
+            int32_t     type_server_map_size;
+            uint32_t    mfc_type_server;
+            int32_t     debug_header_size;
+            int32_t     ec_size;
+            uint16_t    flags;
+            uint16_t    machine;
+            uint32_t    reserved;
+        };
+
+        struct dbi_module_info
+        {
+            uint32_t    reserved1;
+            uint16_t    section;
+            uint16_t    padding1;
+            int32_t     offset;
+            int32_t     size;
+            uint32_t    characteristics;
+            uint16_t    module_index;
+            uint16_t    padding2;
+            uint32_t    data_crc;
+            uint32_t    reloc_crc;
+            uint16_t    flags;
+            uint16_t    stream;
+            uint32_t    symbols_size;
+            uint32_t    c11_size;
+            uint32_t    c13_size;
+            uint16_t    source_count;
+            uint16_t    padding3;
+            uint32_t    reserved2;
+            uint32_t    source_name;
+            uint32_t    pdb_path_name;
+            // char     module_name[];
+            // char     object_name[];
+        };
+
+        struct section_map_header
+        {
+            uint16_t    count;
+            uint16_t    log_count;
+        };
+
+        struct publics_header
+        {
+            uint32_t    hash_size;
+            uint32_t    address_map_size;
+            uint32_t    thunk_count;
+            uint32_t    thunk_size;
+            uint16_t    thunk_section;
+            uint16_t    padding;
+            uint32_t    thunk_offset;
+            uint32_t    section_count;
+        };
+
+        struct gsi_hash_header
+        {
+            uint32_t    signature;
+            uint32_t    version;
+            uint32_t    records_size;
+            uint32_t    buckets_size;
+        };
+
+        struct gsi_hash_record
+        {
+            int32_t     offset;     // Offset in the records stream plus one
+            int32_t     references;
+        };
+
+        struct record_header
+        {
+            uint16_t    length;     // Not counting this field
+            uint16_t    kind;
+        };
+
+        struct public_record
+        {
+            record_header   header;
+            uint32_t        flags;
+            uint32_t        offset;
+            uint16_t        segment;
+            // char         name[];
+        };
+
+        struct data_record
+        {
+            record_header   header;
+            uint32_t        type;
+            uint32_t        offset;
+            uint16_t        segment;
+            // char         name[];
+        };
+
+        struct procedure_reference_record
+        {
+            record_header   header;
+            uint32_t        checksum;
+            uint32_t        offset;     // Offset of the procedure in the module stream
+            uint16_t        module;     // 1-based
+            // char         name[];
+        };
+
+        struct procedure_record
+        {
+            record_header   header;
+            uint32_t        parent;
+            uint32_t        end;
+            uint32_t        next;
+            uint32_t        length;
+            uint32_t        debug_start;
+            uint32_t        debug_end;
+            uint32_t        type;
+            uint32_t        offset;
+            uint16_t        segment;
+            uint8_t         flags;
+            // char         name[];
+        };
+    #pragma pack(pop)
+
+        ///<summary>
+        /// The name hash used by the GSI hash tables (lhashPbCb).
+        ///</summary>
+        static uint32_t hash_name_v1(const char* name, size_t length)
+        {
+            uint32_t result = 0;
+            uint32_t value;
+            size_t   i = 0;
+
+            for(; i + 4 <= length; i += 4) {
+                memcpy(&value, name + i, 4);
+                result ^= value;
+            }
+            if(length - i >= 2) {
+                uint16_t half;
+                memcpy(&half, name + i, 2);
+                result ^= half;
+                i += 2;
+            }
+            if(length - i == 1)
+                result ^= static_cast<uint8_t>(name[i]);
+
+            result |= 0x20202020;
+            result ^= result >> 11;
+            return result ^ (result >> 16);
+        }
+
+        static bool symbol_less(const pdb_symbol& lhs, const pdb_symbol& rhs)
+        {
+            return lhs.rva < rhs.rva;
+        }
+
+        static uint32_t popcount(uint32_t value)
+        {
+            value = value - ((value >> 1) & 0x55555555);
+            value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+            return (((value + (value >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+        }
+
+        pdb_file::pdb_file()
+            : _blockSize(0), _age(0), _signature(0),
+            _machine(0), _globalsStream(PDB_INVALID_STREAM), _publicsStream(PDB_INVALID_STREAM),
+            _recordsStream(PDB_INVALID_STREAM), _sectionsStream(PDB_INVALID_STREAM)
+        {
+            memset(&_guid, 0, sizeof(_guid));
+            memset(&_publicsHash, 0, sizeof(_publicsHash));
+            memset(&_globalsHash, 0, sizeof(_globalsHash));
+        }
+
+        pdb_file::~pdb_file()
+        {
+        }
+
+        ///<summary>
+        /// Opens a PDB.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS pdb_file::open(const std::wstring& path)
+        {
+            if(is_open()) return STATUS_INVALID_DEVICE_STATE;
+
+            NTSTATUS status = _file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto base = _file.data();
+            auto size = _file.size();
+            auto super = reinterpret_cast<const msf_super_block*>(base);
+
+            if(size < sizeof(msf_super_block) || memcmp(super->magic, msf_magic, sizeof(super->magic)) != 0) {
+                _file.close();
+                return STATUS_INVALID_IMAGE_FORMAT;
+            }
+
+            _blockSize = super->block_size;
+
+            uint64_t directoryBlocks = (static_cast<uint64_t>(super->directory_size) + _blockSize - 1) / _blockSize;
+
+            if(_blockSize < 512 || (_blockSize & (_blockSize - 1)) != 0 ||
+               static_cast<uint64_t>(super->block_map) * _blockSize + directoryBlocks * sizeof(uint32_t) > size) {
+                _file.close();
+                return STATUS_FILE_CORRUPT_ERROR;
+            }
+
+            //
+            // The directory is scattered like any other stream, flatten it
+            //
+            auto blockMap = reinterpret_cast<const uint32_t*>(base + static_cast<size_t>(super->block_map) * _blockSize);
+
+            std::vector<uint8_t> directory(super->directory_size);
+            for(uint32_t i = 0, copied = 0; copied < super->directory_size; i++) {
+                auto chunk = std::min(_blockSize, super->directory_size - copied);
+                if(static_cast<uint64_t>(blockMap[i]) * _blockSize + chunk > size) {
+                    _file.close();
+                    return STATUS_FILE_CORRUPT_ERROR;
+                }
+                memcpy(directory.data() + copied, base + static_cast<size_t>(blockMap[i]) * _blockSize, chunk);
+                copied += chunk;
+            }
+
+            //
+            // { uint32 count; uint32 sizes[count]; uint32 blocks[count][] }
+            //
+            auto words = reinterpret_cast<const uint32_t*>(directory.data());
+            auto wordCount = directory.size() / sizeof(uint32_t);
+
+            if(wordCount == 0 || words[0] >= wordCount) {
+                _file.close();
+                return STATUS_FILE_CORRUPT_ERROR;
+            }
+
+            uint32_t streamCount = words[0];
+            size_t   next = 1 + streamCount;
+
+            _streamSizes.assign(words + 1, words + 1 + streamCount);
+            _streamBlocks.resize(streamCount);
+            _streams.resize(streamCount);
+
+            //
+            // The flattened directory is temporary, keep a copy of the block lists
+            //
+            _directoryBlocks.assign(words + next, words + wordCount);
+
+            size_t blockIndex = 0;
+            for(uint32_t i = 0; i < streamCount; i++) {
+                uint32_t streamSize = _streamSizes[i] == MSF_INVALID_STREAM_SIZE ? 0 : _streamSizes[i];
+                uint32_t count = static_cast<uint32_t>((static_cast<uint64_t>(streamSize) + _blockSize - 1) / _blockSize);
+
+                if(blockIndex + count > _directoryBlocks.size()) {
+                    _file.close();
+                    return STATUS_FILE_CORRUPT_ERROR;
+                }
+                _streamBlocks[i] = _directoryBlocks.data() + blockIndex;
+                blockIndex += count;
+            }
+
+            auto info = get_stream(PDB_INFO_STREAM);
+            if(info && info->size >= sizeof(pdb_info_header)) {
+                auto header = reinterpret_cast<const pdb_info_header*>(info->data);
+                _signature = header->signature;
+                _age = header->age;
+                _guid = header->guid;
+            }
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Gets the target machine (IMAGE_FILE_MACHINE_*).
+        ///</summary>
+        uint16_t pdb_file::get_machine()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+            return _machine;
+        }
+
+        ///<summary>
+        /// Gets the compilands.
+        ///</summary>
+        const std::vector<pdb_module>& pdb_file::get_modules()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+            return _modules;
+        }
+
+        ///<summary>
+        /// Gets the section map.
+        ///</summary>
+        const std::vector<pdb_section_map_entry>& pdb_file::get_section_map()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+            return _sectionMap;
+        }
+
+        ///<summary>
+        /// Gets the image section headers stored in the PDB.
+        ///</summary>
+        const std::vector<IMAGE_SECTION_HEADER>& pdb_file::get_sections()
+        {
+            std::call_once(_sectionsOnce, &pdb_file::load_sections, this);
+            return _sections;
+        }
+
+        ///<summary>
+        /// Gets the public symbols, sorted by RVA.
+        ///</summary>
+        const std::vector<pdb_symbol>& pdb_file::get_public_symbols()
+        {
+            std::call_once(_publicsOnce, &pdb_file::load_publics, this);
+            return _publics;
+        }
+
+        ///<summary>
+        /// Converts a section:offset pair to a RVA.
+        ///</summary>
+        ///<param name="segment"> The 1-based section index. </param>
+        ///<param name="offset">  The offset in the section. </param>
+        ///<returns>
+        /// The RVA, 0 if the section is unknown.
+        ///</returns>
+        uint32_t pdb_file::section_offset_to_rva(uint16_t segment, uint32_t offset)
+        {
+            std::call_once(_sectionsOnce, &pdb_file::load_sections, this);
+
+            if(segment == 0 || segment > _sections.size())
+                return 0;
+            return _sections[segment - 1].VirtualAddress + offset;
+        }
+
+        ///<summary>
+        /// Finds the public symbol containing an address.
+        ///</summary>
+        ///<param name="rva">          The RVA. </param>
+        ///<param name="symbol">       The returned symbol. </param>
+        ///<param name="displacement"> The distance between the symbol and the RVA. </param>
+        ///<returns>
+        /// True if a symbol precedes the RVA in its section.
+        ///</returns>
+        bool pdb_file::find_symbol_by_rva(uint32_t rva, pdb_symbol& symbol, uint32_t* displacement)
+        {
+            auto& publics = get_public_symbols();
+
+            auto it = std::upper_bound(publics.begin(), publics.end(), rva, [](uint32_t value, const pdb_symbol& entry) {
+                return value < entry.rva;
+            });
+            if(it == publics.begin())
+                return false;
+            --it;
+
+            //
+            // Don't let a symbol of a previous section claim the address
+            //
+            if(it->segment != 0 && it->segment <= _sections.size()) {
+                auto& header = _sections[it->segment - 1];
+                if(rva >= header.VirtualAddress + std::max(header.Misc.VirtualSize, header.SizeOfRawData))
+                    return false;
+            }
+
+            symbol = *it;
+            if(displacement)
+                *displacement = rva - it->rva;
+            return true;
+        }
+
+        ///<summary>
+        /// Finds a symbol by name.
+        ///</summary>
+        ///<param name="name">   The name, decorated as stored in the PDB. </param>
+        ///<param name="symbol"> The returned symbol. </param>
+        ///<returns>
+        /// True if found in the publics or globals.
+        ///</returns>
+        bool pdb_file::find_symbol_by_name(const std::string& name, pdb_symbol& symbol)
+        {
+            std::call_once(_publicsOnce, &pdb_file::load_publics, this);
+            if(find_in_hash_table(_publicsHash, name, symbol))
+                return true;
+
+            std::call_once(_globalsOnce, &pdb_file::load_globals, this);
+            return find_in_hash_table(_globalsHash, name, symbol);
+        }
+
+        ///<summary>
+        /// Reads a whole stream.
+        ///</summary>
+        ///<param name="index"> The stream index. </param>
+        ///<param name="data">  The returned data, valid as long as the pdb_file. </param>
+        ///<param name="size">  The returned size. </param>
+        ///<returns>
+        /// False if the stream doesn't exist.
+        ///</returns>
+        bool pdb_file::read_stream(uint32_t index, const uint8_t** data, uint32_t* size)
+        {
+            auto stream = get_stream(index);
+            if(!stream)
+                return false;
+
+            *data = stream->data;
+            *size = stream->size;
+            return true;
+        }
+
+        ///<summary>
+        /// Finds a named stream (e.g. /names) in the info stream.
+        ///</summary>
+        ///<param name="name">  The stream name. </param>
+        ///<param name="index"> The returned stream index. </param>
+        ///<returns>
+        /// True if found.
+        ///</returns>
+        bool pdb_file::find_named_stream(const char* name, uint32_t* index)
+        {
+            auto info = get_stream(PDB_INFO_STREAM);
+            if(!info || info->size < sizeof(pdb_info_header))
+                return false;
+
+            auto p = info->data + sizeof(pdb_info_header);
+            auto end = info->data + info->size;
+
+            auto read = [&](uint32_t* value) {
+                if(end - p < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+                    return false;
+                memcpy(value, p, sizeof(uint32_t));
+                p += sizeof(uint32_t);
+                return true;
+            };
+
+            //
+            // { uint32 size; char names[size]; uint32 count; uint32 capacity;
+            //   bit vector present; bit vector deleted; { uint32 name; uint32 stream }[count] }
+            //
+            uint32_t namesSize, count, capacity, words;
+            if(!read(&namesSize) || namesSize > static_cast<size_t>(end - p))
+                return false;
+
+            auto names = reinterpret_cast<const char*>(p);
+            p += namesSize;
+
+            if(!read(&count) || !read(&capacity))
+                return false;
+            for(int vector = 0; vector < 2; vector++) {
+                if(!read(&words) || words > static_cast<size_t>(end - p) / sizeof(uint32_t))
+                    return false;
+                p += words * sizeof(uint32_t);
+            }
+
+            auto length = strlen(name);
+            for(uint32_t i = 0; i < count; i++) {
+                uint32_t offset, stream;
+                if(!read(&offset) || !read(&stream))
+                    return false;
+                if(offset < namesSize && strnlen(names + offset, namesSize - offset) == length &&
+                   memcmp(names + offset, name, length) == 0) {
+                    *index = stream;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        ///<summary>
+        /// Gets the memory used by the PDB, in bytes: the streams copied out of the file
+        /// and the parsed tables. The mapped file itself isn't counted.
+        ///</summary>
+        size_t pdb_file::get_memory_usage()
+        {
+            std::lock_guard<std::mutex> lock(_streamLock);
+
+            size_t usage = sizeof(*this) +
+                (_streamSizes.capacity() + _directoryBlocks.capacity()) * sizeof(uint32_t) +
+                (_streamBlocks.capacity() + _streams.capacity()) * sizeof(void*) +
+                _modules.capacity() * sizeof(pdb_module) +
+                _sectionMap.capacity() * sizeof(pdb_section_map_entry) +
+                _sections.capacity() * sizeof(IMAGE_SECTION_HEADER) +
+                _publics.capacity() * sizeof(pdb_symbol);
+
+            for(auto& stream : _streams) {
+                if(stream)
+                    usage += sizeof(stream_view) + stream->copy.capacity();
+            }
+            return usage;
+        }
+
+        const pdb_file::stream_view* pdb_file::get_stream(uint32_t index)
+        {
+            if(index >= _streams.size() || _streamSizes[index] == MSF_INVALID_STREAM_SIZE)
+                return nullptr;
+
+            std::lock_guard<std::mutex> lock(_streamLock);
+
+            if(_streams[index])
+                return _streams[index].get();
+
+            auto base   = _file.data();
+            auto blocks = _streamBlocks[index];
+            auto size   = _streamSizes[index];
+            auto count  = (size + _blockSize - 1) / _blockSize;
+
+            for(uint32_t i = 0; i < count; i++) {
+                if((static_cast<uint64_t>(blocks[i]) + 1) * _blockSize > _file.size())
+                    return nullptr;
+            }
+
+            std::unique_ptr<stream_view> view(new stream_view());
+            view->size = size;
+
+            uint32_t i = 1;
+            while(i < count && blocks[i] == blocks[i - 1] + 1)
+                i++;
+
+            if(i >= count) {
+                view->data = base + static_cast<size_t>(blocks[0]) * _blockSize;
+            } else {
+                view->copy.resize(size);
+                for(i = 0; i < count; i++) {
+                    auto chunk = std::min(_blockSize, size - i * _blockSize);
+                    memcpy(view->copy.data() + i * _blockSize, base + static_cast<size_t>(blocks[i]) * _blockSize, chunk);
+                }
+                view->data = view->copy.data();
+            }
+
+            _streams[index] = std::move(view);
+            return _streams[index].get();
+        }
+
+        void pdb_file::load_dbi()
+        {
+            auto dbi = get_stream(PDB_DBI_STREAM);
+            if(!dbi || dbi->size < sizeof(dbi_header))
+                return;
+
+            auto header = reinterpret_cast<const dbi_header*>(dbi->data);
+
+            //
+            // The substreams follow the header in this order, each one must fit in what is left
+            //
+            const int32_t sizes[] = {
+                header->modules_size, header->contributions_size, header->section_map_size, header->source_info_size,
+                header->type_server_map_size, header->ec_size, header->debug_header_size
+            };
+
+            size_t total = sizeof(dbi_header);
+            for(auto size : sizes) {
+                if(size < 0 || static_cast<size_t>(size) > dbi->size - total)
+                    return;
+                total += size;
+            }
+
+            _machine        = header->machine;
+            _globalsStream  = header->globals_stream;
+            _publicsStream  = header->publics_stream;
+            _recordsStream  = header->records_stream;
+
+            auto modules = dbi->data + sizeof(dbi_header);
+            auto modulesEnd = modules + header->modules_size;
+
+            while(modules + sizeof(dbi_module_info) < modulesEnd) {
+                auto info = reinterpret_cast<const dbi_module_info*>(modules);
+                auto moduleName = reinterpret_cast<const char*>(info + 1);
+                auto nameLength = strnlen(moduleName, modulesEnd - reinterpret_cast<const uint8_t*>(moduleName));
+                if(reinterpret_cast<const uint8_t*>(moduleName + nameLength) >= modulesEnd)
+                    break;
+
+                auto objectName = moduleName + nameLength + 1;
+                auto objectLength = strnlen(objectName, modulesEnd - reinterpret_cast<const uint8_t*>(objectName));
+                if(reinterpret_cast<const uint8_t*>(objectName + objectLength) >= modulesEnd)
+                    break;
+
+                pdb_module module;
+                module.name.assign(moduleName, nameLength);
+                module.object_name.assign(objectName, objectLength);
+                module.stream       = info->stream;
+                module.symbols_size = info->symbols_size;
+                module.c11_size     = info->c11_size;
+                module.c13_size     = info->c13_size;
+                module.section      = info->section;
+                module.offset       = static_cast<uint32_t>(info->offset);
+                module.size         = static_cast<uint32_t>(info->size);
+                _modules.push_back(std::move(module));
+
+                auto next = reinterpret_cast<uintptr_t>(objectName + objectLength + 1) - reinterpret_cast<uintptr_t>(dbi->data);
+                modules = dbi->data + ((next + 3) & ~3);
+            }
+
+            auto sectionMap = dbi->data + sizeof(dbi_header) + header->modules_size + header->contributions_size;
+            if(header->section_map_size >= static_cast<int32_t>(sizeof(section_map_header))) {
+                auto mapHeader = reinterpret_cast<const section_map_header*>(sectionMap);
+                auto entries = reinterpret_cast<const pdb_section_map_entry*>(mapHeader + 1);
+                auto count = std::min<size_t>(mapHeader->count,
+                    (header->section_map_size - sizeof(section_map_header)) / sizeof(pdb_section_map_entry));
+                _sectionMap.assign(entries, entries + count);
+            }
+
+            //
+            // The optional debug header is an array of stream indices
+            //
+            auto debugHeader = dbi->data + total - header->debug_header_size;
+            if(header->debug_header_size >= static_cast<int32_t>((DBG_SECTION_HEADERS + 1) * sizeof(uint16_t)))
+                memcpy(&_sectionsStream, debugHeader + DBG_SECTION_HEADERS * sizeof(uint16_t), sizeof(uint16_t));
+        }
+
+        void pdb_file::load_sections()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+
+            auto stream = get_stream(_sectionsStream);
+            if(!stream)
+                return;
+
+            auto headers = reinterpret_cast<const IMAGE_SECTION_HEADER*>(stream->data);
+            _sections.assign(headers, headers + stream->size / sizeof(IMAGE_SECTION_HEADER));
+        }
+
+        void pdb_file::load_publics()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+            std::call_once(_sectionsOnce, &pdb_file::load_sections, this);
+
+            auto stream = get_stream(_publicsStream);
+            if(!stream || stream->size < sizeof(publics_header))
+                return;
+
+            auto header = reinterpret_cast<const publics_header*>(stream->data);
+            if(sizeof(publics_header) + static_cast<uint64_t>(header->hash_size) + header->address_map_size > stream->size)
+                return;
+
+            read_hash_table(stream->data + sizeof(publics_header), header->hash_size, _publicsHash);
+
+            //
+            // The address map is sorted by section:offset, which sorts by RVA
+            // as long as the sections are in order. Sort anyway to be safe.
+            //
+            auto addressMap = reinterpret_cast<const uint32_t*>(stream->data + sizeof(publics_header) + header->hash_size);
+            auto count = header->address_map_size / sizeof(uint32_t);
+
+            _publics.reserve(count);
+            for(size_t i = 0; i < count; i++) {
+                pdb_symbol symbol;
+                if(read_symbol_record(addressMap[i], symbol))
+                    _publics.push_back(symbol);
+            }
+
+            if(!std::is_sorted(_publics.begin(), _publics.end(), symbol_less))
+                std::stable_sort(_publics.begin(), _publics.end(), symbol_less);
+        }
+
+        void pdb_file::load_globals()
+        {
+            std::call_once(_dbiOnce, &pdb_file::load_dbi, this);
+
+            auto stream = get_stream(_globalsStream);
+            if(stream)
+                read_hash_table(stream->data, stream->size, _globalsHash);
+        }
+
+        bool pdb_file::read_hash_table(const uint8_t* data, uint32_t size, hash_table& table)
+        {
+            if(size < sizeof(gsi_hash_header))
+                return false;
+
+            auto header = reinterpret_cast<const gsi_hash_header*>(data);
+            if(header->signature != GSI_HASH_SIGNATURE ||
+               sizeof(gsi_hash_header) + static_cast<uint64_t>(header->records_size) + header->buckets_size > size)
+                return false;
+
+            const uint32_t bitmapWords = (GSI_HASH_BUCKETS + 32) / 32;
+
+            if(header->buckets_size < bitmapWords * sizeof(uint32_t))
+                return false;
+
+            table.records       = data + sizeof(gsi_hash_header);
+            table.record_count  = header->records_size / sizeof(gsi_hash_record);
+            table.bitmap        = reinterpret_cast<const uint32_t*>(table.records + header->records_size);
+            table.buckets       = table.bitmap + bitmapWords;
+            table.bucket_count  = (header->buckets_size - bitmapWords * sizeof(uint32_t)) / sizeof(uint32_t);
+            return true;
+        }
+
+        bool pdb_file::find_in_hash_table(const hash_table& table, const std::string& name, pdb_symbol& symbol)
+        {
+            if(!table.records)
+                return false;
+
+            uint32_t bucket = hash_name_v1(name.c_str(), name.size()) % GSI_HASH_BUCKETS;
+
+            if(!(table.bitmap[bucket / 32] & (1u << (bucket % 32))))
+                return false;
+
+            //
+            // Buckets are compressed: the chain of a bucket is found by counting
+            // the non empty buckets before it.
+            //
+            uint32_t compressed = 0;
+            for(uint32_t i = 0; i < bucket / 32; i++)
+                compressed += popcount(table.bitmap[i]);
+            compressed += popcount(table.bitmap[bucket / 32] & ((1u << (bucket % 32)) - 1));
+
+            if(compressed >= table.bucket_count)
+                return false;
+
+            //
+            // Chain offsets are expressed in 12 byte units (the in-memory record size of the writer)
+            //
+            uint32_t first = table.buckets[compressed] / 12;
+            uint32_t last = compressed + 1 < table.bucket_count ? table.buckets[compressed + 1] / 12 : table.record_count;
+
+            auto records = reinterpret_cast<const gsi_hash_record*>(table.records);
+
+            for(uint32_t i = first; i < last && i < table.record_count; i++) {
+                pdb_symbol candidate;
+                if(records[i].offset <= 0)
+                    continue;
+                if(!read_symbol_record(static_cast<uint32_t>(records[i].offset - 1), candidate))
+                    continue;
+                if(strcmp(candidate.name, name.c_str()) == 0) {
+                    symbol = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool pdb_file::read_symbol_record(uint32_t offset, pdb_symbol& symbol)
+        {
+            auto records = get_stream(_recordsStream);
+            if(!records || static_cast<uint64_t>(offset) + sizeof(record_header) > records->size)
+                return false;
+
+            auto header = reinterpret_cast<const record_header*>(records->data + offset);
+            auto end    = offset + sizeof(uint16_t) + header->length;
+            if(end > records->size || header->length < sizeof(uint16_t))
+                return false;
+
+            //
+            // Names are zero terminated inside the record
+            //
+            auto terminated = [&](const char* name) {
+                return memchr(name, 0, records->data + end - reinterpret_cast<const uint8_t*>(name)) != nullptr;
+            };
+
+            switch(header->kind) {
+                case S_PUB32:
+                {
+                    auto record = reinterpret_cast<const public_record*>(header);
+                    if(offset + sizeof(public_record) >= end || !terminated(reinterpret_cast<const char*>(record + 1)))
+                        return false;
+                    symbol.segment  = record->segment;
+                    symbol.offset   = record->offset;
+                    symbol.name     = reinterpret_cast<const char*>(record + 1);
+                    break;
+                }
+                case S_GDATA32:
+                case S_LDATA32:
+                case S_GTHREAD32:
+                case S_LTHREAD32:
+                {
+                    auto record = reinterpret_cast<const data_record*>(header);
+                    if(offset + sizeof(data_record) >= end || !terminated(reinterpret_cast<const char*>(record + 1)))
+                        return false;
+                    symbol.segment  = record->segment;
+                    symbol.offset   = record->offset;
+                    symbol.name     = reinterpret_cast<const char*>(record + 1);
+                    break;
+                }
+                case S_PROCREF:
+                case S_LPROCREF:
+                {
+                    auto record = reinterpret_cast<const procedure_reference_record*>(header);
+                    if(offset + sizeof(procedure_reference_record) >= end || !terminated(reinterpret_cast<const char*>(record + 1)))
+                        return false;
+                    if(!resolve_procedure(record->module, record->offset, symbol))
+                        return false;
+                    symbol.name = reinterpret_cast<const char*>(record + 1);
+                    break;
+                }
+                default:
+                    return false;
+            }
+
+            symbol.rva = section_offset_to_rva(symbol.segment, symbol.offset);
+            return true;
+        }
+
+        bool pdb_file::resolve_procedure(uint16_t module, uint32_t offset, pdb_symbol& symbol)
+        {
+            auto& modules = get_modules();
+            if(module == 0 || module > modules.size())
+                return false;
+
+            auto stream = get_stream(modules[module - 1].stream);
+            if(!stream || static_cast<uint64_t>(offset) + sizeof(procedure_record) > stream->size)
+                return false;
+
+            auto record = reinterpret_cast<const procedure_record*>(stream->data + offset);
+            switch(record->header.kind) {
+                case S_GPROC32:
+                case S_LPROC32:
+                case S_GPROC32_ID:
+                case S_LPROC32_ID:
+                    symbol.segment = record->segment;
+                    symbol.offset  = record->offset;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    }
+}
@@ -0,0 +1,246 @@
+#include <system/symbols/symbol_database.hpp>
+#include <system/symbols/symbol_system.hpp>
+#include <system/symbols/pdb_file.hpp>
+#include <system/image_debug_info.hpp>
+#include <misc/mapped_file.hpp>
+
+#include <algorithm>
+
+namespace resurgence
+{
+    namespace system
+    {
+        static std::wstring get_file_name(const std::wstring& path)
+        {
+            auto slash = path.find_last_of(L"\\/");
+            return slash != std::wstring::npos ? path.substr(slash + 1) : path;
+        }
+
+        symbol_database::symbol_database()
+        {
+        }
+
+        symbol_database::symbol_database(const std::wstring& directory)
+            : _directory(directory)
+        {
+        }
+
+        ///<summary>
+        /// Gets the path of a table.
+        ///</summary>
+        ///<param name="name"> The PDB or image file name. </param>
+        ///<param name="key">  The key. </param>
+        ///<returns>
+        /// The path.
+        ///</returns>
+        std::wstring symbol_database::get_path(const std::wstring& name, const symbol_key& key) const
+        {
+            return get_base_path(name, key) + (key.source == symbol_backend_dbghelp ? L".dbghelp.rsym" : L".publics.rsym");
+        }
+
+        ///<summary>
+        /// Gets the path of a type table.
+        ///</summary>
+        ///<param name="name"> The PDB or image file name. </param>
+        ///<param name="key">  The key. The source is ignored. </param>
+        ///<returns>
+        /// The path.
+        ///</returns>
+        std::wstring symbol_database::get_types_path(const std::wstring& name, const symbol_key& key) const
+        {
+            return get_base_path(name, key) + L".types.rtyp";
+        }
+
+        ///<summary>
+        /// Opens a saved table.
+        ///</summary>
+        ///<param name="name">  The PDB or image file name. </param>
+        ///<param name="key">   The key. </param>
+        ///<param name="table"> The table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::load(const std::wstring& name, const symbol_key& key, symbol_table& table) const
+        {
+            if(!is_enabled())
+                return STATUS_NOT_FOUND;
+            return table.open(get_path(name, key), key);
+        }
+
+        ///<summary>
+        /// Saves a finalized table.
+        ///</summary>
+        ///<param name="name">  The PDB or image file name. </param>
+        ///<param name="key">   The key. </param>
+        ///<param name="table"> The table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::store(const std::wstring& name, const symbol_key& key, const symbol_table& table) const
+        {
+            if(!is_enabled())
+                return STATUS_NOT_FOUND;
+            return table.save(get_path(name, key), key);
+        }
+
+        ///<summary>
+        /// Opens a saved type table.
+        ///</summary>
+        ///<param name="name">  The PDB or image file name. </param>
+        ///<param name="key">   The key. The source is ignored. </param>
+        ///<param name="types"> The type table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::load_types(const std::wstring& name, const symbol_key& key, type_table& types) const
+        {
+            if(!is_enabled())
+                return STATUS_NOT_FOUND;
+            return types.open(get_types_path(name, key), get_types_key(key));
+        }
+
+        ///<summary>
+        /// Saves a type table.
+        ///</summary>
+        ///<param name="name">  The PDB or image file name. </param>
+        ///<param name="key">   The key. The source is ignored. </param>
+        ///<param name="types"> The type table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::store_types(const std::wstring& name, const symbol_key& key, const type_table& types) const
+        {
+            if(!is_enabled())
+                return STATUS_NOT_FOUND;
+            return types.save(get_types_path(name, key), get_types_key(key));
+        }
+
+        ///<summary>
+        /// Builds and saves the tables of a PDB (its public symbols and types), without the image.
+        ///</summary>
+        ///<param name="pdbPath"> The PDB path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::build(const std::wstring& pdbPath) const
+        {
+            pdb_file        pdb;
+            symbol_table    table;
+            type_table      types;
+            symbol_key      key = {};
+
+            auto status = pdb.open(pdbPath);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            key.guid = pdb.get_guid();
+            key.age = pdb.get_age();
+            key.source = symbol_backend_pdb;
+
+            //
+            // Without the image, the last section tells where the last symbol ends
+            //
+            uint32_t limit = 0;
+            for(auto& section : pdb.get_sections())
+                limit = std::max<uint32_t>(limit, section.VirtualAddress + section.Misc.VirtualSize);
+
+            for(auto& symbol : pdb.get_public_symbols())
+                table.add(symbol.rva, 0, symbol.name, strlen(symbol.name));
+            table.finalize(limit);
+
+            status = store(get_file_name(pdbPath), key, table);
+
+            //
+            // PDBs stripped of their types still have publics, that's not an error
+            //
+            if(NT_SUCCESS(status) && NT_SUCCESS(types.build(pdb)))
+                status = store_types(get_file_name(pdbPath), key, types);
+            return status;
+        }
+
+        ///<summary>
+        /// Gets the key of an image file from its headers and CodeView record.
+        ///</summary>
+        ///<param name="imagePath"> The image path. </param>
+        ///<param name="name">      Receives the PDB file name, or the image file name when keyed by image. </param>
+        ///<param name="key">       Receives the key. The source is left 0. </param>
+        ///<param name="machine">   Optionally receives the image machine (IMAGE_FILE_MACHINE_*). </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_database::get_image_key(const std::wstring& imagePath, std::wstring& name, symbol_key& key, uint16_t* machine)
+        {
+            misc::mapped_file   file;
+            image_debug_info    debug;
+
+            auto status = file.open(imagePath);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            image_file_view view(file.data(), file.size());
+            status = view.parse_headers();
+            if(!NT_SUCCESS(status))
+                return status;
+
+            memset(&key, 0, sizeof(key));
+            key.timestamp = view.get_timestamp();
+            key.image_size = view.get_image_size();
+            name = get_file_name(imagePath);
+
+            if(machine)
+                *machine = view.get_machine();
+
+            //
+            // The record holds the path the linker wrote the PDB to, only its file name is kept.
+            // NB10 PDBs have no GUID, their images are keyed by timestamp and size.
+            //
+            if(NT_SUCCESS(debug.parse(view)) && debug.has_pdb() && debug.get_pdb_identity().signature == 0) {
+                auto pdbName = debug.get_pdb_name();
+                if(!pdbName.empty()) {
+                    name = std::move(pdbName);
+                    key.guid = debug.get_pdb_identity().guid;
+                    key.age = debug.get_pdb_identity().age;
+                    key.timestamp = 0;
+                    key.image_size = 0;
+                }
+            }
+            return STATUS_SUCCESS;
+        }
+
+        std::wstring symbol_database::get_base_path(const std::wstring& name, const symbol_key& key) const
+        {
+            wchar_t id[64];
+
+            //
+            // Same ids as a symbol store: GUID and age for PDBs, timestamp and size for images
+            //
+            if(key.timestamp == 0 && key.image_size == 0) {
+                swprintf_s(id, L"%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X",
+                    key.guid.Data1, key.guid.Data2, key.guid.Data3,
+                    key.guid.Data4[0], key.guid.Data4[1], key.guid.Data4[2], key.guid.Data4[3],
+                    key.guid.Data4[4], key.guid.Data4[5], key.guid.Data4[6], key.guid.Data4[7],
+                    key.age);
+            } else {
+                swprintf_s(id, L"%08X%X", key.timestamp, key.image_size);
+            }
+
+            std::wstring path = _directory;
+            if(!path.empty() && path.back() != L'\\' && path.back() != L'/')
+                path += L'\\';
+            path += name;
+            path += L'.';
+            path += id;
+            return path;
+        }
+
+        symbol_key symbol_database::get_types_key(const symbol_key& key) const
+        {
+            //
+            // Types come from the PDB whichever backend asked for them
+            //
+            auto typesKey = key;
+            typesKey.source = 0;
+            return typesKey;
+        }
+    }
+}
@@ -0,0 +1,252 @@
+#include <system/symbols/symbol_name_index.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+//
+// Below this many candidates the prefix range is checked as is, without looking at trigrams
+//
+#define SMALL_CANDIDATE_COUNT 256
+
+namespace resurgence
+{
+    namespace system
+    {
+        static unsigned char to_lower(char c)
+        {
+            return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c - 'A' + 'a') : static_cast<unsigned char>(c);
+        }
+
+        static bool is_wildcard(char c)
+        {
+            return c == '*' || c == '?';
+        }
+
+        static uint32_t make_trigram(const char* s)
+        {
+            return (to_lower(s[0]) << 16) | (to_lower(s[1]) << 8) | to_lower(s[2]);
+        }
+
+        static int compare_prefix(const char* name, const std::string& prefix)
+        {
+            //
+            // A shorter name stops at its terminator, which is lower than any prefix character
+            //
+            for(size_t i = 0; i < prefix.size(); i++) {
+                auto lhs = to_lower(name[i]);
+                auto rhs = to_lower(prefix[i]);
+                if(lhs != rhs)
+                    return lhs < rhs ? -1 : 1;
+            }
+            return 0;
+        }
+
+        symbol_name_index::symbol_name_index(const symbol_table& table)
+            : _table(table)
+        {
+        }
+
+        ///<summary>
+        /// Finds the symbols whose name matches a pattern.
+        ///</summary>
+        ///<param name="pattern"> The pattern (UTF-8). * matches any run of characters, ? any single one. </param>
+        ///<param name="matches"> Receives the indices of the matching symbols in the table. </param>
+        ///<remarks>
+        /// Safe to call from several threads.
+        ///</remarks>
+        void symbol_name_index::search(const std::string& pattern, std::vector<uint32_t>& matches)
+        {
+            matches.clear();
+            if(pattern.empty() || _table.empty())
+                return;
+
+            auto entries = _table.get_entries();
+            auto prefixLength = std::find_if(pattern.begin(), pattern.end(), is_wildcard) - pattern.begin();
+
+            const uint32_t* first = nullptr;
+            const uint32_t* last = nullptr;
+            size_t candidates = _table.size();
+
+            if(prefixLength != 0) {
+                std::call_once(_sortedOnce, &symbol_name_index::build_sorted, this);
+                find_prefix(pattern.substr(0, prefixLength), &first, &last);
+                candidates = last - first;
+            }
+
+            //
+            // Every trigram of the literal parts must appear in a matching name, so the
+            // shortest postings bound the candidates. Intersect them when that beats the range.
+            //
+            std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+            if(candidates > SMALL_CANDIDATE_COUNT) {
+                for(size_t i = 0; i + 3 <= pattern.size(); i++) {
+                    if(is_wildcard(pattern[i]) || is_wildcard(pattern[i + 1]) || is_wildcard(pattern[i + 2]))
+                        continue;
+
+                    std::call_once(_trigramsOnce, &symbol_name_index::build_trigrams, this);
+
+                    const uint32_t* postFirst;
+                    const uint32_t* postLast;
+                    if(!find_trigram(make_trigram(&pattern[i]), &postFirst, &postLast))
+                        return;
+                    lists.push_back(std::make_pair(postFirst, postLast));
+                }
+                std::sort(lists.begin(), lists.end(), [](const std::pair<const uint32_t*, const uint32_t*>& lhs, const std::pair<const uint32_t*, const uint32_t*>& rhs) {
+                    return lhs.second - lhs.first < rhs.second - rhs.first;
+                });
+            }
+
+            if(!lists.empty() && static_cast<size_t>(lists[0].second - lists[0].first) < candidates) {
+                std::vector<uint32_t> current(lists[0].first, lists[0].second);
+                std::vector<uint32_t> next;
+
+                for(size_t i = 1; i < lists.size() && current.size() > SMALL_CANDIDATE_COUNT; i++) {
+                    next.clear();
+                    std::set_intersection(current.begin(), current.end(), lists[i].first, lists[i].second, std::back_inserter(next));
+                    current.swap(next);
+                }
+
+                for(auto index : current) {
+                    if(match(pattern, _table.get_name(entries[index]), true))
+                        matches.push_back(index);
+                }
+            } else if(first) {
+                for(auto it = first; it != last; ++it) {
+                    if(match(pattern, _table.get_name(entries[*it]), true))
+                        matches.push_back(*it);
+                }
+            } else {
+                for(uint32_t index = 0; index < _table.size(); index++) {
+                    if(match(pattern, _table.get_name(entries[index]), true))
+                        matches.push_back(index);
+                }
+            }
+        }
+
+        ///<summary>
+        /// Matches a name against a pattern.
+        ///</summary>
+        ///<param name="pattern">    The pattern. * matches any run of characters, ? any single one. </param>
+        ///<param name="name">       The name. </param>
+        ///<param name="ignoreCase"> Whether ASCII case is ignored. </param>
+        ///<returns>
+        /// True if the name matches.
+        ///</returns>
+        bool symbol_name_index::match(const std::string& pattern, const char* name, bool ignoreCase)
+        {
+            auto p = pattern.c_str();
+            auto end = p + pattern.size();
+            const char* star = nullptr;
+            const char* resume = nullptr;
+
+            //
+            // On a mismatch, go back to the last * and let it swallow one more character
+            //
+            while(*name) {
+                if(p != end && *p == '*') {
+                    star = ++p;
+                    resume = name;
+                } else if(p != end && (*p == '?' || *p == *name || (ignoreCase && to_lower(*p) == to_lower(*name)))) {
+                    p++;
+                    name++;
+                } else if(star) {
+                    p = star;
+                    name = ++resume;
+                } else {
+                    return false;
+                }
+            }
+
+            while(p != end && *p == '*')
+                p++;
+            return p == end;
+        }
+
+        ///<summary>
+        /// Gets the memory used by the index, in bytes.
+        ///</summary>
+        ///<remarks>
+        /// Not safe to call while another thread searches for the first time.
+        ///</remarks>
+        size_t symbol_name_index::get_memory_usage() const
+        {
+            return sizeof(*this) +
+                (_sorted.capacity() + _trigrams.capacity() + _trigramOffsets.capacity() + _postings.capacity()) * sizeof(uint32_t);
+        }
+
+        void symbol_name_index::build_sorted()
+        {
+            auto entries = _table.get_entries();
+
+            _sorted.resize(_table.size());
+            for(uint32_t i = 0; i < _sorted.size(); i++)
+                _sorted[i] = i;
+
+            std::stable_sort(_sorted.begin(), _sorted.end(), [this, entries](uint32_t lhs, uint32_t rhs) {
+                auto a = _table.get_name(entries[lhs]);
+                auto b = _table.get_name(entries[rhs]);
+                while(*a && to_lower(*a) == to_lower(*b)) {
+                    a++;
+                    b++;
+                }
+                return to_lower(*a) < to_lower(*b);
+            });
+        }
+
+        void symbol_name_index::build_trigrams()
+        {
+            auto entries = _table.get_entries();
+
+            //
+            // (trigram, symbol) pairs, sorted and deduplicated, then split into postings
+            //
+            std::vector<uint64_t> pairs;
+            for(uint32_t index = 0; index < _table.size(); index++) {
+                auto name = _table.get_name(entries[index]);
+                auto length = strlen(name);
+                for(size_t i = 0; i + 3 <= length; i++)
+                    pairs.push_back((static_cast<uint64_t>(make_trigram(name + i)) << 32) | index);
+            }
+            std::sort(pairs.begin(), pairs.end());
+            pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+            _postings.reserve(pairs.size());
+            for(auto pair : pairs) {
+                auto trigram = static_cast<uint32_t>(pair >> 32);
+                if(_trigrams.empty() || _trigrams.back() != trigram) {
+                    _trigrams.push_back(trigram);
+                    _trigramOffsets.push_back(static_cast<uint32_t>(_postings.size()));
+                }
+                _postings.push_back(static_cast<uint32_t>(pair));
+            }
+            _trigramOffsets.push_back(static_cast<uint32_t>(_postings.size()));
+        }
+
+        void symbol_name_index::find_prefix(const std::string& prefix, const uint32_t** first, const uint32_t** last) const
+        {
+            auto entries = _table.get_entries();
+
+            auto lower = std::partition_point(_sorted.data(), _sorted.data() + _sorted.size(), [&](uint32_t index) {
+                return compare_prefix(_table.get_name(entries[index]), prefix) < 0;
+            });
+            auto upper = std::partition_point(lower, _sorted.data() + _sorted.size(), [&](uint32_t index) {
+                return compare_prefix(_table.get_name(entries[index]), prefix) == 0;
+            });
+
+            *first = lower;
+            *last = upper;
+        }
+
+        bool symbol_name_index::find_trigram(uint32_t trigram, const uint32_t** first, const uint32_t** last) const
+        {
+            auto it = std::lower_bound(_trigrams.begin(), _trigrams.end(), trigram);
+            if(it == _trigrams.end() || *it != trigram)
+                return false;
+
+            auto i = it - _trigrams.begin();
+            *first = _postings.data() + _trigramOffsets[i];
+            *last = _postings.data() + _trigramOffsets[i + 1];
+            return true;
+        }
+    }
+}
@@ -0,0 +1,303 @@
+#include <system/symbols/symbol_service.hpp>
+#include <system/symbols/pdb_file.hpp>
+
+#include <algorithm>
+#include <cwctype>
+
+namespace resurgence
+{
+    namespace system
+    {
+        ///<summary>
+        /// Creates a service.
+        ///</summary>
+        ///<param name="shards"> The number of shards, rounded up to a power of two. </param>
+        symbol_service::symbol_service(size_t shards)
+            : _shardCount(1), _count(0)
+        {
+            while(_shardCount < shards)
+                _shardCount <<= 1;
+
+            _shards.reset(new shard[_shardCount]);
+            for(size_t i = 0; i < _shardCount; i++) {
+                _shards[i].current.store(nullptr, std::memory_order_relaxed);
+                _shards[i].count = 0;
+            }
+        }
+
+        symbol_service::~symbol_service()
+        {
+        }
+
+        ///<summary>
+        /// Gets the shared service.
+        ///</summary>
+        symbol_service& symbol_service::instance()
+        {
+            static symbol_service service;
+            return service;
+        }
+
+        ///<summary>
+        /// Sets a directory searched for PDBs before the module directory.
+        /// Only modules loaded afterwards are affected.
+        ///</summary>
+        ///<param name="path"> The directory. </param>
+        void symbol_service::set_search_path(const std::wstring& path)
+        {
+            std::lock_guard<std::mutex> lock(_settingsLock);
+            _searchPath = path;
+        }
+
+        ///<summary>
+        /// Sets the directory of the symbol database. Empty (the default) disables it.
+        /// Only modules loaded afterwards are affected.
+        ///</summary>
+        ///<param name="path"> The directory, it must exist. </param>
+        void symbol_service::set_database_path(const std::wstring& path)
+        {
+            std::lock_guard<std::mutex> lock(_settingsLock);
+            _database.set_directory(path);
+        }
+
+        ///<summary>
+        /// Gets the symbol table of a module, loading it the first time.
+        ///</summary>
+        ///<param name="module"> The module. </param>
+        ///<returns>
+        /// The table, nullptr if the module has no symbols. Valid as long as the service.
+        ///</returns>
+        const symbol_table* symbol_service::get_table(const process_module& module)
+        {
+            auto tables = get_tables(module);
+            return tables && !tables->table.empty() ? &tables->table : nullptr;
+        }
+
+        ///<summary>
+        /// Finds the symbol containing an address.
+        ///</summary>
+        ///<param name="module">       The module the address is in. </param>
+        ///<param name="address">      The address. </param>
+        ///<param name="displacement"> Receives the offset from the symbol, or from the module base if none. </param>
+        ///<returns>
+        /// The raw (UTF-8, possibly decorated) symbol name, nullptr if none.
+        ///</returns>
+        const char* symbol_service::find(const process_module& module, uintptr_t address, uint64_t* displacement)
+        {
+            return find(get_tables(module), module, address, displacement);
+        }
+
+        ///<summary>
+        /// Finds the symbols of many addresses of a module at once.
+        ///</summary>
+        ///<param name="module">    The module the addresses are in. </param>
+        ///<param name="addresses"> The addresses, sorted in ascending order. </param>
+        ///<param name="count">     The number of addresses. </param>
+        ///<param name="results">   Receives the symbols (nullptr if none), in the same order as the addresses. </param>
+        void symbol_service::find_sorted(const process_module& module, const uintptr_t* addresses, size_t count, const symbol_table_entry** results)
+        {
+            auto table = get_table(module);
+            if(!table) {
+                std::fill(results, results + count, nullptr);
+                return;
+            }
+
+            std::vector<uint32_t> rvas(count);
+            for(size_t i = 0; i < count; i++)
+                rvas[i] = static_cast<uint32_t>(addresses[i] - reinterpret_cast<uintptr_t>(module.get_base()));
+            table->find_sorted(rvas.data(), count, results);
+        }
+
+        ///<summary>
+        /// Formats an address as module!symbol+0x10 or module+0x10.
+        ///</summary>
+        ///<param name="module">  The module the address is in. </param>
+        ///<param name="address"> The address. </param>
+        ///<param name="out">     The string the name is appended to. </param>
+        void symbol_service::format(const process_module& module, uintptr_t address, std::wstring& out)
+        {
+            wchar_t     digits[20];
+            uint64_t    displacement;
+
+            auto tables = get_tables(module);
+            auto name = find(tables, module, address, &displacement);
+
+            out.append(module.get_name());
+            if(name) {
+                out.push_back(L'!');
+                symbol_system::append_name(name, tables->decorated, out);
+                if(displacement == 0)
+                    return;
+            }
+
+            size_t i = _countof(digits);
+            do {
+                digits[--i] = L"0123456789ABCDEF"[displacement & 0xF];
+                displacement >>= 4;
+            } while(displacement != 0);
+            out.append(L"+0x");
+            out.append(digits + i, _countof(digits) - i);
+        }
+
+        ///<summary>
+        /// Gets the symbol of an address as a symbol_info.
+        ///</summary>
+        ///<param name="proc">    The process the module belongs to. </param>
+        ///<param name="module">  The module the address is in. </param>
+        ///<param name="address"> The address. </param>
+        symbol_info symbol_service::get_symbol_info(process* proc, const process_module& module, uintptr_t address)
+        {
+            uint64_t displacement;
+
+            auto tables = get_tables(module);
+            auto name = find(tables, module, address, &displacement);
+            if(!name)
+                return symbol_info{proc, module, address, std::wstring(), 0};
+
+            std::wstring wide;
+            symbol_system::append_name(name, tables->decorated, wide);
+            return symbol_info{proc, module, address - displacement, wide, displacement};
+        }
+
+        size_t symbol_service::get_hash(const process_module& module)
+        {
+            //
+            // FNV-1a of the lower case path, then the size and the timestamp. A module
+            // rebuilt in place usually keeps its path and often its size, not its timestamp.
+            //
+            size_t hash = sizeof(size_t) == 8 ? static_cast<size_t>(14695981039346656037ull) : 2166136261u;
+            size_t prime = sizeof(size_t) == 8 ? static_cast<size_t>(1099511628211ull) : 16777619u;
+
+            for(auto c : module.get_path())
+                hash = (hash ^ static_cast<size_t>(towlower(c))) * prime;
+            hash = (hash ^ module.get_size()) * prime;
+            return (hash ^ module.get_timestamp()) * prime;
+        }
+
+        const symbol_service::module_tables* symbol_service::find_tables(const process_module& module, size_t hash) const
+        {
+            auto array = _shards[hash & (_shardCount - 1)].current.load(std::memory_order_acquire);
+            if(!array)
+                return nullptr;
+
+            //
+            // Slots are filled in probe order and never emptied, the first empty one ends the search
+            //
+            auto mask = array->capacity - 1;
+            for(size_t i = (hash / _shardCount) & mask, probes = 0; probes < array->capacity; i = (i + 1) & mask, probes++) {
+                auto tables = array->slots[i].load(std::memory_order_acquire);
+                if(!tables)
+                    return nullptr;
+                if(tables->hash == hash && tables->size == module.get_size() && tables->timestamp == module.get_timestamp() &&
+                   _wcsicmp(tables->path.c_str(), module.get_path().c_str()) == 0)
+                    return tables;
+            }
+            return nullptr;
+        }
+
+        const symbol_service::module_tables* symbol_service::load_tables(const process_module& module, size_t hash)
+        {
+            auto& target = _shards[hash & (_shardCount - 1)];
+
+            std::lock_guard<std::mutex> lock(target.lock);
+
+            //
+            // Another thread may have loaded it while we waited
+            //
+            auto found = find_tables(module, hash);
+            if(found)
+                return found;
+
+            std::wstring    searchPath;
+            symbol_database database;
+            {
+                std::lock_guard<std::mutex> settingsLock(_settingsLock);
+                searchPath = _searchPath;
+                database = _database;
+            }
+
+            std::unique_ptr<module_tables> tables(new module_tables());
+            tables->path = module.get_path();
+            tables->size = module.get_size();
+            tables->timestamp = module.get_timestamp();
+            tables->hash = hash;
+
+            //
+            // Modules without symbols get an empty table, so we don't go looking again for every address.
+            // The PDB is only opened when its table isn't in the database.
+            //
+            pdb_file pdb;
+            uint16_t machine = 0;
+
+            symbol_system::build_module_table(module, database, symbol_backend_pdb, tables->table, machine, [&](symbol_table& table) {
+                symbol_system::open_module_pdb(module, searchPath, pdb);
+                symbol_system::add_pdb_symbols(pdb, table);
+                if(pdb.is_open())
+                    machine = pdb.get_machine();
+                return pdb.is_open();
+            });
+            tables->decorated = machine == IMAGE_FILE_MACHINE_I386;
+
+            auto result = tables.get();
+            target.tables.push_back(std::move(tables));
+            publish(target, result);
+            _count.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+
+        const char* symbol_service::find(const module_tables* tables, const process_module& module, uintptr_t address, uint64_t* displacement)
+        {
+            auto rva = static_cast<uint32_t>(address - reinterpret_cast<uintptr_t>(module.get_base()));
+            auto symbol = tables ? tables->table.find(rva) : nullptr;
+
+            if(displacement)
+                *displacement = symbol ? rva - symbol->rva : rva;
+            return symbol ? tables->table.get_name(*symbol) : nullptr;
+        }
+
+        const symbol_service::module_tables* symbol_service::get_tables(const process_module& module)
+        {
+            if(!module.is_valid())
+                return nullptr;
+
+            auto hash = get_hash(module);
+            auto tables = find_tables(module, hash);
+            return tables ? tables : load_tables(module, hash);
+        }
+
+        void symbol_service::publish(shard& target, const module_tables* tables)
+        {
+            auto insert = [this](const slot_array* array, const module_tables* value) {
+                auto mask = array->capacity - 1;
+                auto i = (value->hash / _shardCount) & mask;
+                while(array->slots[i].load(std::memory_order_relaxed))
+                    i = (i + 1) & mask;
+                array->slots[i].store(value, std::memory_order_release);
+            };
+
+            target.count++;
+
+            //
+            // Up to half full the table goes in place. Past that readers get a bigger copy,
+            // the old array stays alive for those still probing it.
+            //
+            auto array = target.current.load(std::memory_order_relaxed);
+            if(array && target.count * 2 <= array->capacity) {
+                insert(array, tables);
+                return;
+            }
+
+            std::unique_ptr<slot_array> grown(new slot_array());
+            grown->capacity = array ? array->capacity * 2 : 16;
+            grown->slots.reset(new std::atomic<const module_tables*>[grown->capacity]);
+            for(size_t i = 0; i < grown->capacity; i++)
+                grown->slots[i].store(nullptr, std::memory_order_relaxed);
+
+            for(auto& existing : target.tables)
+                insert(grown.get(), existing.get());
+
+            target.current.store(grown.get(), std::memory_order_release);
+            target.arrays.push_back(std::move(grown));
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#include <system/symbols/symbol_store_index.hpp>
+#include <system/symbols/pdb_file.hpp>
+
+#include <algorithm>
+#include <cwctype>
+
+namespace resurgence
+{
+    namespace system
+    {
+        static std::wstring to_lower(const std::wstring& value)
+        {
+            std::wstring lower(value);
+            std::transform(lower.begin(), lower.end(), lower.begin(), towlower);
+            return lower;
+        }
+
+        static bool is_pdb_name(const wchar_t* name)
+        {
+            auto length = wcslen(name);
+            return length > 4 && _wcsicmp(name + length - 4, L".pdb") == 0;
+        }
+
+        static bool is_zero_guid(const GUID& guid)
+        {
+            static const GUID zero = {};
+            return memcmp(&guid, &zero, sizeof(guid)) == 0;
+        }
+
+        static bool parse_hex(const wchar_t* text, size_t length, uint32_t& value)
+        {
+            if(length == 0 || length > 8)
+                return false;
+
+            value = 0;
+            for(size_t i = 0; i < length; i++) {
+                auto c = text[i];
+                uint32_t digit;
+                if(c >= L'0' && c <= L'9')
+                    digit = c - L'0';
+                else if(c >= L'a' && c <= L'f')
+                    digit = c - L'a' + 10;
+                else if(c >= L'A' && c <= L'F')
+                    digit = c - L'A' + 10;
+                else
+                    return false;
+                value = (value << 4) | digit;
+            }
+            return true;
+        }
+
+        //
+        // Store directories are named after the GUID (32 digits) and age of RSDS PDBs,
+        // or the signature (8 digits) and age of NB10 PDBs, in hex
+        //
+        static bool parse_store_id(const wchar_t* id, pdb_identity& identity)
+        {
+            uint32_t value;
+            auto length = wcslen(id);
+
+            memset(&identity, 0, sizeof(identity));
+            if(length > 32) {
+                if(!parse_hex(id, 8, value))
+                    return false;
+                identity.guid.Data1 = value;
+                if(!parse_hex(id + 8, 4, value))
+                    return false;
+                identity.guid.Data2 = static_cast<uint16_t>(value);
+                if(!parse_hex(id + 12, 4, value))
+                    return false;
+                identity.guid.Data3 = static_cast<uint16_t>(value);
+                for(size_t i = 0; i < 8; i++) {
+                    if(!parse_hex(id + 16 + i * 2, 2, value))
+                        return false;
+                    identity.guid.Data4[i] = static_cast<uint8_t>(value);
+                }
+                return parse_hex(id + 32, length - 32, identity.age);
+            }
+            if(length > 8)
+                return parse_hex(id, 8, identity.signature) && parse_hex(id + 8, length - 8, identity.age);
+            return false;
+        }
+
+        template<typename _Fn>
+        static NTSTATUS enum_directory(const std::wstring& directory, _Fn callback)
+        {
+            WIN32_FIND_DATAW data;
+
+            auto find = FindFirstFileExW((directory + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+            if(find == INVALID_HANDLE_VALUE)
+                return STATUS_OBJECT_PATH_NOT_FOUND;
+
+            do {
+                if(wcscmp(data.cFileName, L".") != 0 && wcscmp(data.cFileName, L"..") != 0)
+                    callback(data);
+            } while(FindNextFileW(find, &data));
+
+            FindClose(find);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Gets the shared index, used by the symbol system and service to find PDBs.
+        ///</summary>
+        symbol_store_index& symbol_store_index::instance()
+        {
+            static symbol_store_index index;
+            return index;
+        }
+
+        ///<summary>
+        /// Adds the PDBs of a symbol store.
+        ///</summary>
+        ///<param name="root"> The store directory. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_store_index::add_store(const std::wstring& root)
+        {
+            //
+            // Two tier stores put every name.pdb directory under one named after its first two letters
+            //
+            bool twoTier = GetFileAttributesW((root + L"\\index2.txt").c_str()) != INVALID_FILE_ATTRIBUTES;
+
+            return enum_directory(root, [&](const WIN32_FIND_DATAW& data) {
+                if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                    return;
+
+                auto path = root + L"\\" + data.cFileName;
+                if(is_pdb_name(data.cFileName)) {
+                    add_store_entries(path, data.cFileName);
+                } else if(twoTier) {
+                    enum_directory(path, [&](const WIN32_FIND_DATAW& inner) {
+                        if((inner.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && is_pdb_name(inner.cFileName))
+                            add_store_entries(path + L"\\" + inner.cFileName, inner.cFileName);
+                    });
+                }
+            });
+        }
+
+        ///<summary>
+        /// Adds the PDBs of a directory, reading their headers. Subdirectories are ignored.
+        ///</summary>
+        ///<param name="directory"> The directory. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_store_index::add_directory(const std::wstring& directory)
+        {
+            return enum_directory(directory, [&](const WIN32_FIND_DATAW& data) {
+                if((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !is_pdb_name(data.cFileName))
+                    return;
+
+                pdb_file pdb;
+                auto path = directory + L"\\" + data.cFileName;
+                if(!NT_SUCCESS(pdb.open(path)))
+                    return;
+
+                pdb_identity identity;
+                identity.guid = pdb.get_guid();
+                identity.signature = is_zero_guid(identity.guid) ? pdb.get_signature() : 0;
+                identity.age = pdb.get_age();
+                add(data.cFileName, identity, std::move(path));
+            });
+        }
+
+        ///<summary>
+        /// Finds a PDB.
+        ///</summary>
+        ///<param name="name">     The PDB file name, case insensitive. </param>
+        ///<param name="identity"> The PDB identity. </param>
+        ///<returns>
+        /// The PDB path, nullptr if not indexed.
+        ///</returns>
+        const std::wstring* symbol_store_index::find(const std::wstring& name, const pdb_identity& identity) const
+        {
+            auto it = _entries.find(key{to_lower(name), identity});
+            return it != _entries.end() ? &it->second : nullptr;
+        }
+
+        ///<summary>
+        /// Finds the PDB of an image.
+        ///</summary>
+        ///<param name="debug"> The debug information of the image. </param>
+        ///<returns>
+        /// The PDB path, nullptr if the image has no CodeView record or its PDB isn't indexed.
+        ///</returns>
+        const std::wstring* symbol_store_index::find(const image_debug_info& debug) const
+        {
+            if(!debug.has_pdb() || _entries.empty())
+                return nullptr;
+            return find(debug.get_pdb_name(), debug.get_pdb_identity());
+        }
+
+        size_t symbol_store_index::key_hash::operator()(const key& value) const
+        {
+            uint32_t words[sizeof(pdb_identity) / sizeof(uint32_t)];
+            memcpy(words, &value.identity, sizeof(words));
+
+            auto hash = std::hash<std::wstring>()(value.name);
+            for(auto word : words)
+                hash = hash * 31 + word;
+            return hash;
+        }
+
+        bool symbol_store_index::key_equal::operator()(const key& lhs, const key& rhs) const
+        {
+            return memcmp(&lhs.identity, &rhs.identity, sizeof(pdb_identity)) == 0 && lhs.name == rhs.name;
+        }
+
+        void symbol_store_index::add(const std::wstring& name, const pdb_identity& identity, std::wstring path)
+        {
+            _entries.emplace(key{to_lower(name), identity}, std::move(path));
+        }
+
+        void symbol_store_index::add_store_entries(const std::wstring& directory, const std::wstring& name)
+        {
+            enum_directory(directory, [&](const WIN32_FIND_DATAW& data) {
+                pdb_identity identity;
+                if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !parse_store_id(data.cFileName, identity))
+                    return;
+
+                //
+                // Entries may only hold a compressed PDB (name.pd_) or a file.ptr, which we can't use
+                //
+                auto path = directory + L"\\" + data.cFileName + L"\\" + name;
+                auto attributes = GetFileAttributesW(path.c_str());
+                if(attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+                    add(name, identity, std::move(path));
+            });
+        }
+    }
+}
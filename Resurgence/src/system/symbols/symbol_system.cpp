@@ -1,8 +1,13 @@
 #include <system/symbols/symbol_system.hpp>
+#include <system/symbols/image_symbols.hpp>
+#include <system/symbols/symbol_store_index.hpp>
 #include <system/process.hpp>
 #include <misc/exceptions.hpp>
 #include <misc/native.hpp>
+#include <misc/thread_pool.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <DbgHelp.h>
 
@@ -19,6 +24,11 @@ namespace resurgence
         //std::vector<DWORD64>    symbol_system::s_LoadedModules;
         //std::mutex              symbol_system::s_LoadedModulesMutex;
 
+        symbol_info::symbol_info()
+            : _process(nullptr), _moduleBase(0), _address(0), _disp(0)
+        {
+        }
+
         symbol_info::symbol_info(process* proc, PSYMBOL_INFOW info, uintptr_t displacement)
         {
             _process = proc;
@@ -30,29 +40,38 @@ namespace resurgence
             }
             _address = info->Address;
             _disp = displacement;
-            build_name(info, displacement);
+            build_name(info->Name, info->NameLen, displacement);
         }
 
-        void symbol_info::build_name(PSYMBOL_INFOW info, uintptr_t displacement)
+        symbol_info::symbol_info(process* proc, const process_module& module, uint64_t address, const std::wstring& name, uint64_t displacement)
+        {
+            _process = proc;
+            _module = module;
+            _moduleBase = reinterpret_cast<uintptr_t>(_module.get_base());
+            _address = address;
+            _disp = displacement;
+            build_name(std::data(name), name.size(), displacement);
+        }
+
+        void symbol_info::build_name(const wchar_t* symbolName, size_t length, uint64_t displacement)
         {
             wchar_t buffer[1024];
-            auto module = _process->modules()->get_module_by_address(reinterpret_cast<uint8_t*>(info->Address));
-            auto moduleName = module.get_name();
+            auto moduleName = _module.get_name();
 
             if(moduleName.empty()) {
                 //
                 // We don't have a module name.
                 // Return an address;
                 //
-                swprintf_s(buffer, L"0x%llX", static_cast<uintptr_t>(info->Address));
+                swprintf_s(buffer, L"0x%llX", _address);
                 _name = buffer;
             } else {
-                if(info->NameLen == 0) {
+                if(length == 0) {
                     //
                     // We have a module name but not a symbol name.
                     // Return module+offset;
                     //
-                    swprintf_s(buffer, L"%ws+0x%lX", std::data(moduleName), static_cast<uint32_t>(info->Address - (uintptr_t)module.get_base()));
+                    swprintf_s(buffer, L"%ws+0x%lX", std::data(moduleName), static_cast<uint32_t>(_address - (uintptr_t)_module.get_base()));
                     _name = buffer;
                 } else {
                     //
@@ -60,23 +79,60 @@ namespace resurgence
                     // Return module!symbol+diplacement
                     //
                     if(displacement == 0) {
-                        swprintf_s(buffer, L"%ws!%s", std::data(moduleName), info->Name);
+                        swprintf_s(buffer, L"%ws!%.*s", std::data(moduleName), static_cast<int>(length), symbolName);
                     } else {
-                        swprintf_s(buffer, L"%ws!%s+0x%lX", std::data(moduleName), info->Name, static_cast<uint32_t>(displacement));
+                        swprintf_s(buffer, L"%ws!%.*s+0x%lX", std::data(moduleName), static_cast<int>(length), symbolName, static_cast<uint32_t>(displacement));
                     }
                     _name = buffer;
                 }
             }
         }
 
-        symbol_system::symbol_system(process* proc)
-            : _process(proc), _initialized(false), _symbolHandle(nullptr)
+        symbol_system::symbol_system(process* proc, symbol_backend backend)
+            : _process(proc), _backend(backend), _initialized(false), _symbolHandle(nullptr),
+            _cacheBudget(0), _cacheTick(0)
         {
+            memset(&_cacheStats, 0, sizeof(_cacheStats));
         }
         symbol_system::~symbol_system()
         {
             cleanup();
         }
+        symbol_system& symbol_system::operator=(symbol_system&& rhs)
+        {
+            if(this != &rhs) {
+                cleanup();
+
+                //
+                // Preload tasks hold on to the symbol_system that queued them
+                //
+                rhs.wait_for_preload();
+                _process        = rhs._process;
+                _backend        = rhs._backend;
+                _initialized    = rhs._initialized;
+                _symbolHandle   = rhs._symbolHandle;
+                _loadedModules  = std::move(rhs._loadedModules);
+                _searchPath     = std::move(rhs._searchPath);
+                _database       = std::move(rhs._database);
+                _modules        = std::move(rhs._modules);
+                _cacheBudget    = rhs._cacheBudget;
+                _cacheTick      = rhs._cacheTick;
+                _cacheStats     = rhs._cacheStats;
+                rhs._initialized = false;
+            }
+            return *this;
+        }
+        void symbol_system::set_backend(symbol_backend backend)
+        {
+            if(backend == _backend) return;
+
+            bool wasInitialized = _initialized;
+
+            cleanup();
+            _backend = backend;
+            if(wasInitialized)
+                initialize();
+        }
         bool symbol_system::is_initialized()
         {
             return _initialized;
@@ -86,6 +142,13 @@ namespace resurgence
             if(_initialized) {
                 cleanup();
             }
+            if(_backend == symbol_backend_pdb) {
+                //
+                // PDBs are opened on demand, there is nothing to set up
+                //
+                _initialized = true;
+                return;
+            }
             bool realHandle = false;
             if(!_process->is_system_idle_process()) {
                 static ACCESS_MASK accesses[] =
@@ -126,8 +189,17 @@ namespace resurgence
         }
         void symbol_system::cleanup()
         {
+            wait_for_preload();
+
             if(!_initialized) return;
 
+            _modules.clear();
+
+            if(_backend == symbol_backend_pdb) {
+                _initialized = false;
+                return;
+            }
+
             for(auto& module : _loadedModules) {
                 SymUnloadModule64(_symbolHandle, module);
             }
@@ -139,9 +211,18 @@ namespace resurgence
         {
             if(!_initialized) return 0;
 
-            auto module = _process->modules()->get_module_by_address(reinterpret_cast<uint8_t*>(address));
-            
+            auto entry = get_module_entry(address);
+            if(!entry) return 0;
+
+            auto result = _backend == symbol_backend_pdb ? static_cast<DWORD64>(entry->base) : entry->symbols->dbghelp_base;
+            trim_cache();
+            return result;
+        }
+        DWORD64 symbol_system::load_dbghelp_module(const process_module& module)
+        {
             if(module.get_base() != 0) {
+                std::lock_guard<std::mutex> lock(_dbghelpLock);
+
                 auto result = SymLoadModuleExW(
                     _symbolHandle,
                     NULL,
@@ -156,7 +237,7 @@ namespace resurgence
                     IMAGEHLP_MODULEW64 info;
                     info.SizeOfStruct = sizeof(info);
                     if(SymGetModuleInfoW64(_symbolHandle, result, &info)) {
-                        if(std::find(std::begin(_loadedModules), std::end(_loadedModules), result) != std::end(_loadedModules)) {
+                        if(std::find(std::begin(_loadedModules), std::end(_loadedModules), result) == std::end(_loadedModules)) {
                             _loadedModules.emplace_back(result);
                         }
                     } else {
@@ -169,6 +250,9 @@ namespace resurgence
         }
         symbol_info symbol_system::get_symbol_info_from_address(uintptr_t address)
         {
+            if(_backend == symbol_backend_pdb)
+                return get_pdb_symbol_from_address(address);
+
             DWORD64 displacement = 0;
             char buffer[sizeof(SYMBOL_INFOW) + MAX_SYM_NAME * sizeof(WCHAR)];
             ZeroMemory(buffer, sizeof(buffer));
@@ -178,6 +262,8 @@ namespace resurgence
             symbolBuffer->MaxNameLen = MAX_PATH;
 
             load_module_from_address(address);
+
+            std::lock_guard<std::mutex> lock(_dbghelpLock);
             if(!SymFromAddrW(_symbolHandle, address, &displacement, symbolBuffer))
                 symbolBuffer->Address = address;
 
@@ -185,6 +271,9 @@ namespace resurgence
         }
         symbol_info symbol_system::get_symbol_info_from_name(const std::wstring& name)
         {
+            if(_backend == symbol_backend_pdb)
+                return get_pdb_symbol_from_name(name);
+
             char buffer[sizeof(SYMBOL_INFOW) + MAX_SYM_NAME * sizeof(WCHAR)];
             ZeroMemory(buffer, sizeof(buffer));
             PSYMBOL_INFOW symbolBuffer = (PSYMBOL_INFOW)buffer;
@@ -192,9 +281,1100 @@ namespace resurgence
             symbolBuffer->SizeOfStruct = sizeof(SYMBOL_INFOW);
             symbolBuffer->MaxNameLen = MAX_PATH;
 
+            std::lock_guard<std::mutex> lock(_dbghelpLock);
             SymFromNameW(_symbolHandle, std::data(name), symbolBuffer);
 
             return symbol_info{_process, symbolBuffer, 0};
         }
+        std::vector<symbol_info> symbol_system::symbolize_sorted(const uintptr_t* addresses, size_t count)
+        {
+            std::vector<symbol_ref>  refs(count);
+            std::vector<symbol_info> results(count);
+
+            for(auto& group : group_by_module(addresses, count))
+                resolve_group(group.entry, addresses + group.first, group.count, nullptr, refs.data() + group.first);
+
+            for(size_t i = 0; i < count; i++)
+                results[i] = to_symbol_info(refs[i]);
+
+            trim_cache();
+            return results;
+        }
+
+        std::vector<symbol_info> symbol_system::symbolize(const uintptr_t* addresses, size_t count)
+        {
+            //
+            // The modules stay loaded until the end, the conversions below can't reload them concurrently
+            //
+            auto refs = resolve_batch(addresses, count);
+
+            std::vector<symbol_info> results(count);
+
+            misc::thread_pool::instance().parallel_for((count + 0x3FFF) / 0x4000, [&](size_t chunk) {
+                auto last = std::min(count, (chunk + 1) * 0x4000);
+                for(size_t i = chunk * 0x4000; i < last; i++)
+                    results[i] = to_symbol_info(refs[i]);
+            });
+
+            trim_cache();
+            return results;
+        }
+
+        symbol_ref symbol_system::resolve(uintptr_t address)
+        {
+            symbol_ref ref;
+            resolve_group(get_module_entry(address), &address, 1, nullptr, &ref);
+            trim_cache();
+            return ref;
+        }
+
+        std::vector<symbol_ref> symbol_system::resolve(const uintptr_t* addresses, size_t count)
+        {
+            auto results = resolve_batch(addresses, count);
+            trim_cache();
+            return results;
+        }
+
+        std::vector<symbol_ref> symbol_system::resolve_batch(const uintptr_t* addresses, size_t count)
+        {
+            //
+            // Big groups are split so a single hot module still spreads over the pool
+            //
+            const size_t chunkSize = 0x4000;
+
+            std::vector<symbol_ref>     results(count);
+            std::vector<size_t>         order(count);
+            std::vector<uintptr_t>      sorted(count);
+
+            for(size_t i = 0; i < count; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [addresses](size_t lhs, size_t rhs) {
+                return addresses[lhs] < addresses[rhs];
+            });
+            for(size_t i = 0; i < count; i++)
+                sorted[i] = addresses[order[i]];
+
+            //
+            // Module lookups touch the loader list and the module cache, keep them on this thread
+            //
+            auto groups = group_by_module(sorted.data(), count);
+            auto& pool = misc::thread_pool::instance();
+
+            std::vector<module_entry*> entries;
+            for(auto& group : groups) {
+                if(group.entry)
+                    entries.push_back(group.entry);
+            }
+            load_symbol_tables(entries);
+
+            std::vector<address_group> chunks;
+            for(auto& group : groups) {
+                for(size_t first = 0; first < group.count; first += chunkSize)
+                    chunks.push_back(address_group{group.entry, group.first + first, std::min(chunkSize, group.count - first)});
+            }
+
+            pool.parallel_for(chunks.size(), [&](size_t i) {
+                auto& chunk = chunks[i];
+                resolve_group(chunk.entry, sorted.data() + chunk.first, chunk.count, order.data() + chunk.first, results.data());
+            });
+            return results;
+        }
+
+        std::vector<symbol_match> symbol_system::search(const std::wstring& pattern, size_t maxResults)
+        {
+            std::vector<symbol_match> results;
+
+            auto length = WideCharToMultiByte(CP_UTF8, 0, pattern.c_str(), static_cast<int>(pattern.size()), nullptr, 0, nullptr, nullptr);
+            if(length <= 0)
+                return results;
+
+            std::string utf8(length, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, pattern.c_str(), static_cast<int>(pattern.size()), &utf8[0], length, nullptr, nullptr);
+
+            std::vector<module_entry*> entries;
+            for(auto& module : _process->modules()->get_all_modules()) {
+                auto entry = load_module_entry(module);
+                if(entry && std::find(entries.begin(), entries.end(), entry) == entries.end())
+                    entries.push_back(entry);
+            }
+            load_symbol_tables(entries);
+
+            //
+            // Each module is searched (and indexed, the first time) on its own thread
+            //
+            std::vector<std::vector<symbol_match>> found(entries.size());
+
+            misc::thread_pool::instance().parallel_for(entries.size(), [&](size_t i) {
+                auto entry = entries[i];
+                auto table = get_symbol_table(entry);
+                if(!table)
+                    return;
+
+                if(!entry->symbols->names)
+                    entry->symbols->names.reset(new symbol_name_index(*table));
+
+                std::vector<uint32_t> matches;
+                entry->symbols->names->search(utf8, matches);
+
+                for(auto index : matches) {
+                    auto name = table->get_name(table->get_entries()[index]);
+
+                    symbol_match match;
+                    match.symbol.module = entry->id;
+                    match.symbol.symbol = index;
+                    match.symbol.displacement = 0;
+                    if(strcmp(name, utf8.c_str()) == 0)
+                        match.rank = symbol_match_exact;
+                    else if(_stricmp(name, utf8.c_str()) == 0)
+                        match.rank = symbol_match_exact_ignore_case;
+                    else if(symbol_name_index::match(utf8, name, false))
+                        match.rank = symbol_match_pattern;
+                    else
+                        match.rank = symbol_match_pattern_ignore_case;
+                    match.length = static_cast<uint32_t>(strlen(name));
+                    found[i].push_back(match);
+                }
+            });
+
+            for(auto& matches : found)
+                results.insert(results.end(), matches.begin(), matches.end());
+
+            //
+            // Best rank first, then shorter names, then by module and address
+            //
+            auto better = [](const symbol_match& lhs, const symbol_match& rhs) {
+                if(lhs.rank != rhs.rank)
+                    return lhs.rank < rhs.rank;
+                if(lhs.length != rhs.length)
+                    return lhs.length < rhs.length;
+                if(lhs.symbol.module != rhs.symbol.module)
+                    return lhs.symbol.module < rhs.symbol.module;
+                return lhs.symbol.symbol < rhs.symbol.symbol;
+            };
+
+            if(maxResults != 0 && maxResults < results.size()) {
+                std::partial_sort(results.begin(), results.begin() + maxResults, results.end(), better);
+                results.resize(maxResults);
+            } else {
+                std::sort(results.begin(), results.end(), better);
+            }
+
+            trim_cache();
+            return results;
+        }
+
+        void symbol_system::format(const symbol_ref& ref, std::wstring& out)
+        {
+            wchar_t digits[20];
+
+            auto append_hex = [&](uint64_t value) {
+                size_t i = _countof(digits);
+                do {
+                    digits[--i] = L"0123456789ABCDEF"[value & 0xF];
+                    value >>= 4;
+                } while(value != 0);
+                out.append(L"0x");
+                out.append(digits + i, _countof(digits) - i);
+            };
+
+            if(!ref.has_module() || ref.module >= _modules.size()) {
+                append_hex(ref.displacement);
+                return;
+            }
+
+            module_entry* entry;
+            auto table = get_ref_table(ref, &entry);
+
+            out.append(entry->module.get_name());
+            if(table) {
+                out.push_back(L'!');
+                append_symbol_name(entry, table->get_name(table->get_entries()[ref.symbol]), out);
+                if(ref.displacement == 0)
+                    return;
+            }
+            out.push_back(L'+');
+            append_hex(ref.displacement);
+        }
+
+        uint64_t symbol_system::get_address(const symbol_ref& ref)
+        {
+            if(!ref.has_module() || ref.module >= _modules.size())
+                return ref.displacement;
+
+            module_entry* entry;
+            auto table = get_ref_table(ref, &entry);
+            if(!table)
+                return entry->base + ref.displacement;
+            return entry->base + table->get_entries()[ref.symbol].rva + ref.displacement;
+        }
+
+        const process_module* symbol_system::get_module(const symbol_ref& ref)
+        {
+            if(!ref.has_module() || ref.module >= _modules.size())
+                return nullptr;
+            return &_modules[ref.module]->module;
+        }
+
+        const char* symbol_system::get_symbol_name(const symbol_ref& ref)
+        {
+            if(!ref.has_module() || !ref.has_symbol() || ref.module >= _modules.size())
+                return nullptr;
+
+            module_entry* entry;
+            auto table = get_ref_table(ref, &entry);
+            return table ? table->get_name(table->get_entries()[ref.symbol]) : nullptr;
+        }
+
+        symbol_info symbol_system::to_symbol_info(const symbol_ref& ref)
+        {
+            if(!ref.has_module() || ref.module >= _modules.size())
+                return symbol_info{_process, process_module(), ref.displacement, std::wstring(), 0};
+
+            module_entry* entry;
+            auto table = get_ref_table(ref, &entry);
+            if(!table)
+                return symbol_info{_process, entry->module, entry->base + ref.displacement, std::wstring(), 0};
+
+            auto& symbol = table->get_entries()[ref.symbol];
+
+            std::wstring name;
+            append_symbol_name(entry, table->get_name(symbol), name);
+            return symbol_info{_process, entry->module, entry->base + symbol.rva, name, ref.displacement};
+        }
+
+        std::vector<symbol_system::address_group> symbol_system::group_by_module(const uintptr_t* addresses, size_t count)
+        {
+            std::vector<address_group> groups;
+
+            for(size_t i = 0; i < count; ) {
+                auto entry = get_module_entry(addresses[i]);
+
+                //
+                // Addresses are sorted, so the ones in a module follow each other
+                //
+                size_t last = i + 1;
+                if(entry) {
+                    while(last < count && addresses[last] - entry->base < entry->size)
+                        last++;
+                } else {
+                    while(last < count && addresses[last] == addresses[i])
+                        last++;
+                }
+                groups.push_back(address_group{entry, i, last - i});
+                i = last;
+            }
+            return groups;
+        }
+
+        void symbol_system::resolve_group(module_entry* entry, const uintptr_t* addresses, size_t count, const size_t* slots, symbol_ref* results)
+        {
+            std::vector<uint32_t>                   rvas(count);
+            std::vector<const symbol_table_entry*>  symbols(count, nullptr);
+
+            auto table = entry ? get_symbol_table(entry) : nullptr;
+            if(entry) {
+                for(size_t i = 0; i < count; i++)
+                    rvas[i] = static_cast<uint32_t>(addresses[i] - entry->base);
+            }
+            if(table)
+                table->find_sorted(rvas.data(), count, symbols.data());
+
+            auto first = table ? table->get_entries() : nullptr;
+
+            for(size_t i = 0; i < count; i++) {
+                auto& result = results[slots ? slots[i] : i];
+                if(symbols[i]) {
+                    result.module       = entry->id;
+                    result.symbol       = static_cast<uint32_t>(symbols[i] - first);
+                    result.displacement = rvas[i] - symbols[i]->rva;
+                } else if(entry) {
+                    result.module       = entry->id;
+                    result.symbol       = symbol_ref::invalid_id;
+                    result.displacement = rvas[i];
+                } else {
+                    result.module       = symbol_ref::invalid_id;
+                    result.symbol       = symbol_ref::invalid_id;
+                    result.displacement = addresses[i];
+                }
+            }
+        }
+
+        symbol_system::module_entry* symbol_system::get_module_entry(uintptr_t address)
+        {
+            //
+            // Try the modules we already know before walking the loader list
+            //
+            for(auto& entry : _modules) {
+                if(address >= entry->base && address - entry->base < entry->size) {
+                    acquire_module(entry.get());
+                    return entry.get();
+                }
+            }
+
+            auto module = _process->modules()->get_module_by_address(reinterpret_cast<uint8_t*>(address));
+            if(!module.is_valid())
+                return nullptr;
+            return load_module_entry(module);
+        }
+
+        symbol_system::module_entry* symbol_system::load_module_entry(const process_module& module, bool wait)
+        {
+            auto entry = find_module_entry(module);
+            if(!entry) return nullptr;
+
+            if(wait)
+                adopt_preload(entry, true);
+            acquire_module(entry);
+            return entry;
+        }
+
+        symbol_system::module_entry* symbol_system::find_module_entry(const process_module& module)
+        {
+            if(!module.is_valid()) return nullptr;
+
+            auto base = reinterpret_cast<uintptr_t>(module.get_base());
+
+            for(auto& entry : _modules) {
+                if(entry->base == base)
+                    return entry.get();
+            }
+
+            std::unique_ptr<module_entry> entry(new module_entry());
+            entry->id = static_cast<uint32_t>(_modules.size());
+            entry->module = module;
+            entry->base = base;
+            entry->size = module.get_size();
+            entry->last_used = 0;
+            entry->pins = 0;
+
+            //
+            // Modules without symbols are kept too, so we don't go looking again for every address
+            //
+            _modules.push_back(std::move(entry));
+            return _modules.back().get();
+        }
+
+        void symbol_system::acquire_module(module_entry* entry)
+        {
+            entry->last_used = ++_cacheTick;
+
+            if(entry->preload.valid() && !adopt_preload(entry, false)) {
+                //
+                // Still loading on the pool: answer from the module alone rather than wait
+                //
+                _cacheStats.fallbacks++;
+                if(!entry->symbols) {
+                    entry->symbols.reset(new module_symbols());
+                    entry->symbols->dbghelp_base = 0;
+                    entry->symbols->table_loaded = true;
+                    entry->symbols->types_loaded = false;
+                    entry->symbols->lines_loaded = false;
+                }
+                return;
+            }
+
+            if(entry->symbols) {
+                _cacheStats.hits++;
+                return;
+            }
+            _cacheStats.misses++;
+
+            entry->symbols = load_module_symbols(entry->module);
+        }
+
+        bool symbol_system::adopt_preload(module_entry* entry, bool wait)
+        {
+            if(!entry->preload.valid())
+                return false;
+
+            if(!wait && entry->preload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+            entry->preload.wait();
+            entry->preload = std::shared_future<bool>();
+
+            //
+            // Drop the placeholder lookups used meanwhile. A failed preload leaves nothing,
+            // the module is then loaded the usual way on its next use.
+            //
+            if(entry->symbols)
+                unload_module(entry);
+            entry->symbols = std::move(entry->preloaded);
+            return true;
+        }
+
+        std::unique_ptr<symbol_system::module_symbols> symbol_system::load_module_symbols(const process_module& module)
+        {
+            std::unique_ptr<module_symbols> symbols(new module_symbols());
+            symbols->dbghelp_base = 0;
+            symbols->pdb_opened = false;
+            symbols->machine = 0;
+            symbols->table_loaded = false;
+            symbols->types_loaded = false;
+            symbols->lines_loaded = false;
+
+            //
+            // The pdb backend opens the PDB on first use, tables found in the database don't need it
+            //
+            if(_backend == symbol_backend_dbghelp)
+                symbols->dbghelp_base = load_dbghelp_module(module);
+            return symbols;
+        }
+
+        void symbol_system::unload_module(module_entry* entry)
+        {
+            auto base = entry->symbols ? entry->symbols->dbghelp_base : 0;
+            if(base != 0) {
+                std::lock_guard<std::mutex> lock(_dbghelpLock);
+                SymUnloadModule64(_symbolHandle, base);
+                _loadedModules.erase(std::remove(_loadedModules.begin(), _loadedModules.end(), base), _loadedModules.end());
+            }
+            entry->symbols.reset();
+        }
+
+        size_t symbol_system::get_memory_usage(module_entry* entry)
+        {
+            auto symbols = entry->symbols.get();
+            if(!symbols)
+                return 0;
+
+            return sizeof(module_symbols) +
+                symbols->pdb.get_memory_usage() +
+                symbols->table.get_memory_usage() +
+                (symbols->names ? symbols->names->get_memory_usage() : 0) +
+                symbols->types.get_memory_usage() +
+                symbols->lines.get_memory_usage();
+        }
+
+        void symbol_system::trim_cache()
+        {
+            if(_cacheBudget == 0)
+                return;
+
+            size_t usage = 0;
+            std::vector<std::pair<uint64_t, module_entry*>> candidates;
+
+            for(auto& entry : _modules) {
+                //
+                // Finished preloads count against the budget from now on, whether used yet or not
+                //
+                adopt_preload(entry.get(), false);
+
+                if(!entry->symbols)
+                    continue;
+                auto size = get_memory_usage(entry.get());
+                usage += size;
+
+                //
+                // Pinned modules stay, and so does the one the last call used, its results point into it
+                //
+                if(entry->pins == 0 && entry->last_used != _cacheTick)
+                    candidates.push_back(std::make_pair(entry->last_used, entry.get()));
+            }
+            if(usage <= _cacheBudget)
+                return;
+
+            std::sort(candidates.begin(), candidates.end());
+
+            for(auto& candidate : candidates) {
+                if(usage <= _cacheBudget)
+                    break;
+                usage -= std::min(usage, get_memory_usage(candidate.second));
+                unload_module(candidate.second);
+                _cacheStats.evictions++;
+            }
+        }
+
+        const symbol_table* symbol_system::get_ref_table(const symbol_ref& ref, module_entry** entry)
+        {
+            *entry = _modules[ref.module].get();
+            if(!ref.has_symbol())
+                return nullptr;
+
+            //
+            // The module may have been evicted since the reference was made, its table reloads the same
+            //
+            if(!(*entry)->symbols)
+                acquire_module(*entry);
+
+            auto table = get_symbol_table(*entry);
+            return table && ref.symbol < table->size() ? table : nullptr;
+        }
+
+        void symbol_system::set_cache_budget(size_t bytes)
+        {
+            _cacheBudget = bytes;
+            trim_cache();
+        }
+
+        bool symbol_system::pin_module(const process_module& module)
+        {
+            auto entry = load_module_entry(module, true);
+            if(!entry)
+                return false;
+            entry->pins++;
+            return true;
+        }
+
+        void symbol_system::unpin_module(const process_module& module)
+        {
+            auto base = reinterpret_cast<uintptr_t>(module.get_base());
+
+            for(auto& entry : _modules) {
+                if(entry->base == base && entry->pins > 0) {
+                    entry->pins--;
+                    break;
+                }
+            }
+            trim_cache();
+        }
+
+        symbol_cache_stats symbol_system::get_cache_stats()
+        {
+            auto stats = _cacheStats;
+
+            stats.memory_usage = 0;
+            stats.budget = _cacheBudget;
+            stats.loaded_modules = 0;
+            stats.pinned_modules = 0;
+
+            for(auto& entry : _modules) {
+                if(entry->symbols) {
+                    stats.memory_usage += get_memory_usage(entry.get());
+                    stats.loaded_modules++;
+                }
+                if(entry->pins > 0)
+                    stats.pinned_modules++;
+            }
+            return stats;
+        }
+
+        void symbol_system::reset_cache_stats()
+        {
+            _cacheStats.hits = 0;
+            _cacheStats.misses = 0;
+            _cacheStats.evictions = 0;
+            _cacheStats.fallbacks = 0;
+        }
+
+        static std::shared_future<bool> make_ready_future(bool value)
+        {
+            std::promise<bool> promise;
+            promise.set_value(value);
+            return promise.get_future().share();
+        }
+
+        std::vector<std::shared_future<bool>> symbol_system::preload(const std::vector<process_module>& modules, const preload_callback& progress)
+        {
+            struct preload_state
+            {
+                std::atomic<size_t>     done;
+                size_t                  total;
+                preload_callback        progress;
+            };
+
+            std::vector<std::shared_future<bool>>           results(modules.size());
+            std::vector<std::pair<module_entry*, size_t>>   queued;     // Entry, index in modules
+
+            for(size_t i = 0; i < modules.size(); i++) {
+                auto entry = _initialized ? find_module_entry(modules[i]) : nullptr;
+
+                if(!entry) {
+                    results[i] = make_ready_future(false);
+                } else if(entry->preload.valid()) {
+                    results[i] = entry->preload;
+                } else if(entry->symbols && (entry->symbols->table_loaded || entry->pins > 0)) {
+                    //
+                    // Pinned modules are left alone, pointers into them must stay valid
+                    //
+                    results[i] = make_ready_future(entry->symbols->table_loaded ? !entry->symbols->table.empty() : true);
+                } else {
+                    queued.push_back(std::make_pair(entry, i));
+                }
+            }
+
+            //
+            // The pool starts tasks in the order they're queued: the main module goes first,
+            // then the modules used most recently, then the others as given
+            //
+            auto mainBase = reinterpret_cast<uintptr_t>(_process->modules()->get_main_module().get_base());
+
+            std::stable_sort(queued.begin(), queued.end(), [mainBase](const std::pair<module_entry*, size_t>& lhs, const std::pair<module_entry*, size_t>& rhs) {
+                bool lhsMain = lhs.first->base == mainBase;
+                bool rhsMain = rhs.first->base == mainBase;
+                if(lhsMain != rhsMain)
+                    return lhsMain;
+                return lhs.first->last_used > rhs.first->last_used;
+            });
+
+            auto state = std::make_shared<preload_state>();
+            state->done = 0;
+            state->total = queued.size();
+            state->progress = progress;
+
+            //
+            // The tasks get their own copies, these may change while they run
+            //
+            auto searchPath = _searchPath;
+            auto database = _database;
+
+            for(auto& item : queued) {
+                auto entry = item.first;
+
+                if(!entry->preload.valid()) {
+                    //
+                    // Whatever was loaded for the module is dropped, the task loads it all again
+                    //
+                    if(entry->symbols)
+                        unload_module(entry);
+
+                    auto module = entry->module;
+                    entry->preload = misc::thread_pool::instance().submit([this, entry, module, searchPath, database, state]() {
+                        bool loaded = false;
+                        try {
+                            auto symbols = load_module_symbols(module);
+                            build_symbol_table(module, searchPath, database, *symbols);
+                            symbols->table_loaded = true;
+                            loaded = !symbols->table.empty();
+                            entry->preloaded = std::move(symbols);
+                        } catch(...) {
+                            if(state->progress)
+                                state->progress(module, false, ++state->done, state->total);
+                            throw;
+                        }
+                        if(state->progress)
+                            state->progress(module, loaded, ++state->done, state->total);
+                        return loaded;
+                    }).share();
+                }
+                results[item.second] = entry->preload;
+            }
+            return results;
+        }
+
+        std::vector<std::shared_future<bool>> symbol_system::preload_all(const preload_callback& progress)
+        {
+            if(!_initialized)
+                return std::vector<std::shared_future<bool>>();
+            return preload(_process->modules()->get_all_modules(), progress);
+        }
+
+        void symbol_system::wait_for_preload()
+        {
+            for(auto& entry : _modules)
+                adopt_preload(entry.get(), true);
+            trim_cache();
+        }
+
+        void symbol_system::open_module_pdb(const process_module& module, const std::wstring& searchPath, pdb_file& pdb)
+        {
+            //
+            // A PDB indexed by identity is the right one for sure, try it first
+            //
+            auto& path = module.get_path();
+            auto& store = symbol_store_index::instance();
+            if(!store.empty()) {
+                image_debug_info debug;
+                if(NT_SUCCESS(debug.parse(path))) {
+                    auto found = store.find(debug);
+                    if(found && NT_SUCCESS(pdb.open(*found)))
+                        return;
+                }
+            }
+
+            //
+            // Look for <module>.pdb in the search path, then next to the module
+            //
+            auto name = module.get_name();
+            auto dot = name.find_last_of(L'.');
+            if(dot != std::wstring::npos)
+                name.resize(dot);
+            name += L".pdb";
+
+            std::vector<std::wstring> candidates;
+            if(!searchPath.empty())
+                candidates.push_back(searchPath + L"\\" + name);
+
+            auto slash = path.find_last_of(L"\\/");
+            if(slash != std::wstring::npos)
+                candidates.push_back(path.substr(0, slash + 1) + name);
+
+            for(auto& candidate : candidates) {
+                if(NT_SUCCESS(pdb.open(candidate)))
+                    break;
+            }
+        }
+
+        pdb_file& symbol_system::get_module_pdb(const process_module& module, const std::wstring& searchPath, module_symbols& symbols)
+        {
+            //
+            // Looked for once, a missing PDB isn't searched again until the module is reloaded
+            //
+            if(!symbols.pdb_opened) {
+                symbols.pdb_opened = true;
+                if(!symbols.pdb.is_open())
+                    open_module_pdb(module, searchPath, symbols.pdb);
+            }
+            return symbols.pdb;
+        }
+
+        static BOOL CALLBACK enum_symbols_callback(PSYMBOL_INFOW info, ULONG size, PVOID context)
+        {
+            auto table = static_cast<symbol_table*>(context);
+            char name[MAX_SYM_NAME * 3];
+
+            auto length = WideCharToMultiByte(CP_UTF8, 0, info->Name, static_cast<int>(info->NameLen), name, static_cast<int>(sizeof(name)), nullptr, nullptr);
+            if(length > 0)
+                table->add(static_cast<uint32_t>(info->Address - info->ModBase), size, name, length);
+            return TRUE;
+        }
+
+        void symbol_system::load_symbol_tables(const std::vector<module_entry*>& entries)
+        {
+            //
+            // dbghelp isn't thread safe, its tables are built on the calling thread
+            //
+            if(_backend == symbol_backend_pdb) {
+                misc::thread_pool::instance().parallel_for(entries.size(), [&](size_t i) {
+                    get_symbol_table(entries[i]);
+                });
+            } else {
+                for(auto entry : entries)
+                    get_symbol_table(entry);
+            }
+        }
+
+        const symbol_table* symbol_system::get_symbol_table(module_entry* entry)
+        {
+            if(entry->symbols->table_loaded)
+                return entry->symbols->table.empty() ? nullptr : &entry->symbols->table;
+
+            entry->symbols->table_loaded = true;
+            build_symbol_table(entry->module, _searchPath, _database, *entry->symbols);
+
+            return entry->symbols->table.empty() ? nullptr : &entry->symbols->table;
+        }
+
+        void symbol_system::build_symbol_table(const process_module& module, const std::wstring& searchPath, const symbol_database& database, module_symbols& symbols)
+        {
+            build_module_table(module, database, _backend, symbols.table, symbols.machine, [&](symbol_table& table) {
+                if(_backend == symbol_backend_pdb) {
+                    auto& pdb = get_module_pdb(module, searchPath, symbols);
+                    add_pdb_symbols(pdb, table);
+                    if(pdb.is_open())
+                        symbols.machine = pdb.get_machine();
+                    return pdb.is_open();
+                }
+
+                //
+                // Only what dbghelp read from a PDB is saved, its export symbols are rebuilt anyway
+                //
+                if(symbols.dbghelp_base == 0)
+                    return false;
+
+                IMAGEHLP_MODULEW64 info;
+                info.SizeOfStruct = sizeof(info);
+
+                std::lock_guard<std::mutex> lock(_dbghelpLock);
+                SymEnumSymbolsW(_symbolHandle, symbols.dbghelp_base, L"*", enum_symbols_callback, &table);
+                return SymGetModuleInfoW64(_symbolHandle, symbols.dbghelp_base, &info) && info.SymType != SymNone && info.SymType != SymExport;
+            });
+        }
+
+        void symbol_system::add_pdb_symbols(pdb_file& pdb, symbol_table& table)
+        {
+            if(pdb.is_open()) {
+                for(auto& symbol : pdb.get_public_symbols())
+                    table.add(symbol.rva, 0, symbol.name, strlen(symbol.name));
+            }
+        }
+
+        void symbol_system::build_module_table(const process_module& module, const symbol_database& database, symbol_backend source,
+                                               symbol_table& table, uint16_t& machine, const std::function<bool(symbol_table&)>& read)
+        {
+            //
+            // A saved table is used as is, without touching the PDB or dbghelp. The image
+            // tells the machine then, read() sets it from the PDB otherwise.
+            //
+            std::wstring    name;
+            symbol_key      key;
+            bool            keyed = false;
+
+            if(database.is_enabled() && NT_SUCCESS(symbol_database::get_image_key(module.get_path(), name, key, &machine))) {
+                key.source = source;
+                keyed = true;
+            }
+
+            if(!keyed || !NT_SUCCESS(database.load(name, key, table))) {
+                bool complete = read(table);
+
+                table.finalize(static_cast<uint32_t>(module.get_size()));
+
+                //
+                // Only symbols read from a PDB are saved. A module whose PDB wasn't found
+                // is looked up again next time, it may be there by then.
+                //
+                if(keyed && complete && !table.empty())
+                    database.store(name, key, table);
+            }
+
+            //
+            // No symbols at all, fall back to what the image itself tells (.pdata and exports).
+            // Neither these nor the empty table are saved, so the real symbols are picked up
+            // as soon as the PDB can be found.
+            //
+            if(table.empty()) {
+                machine = 0;
+                image_symbols::build(module.get_path(), table);
+            }
+        }
+
+        const type_table* symbol_system::get_type_table(const process_module& module)
+        {
+            if(!_initialized) return nullptr;
+
+            auto entry = load_module_entry(module, true);
+            if(!entry) return nullptr;
+
+            if(!entry->symbols->types_loaded) {
+                entry->symbols->types_loaded = true;
+
+                std::wstring    name;
+                symbol_key      key;
+                bool            keyed = _database.is_enabled() && NT_SUCCESS(symbol_database::get_image_key(module.get_path(), name, key));
+
+                if(!keyed || !NT_SUCCESS(_database.load_types(name, key, entry->symbols->types))) {
+                    //
+                    // Types are always read with pdb_file, whatever the backend
+                    //
+                    auto& pdb = get_module_pdb(entry->module, _searchPath, *entry->symbols);
+                    if(pdb.is_open() && NT_SUCCESS(entry->symbols->types.build(pdb)) && keyed)
+                        _database.store_types(name, key, entry->symbols->types);
+                }
+            }
+            auto result = entry->symbols->types.empty() ? nullptr : &entry->symbols->types;
+            trim_cache();
+            return result;
+        }
+
+        source_line symbol_system::get_line_from_address(uintptr_t address)
+        {
+            source_line result = { std::string(), 0, 0 };
+
+            auto entry = get_module_entry(address);
+            auto lines = entry ? load_line_table(entry) : nullptr;
+            if(!lines)
+                return result;
+
+            auto rva = static_cast<uint32_t>(address - entry->base);
+            auto found = lines->find(rva);
+            if(found) {
+                result.file = lines->get_file(found->file);
+                result.line = found->line;
+                result.displacement = rva - found->rva;
+            }
+            trim_cache();
+            return result;
+        }
+
+        std::vector<source_line> symbol_system::get_lines(const uintptr_t* addresses, size_t count)
+        {
+            std::vector<source_line>    results(count, source_line{ std::string(), 0, 0 });
+            std::vector<size_t>         order(count);
+            std::vector<uintptr_t>      sorted(count);
+
+            for(size_t i = 0; i < count; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [addresses](size_t lhs, size_t rhs) {
+                return addresses[lhs] < addresses[rhs];
+            });
+            for(size_t i = 0; i < count; i++)
+                sorted[i] = addresses[order[i]];
+
+            auto groups = group_by_module(sorted.data(), count);
+            auto& pool = misc::thread_pool::instance();
+
+            //
+            // dbghelp isn't thread safe, its lines are read on the calling thread
+            //
+            if(_backend == symbol_backend_pdb) {
+                pool.parallel_for(groups.size(), [&](size_t i) {
+                    if(groups[i].entry)
+                        load_line_table(groups[i].entry);
+                });
+            } else {
+                for(auto& group : groups) {
+                    if(group.entry)
+                        load_line_table(group.entry);
+                }
+            }
+
+            pool.parallel_for(groups.size(), [&](size_t i) {
+                auto& group = groups[i];
+                auto lines = group.entry ? load_line_table(group.entry) : nullptr;
+                if(!lines)
+                    return;
+
+                std::vector<uint32_t>                   rvas(group.count);
+                std::vector<const line_table_entry*>    found(group.count);
+
+                for(size_t j = 0; j < group.count; j++)
+                    rvas[j] = static_cast<uint32_t>(sorted[group.first + j] - group.entry->base);
+                lines->find_sorted(rvas.data(), group.count, found.data());
+
+                for(size_t j = 0; j < group.count; j++) {
+                    if(!found[j])
+                        continue;
+                    auto& result = results[order[group.first + j]];
+                    result.file = lines->get_file(found[j]->file);
+                    result.line = found[j]->line;
+                    result.displacement = rvas[j] - found[j]->rva;
+                }
+            });
+            trim_cache();
+            return results;
+        }
+
+        const line_table* symbol_system::get_line_table(const process_module& module)
+        {
+            auto entry = load_module_entry(module, true);
+            auto lines = entry ? load_line_table(entry) : nullptr;
+            trim_cache();
+            return lines;
+        }
+
+        struct enum_lines_context
+        {
+            line_table*     lines;
+            std::wstring    file;       // The last file seen, lines come grouped by file
+            uint32_t        index;
+        };
+
+        static BOOL CALLBACK enum_lines_callback(PSRCCODEINFOW info, PVOID context)
+        {
+            auto lines = static_cast<enum_lines_context*>(context);
+
+            if(lines->file.empty() || lines->file != info->FileName) {
+                char name[MAX_PATH * 3];
+
+                auto length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, -1, name, static_cast<int>(sizeof(name)), nullptr, nullptr);
+                if(length <= 1)
+                    return TRUE;
+
+                lines->file = info->FileName;
+                lines->index = lines->lines->add_file(name, length - 1);
+            }
+            lines->lines->add(static_cast<uint32_t>(info->Address - info->ModBase), lines->index, info->LineNumber);
+            return TRUE;
+        }
+
+        const line_table* symbol_system::load_line_table(module_entry* entry)
+        {
+            if(entry->symbols->lines_loaded)
+                return entry->symbols->lines.empty() ? nullptr : &entry->symbols->lines;
+
+            entry->symbols->lines_loaded = true;
+
+            if(_backend == symbol_backend_pdb) {
+                auto& pdb = get_module_pdb(entry->module, _searchPath, *entry->symbols);
+                if(pdb.is_open())
+                    entry->symbols->lines.build(pdb);
+            } else if(_initialized) {
+                enum_lines_context context = { &entry->symbols->lines, std::wstring(), 0 };
+                std::lock_guard<std::mutex> lock(_dbghelpLock);
+                SymEnumLinesW(_symbolHandle, entry->base, nullptr, nullptr, enum_lines_callback, &context);
+
+                //
+                // dbghelp doesn't say where a function's last line ends, stop the very last one at the end of the module
+                //
+                entry->symbols->lines.add(static_cast<uint32_t>(entry->size), 0, 0);
+                entry->symbols->lines.finalize();
+            }
+            return entry->symbols->lines.empty() ? nullptr : &entry->symbols->lines;
+        }
+
+        void symbol_system::append_symbol_name(module_entry* entry, const char* name, std::wstring& out)
+        {
+            append_name(name, _backend == symbol_backend_pdb && entry->symbols->machine == IMAGE_FILE_MACHINE_I386, out);
+        }
+
+        void symbol_system::append_name(const char* name, bool decorated, std::wstring& out)
+        {
+            size_t length = strlen(name);
+
+            //
+            // x86 C names in PDBs are decorated (_name, _name@8, @name@8)
+            //
+            if(decorated && length > 1 && (name[0] == '_' || name[0] == '@')) {
+                auto at = static_cast<const char*>(memchr(name + 1, '@', length - 1));
+                name++;
+                length = at ? static_cast<size_t>(at - name) : length - 1;
+            }
+
+            //
+            // Names are almost always ASCII, only call into the converter when they aren't
+            //
+            size_t ascii = 0;
+            while(ascii < length && static_cast<unsigned char>(name[ascii]) < 0x80)
+                ascii++;
+
+            out.append(name, name + ascii);
+            if(ascii == length)
+                return;
+
+            auto offset = out.size();
+            out.resize(offset + length - ascii);
+            auto count = MultiByteToWideChar(CP_UTF8, 0, name + ascii, static_cast<int>(length - ascii), &out[offset], static_cast<int>(length - ascii));
+            out.resize(offset + (count > 0 ? count : 0));
+        }
+
+        symbol_info symbol_system::get_pdb_symbol_from_address(uintptr_t address)
+        {
+            return to_symbol_info(resolve(address));
+        }
+
+        symbol_info symbol_system::get_pdb_symbol_from_name(const std::wstring& name)
+        {
+            //
+            // Accepts module!symbol or a bare symbol, searched in the PDBs loaded so far
+            //
+            auto separator = name.find(L'!');
+            auto symbolName = separator == std::wstring::npos ? name : name.substr(separator + 1);
+
+            std::vector<module_entry*> entries;
+            if(separator != std::wstring::npos) {
+                auto entry = load_module_entry(_process->modules()->get_module_by_name(name.substr(0, separator)));
+                if(entry)
+                    entries.push_back(entry);
+            } else {
+                for(auto& entry : _modules)
+                    entries.push_back(entry.get());
+            }
+
+            std::string narrow(WideCharToMultiByte(CP_UTF8, 0, std::data(symbolName), static_cast<int>(symbolName.size()), nullptr, 0, nullptr, nullptr), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, std::data(symbolName), static_cast<int>(symbolName.size()), &narrow[0], static_cast<int>(narrow.size()), nullptr, nullptr);
+
+            for(auto entry : entries) {
+                pdb_symbol symbol;
+
+                //
+                // Evicted modules are loaded again one at a time, so a lookup over all of them stays within the budget
+                //
+                acquire_module(entry);
+                auto& pdb = get_module_pdb(entry->module, _searchPath, *entry->symbols);
+                if(!pdb.is_open()) {
+                    trim_cache();
+                    continue;
+                }
+
+                bool found = pdb.find_symbol_by_name(narrow, symbol);
+                if(!found && pdb.get_machine() == IMAGE_FILE_MACHINE_I386)
+                    found = pdb.find_symbol_by_name("_" + narrow, symbol);
+
+                trim_cache();
+                if(found)
+                    return symbol_info{_process, entry->module, entry->base + symbol.rva, symbolName, 0};
+            }
+            return symbol_info{_process, process_module(), 0, std::wstring(), 0};
+        }
     }
 }
\ No newline at end of file
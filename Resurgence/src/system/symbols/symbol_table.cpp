@@ -0,0 +1,337 @@
+#include <system/symbols/symbol_table.hpp>
+#include <misc/native.hpp>
+
+#include <algorithm>
+#include <intrin.h>
+
+#define SYMBOL_FILE_MAGIC       0x4D595352  // "RSYM"
+#define SYMBOL_FILE_VERSION     1
+
+namespace resurgence
+{
+    namespace system
+    {
+        //
+        // Layout of a saved table. Every array starts on an 8 byte boundary so
+        // it can be used in place; keys and ranks hold count + 1 elements.
+        //
+        struct symbol_file_header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            symbol_key  key;
+            uint32_t    count;
+            uint32_t    names_size;
+            uint64_t    entries_offset;
+            uint64_t    keys_offset;
+            uint64_t    ranks_offset;
+            uint64_t    names_offset;
+            uint64_t    file_size;
+        };
+
+        static uint64_t align_file_offset(uint64_t offset)
+        {
+            return (offset + 7) & ~7ull;
+        }
+
+        static bool file_range_valid(const symbol_file_header* header, uint64_t offset, uint64_t length)
+        {
+            return (offset & 7) == 0 && offset >= sizeof(symbol_file_header) &&
+                offset <= header->file_size && length <= header->file_size - offset;
+        }
+
+        static bool entry_less(const symbol_table_entry& lhs, const symbol_table_entry& rhs)
+        {
+            return lhs.rva < rhs.rva;
+        }
+
+        symbol_table::symbol_table()
+            : _count(0), _namesSize(0), _entryData(nullptr), _nameData(nullptr), _keyData(nullptr), _rankData(nullptr)
+        {
+        }
+
+        ///<summary>
+        /// Adds a symbol. The table can't be searched until finalize is called.
+        ///</summary>
+        ///<param name="rva">    The symbol RVA. </param>
+        ///<param name="size">   The symbol size, 0 if unknown. </param>
+        ///<param name="name">   The symbol name (UTF-8). </param>
+        ///<param name="length"> The name length. </param>
+        void symbol_table::add(uint32_t rva, uint32_t size, const char* name, size_t length)
+        {
+            if(_file.is_open()) {
+                _file.close();
+                set_views();
+            }
+
+            auto inserted = _interned.emplace(std::string(name, length), static_cast<uint32_t>(_names.size()));
+            if(inserted.second) {
+                _names.insert(_names.end(), name, name + length);
+                _names.push_back('\0');
+            }
+            _entries.push_back(symbol_table_entry{rva, size, inserted.first->second});
+        }
+
+        ///<summary>
+        /// Sorts the symbols and builds the search tree.
+        ///</summary>
+        ///<param name="limit">
+        /// End of the address range covered by the table (usually the image size).
+        /// Symbols of unknown size end at the next symbol or at the limit.
+        ///</param>
+        void symbol_table::finalize(uint32_t limit)
+        {
+            if(_file.is_open())
+                return;
+
+            std::stable_sort(_entries.begin(), _entries.end(), entry_less);
+
+            //
+            // Aliases share an address, keep the first one added
+            //
+            _entries.erase(std::unique(_entries.begin(), _entries.end(), [](const symbol_table_entry& lhs, const symbol_table_entry& rhs) {
+                return lhs.rva == rhs.rva;
+            }), _entries.end());
+            _entries.shrink_to_fit();
+            _names.shrink_to_fit();
+            _interned = std::unordered_map<std::string, uint32_t>();
+
+            for(size_t i = 0; i < _entries.size(); i++) {
+                if(_entries[i].size != 0)
+                    continue;
+                uint32_t end = i + 1 < _entries.size() ? _entries[i + 1].rva : limit;
+                _entries[i].size = end > _entries[i].rva ? end - _entries[i].rva : 0;
+            }
+
+            _keys.assign(_entries.size() + 1, 0);
+            _ranks.assign(_entries.size() + 1, 0);
+
+            uint32_t next = 0;
+            build_tree(next, 1);
+
+            set_views();
+        }
+
+        ///<summary>
+        /// Opens a table saved with save. Any symbols already in the table are dropped.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<param name="key">  The key the table must have been saved with. </param>
+        ///<returns>
+        /// The status code. STATUS_OBJECT_TYPE_MISMATCH if the key doesn't match.
+        ///</returns>
+        NTSTATUS symbol_table::open(const std::wstring& path, const symbol_key& key)
+        {
+            _entries = std::vector<symbol_table_entry>();
+            _names = std::vector<char>();
+            _interned = std::unordered_map<std::string, uint32_t>();
+            _keys = std::vector<uint32_t>();
+            _ranks = std::vector<uint32_t>();
+            set_views();
+
+            auto status = _file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto header = reinterpret_cast<const symbol_file_header*>(_file.data());
+
+            if(_file.size() < sizeof(symbol_file_header) || header->magic != SYMBOL_FILE_MAGIC) {
+                status = STATUS_INVALID_IMAGE_FORMAT;
+            } else if(header->version != SYMBOL_FILE_VERSION) {
+                status = STATUS_REVISION_MISMATCH;
+            } else if(memcmp(&header->key, &key, sizeof(symbol_key)) != 0) {
+                status = STATUS_OBJECT_TYPE_MISMATCH;
+            } else if(header->file_size != _file.size() ||
+                !file_range_valid(header, header->entries_offset, header->count * static_cast<uint64_t>(sizeof(symbol_table_entry))) ||
+                !file_range_valid(header, header->keys_offset, (header->count + 1ull) * sizeof(uint32_t)) ||
+                !file_range_valid(header, header->ranks_offset, (header->count + 1ull) * sizeof(uint32_t)) ||
+                !file_range_valid(header, header->names_offset, header->names_size)) {
+                //
+                // Most likely a partially written file
+                //
+                status = STATUS_FILE_CORRUPT_ERROR;
+            }
+
+            if(!NT_SUCCESS(status)) {
+                _file.close();
+                return status;
+            }
+
+            _count = header->count;
+            _namesSize = header->names_size;
+            _entryData = reinterpret_cast<const symbol_table_entry*>(_file.data() + header->entries_offset);
+            _keyData = reinterpret_cast<const uint32_t*>(_file.data() + header->keys_offset);
+            _rankData = reinterpret_cast<const uint32_t*>(_file.data() + header->ranks_offset);
+            _nameData = reinterpret_cast<const char*>(_file.data() + header->names_offset);
+
+            //
+            // Names are only checked for a terminator at the end of the blob, get_name
+            // bounds the offsets and find bounds the ranks.
+            //
+            if(_namesSize != 0 && _nameData[_namesSize - 1] != '\0')
+                _namesSize = 0;
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Saves a finalized table.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<param name="key">  The key stored with the table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS symbol_table::save(const std::wstring& path, const symbol_key& key) const
+        {
+            symbol_file_header header = {};
+
+            header.magic = SYMBOL_FILE_MAGIC;
+            header.version = SYMBOL_FILE_VERSION;
+            header.key = key;
+            header.count = _count;
+            header.names_size = _namesSize;
+            header.entries_offset = align_file_offset(sizeof(symbol_file_header));
+            header.keys_offset = align_file_offset(header.entries_offset + _count * static_cast<uint64_t>(sizeof(symbol_table_entry)));
+            header.ranks_offset = align_file_offset(header.keys_offset + (_count + 1ull) * sizeof(uint32_t));
+            header.names_offset = align_file_offset(header.ranks_offset + (_count + 1ull) * sizeof(uint32_t));
+            header.file_size = header.names_offset + _namesSize;
+
+            if(header.file_size > MAXULONG)
+                return STATUS_FILE_TOO_LARGE;
+
+            std::vector<uint8_t> buffer(static_cast<size_t>(header.file_size), 0);
+            auto write = [&buffer](uint64_t offset, const void* data, size_t length) {
+                if(length != 0)
+                    memcpy(buffer.data() + offset, data, length);
+            };
+
+            //
+            // An empty table has no tree, it's saved as the single unused root slot
+            //
+            uint32_t emptyTree = 0;
+
+            write(0, &header, sizeof(header));
+            write(header.entries_offset, _entryData, _count * sizeof(symbol_table_entry));
+            write(header.keys_offset, _keyData ? _keyData : &emptyTree, (_count + 1) * sizeof(uint32_t));
+            write(header.ranks_offset, _rankData ? _rankData : &emptyTree, (_count + 1) * sizeof(uint32_t));
+            write(header.names_offset, _nameData, _namesSize);
+
+            return native::create_file(path, buffer.data(), buffer.size());
+        }
+
+        ///<summary>
+        /// Finds the symbol containing an address.
+        ///</summary>
+        ///<param name="rva"> The RVA. </param>
+        ///<returns>
+        /// The symbol, nullptr if none.
+        ///</returns>
+        const symbol_table_entry* symbol_table::find(uint32_t rva) const
+        {
+            uint32_t count = _count;
+            uint32_t k = 1;
+
+            if(count == 0)
+                return nullptr;
+
+            //
+            // Descend to the first key greater than rva, then undo the trailing
+            // right turns. k ends up 0 when every key is <= rva.
+            //
+            auto keys = _keyData;
+            while(k <= count) {
+                _mm_prefetch(reinterpret_cast<const char*>(keys + k * 16), _MM_HINT_T0);
+                k = 2 * k + (keys[k] <= rva);
+            }
+
+            unsigned long shift = 0;
+            _BitScanForward(&shift, ~k);
+            k >>= shift + 1;
+
+            uint32_t upper = k != 0 ? _rankData[k] : count;
+            if(upper == 0 || upper > count)
+                return nullptr;
+            return contains(upper - 1, rva);
+        }
+
+        ///<summary>
+        /// Gets the memory used by the table, in bytes, counting the mapped file if any.
+        ///</summary>
+        size_t symbol_table::get_memory_usage() const
+        {
+            return sizeof(*this) +
+                _entries.capacity() * sizeof(symbol_table_entry) +
+                _names.capacity() +
+                _keys.capacity() * sizeof(uint32_t) +
+                _ranks.capacity() * sizeof(uint32_t) +
+                _file.size();
+        }
+
+        ///<summary>
+        /// Finds the symbols of many addresses in a single pass.
+        ///</summary>
+        ///<param name="rvas">    The RVAs, sorted in ascending order. </param>
+        ///<param name="count">   The number of RVAs. </param>
+        ///<param name="results"> Receives the symbol of each RVA, nullptr if none. </param>
+        void symbol_table::find_sorted(const uint32_t* rvas, size_t count, const symbol_table_entry** results) const
+        {
+            auto first = _entryData;
+            auto last = first + _count;
+            auto current = first;
+
+            for(size_t i = 0; i < count; i++) {
+                uint32_t rva = rvas[i];
+
+                //
+                // Walk forward from the previous match. Sparse addresses gallop
+                // ahead and finish with a binary search, dense ones take a step or two.
+                //
+                if(current != last && current->rva <= rva) {
+                    size_t step = 1;
+                    auto probe = current;
+                    while(static_cast<size_t>(last - probe) > step && probe[step].rva <= rva) {
+                        probe += step;
+                        step *= 2;
+                    }
+                    auto bound = static_cast<size_t>(last - probe) > step ? probe + step + 1 : last;
+                    current = std::upper_bound(probe, bound, rva, [](uint32_t value, const symbol_table_entry& entry) {
+                        return value < entry.rva;
+                    });
+                }
+
+                results[i] = current != first ? contains(static_cast<uint32_t>(current - first - 1), rva) : nullptr;
+            }
+        }
+
+        void symbol_table::build_tree(uint32_t& next, uint32_t node)
+        {
+            //
+            // In-order walk of the implicit tree, filling it with the sorted keys
+            //
+            if(node >= _keys.size())
+                return;
+            build_tree(next, 2 * node);
+            _keys[node] = _entries[next].rva;
+            _ranks[node] = next++;
+            build_tree(next, 2 * node + 1);
+        }
+
+        void symbol_table::set_views()
+        {
+            _count = static_cast<uint32_t>(_entries.size());
+            _namesSize = static_cast<uint32_t>(_names.size());
+            _entryData = _entries.data();
+            _nameData = _names.data();
+            _keyData = _keys.empty() ? nullptr : _keys.data();
+            _rankData = _ranks.empty() ? nullptr : _ranks.data();
+        }
+
+        const symbol_table_entry* symbol_table::contains(uint32_t index, uint32_t rva) const
+        {
+            auto& entry = _entryData[index];
+            if(entry.size != 0 && rva - entry.rva >= entry.size)
+                return nullptr;
+            return &entry;
+        }
+    }
+}
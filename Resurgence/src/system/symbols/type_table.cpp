@@ -0,0 +1,999 @@
+#include <system/symbols/type_table.hpp>
+#include <misc/native.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+
+#define TYPE_FILE_MAGIC         0x50595452  // "RTYP"
+#define TYPE_FILE_VERSION       1
+
+#define PDB_TPI_STREAM          2
+#define TPI_FIRST_TYPE_INDEX    0x1000
+#define MAX_TYPE_DEPTH          16
+
+#define LF_MODIFIER             0x1001
+#define LF_POINTER              0x1002
+#define LF_PROCEDURE            0x1008
+#define LF_MFUNCTION            0x1009
+#define LF_FIELDLIST            0x1203
+#define LF_BITFIELD             0x1205
+#define LF_BCLASS               0x1400
+#define LF_VBCLASS              0x1401
+#define LF_IVBCLASS             0x1402
+#define LF_INDEX                0x1404
+#define LF_VFUNCTAB             0x1409
+#define LF_FRIENDCLS            0x140B
+#define LF_VFUNCOFF             0x140C
+#define LF_ENUMERATE            0x1502
+#define LF_ARRAY                0x1503
+#define LF_CLASS                0x1504
+#define LF_STRUCTURE            0x1505
+#define LF_UNION                0x1506
+#define LF_ENUM                 0x1507
+#define LF_FRIENDFCN            0x150C
+#define LF_MEMBER               0x150D
+#define LF_STMEMBER             0x150E
+#define LF_METHOD               0x150F
+#define LF_NESTTYPE             0x1510
+#define LF_ONEMETHOD            0x1511
+#define LF_NESTTYPEEX           0x1512
+#define LF_MEMBERMODIFY         0x1513
+#define LF_INTERFACE            0x1519
+#define LF_BINTERFACE           0x151A
+
+#define LF_NUMERIC              0x8000
+#define LF_CHAR                 0x8000
+#define LF_SHORT                0x8001
+#define LF_USHORT               0x8002
+#define LF_LONG                 0x8003
+#define LF_ULONG                0x8004
+#define LF_QUADWORD             0x8009
+#define LF_UQUADWORD            0x800A
+
+#define UDT_FORWARD_REF         0x0080
+#define UDT_HAS_UNIQUE_NAME     0x0200
+
+#define MTintro                 4
+#define MTpureintro             6
+
+namespace resurgence
+{
+    namespace system
+    {
+        struct tpi_header
+        {
+            uint32_t    version;
+            uint32_t    header_size;
+            uint32_t    type_index_begin;
+            uint32_t    type_index_end;
+            uint32_t    type_record_bytes;
+            uint16_t    hash_stream;
+            uint16_t    hash_aux_stream;
+            uint32_t    hash_key_size;
+            uint32_t    hash_bucket_count;
+            int32_t     hash_values_offset;
+            uint32_t    hash_values_length;
+            int32_t     index_offsets_offset;
+            uint32_t    index_offsets_length;
+            int32_t     hash_adj_offset;
+            uint32_t    hash_adj_length;
+        };
+
+        struct type_file_header
+        {
+            uint32_t    magic;
+            uint32_t    version;
+            symbol_key  key;
+            uint32_t    type_count;
+            uint32_t    field_count;
+            uint32_t    bucket_count;
+            uint32_t    strings_size;
+            uint64_t    types_offset;
+            uint64_t    fields_offset;
+            uint64_t    buckets_offset;
+            uint64_t    strings_offset;
+            uint64_t    file_size;
+        };
+
+        struct simple_type
+        {
+            uint8_t     kind;
+            uint8_t     size;
+            const char* name;
+        };
+
+        static const simple_type s_simpleTypes[] = {
+            { 0x03, 0,  "void" },           { 0x08, 4,  "HRESULT" },
+            { 0x10, 1,  "char" },           { 0x20, 1,  "unsigned char" },
+            { 0x70, 1,  "char" },           { 0x71, 2,  "wchar_t" },
+            { 0x7A, 2,  "char16_t" },       { 0x7B, 4,  "char32_t" },
+            { 0x7C, 1,  "char8_t" },
+            { 0x11, 2,  "short" },          { 0x21, 2,  "unsigned short" },
+            { 0x72, 2,  "short" },          { 0x73, 2,  "unsigned short" },
+            { 0x12, 4,  "long" },           { 0x22, 4,  "unsigned long" },
+            { 0x74, 4,  "int" },            { 0x75, 4,  "unsigned int" },
+            { 0x13, 8,  "__int64" },        { 0x23, 8,  "unsigned __int64" },
+            { 0x76, 8,  "__int64" },        { 0x77, 8,  "unsigned __int64" },
+            { 0x14, 16, "__int128" },       { 0x24, 16, "unsigned __int128" },
+            { 0x78, 16, "__int128" },       { 0x79, 16, "unsigned __int128" },
+            { 0x46, 2,  "half" },           { 0x40, 4,  "float" },
+            { 0x41, 8,  "double" },         { 0x42, 10, "long double" },
+            { 0x43, 16, "__float128" },
+            { 0x30, 1,  "bool" },           { 0x31, 2,  "bool16" },
+            { 0x32, 4,  "bool32" },         { 0x33, 8,  "bool64" },
+        };
+
+        static uint32_t hash_name(const char* name)
+        {
+            //
+            // FNV-1a
+            //
+            uint32_t hash = 2166136261u;
+            while(*name) {
+                hash ^= static_cast<uint8_t>(*name++);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        static bool is_unnamed(const char* name)
+        {
+            //
+            // Nested ones are scoped, e.g. _KTHREAD::<unnamed-tag>
+            //
+            return strstr(name, "<unnamed-") || strstr(name, "<anonymous-") || strstr(name, "__unnamed");
+        }
+
+        static bool file_range_valid(const type_file_header* header, uint64_t offset, uint64_t length)
+        {
+            return (offset & 7) == 0 && offset >= sizeof(type_file_header) &&
+                offset <= header->file_size && length <= header->file_size - offset;
+        }
+
+        //
+        // Bounds checked reads over a type record
+        //
+        class record_reader
+        {
+        public:
+            record_reader(const uint8_t* begin, const uint8_t* end)
+                : _p(begin), _end(end), _ok(true)
+            {
+            }
+
+            bool ok() const { return _ok; }
+            bool at_end() const { return _p >= _end; }
+            const uint8_t* position() const { return _p; }
+
+            uint8_t peek() const { return _p < _end ? *_p : 0; }
+
+            template<typename T>
+            T read()
+            {
+                T value = T();
+                if(_ok && static_cast<size_t>(_end - _p) >= sizeof(T)) {
+                    memcpy(&value, _p, sizeof(T));
+                    _p += sizeof(T);
+                } else {
+                    _ok = false;
+                }
+                return value;
+            }
+
+            uint64_t read_numeric()
+            {
+                auto leaf = read<uint16_t>();
+                if(leaf < LF_NUMERIC)
+                    return leaf;
+
+                switch(leaf) {
+                case LF_CHAR:       return static_cast<uint64_t>(static_cast<int64_t>(read<int8_t>()));
+                case LF_SHORT:      return static_cast<uint64_t>(static_cast<int64_t>(read<int16_t>()));
+                case LF_USHORT:     return read<uint16_t>();
+                case LF_LONG:       return static_cast<uint64_t>(static_cast<int64_t>(read<int32_t>()));
+                case LF_ULONG:      return read<uint32_t>();
+                case LF_QUADWORD:   return static_cast<uint64_t>(read<int64_t>());
+                case LF_UQUADWORD:  return read<uint64_t>();
+                default:
+                    _ok = false;
+                    return 0;
+                }
+            }
+
+            const char* read_name()
+            {
+                if(!_ok)
+                    return "";
+
+                auto terminator = static_cast<const uint8_t*>(memchr(_p, 0, _end - _p));
+                if(!terminator) {
+                    _ok = false;
+                    return "";
+                }
+
+                auto name = reinterpret_cast<const char*>(_p);
+                _p = terminator + 1;
+                return name;
+            }
+
+            void skip_padding()
+            {
+                //
+                // Field list members are aligned with LF_PAD0..LF_PAD15 bytes, the low nibble is the count
+                //
+                if(_p < _end && *_p >= 0xF0) {
+                    auto count = *_p & 0x0F;
+                    _p = count != 0 && count <= _end - _p ? _p + count : _p + 1;
+                }
+            }
+
+        private:
+            const uint8_t*  _p;
+            const uint8_t*  _end;
+            bool            _ok;
+        };
+
+        class tpi_reader
+        {
+        public:
+            bool open(const uint8_t* data, uint32_t size)
+            {
+                if(size < sizeof(tpi_header))
+                    return false;
+
+                auto header = reinterpret_cast<const tpi_header*>(data);
+                if(header->header_size < sizeof(tpi_header) || header->header_size > size ||
+                   header->type_index_begin > header->type_index_end)
+                    return false;
+
+                _data = data;
+                _first = header->type_index_begin;
+
+                uint32_t offset = header->header_size;
+                uint32_t end = header->type_record_bytes <= size - header->header_size ? header->header_size + header->type_record_bytes : size;
+
+                _offsets.reserve(header->type_index_end - header->type_index_begin);
+                while(end - offset >= 4) {
+                    uint16_t length;
+                    memcpy(&length, data + offset, sizeof(length));
+                    if(length < 2 || length > end - offset - 2)
+                        break;
+                    _offsets.push_back(offset);
+                    offset += 2 + length;
+                }
+                return true;
+            }
+
+            uint32_t first() const { return _first; }
+            uint32_t last() const { return _first + static_cast<uint32_t>(_offsets.size()); }
+
+            bool get_record(uint32_t index, uint16_t* kind, record_reader* reader) const
+            {
+                if(index < _first || index >= last())
+                    return false;
+
+                uint16_t length;
+                auto record = _data + _offsets[index - _first];
+                memcpy(&length, record, sizeof(length));
+                memcpy(kind, record + 2, sizeof(uint16_t));
+                *reader = record_reader(record + 4, record + 2 + length);
+                return true;
+            }
+
+        private:
+            const uint8_t*          _data;
+            uint32_t                _first;
+            std::vector<uint32_t>   _offsets;
+        };
+
+        struct udt_record
+        {
+            uint16_t    kind;
+            uint16_t    property;
+            uint32_t    field_list;
+            uint64_t    size;
+            const char* name;
+            const char* unique_name;
+        };
+
+        struct built_field
+        {
+            std::string     name;
+            std::string     type_name;
+            field_layout    layout;
+        };
+
+        class layout_builder
+        {
+        public:
+            layout_builder(const tpi_reader& reader)
+                : _reader(reader)
+            {
+            }
+
+            bool read_udt(uint32_t index, udt_record& udt) const
+            {
+                uint16_t        kind;
+                record_reader   reader(nullptr, nullptr);
+
+                if(!_reader.get_record(index, &kind, &reader))
+                    return false;
+                if(kind != LF_CLASS && kind != LF_STRUCTURE && kind != LF_INTERFACE && kind != LF_UNION)
+                    return false;
+
+                udt.kind = kind;
+                reader.read<uint16_t>();                // Member count
+                udt.property = reader.read<uint16_t>();
+                udt.field_list = reader.read<uint32_t>();
+                if(kind != LF_UNION) {
+                    reader.read<uint32_t>();            // Derived from
+                    reader.read<uint32_t>();            // VT shape
+                }
+                udt.size = reader.read_numeric();
+                udt.name = reader.read_name();
+                udt.unique_name = (udt.property & UDT_HAS_UNIQUE_NAME) ? reader.read_name() : nullptr;
+                return reader.ok();
+            }
+
+            void index_definitions()
+            {
+                udt_record udt;
+                for(uint32_t index = _reader.first(); index < _reader.last(); index++) {
+                    if(!read_udt(index, udt) || (udt.property & UDT_FORWARD_REF))
+                        continue;
+                    if(!is_unnamed(udt.name))
+                        _definitions.emplace(udt.name, index);
+                    if(udt.unique_name)
+                        _definitions.emplace(udt.unique_name, index);
+                }
+            }
+
+            uint32_t resolve(uint32_t index) const
+            {
+                //
+                // Members usually point at forward references, find the definition
+                //
+                udt_record udt;
+                if(!read_udt(index, udt) || !(udt.property & UDT_FORWARD_REF))
+                    return index;
+
+                auto it = _definitions.find(udt.unique_name ? udt.unique_name : udt.name);
+                if(it == _definitions.end() && udt.unique_name)
+                    it = _definitions.find(udt.name);
+                return it != _definitions.end() ? it->second : index;
+            }
+
+            uint64_t type_size(uint32_t index, int depth = 0) const
+            {
+                if(index < TPI_FIRST_TYPE_INDEX) {
+                    uint32_t mode = (index >> 8) & 0x0F;
+                    if(mode != 0)
+                        return mode == 6 ? 8 : mode == 5 ? 6 : mode >= 3 ? 4 : 2;
+                    for(auto& simple : s_simpleTypes) {
+                        if(simple.kind == (index & 0xFF))
+                            return simple.size;
+                    }
+                    return 0;
+                }
+
+                uint16_t        kind;
+                record_reader   reader(nullptr, nullptr);
+                if(depth > MAX_TYPE_DEPTH || !_reader.get_record(index, &kind, &reader))
+                    return 0;
+
+                switch(kind) {
+                case LF_MODIFIER:
+                case LF_BITFIELD:
+                    return type_size(reader.read<uint32_t>(), depth + 1);
+                case LF_POINTER:
+                    reader.read<uint32_t>();
+                    return (reader.read<uint32_t>() >> 13) & 0x3F;
+                case LF_ARRAY:
+                    reader.read<uint32_t>();
+                    reader.read<uint32_t>();
+                    return reader.read_numeric();
+                case LF_ENUM:
+                    reader.read<uint16_t>();
+                    reader.read<uint16_t>();
+                    return type_size(reader.read<uint32_t>(), depth + 1);
+                case LF_CLASS:
+                case LF_STRUCTURE:
+                case LF_INTERFACE:
+                case LF_UNION: {
+                    udt_record udt;
+                    return read_udt(resolve(index), udt) ? udt.size : 0;
+                }
+                default:
+                    return 0;
+                }
+            }
+
+            std::string type_name(uint32_t index, int depth = 0) const
+            {
+                if(index < TPI_FIRST_TYPE_INDEX) {
+                    std::string name = "<simple>";
+                    for(auto& simple : s_simpleTypes) {
+                        if(simple.kind == (index & 0xFF)) {
+                            name = simple.name;
+                            break;
+                        }
+                    }
+                    return ((index >> 8) & 0x0F) != 0 ? name + "*" : name;
+                }
+
+                uint16_t        kind;
+                record_reader   reader(nullptr, nullptr);
+                if(depth > MAX_TYPE_DEPTH || !_reader.get_record(index, &kind, &reader))
+                    return "<unknown>";
+
+                switch(kind) {
+                case LF_MODIFIER: {
+                    auto type = reader.read<uint32_t>();
+                    auto attributes = reader.read<uint16_t>();
+                    std::string prefix = (attributes & 1) ? "const " : "";
+                    if(attributes & 2)
+                        prefix += "volatile ";
+                    return prefix + type_name(type, depth + 1);
+                }
+                case LF_POINTER:
+                    return type_name(reader.read<uint32_t>(), depth + 1) + "*";
+                case LF_BITFIELD:
+                    return type_name(reader.read<uint32_t>(), depth + 1);
+                case LF_ARRAY: {
+                    auto element = reader.read<uint32_t>();
+                    reader.read<uint32_t>();
+                    auto size = reader.read_numeric();
+                    auto elementSize = type_size(element, depth + 1);
+                    return type_name(element, depth + 1) + "[" + std::to_string(elementSize ? size / elementSize : 0) + "]";
+                }
+                case LF_ENUM:
+                    reader.read<uint16_t>();
+                    reader.read<uint16_t>();
+                    reader.read<uint32_t>();
+                    reader.read<uint32_t>();
+                    return reader.read_name();
+                case LF_CLASS:
+                case LF_STRUCTURE:
+                case LF_INTERFACE:
+                case LF_UNION: {
+                    udt_record udt;
+                    return read_udt(index, udt) ? udt.name : "<unknown>";
+                }
+                case LF_PROCEDURE:
+                case LF_MFUNCTION:
+                    return "<function>";
+                default:
+                    return "<unknown>";
+                }
+            }
+
+            void collect_fields(uint32_t fieldList, uint64_t base, const std::string& prefix, int depth, std::vector<built_field>& fields) const
+            {
+                uint16_t        kind;
+                record_reader   reader(nullptr, nullptr);
+
+                if(depth > MAX_TYPE_DEPTH || !_reader.get_record(fieldList, &kind, &reader) || kind != LF_FIELDLIST)
+                    return;
+
+                while(reader.ok() && !reader.at_end()) {
+                    auto member = reader.read<uint16_t>();
+                    switch(member) {
+                    case LF_MEMBER: {
+                        reader.read<uint16_t>();
+                        auto type = reader.read<uint32_t>();
+                        auto offset = base + reader.read_numeric();
+                        auto name = reader.read_name();
+                        if(!reader.ok())
+                            return;
+                        add_member(type, offset, prefix, name, depth, fields);
+                        break;
+                    }
+                    case LF_BCLASS:
+                    case LF_BINTERFACE: {
+                        reader.read<uint16_t>();
+                        auto type = resolve(reader.read<uint32_t>());
+                        auto offset = base + reader.read_numeric();
+                        udt_record udt;
+                        if(reader.ok() && read_udt(type, udt))
+                            collect_fields(udt.field_list, offset, prefix, depth + 1, fields);
+                        break;
+                    }
+                    case LF_VBCLASS:
+                    case LF_IVBCLASS:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        reader.read<uint32_t>();
+                        reader.read_numeric();
+                        reader.read_numeric();
+                        break;
+                    case LF_ENUMERATE:
+                        reader.read<uint16_t>();
+                        reader.read_numeric();
+                        reader.read_name();
+                        break;
+                    case LF_STMEMBER:
+                    case LF_NESTTYPEEX:
+                    case LF_MEMBERMODIFY:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        reader.read_name();
+                        break;
+                    case LF_METHOD:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        reader.read_name();
+                        break;
+                    case LF_ONEMETHOD: {
+                        auto attributes = reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        auto property = (attributes >> 2) & 7;
+                        if(property == MTintro || property == MTpureintro)
+                            reader.read<uint32_t>();
+                        reader.read_name();
+                        break;
+                    }
+                    case LF_NESTTYPE:
+                    case LF_FRIENDFCN:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        reader.read_name();
+                        break;
+                    case LF_VFUNCTAB:
+                    case LF_FRIENDCLS:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        break;
+                    case LF_VFUNCOFF:
+                        reader.read<uint16_t>();
+                        reader.read<uint32_t>();
+                        reader.read<uint32_t>();
+                        break;
+                    case LF_INDEX:
+                        //
+                        // Long lists continue in another record
+                        //
+                        reader.read<uint16_t>();
+                        collect_fields(reader.read<uint32_t>(), base, prefix, depth + 1, fields);
+                        return;
+                    default:
+                        //
+                        // Can't tell how long an unknown member is, stop here
+                        //
+                        return;
+                    }
+                    reader.skip_padding();
+                }
+            }
+
+        private:
+            void add_member(uint32_t type, uint64_t offset, const std::string& prefix, const char* name, int depth, std::vector<built_field>& fields) const
+            {
+                udt_record udt;
+                auto nested = read_udt(resolve(type), udt) && is_unnamed(udt.name);
+
+                //
+                // An anonymous member's own members belong to the parent
+                //
+                if(*name == '\0') {
+                    if(nested)
+                        collect_fields(udt.field_list, offset, prefix, depth + 1, fields);
+                    return;
+                }
+
+                built_field field;
+                field.name = prefix + name;
+                field.type_name = type_name(type);
+                field.layout.offset = static_cast<uint32_t>(offset);
+                field.layout.size = static_cast<uint32_t>(type_size(type));
+                field.layout.bit_position = 0;
+                field.layout.bit_length = 0;
+                field.layout.reserved = 0;
+
+                uint16_t        kind;
+                record_reader   reader(nullptr, nullptr);
+                if(_reader.get_record(type, &kind, &reader) && kind == LF_BITFIELD) {
+                    reader.read<uint32_t>();
+                    field.layout.bit_length = reader.read<uint8_t>();
+                    field.layout.bit_position = reader.read<uint8_t>();
+                }
+                fields.push_back(field);
+
+                //
+                // Members of unnamed nested types are reachable as parent.member
+                //
+                if(nested)
+                    collect_fields(udt.field_list, offset, field.name + ".", depth + 1, fields);
+            }
+
+            const tpi_reader&                           _reader;
+            std::unordered_map<std::string, uint32_t>   _definitions;
+        };
+
+        type_table::type_table()
+            : _typeCount(0), _bucketCount(0), _stringsSize(0),
+            _typeData(nullptr), _fieldData(nullptr), _bucketData(nullptr), _stringData(nullptr)
+        {
+        }
+
+        ///<summary>
+        /// Reads the layouts of a PDB. Any layouts already in the table are dropped.
+        ///</summary>
+        ///<param name="pdb"> The PDB. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS type_table::build(pdb_file& pdb)
+        {
+            const uint8_t*  data;
+            uint32_t        size;
+            tpi_reader      reader;
+
+            clear();
+
+            if(!pdb.read_stream(PDB_TPI_STREAM, &data, &size))
+                return STATUS_NOT_FOUND;
+            if(!reader.open(data, size))
+                return STATUS_FILE_CORRUPT_ERROR;
+
+            layout_builder builder(reader);
+            builder.index_definitions();
+
+            std::unordered_set<std::string> added;
+            std::vector<built_field>        fields;
+            udt_record                      udt;
+
+            for(uint32_t index = reader.first(); index < reader.last(); index++) {
+                if(!builder.read_udt(index, udt) || (udt.property & UDT_FORWARD_REF) || is_unnamed(udt.name))
+                    continue;
+
+                //
+                // The same type is often defined by several compilands, keep the first
+                //
+                if(!added.insert(udt.name).second)
+                    continue;
+
+                fields.clear();
+                builder.collect_fields(udt.field_list, 0, std::string(), 0, fields);
+
+                type_table_entry type;
+                type.name = add_string(udt.name);
+                type.size = static_cast<uint32_t>(udt.size);
+                type.first_field = static_cast<uint32_t>(_fields.size());
+                type.field_count = static_cast<uint32_t>(fields.size());
+                _types.push_back(type);
+
+                for(auto& field : fields) {
+                    type_table_field entry;
+                    entry.name = add_string(field.name);
+                    entry.type_name = add_string(field.type_name);
+                    entry.layout = field.layout;
+                    _fields.push_back(entry);
+                }
+            }
+
+            _interned = std::unordered_map<std::string, uint32_t>();
+            build_buckets();
+            set_views();
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Opens a table saved with save. Any layouts already in the table are dropped.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<param name="key">  The key the table must have been saved with. </param>
+        ///<returns>
+        /// The status code. STATUS_OBJECT_TYPE_MISMATCH if the key doesn't match.
+        ///</returns>
+        NTSTATUS type_table::open(const std::wstring& path, const symbol_key& key)
+        {
+            clear();
+
+            auto status = _file.open(path);
+            if(!NT_SUCCESS(status))
+                return status;
+
+            auto header = reinterpret_cast<const type_file_header*>(_file.data());
+
+            if(_file.size() < sizeof(type_file_header) || header->magic != TYPE_FILE_MAGIC) {
+                status = STATUS_INVALID_IMAGE_FORMAT;
+            } else if(header->version != TYPE_FILE_VERSION) {
+                status = STATUS_REVISION_MISMATCH;
+            } else if(memcmp(&header->key, &key, sizeof(symbol_key)) != 0) {
+                status = STATUS_OBJECT_TYPE_MISMATCH;
+            } else if(header->file_size != _file.size() ||
+                (header->bucket_count & (header->bucket_count - 1)) != 0 ||
+                !file_range_valid(header, header->types_offset, header->type_count * static_cast<uint64_t>(sizeof(type_table_entry))) ||
+                !file_range_valid(header, header->fields_offset, header->field_count * static_cast<uint64_t>(sizeof(type_table_field))) ||
+                !file_range_valid(header, header->buckets_offset, header->bucket_count * static_cast<uint64_t>(sizeof(uint32_t))) ||
+                !file_range_valid(header, header->strings_offset, header->strings_size)) {
+                status = STATUS_FILE_CORRUPT_ERROR;
+            }
+
+            if(NT_SUCCESS(status)) {
+                //
+                // One pass over the types and buckets so nothing else has to check bounds.
+                // Strings are bounded by get_string.
+                //
+                auto types = reinterpret_cast<const type_table_entry*>(_file.data() + header->types_offset);
+                auto buckets = reinterpret_cast<const uint32_t*>(_file.data() + header->buckets_offset);
+
+                for(uint32_t i = 0; i < header->type_count && NT_SUCCESS(status); i++) {
+                    if(types[i].first_field > header->field_count || types[i].field_count > header->field_count - types[i].first_field)
+                        status = STATUS_FILE_CORRUPT_ERROR;
+                }
+                for(uint32_t i = 0; i < header->bucket_count && NT_SUCCESS(status); i++) {
+                    if(buckets[i] > header->type_count)
+                        status = STATUS_FILE_CORRUPT_ERROR;
+                }
+                if(header->type_count != 0 && header->bucket_count == 0)
+                    status = STATUS_FILE_CORRUPT_ERROR;
+                if(header->strings_size != 0 && _file.data()[header->strings_offset + header->strings_size - 1] != '\0')
+                    status = STATUS_FILE_CORRUPT_ERROR;
+            }
+
+            if(!NT_SUCCESS(status)) {
+                _file.close();
+                return status;
+            }
+
+            _typeCount = header->type_count;
+            _bucketCount = header->bucket_count;
+            _stringsSize = header->strings_size;
+            _typeData = reinterpret_cast<const type_table_entry*>(_file.data() + header->types_offset);
+            _fieldData = reinterpret_cast<const type_table_field*>(_file.data() + header->fields_offset);
+            _bucketData = reinterpret_cast<const uint32_t*>(_file.data() + header->buckets_offset);
+            _stringData = reinterpret_cast<const char*>(_file.data() + header->strings_offset);
+            return STATUS_SUCCESS;
+        }
+
+        ///<summary>
+        /// Saves the table.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<param name="key">  The key stored with the table. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS type_table::save(const std::wstring& path, const symbol_key& key) const
+        {
+            type_file_header header = {};
+
+            auto align = [](uint64_t offset) { return (offset + 7) & ~7ull; };
+            auto fieldCount = _typeCount != 0 ? _typeData[_typeCount - 1].first_field + _typeData[_typeCount - 1].field_count : 0;
+
+            header.magic = TYPE_FILE_MAGIC;
+            header.version = TYPE_FILE_VERSION;
+            header.key = key;
+            header.type_count = _typeCount;
+            header.field_count = fieldCount;
+            header.bucket_count = _bucketCount;
+            header.strings_size = _stringsSize;
+            header.types_offset = align(sizeof(type_file_header));
+            header.fields_offset = align(header.types_offset + _typeCount * static_cast<uint64_t>(sizeof(type_table_entry)));
+            header.buckets_offset = align(header.fields_offset + fieldCount * static_cast<uint64_t>(sizeof(type_table_field)));
+            header.strings_offset = align(header.buckets_offset + _bucketCount * static_cast<uint64_t>(sizeof(uint32_t)));
+            header.file_size = header.strings_offset + _stringsSize;
+
+            if(header.file_size > MAXULONG)
+                return STATUS_FILE_TOO_LARGE;
+
+            std::vector<uint8_t> buffer(static_cast<size_t>(header.file_size), 0);
+            auto write = [&buffer](uint64_t offset, const void* data, size_t length) {
+                if(length != 0)
+                    memcpy(buffer.data() + offset, data, length);
+            };
+
+            write(0, &header, sizeof(header));
+            write(header.types_offset, _typeData, _typeCount * sizeof(type_table_entry));
+            write(header.fields_offset, _fieldData, fieldCount * sizeof(type_table_field));
+            write(header.buckets_offset, _bucketData, _bucketCount * sizeof(uint32_t));
+            write(header.strings_offset, _stringData, _stringsSize);
+
+            return native::create_file(path, buffer.data(), buffer.size());
+        }
+
+        ///<summary>
+        /// Gets the memory used by the table, in bytes, counting the mapped file if any.
+        ///</summary>
+        size_t type_table::get_memory_usage() const
+        {
+            return sizeof(*this) +
+                _types.capacity() * sizeof(type_table_entry) +
+                _fields.capacity() * sizeof(type_table_field) +
+                _buckets.capacity() * sizeof(uint32_t) +
+                _strings.capacity() +
+                _file.size();
+        }
+
+        ///<summary>
+        /// Finds a type by name.
+        ///</summary>
+        ///<param name="name"> The name, e.g. _EPROCESS. </param>
+        ///<returns>
+        /// The type, nullptr if none.
+        ///</returns>
+        const type_table_entry* type_table::find(const char* name) const
+        {
+            if(_bucketCount == 0)
+                return nullptr;
+
+            //
+            // Open addressing with linear probing, the table is at most half full
+            //
+            auto mask = _bucketCount - 1;
+            for(uint32_t i = hash_name(name) & mask, probes = 0; probes < _bucketCount; i = (i + 1) & mask, probes++) {
+                auto slot = _bucketData[i];
+                if(slot == 0)
+                    return nullptr;
+                if(strcmp(get_string(_typeData[slot - 1].name), name) == 0)
+                    return &_typeData[slot - 1];
+            }
+            return nullptr;
+        }
+
+        ///<summary>
+        /// Finds a field of a type by name.
+        ///</summary>
+        ///<param name="type"> The type. </param>
+        ///<param name="name"> The field name, e.g. Pcb or u.Flags. </param>
+        ///<returns>
+        /// The field, nullptr if none.
+        ///</returns>
+        const type_table_field* type_table::find_field(const type_table_entry& type, const char* name) const
+        {
+            auto fields = get_fields(type);
+            for(uint32_t i = 0; i < type.field_count; i++) {
+                if(strcmp(get_string(fields[i].name), name) == 0)
+                    return &fields[i];
+            }
+            return nullptr;
+        }
+
+        ///<summary>
+        /// Gets the layout of a field.
+        ///</summary>
+        ///<param name="type">   The type name. </param>
+        ///<param name="field">  The field name. </param>
+        ///<param name="layout"> The returned layout. </param>
+        ///<returns>
+        /// True if found.
+        ///</returns>
+        bool type_table::get_field_layout(const char* type, const char* field, field_layout& layout) const
+        {
+            auto entry = find(type);
+            auto found = entry ? find_field(*entry, field) : nullptr;
+            if(!found)
+                return false;
+
+            layout = found->layout;
+            return true;
+        }
+
+        ///<summary>
+        /// Writes a C++ header with the layouts of some types as constexpr field_layout values.
+        ///</summary>
+        ///<param name="types">      The type names, empty for all of them. </param>
+        ///<param name="nameSpace">  The namespace the types are put in. </param>
+        ///<param name="out">        The string the header is appended to. </param>
+        ///<returns>
+        /// The status code. STATUS_NOT_FOUND if a type isn't in the table, then nothing is written.
+        ///</returns>
+        NTSTATUS type_table::generate_header(const std::vector<std::string>& types, const std::string& nameSpace, std::string& out) const
+        {
+            std::vector<const type_table_entry*> entries;
+
+            if(types.empty()) {
+                for(uint32_t i = 0; i < _typeCount; i++)
+                    entries.push_back(&_typeData[i]);
+            } else {
+                for(auto& name : types) {
+                    auto entry = find(name.c_str());
+                    if(!entry)
+                        return STATUS_NOT_FOUND;
+                    entries.push_back(entry);
+                }
+            }
+
+            auto identifier = [](const char* name) {
+                std::string result;
+                for(; *name; name++)
+                    result += isalnum(static_cast<uint8_t>(*name)) || *name == '_' ? *name : '_';
+                if(result.empty() || isdigit(static_cast<uint8_t>(result[0])))
+                    result.insert(0, 1, '_');
+                return result;
+            };
+
+            char line[256];
+            std::string text;
+
+            text += "//\n// Generated by resurgence::system::type_table::generate_header, do not edit.\n//\n";
+            text += "#pragma once\n\n#include <system/symbols/field_layout.hpp>\n\n";
+            text += "namespace " + identifier(nameSpace.c_str()) + "\n{\n";
+
+            for(size_t i = 0; i < entries.size(); i++) {
+                auto type = entries[i];
+                auto fields = get_fields(*type);
+
+                sprintf_s(line, "    namespace %s\n    {\n        constexpr uint32_t size = 0x%X;\n", identifier(get_string(type->name)).c_str(), type->size);
+                text += line;
+
+                //
+                // Unions and flattened bases can repeat a name, later ones get a suffix
+                //
+                std::unordered_set<std::string> used;
+                used.insert("size");
+
+                for(uint32_t j = 0; j < type->field_count; j++) {
+                    auto& field = fields[j];
+                    auto name = identifier(get_string(field.name));
+                    auto unique = name;
+                    for(int n = 2; !used.insert(unique).second; n++)
+                        unique = name + "_" + std::to_string(n);
+
+                    sprintf_s(line, "        constexpr resurgence::system::field_layout %s = { 0x%X, 0x%X, %u, %u, 0 };",
+                        unique.c_str(), field.layout.offset, field.layout.size, field.layout.bit_position, field.layout.bit_length);
+                    text += line;
+                    text += " // ";
+                    text += get_string(field.type_name);
+                    text += "\n";
+                }
+
+                text += i + 1 < entries.size() ? "    }\n\n" : "    }\n";
+            }
+            text += "}\n";
+
+            out += text;
+            return STATUS_SUCCESS;
+        }
+
+        uint32_t type_table::add_string(const std::string& value)
+        {
+            auto inserted = _interned.emplace(value, static_cast<uint32_t>(_strings.size()));
+            if(inserted.second) {
+                _strings.insert(_strings.end(), value.begin(), value.end());
+                _strings.push_back('\0');
+            }
+            return inserted.first->second;
+        }
+
+        void type_table::build_buckets()
+        {
+            uint32_t count = 1;
+            while(count < _types.size() * 2)
+                count *= 2;
+
+            _buckets.assign(_types.empty() ? 0 : count, 0);
+
+            for(uint32_t i = 0; i < _types.size(); i++) {
+                auto mask = count - 1;
+                auto slot = hash_name(_strings.data() + _types[i].name) & mask;
+                while(_buckets[slot] != 0)
+                    slot = (slot + 1) & mask;
+                _buckets[slot] = i + 1;
+            }
+        }
+
+        void type_table::set_views()
+        {
+            _typeCount = static_cast<uint32_t>(_types.size());
+            _bucketCount = static_cast<uint32_t>(_buckets.size());
+            _stringsSize = static_cast<uint32_t>(_strings.size());
+            _typeData = _types.data();
+            _fieldData = _fields.data();
+            _bucketData = _buckets.data();
+            _stringData = _strings.data();
+        }
+
+        void type_table::clear()
+        {
+            _file.close();
+            _types = std::vector<type_table_entry>();
+            _fields = std::vector<type_table_field>();
+            _buckets = std::vector<uint32_t>();
+            _strings = std::vector<char>();
+            _interned = std::unordered_map<std::string, uint32_t>();
+            set_views();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#include <system/unwind_memory.hpp>
+#include <system/process.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace resurgence
+{
+    namespace system
+    {
+        process_unwind_memory::process_unwind_memory(process* proc)
+            : _process(proc)
+        {
+        }
+
+        NTSTATUS process_unwind_memory::read(uint64_t address, void* buffer, size_t size)
+        {
+            if(address > UINTPTR_MAX || size > UINTPTR_MAX - address)
+                return STATUS_INVALID_PARAMETER;
+            return _process->memory()->read_bytes(reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(address)), static_cast<uint8_t*>(buffer), size);
+        }
+
+        ///<summary>
+        /// Adds a recorded region. Regions must not overlap, and can't be added while reading.
+        ///</summary>
+        ///<param name="address"> The address of the region. </param>
+        ///<param name="data">    The contents. </param>
+        ///<param name="size">    The size of the region. </param>
+        void snapshot_unwind_memory::add_region(uint64_t address, const void* data, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(data);
+            auto it = std::upper_bound(_regions.begin(), _regions.end(), address, [](uint64_t value, const region& r) {
+                return value < r.address;
+            });
+            _regions.insert(it, region{address, std::vector<uint8_t>(bytes, bytes + size)});
+        }
+
+        NTSTATUS snapshot_unwind_memory::read(uint64_t address, void* buffer, size_t size)
+        {
+            auto it = std::upper_bound(_regions.begin(), _regions.end(), address, [](uint64_t value, const region& r) {
+                return value < r.address;
+            });
+            if(it == _regions.begin())
+                return STATUS_PARTIAL_COPY;
+
+            --it;
+            auto offset = address - it->address;
+            if(offset > it->data.size() || size > it->data.size() - offset)
+                return STATUS_PARTIAL_COPY;
+
+            memcpy(buffer, it->data.data() + offset, size);
+            return STATUS_SUCCESS;
+        }
+    }
+}
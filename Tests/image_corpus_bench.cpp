@@ -0,0 +1,65 @@
+#include "test.hpp"
+
+#include <system/image_corpus_index.hpp>
+
+#include <cstdio>
+
+using namespace resurgence;
+
+//
+// Indexes the images of a directory tree, then queries the index: the build reports
+// files per second, the queries how long one lookup takes without parsing anything.
+//
+BENCHMARK(corpus, "<directory> [export name]")
+{
+    if(args.empty()) {
+        printf("usage: bench corpus <directory> [export name]\n");
+        return;
+    }
+    std::string exportName = "NtClose";
+    if(args.size() > 1)
+        exportName.assign(args[1].begin(), args[1].end());
+
+    system::image_corpus_indexer indexer;
+    auto status = indexer.add_directory(args[0]);
+    if(!NT_SUCCESS(status)) {
+        printf("add_directory failed: %08x\n", status);
+        return;
+    }
+
+    auto path = tests::get_temp_path(L"corpus.idx");
+    status = indexer.build(path);
+    if(!NT_SUCCESS(status)) {
+        printf("build failed: %08x\n", status);
+        return;
+    }
+
+    auto& stats = indexer.get_stats();
+    printf("build        %10llu ms, %llu files (%llu images), %.1f MB, %.0f files/s\n",
+        stats.elapsed_ms, stats.files, stats.images, stats.bytes / 1048576.0, indexer.get_files_per_second());
+
+    tests::stopwatch watch;
+    system::image_corpus_index index;
+    status = index.open(path);
+    if(!NT_SUCCESS(status)) {
+        printf("open failed: %08x\n", status);
+        return;
+    }
+    auto openMs = watch.elapsed_ms();
+
+    std::vector<uint32_t> exports, imports;
+    watch.restart();
+    index.find_exports(exportName.c_str(), exports);
+    auto exportsMs = watch.elapsed_ms();
+
+    watch.restart();
+    index.find_imports("ntdll.dll", exportName.c_str(), imports);
+    auto importsMs = watch.elapsed_ms();
+
+    printf("open         %10.3f ms, %zu exports, %zu imports\n", openMs, index.get_export_count(), index.get_import_count());
+    printf("find         %10.3f ms exports, %10.3f ms imports of %s (%zu and %zu found)\n",
+        exportsMs, importsMs, exportName.c_str(), exports.size(), imports.size());
+
+    index.close();
+    DeleteFileW(path.c_str());
+}
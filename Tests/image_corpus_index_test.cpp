@@ -0,0 +1,64 @@
+#include "test.hpp"
+#include "pe_builder.hpp"
+
+#include <system/image_corpus_index.hpp>
+
+#include <cstring>
+
+using namespace resurgence;
+
+TEST_CASE(image_corpus_index_bounds_exports)
+{
+    tests::pe_builder pe;
+    auto code = pe.add_code({ 0xC3 });
+
+    //
+    // Ordinals 0xFFFD to 0x10000, the last one can't be imported. One name is for a
+    // function past the table.
+    //
+    pe.set_ordinal_base(0xFFFD);
+    pe.add_export("Alpha", code);
+    pe.add_export("Beta", code);
+    pe.add_export(nullptr, code);
+    pe.add_export("Delta", code);
+    pe.add_export_name("Bad", 0xFFFF);
+
+    auto image = tests::get_temp_path(L"corpus_fixture.dll");
+    auto path = tests::get_temp_path(L"corpus_fixture.idx");
+    CHECK(NT_SUCCESS(pe.write(image)));
+
+    system::image_corpus_indexer indexer;
+    indexer.add_file(image);
+    CHECK(NT_SUCCESS(indexer.build(path)));
+
+    system::image_corpus_index index;
+    CHECK(NT_SUCCESS(index.open(path)));
+    CHECK(index.get_file_count() == 1);
+    CHECK(index.get_export_count() == 3);
+
+    auto file = index.get_file(0);
+    CHECK(NT_SUCCESS(file.status));
+    CHECK(file.export_count == 3);
+
+    for(uint32_t i = 0; i < 3 && i < index.get_export_count(); i++) {
+        auto entry = index.get_export(file.first_export + i);
+        CHECK(entry.ordinal == 0xFFFD + i);
+        CHECK(entry.rva == code);
+    }
+    CHECK(strcmp(index.get_string(index.get_export(file.first_export).name), "Alpha") == 0);
+    CHECK(index.get_export(file.first_export + 2).name == 0);
+
+    std::vector<uint32_t> exports;
+    index.find_exports("Beta", exports);
+    CHECK(exports.size() == 1);
+    index.find_exports("Delta", exports);
+    CHECK(exports.empty());
+    index.find_exports("Bad", exports);
+    CHECK(exports.empty());
+
+    //
+    // No debug directory: no PDB name, with no separator to look for
+    //
+    CHECK(!(file.flags & IMAGE_CORPUS_FILE_PDB));
+    CHECK(*index.get_string(file.pdb_name) == '\0');
+}
@@ -0,0 +1,105 @@
+#include "test.hpp"
+#include "pe_builder.hpp"
+
+#include <system/symbols/image_symbols.hpp>
+
+#include <cstring>
+
+using namespace resurgence;
+
+static std::string find_name(const system::symbol_table& table, uint32_t rva, uint32_t* start = nullptr)
+{
+    auto symbol = table.find(rva);
+    if(!symbol)
+        return std::string();
+    if(start)
+        *start = symbol->rva;
+    return table.get_name(*symbol);
+}
+
+TEST_CASE(image_symbols_names_functions_after_exports)
+{
+    tests::pe_builder pe;
+
+    //
+    // UNWIND_INFO version 1 without codes, and one chained to the function at first
+    //
+    auto unwind = pe.add_data({ 0x01, 0x00, 0x00, 0x00 });
+
+    auto first  = pe.add_code(std::vector<uint8_t>(0x20, 0x90));
+    auto alpha  = pe.add_code(std::vector<uint8_t>(0x20, 0x90));
+    auto inner  = pe.add_code(std::vector<uint8_t>(0x30, 0x90));
+    auto split  = pe.add_code(std::vector<uint8_t>(0x10, 0x90));
+    auto leaf   = pe.add_code(std::vector<uint8_t>(0x08, 0xC3));
+
+    std::vector<uint8_t> chained = { 0x21, 0x00, 0x00, 0x00 };     // Version 1, UNW_FLAG_CHAININFO
+    IMAGE_RUNTIME_FUNCTION_ENTRY parent;
+    parent.BeginAddress = alpha;
+    parent.EndAddress = alpha + 0x20;
+    parent.UnwindInfoAddress = unwind;
+    chained.insert(chained.end(), reinterpret_cast<uint8_t*>(&parent), reinterpret_cast<uint8_t*>(&parent + 1));
+    auto chainedUnwind = pe.add_data(chained);
+
+    pe.add_function(first, first + 0x20, unwind);
+    pe.add_function(alpha, alpha + 0x20, unwind);
+    pe.add_function(inner, inner + 0x30, unwind);
+    pe.add_function(split, split + 0x10, chainedUnwind);
+
+    pe.add_export("Alpha", alpha);
+    pe.add_export(nullptr, leaf);
+
+    auto image = pe.build();
+
+    system::symbol_table table;
+    CHECK(NT_SUCCESS(system::image_symbols::build(image.data(), image.size(), table)));
+
+    char sub[16];
+    sprintf_s(sub, "sub_%X", first);
+
+    uint32_t start = 0;
+    CHECK(find_name(table, first + 4) == sub);
+    CHECK(find_name(table, alpha + 4, &start) == "Alpha" && start == alpha);
+    CHECK(find_name(table, inner + 8, &start) == "Alpha+0x20" && start == inner);
+
+    //
+    // The fragment is named after the function it belongs to, not the one before it
+    //
+    CHECK(find_name(table, split + 2, &start) == "Alpha" && start == split);
+
+    //
+    // Exports without .pdata entries are there too, by ordinal when they have no name
+    //
+    CHECK(find_name(table, leaf + 1, &start) == "Ordinal2" && start == leaf);
+}
+
+TEST_CASE(image_symbols_without_pdata)
+{
+    tests::pe_builder pe;
+    auto alpha = pe.add_code(std::vector<uint8_t>(0x10, 0xC3));
+    auto beta  = pe.add_code(std::vector<uint8_t>(0x10, 0xC3));
+    pe.set_ordinal_base(10);
+    pe.add_export("Beta", beta);
+    pe.add_export("Alpha", alpha);
+
+    auto image = pe.build();
+
+    system::symbol_table table;
+    CHECK(NT_SUCCESS(system::image_symbols::build(image.data(), image.size(), table)));
+    CHECK(table.size() == 2);
+    CHECK(find_name(table, alpha + 3) == "Alpha");
+    CHECK(find_name(table, beta + 3) == "Beta");
+}
+
+TEST_CASE(image_symbols_rejects_bad_images)
+{
+    tests::pe_builder pe;
+    pe.add_export("Alpha", pe.add_code({ 0xC3 }));
+    auto image = pe.build();
+
+    system::symbol_table table;
+    CHECK(!NT_SUCCESS(system::image_symbols::build(image.data(), 0x40, table)));
+
+    image[0] = 'X';
+    CHECK(!NT_SUCCESS(system::image_symbols::build(image.data(), image.size(), table)));
+    CHECK(table.empty());
+}
@@ -0,0 +1,96 @@
+#include "test.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+//
+// Tests [name...]                  Runs every test, or the ones named
+// Tests bench <name> [args...]     Runs a benchmark
+// Tests bench                      Lists the benchmarks
+//
+namespace tests
+{
+    static int s_failures = 0;
+
+    std::vector<test_case>& get_tests()
+    {
+        static std::vector<test_case> cases;
+        return cases;
+    }
+
+    std::vector<benchmark_case>& get_benchmarks()
+    {
+        static std::vector<benchmark_case> cases;
+        return cases;
+    }
+
+    void report_failure(const char* file, int line, const char* expression)
+    {
+        printf("    %s(%d): CHECK(%s) failed\n", file, line, expression);
+        s_failures++;
+    }
+
+    std::wstring get_temp_path(const std::wstring& name)
+    {
+        wchar_t directory[MAX_PATH];
+
+        auto length = GetTempPathW(MAX_PATH, directory);
+        if(length == 0 || length > MAX_PATH)
+            return name;
+        return std::wstring(directory, length) + L"resurgence_tests_" + std::to_wstring(GetCurrentProcessId()) + L"_" + name;
+    }
+
+    static std::string narrow(const std::wstring& value)
+    {
+        return std::string(value.begin(), value.end());
+    }
+
+    static int run_tests(const std::vector<std::wstring>& names)
+    {
+        int failed = 0;
+        int count = 0;
+
+        for(auto& test : get_tests()) {
+            if(!names.empty() && std::find(names.begin(), names.end(), std::wstring(test.name, test.name + strlen(test.name))) == names.end())
+                continue;
+
+            auto before = s_failures;
+            printf("[ RUN  ] %s\n", test.name);
+            test.run();
+            printf("[ %s ] %s\n", s_failures == before ? " OK " : "FAIL", test.name);
+            if(s_failures != before)
+                failed++;
+            count++;
+        }
+
+        printf("%d test(s), %d failed\n", count, failed);
+        return failed == 0 ? 0 : 1;
+    }
+
+    static int run_benchmark(const std::vector<std::wstring>& args)
+    {
+        if(!args.empty()) {
+            for(auto& benchmark : get_benchmarks()) {
+                if(narrow(args[0]) == benchmark.name) {
+                    benchmark.run(std::vector<std::wstring>(args.begin() + 1, args.end()));
+                    return 0;
+                }
+            }
+        }
+
+        printf("Benchmarks:\n");
+        for(auto& benchmark : get_benchmarks())
+            printf("    bench %s %s\n", benchmark.name, benchmark.usage);
+        return 1;
+    }
+}
+
+int wmain(int argc, wchar_t** argv)
+{
+    std::vector<std::wstring> args(argv + 1, argv + argc);
+
+    if(!args.empty() && args[0] == L"bench")
+        return tests::run_benchmark(std::vector<std::wstring>(args.begin() + 1, args.end()));
+    return tests::run_tests(args);
+}
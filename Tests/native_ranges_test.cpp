@@ -0,0 +1,166 @@
+#include "test.hpp"
+
+#include <misc/native.hpp>
+#include <misc/native_ranges.hpp>
+
+#include <algorithm>
+#include <functional>
+
+using namespace resurgence;
+
+//
+// A SystemExtendedProcessInformation buffer laid out like the kernel does it:
+// each entry is followed by its extended thread array, the last one has no next.
+//
+static std::vector<uint8_t> make_process_buffer(const std::vector<uint32_t>& threadCounts)
+{
+    std::vector<size_t> offsets;
+    size_t size = 0;
+
+    for(auto count : threadCounts) {
+        offsets.push_back(size);
+        size += ALIGN_UP(FIELD_OFFSET(SYSTEM_PROCESS_INFORMATION, Threads) + count * sizeof(SYSTEM_EXTENDED_THREAD_INFORMATION), sizeof(ULONG_PTR));
+    }
+
+    std::vector<uint8_t> buffer(size, 0);
+    for(size_t i = 0; i < threadCounts.size(); i++) {
+        auto entry = reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(&buffer[offsets[i]]);
+        entry->NextEntryDelta = i + 1 < offsets.size() ? static_cast<ULONG>(offsets[i + 1] - offsets[i]) : 0;
+        entry->ThreadCount = threadCounts[i];
+        entry->UniqueProcessId = reinterpret_cast<HANDLE>((i + 1) * 4);
+
+        auto threads = reinterpret_cast<PSYSTEM_EXTENDED_THREAD_INFORMATION>(entry->Threads);
+        for(uint32_t t = 0; t < threadCounts[i]; t++)
+            threads[t].ClientId.UniqueThread = reinterpret_cast<HANDLE>((i + 1) * 0x1000 + t * 4);
+    }
+    return buffer;
+}
+
+TEST_CASE(process_range_walks_every_entry)
+{
+    auto buffer = make_process_buffer({2, 0, 5, 1});
+
+    std::vector<uintptr_t> pids;
+    for(auto& entry : native::process_range(buffer.data()))
+        pids.push_back(reinterpret_cast<uintptr_t>(entry.UniqueProcessId));
+
+    //
+    // The last entry (NextEntryDelta == 0) is part of the range
+    //
+    CHECK(pids == std::vector<uintptr_t>({4, 8, 12, 16}));
+
+    auto range = native::process_range(buffer.data());
+    CHECK(std::distance(range.begin(), range.end()) == 4);
+    CHECK(std::count_if(range.begin(), range.end(), [](const SYSTEM_PROCESS_INFORMATION& entry) { return entry.ThreadCount == 0; }) == 1);
+
+    auto found = std::find_if(range.begin(), range.end(), [](const SYSTEM_PROCESS_INFORMATION& entry) {
+        return reinterpret_cast<uintptr_t>(entry.UniqueProcessId) == 12;
+    });
+    CHECK(found != range.end() && found->ThreadCount == 5);
+
+    CHECK(native::process_range(static_cast<const uint8_t*>(nullptr)).empty());
+}
+
+TEST_CASE(process_range_stops_on_break)
+{
+    auto buffer = make_process_buffer({1, 1, 1});
+
+    int visited = 0;
+    for(auto& entry : native::process_range(buffer.data())) {
+        visited++;
+        if(reinterpret_cast<uintptr_t>(entry.UniqueProcessId) == 8)
+            break;
+    }
+    CHECK(visited == 2);
+}
+
+TEST_CASE(thread_range_uses_the_extended_size)
+{
+    auto buffer = make_process_buffer({3, 2});
+
+    std::vector<uintptr_t> tids;
+    for(auto& entry : native::process_range(buffer.data())) {
+        for(auto& thread : native::thread_range(entry))
+            tids.push_back(reinterpret_cast<uintptr_t>(thread.ClientId.UniqueThread));
+    }
+    CHECK(tids == std::vector<uintptr_t>({0x1000, 0x1004, 0x1008, 0x2000, 0x2004}));
+}
+
+TEST_CASE(module_and_handle_ranges)
+{
+    std::vector<uint8_t> modules(FIELD_OFFSET(RTL_PROCESS_MODULES, Modules) + 3 * sizeof(RTL_PROCESS_MODULE_INFORMATION), 0);
+    auto moduleInfo = reinterpret_cast<PRTL_PROCESS_MODULES>(modules.data());
+    moduleInfo->NumberOfModules = 3;
+    for(USHORT i = 0; i < 3; i++)
+        moduleInfo->Modules[i].LoadOrderIndex = i;
+
+    USHORT expected = 0;
+    for(auto& module : native::system_module_range(modules.data()))
+        CHECK(module.LoadOrderIndex == expected++);
+    CHECK(expected == 3);
+
+    std::vector<uint8_t> handles(FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION, Handles) + 2 * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO), 0);
+    auto handleInfo = reinterpret_cast<PSYSTEM_HANDLE_INFORMATION>(handles.data());
+    handleInfo->NumberOfHandles = 2;
+    handleInfo->Handles[1].HandleValue = 0x44;
+
+    auto range = native::handle_range(handles.data());
+    CHECK(range.size() == 2 && range[1].HandleValue == 0x44);
+    CHECK(native::handle_range(static_cast<const uint8_t*>(nullptr)).empty());
+}
+
+//
+// Walks the live process list through the pooled buffer: once per entry through a
+// std::function, as the enumerate_* callbacks do, and once with the range.
+//
+BENCHMARK(native_ranges, "[iterations]")
+{
+    int iterations = args.empty() ? 10000 : _wtoi(args[0].c_str());
+
+    auto buffer = misc::information_pool::instance().query(SystemExtendedProcessInformation);
+    if(!buffer) {
+        printf("NtQuerySystemInformation failed: %08x\n", get_last_ntstatus());
+        return;
+    }
+
+    size_t entries = 0;
+    size_t threads = 0;
+
+    std::function<NTSTATUS(PSYSTEM_PROCESS_INFORMATION)> callback = [&](PSYSTEM_PROCESS_INFORMATION entry) -> NTSTATUS {
+        threads += entry->ThreadCount;
+        return STATUS_NOT_FOUND;
+    };
+
+    tests::stopwatch watch;
+    for(int i = 0; i < iterations; i++) {
+        for(auto entry = buffer.as<SYSTEM_PROCESS_INFORMATION>(); entry; ) {
+            entries++;
+            if(NT_SUCCESS(callback(entry)))
+                break;
+            entry = entry->NextEntryDelta ? reinterpret_cast<PSYSTEM_PROCESS_INFORMATION>(PTR_ADD(entry, entry->NextEntryDelta)) : nullptr;
+        }
+    }
+    auto callbackMs = watch.elapsed_ms();
+
+    watch.restart();
+    for(int i = 0; i < iterations; i++) {
+        for(auto& entry : native::process_range(buffer)) {
+            entries++;
+            threads += entry.ThreadCount;
+        }
+    }
+    auto rangeMs = watch.elapsed_ms();
+
+    //
+    // End to end, with the query
+    //
+    watch.restart();
+    for(int i = 0; i < iterations / 100 + 1; i++)
+        native::enumerate_processes([&](PSYSTEM_PROCESS_INFORMATION entry) -> NTSTATUS { threads += entry->ThreadCount; return STATUS_NOT_FOUND; });
+    auto enumerateMs = watch.elapsed_ms() / (iterations / 100 + 1);
+
+    printf("%zu entries walked (%zu threads)\n", entries / 2, threads);
+    printf("std::function per entry: %8.3f us per walk\n", callbackMs * 1000 / iterations);
+    printf("process_range:           %8.3f us per walk\n", rangeMs * 1000 / iterations);
+    printf("enumerate_processes:     %8.3f us per call, with the query\n", enumerateMs * 1000);
+}
@@ -0,0 +1,126 @@
+#include "test.hpp"
+
+#include <system/symbols/pdb_file.hpp>
+
+#include <DbgHelp.h>
+
+#include <cstdio>
+
+using namespace resurgence;
+
+//
+// Where dbghelp loads the PDB, it needs a base address and a size
+//
+#define BENCH_MODULE_BASE   0x10000000ull
+#define BENCH_MODULE_SIZE   0x40000000u
+
+//
+// Loads a real PDB with pdb_file and with dbghelp and resolves the same addresses and
+// names with both. The addresses are spread over the publics, a few bytes past each.
+//
+BENCHMARK(pdb, "<pdb path> [lookups]")
+{
+    if(args.empty()) {
+        printf("usage: bench pdb <pdb path> [lookups]\n");
+        return;
+    }
+    int lookups = args.size() > 1 ? _wtoi(args[1].c_str()) : 1000000;
+
+    tests::stopwatch watch;
+
+    system::pdb_file pdb;
+    auto status = pdb.open(args[0]);
+    if(!NT_SUCCESS(status)) {
+        printf("pdb_file::open failed: %08x\n", status);
+        return;
+    }
+    auto openMs = watch.elapsed_ms();
+
+    watch.restart();
+    auto& publics = pdb.get_public_symbols();
+    auto publicsMs = watch.elapsed_ms();
+
+    if(publics.empty()) {
+        printf("The PDB has no public symbols\n");
+        return;
+    }
+
+    std::vector<uint32_t> rvas(lookups);
+    uint32_t seed = 0x12345678;
+    for(auto& rva : rvas) {
+        seed = seed * 1103515245 + 12345;
+        rva = publics[(seed >> 8) % publics.size()].rva + (seed & 0xF);
+    }
+
+    size_t found = 0;
+    watch.restart();
+    for(auto rva : rvas) {
+        system::pdb_symbol symbol;
+        uint32_t displacement;
+        if(pdb.find_symbol_by_rva(rva, symbol, &displacement))
+            found++;
+    }
+    auto rvaMs = watch.elapsed_ms();
+
+    size_t named = 0;
+    watch.restart();
+    for(auto& symbol : publics) {
+        system::pdb_symbol result;
+        if(pdb.find_symbol_by_name(symbol.name, result))
+            named++;
+    }
+    auto nameMs = watch.elapsed_ms();
+
+    printf("%zu publics, %.1f MB of parsed tables\n", publics.size(), pdb.get_memory_usage() / (1024.0 * 1024.0));
+    printf("pdb_file: open %8.3f ms, publics %8.3f ms, %8.1f ns per address (%zu found), %8.1f ns per name (%zu found)\n",
+        openMs, publicsMs, rvaMs * 1e6 / lookups, found, nameMs * 1e6 / publics.size(), named);
+
+    //
+    // dbghelp, loading the PDB directly at a made up base
+    //
+    auto handle = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(GetCurrentProcessId()) + 1);
+
+    SymSetOptions(SYMOPT_FAIL_CRITICAL_ERRORS);
+    if(!SymInitializeW(handle, NULL, FALSE)) {
+        printf("SymInitialize failed: %u\n", GetLastError());
+        return;
+    }
+
+    watch.restart();
+    auto base = SymLoadModuleExW(handle, NULL, args[0].c_str(), NULL, BENCH_MODULE_BASE, BENCH_MODULE_SIZE, NULL, 0);
+    auto loadMs = watch.elapsed_ms();
+
+    if(base) {
+        std::vector<uint8_t> buffer(sizeof(SYMBOL_INFOW) + MAX_SYM_NAME * sizeof(wchar_t));
+        auto symbolInfo = reinterpret_cast<PSYMBOL_INFOW>(buffer.data());
+
+        found = 0;
+        watch.restart();
+        for(auto rva : rvas) {
+            DWORD64 displacement;
+
+            symbolInfo->SizeOfStruct = sizeof(SYMBOL_INFOW);
+            symbolInfo->MaxNameLen = MAX_SYM_NAME;
+            if(SymFromAddrW(handle, base + rva, &displacement, symbolInfo))
+                found++;
+        }
+        rvaMs = watch.elapsed_ms();
+
+        named = 0;
+        watch.restart();
+        for(auto& symbol : publics) {
+            symbolInfo->SizeOfStruct = sizeof(SYMBOL_INFO);
+            symbolInfo->MaxNameLen = MAX_SYM_NAME;
+            if(SymFromName(handle, symbol.name, reinterpret_cast<PSYMBOL_INFO>(symbolInfo)))
+                named++;
+        }
+        nameMs = watch.elapsed_ms();
+
+        printf("dbghelp:  load %8.3f ms,                    %8.1f ns per address (%zu found), %8.1f ns per name (%zu found)\n",
+            loadMs, rvaMs * 1e6 / lookups, found, nameMs * 1e6 / publics.size(), named);
+    }
+    else {
+        printf("SymLoadModuleEx failed: %u\n", GetLastError());
+    }
+    SymCleanup(handle);
+}
@@ -0,0 +1,196 @@
+#include "pe_builder.hpp"
+
+#include <misc/native.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#define PE_HEADERS_SIZE         0x400
+#define PE_FILE_ALIGNMENT       0x200
+#define PE_SECTION_ALIGNMENT    0x1000
+
+namespace tests
+{
+    static void append(std::vector<uint8_t>& buffer, const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    static void align(std::vector<uint8_t>& buffer, size_t alignment, uint8_t fill = 0)
+    {
+        buffer.resize(ALIGN_UP(buffer.size(), alignment), fill);
+    }
+
+    pe_builder::pe_builder()
+        : _imageBase(0x180000000ull), _ordinalBase(1)
+    {
+    }
+
+    uint32_t pe_builder::add_code(const std::vector<uint8_t>& code)
+    {
+        align(_text, 16, 0xCC);
+        auto rva = text_rva + static_cast<uint32_t>(_text.size());
+        append(_text, code.data(), code.size());
+        return rva;
+    }
+
+    uint32_t pe_builder::add_data(const std::vector<uint8_t>& data)
+    {
+        align(_rdata, 4);
+        auto rva = rdata_rva + static_cast<uint32_t>(_rdata.size());
+        append(_rdata, data.data(), data.size());
+        return rva;
+    }
+
+    void pe_builder::add_function(uint32_t begin, uint32_t end, uint32_t unwind)
+    {
+        IMAGE_RUNTIME_FUNCTION_ENTRY entry;
+        entry.BeginAddress = begin;
+        entry.EndAddress = end;
+        entry.UnwindInfoAddress = unwind;
+        _functions.push_back(entry);
+    }
+
+    uint32_t pe_builder::add_export(const char* name, uint32_t rva)
+    {
+        auto index = static_cast<uint32_t>(_exports.size());
+        _exports.push_back(rva);
+        if(name)
+            _names.push_back(export_name{name, static_cast<uint16_t>(index)});
+        return index;
+    }
+
+    void pe_builder::add_export_name(const char* name, uint16_t index)
+    {
+        _names.push_back(export_name{name, index});
+    }
+
+    std::vector<uint8_t> pe_builder::build() const
+    {
+        //
+        // The export directory goes at the end of .rdata, names sorted as the loader expects
+        //
+        auto rdata = _rdata;
+        IMAGE_DATA_DIRECTORY exportDir = { 0, 0 };
+
+        if(!_exports.empty() || !_names.empty()) {
+            auto names = _names;
+            std::sort(names.begin(), names.end(), [](const export_name& lhs, const export_name& rhs) {
+                return lhs.name < rhs.name;
+            });
+
+            align(rdata, 4);
+            auto offset         = static_cast<uint32_t>(rdata.size());
+            auto functionsRva   = rdata_rva + offset + static_cast<uint32_t>(sizeof(IMAGE_EXPORT_DIRECTORY));
+            auto namesRva       = functionsRva + static_cast<uint32_t>(_exports.size() * sizeof(uint32_t));
+            auto ordinalsRva    = namesRva + static_cast<uint32_t>(names.size() * sizeof(uint32_t));
+            auto stringsRva     = ordinalsRva + static_cast<uint32_t>(names.size() * sizeof(uint16_t));
+
+            std::vector<uint8_t> strings;
+            append(strings, "fixture.dll", sizeof("fixture.dll"));
+
+            std::vector<uint32_t> nameRvas;
+            std::vector<uint16_t> ordinals;
+            for(auto& name : names) {
+                nameRvas.push_back(stringsRva + static_cast<uint32_t>(strings.size()));
+                ordinals.push_back(name.index);
+                append(strings, name.name.c_str(), name.name.size() + 1);
+            }
+
+            IMAGE_EXPORT_DIRECTORY dir;
+            memset(&dir, 0, sizeof(dir));
+            dir.Name                    = stringsRva;
+            dir.Base                    = _ordinalBase;
+            dir.NumberOfFunctions       = static_cast<DWORD>(_exports.size());
+            dir.NumberOfNames           = static_cast<DWORD>(names.size());
+            dir.AddressOfFunctions      = functionsRva;
+            dir.AddressOfNames          = namesRva;
+            dir.AddressOfNameOrdinals   = ordinalsRva;
+
+            append(rdata, &dir, sizeof(dir));
+            append(rdata, _exports.data(), _exports.size() * sizeof(uint32_t));
+            append(rdata, nameRvas.data(), nameRvas.size() * sizeof(uint32_t));
+            append(rdata, ordinals.data(), ordinals.size() * sizeof(uint16_t));
+            append(rdata, strings.data(), strings.size());
+
+            exportDir.VirtualAddress = rdata_rva + offset;
+            exportDir.Size = static_cast<DWORD>(rdata.size() - offset);
+        }
+
+        struct section
+        {
+            const char*                 name;
+            uint32_t                    rva;
+            const std::vector<uint8_t>* data;
+            uint32_t                    characteristics;
+        };
+
+        std::vector<uint8_t> pdata;
+        append(pdata, _functions.data(), _functions.size() * sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY));
+
+        section sections[] = {
+            { ".text",  text_rva,   &_text, IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ },
+            { ".rdata", rdata_rva,  &rdata, IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ },
+            { ".pdata", pdata_rva,  &pdata, IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ },
+        };
+
+        std::vector<uint8_t> file(PE_HEADERS_SIZE, 0);
+        std::vector<IMAGE_SECTION_HEADER> headers;
+        uint32_t imageSize = PE_SECTION_ALIGNMENT;
+
+        for(auto& s : sections) {
+            IMAGE_SECTION_HEADER header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.Name, s.name, strlen(s.name));
+            header.Misc.VirtualSize     = static_cast<DWORD>(s.data->size());
+            header.VirtualAddress       = s.rva;
+            header.SizeOfRawData        = static_cast<DWORD>(ALIGN_UP(s.data->size(), PE_FILE_ALIGNMENT));
+            header.PointerToRawData     = static_cast<DWORD>(file.size());
+            header.Characteristics      = s.characteristics;
+            headers.push_back(header);
+
+            append(file, s.data->data(), s.data->size());
+            align(file, PE_FILE_ALIGNMENT);
+            imageSize = std::max<uint32_t>(imageSize, static_cast<uint32_t>(s.rva + ALIGN_UP(std::max<size_t>(s.data->size(), 1), PE_SECTION_ALIGNMENT)));
+        }
+
+        auto dosHdr = reinterpret_cast<PIMAGE_DOS_HEADER>(file.data());
+        dosHdr->e_magic = IMAGE_DOS_SIGNATURE;
+        dosHdr->e_lfanew = 0x80;
+
+        auto ntHdrs = reinterpret_cast<PIMAGE_NT_HEADERS64>(file.data() + dosHdr->e_lfanew);
+        ntHdrs->Signature                                   = IMAGE_NT_SIGNATURE;
+        ntHdrs->FileHeader.Machine                          = IMAGE_FILE_MACHINE_AMD64;
+        ntHdrs->FileHeader.NumberOfSections                 = static_cast<WORD>(headers.size());
+        ntHdrs->FileHeader.TimeDateStamp                    = 0x5F000000;
+        ntHdrs->FileHeader.SizeOfOptionalHeader             = sizeof(IMAGE_OPTIONAL_HEADER64);
+        ntHdrs->FileHeader.Characteristics                  = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_LARGE_ADDRESS_AWARE | IMAGE_FILE_DLL;
+        ntHdrs->OptionalHeader.Magic                        = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+        ntHdrs->OptionalHeader.BaseOfCode                   = text_rva;
+        ntHdrs->OptionalHeader.ImageBase                    = _imageBase;
+        ntHdrs->OptionalHeader.SectionAlignment             = PE_SECTION_ALIGNMENT;
+        ntHdrs->OptionalHeader.FileAlignment                = PE_FILE_ALIGNMENT;
+        ntHdrs->OptionalHeader.MajorOperatingSystemVersion  = 6;
+        ntHdrs->OptionalHeader.MajorSubsystemVersion        = 6;
+        ntHdrs->OptionalHeader.SizeOfImage                  = imageSize;
+        ntHdrs->OptionalHeader.SizeOfHeaders                = PE_HEADERS_SIZE;
+        ntHdrs->OptionalHeader.Subsystem                    = IMAGE_SUBSYSTEM_WINDOWS_CUI;
+        ntHdrs->OptionalHeader.NumberOfRvaAndSizes          = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+        ntHdrs->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT] = exportDir;
+
+        if(!_functions.empty()) {
+            ntHdrs->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress = pdata_rva;
+            ntHdrs->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION].Size = static_cast<DWORD>(pdata.size());
+        }
+
+        memcpy(IMAGE_FIRST_SECTION(ntHdrs), headers.data(), headers.size() * sizeof(IMAGE_SECTION_HEADER));
+        return file;
+    }
+
+    NTSTATUS pe_builder::write(const std::wstring& path) const
+    {
+        auto file = build();
+        return resurgence::native::create_file(path, file.data(), file.size());
+    }
+}
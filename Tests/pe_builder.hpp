@@ -0,0 +1,104 @@
+#pragma once
+
+#include <headers.hpp>
+#include <string>
+#include <vector>
+
+namespace tests
+{
+    ///<summary>
+    /// Builds small x64 images in file layout, for tests that parse PE files.
+    ///</summary>
+    ///<remarks>
+    /// The image has three sections at fixed RVAs: .text for code, .rdata for data and
+    /// the export directory, .pdata for the function table. Nothing is validated, so
+    /// malformed tables can be built on purpose.
+    ///</remarks>
+    class pe_builder
+    {
+    public:
+        static const uint32_t text_rva  = 0x1000;
+        static const uint32_t rdata_rva = 0x10000;
+        static const uint32_t pdata_rva = 0x20000;
+
+        pe_builder();
+
+        ///<summary>
+        /// Adds code to .text, 16-byte aligned.
+        ///</summary>
+        ///<returns>
+        /// The RVA of the code.
+        ///</returns>
+        uint32_t add_code(const std::vector<uint8_t>& code);
+
+        ///<summary>
+        /// Adds data to .rdata, 4-byte aligned (as UNWIND_INFO must be).
+        ///</summary>
+        ///<returns>
+        /// The RVA of the data.
+        ///</returns>
+        uint32_t add_data(const std::vector<uint8_t>& data);
+
+        ///<summary>
+        /// Adds a function table entry.
+        ///</summary>
+        ///<param name="begin">  The RVA of the function. </param>
+        ///<param name="end">    The RVA past its last byte. </param>
+        ///<param name="unwind"> The RVA of its UNWIND_INFO, or of the entry it is chained to with bit 0 set. </param>
+        void add_function(uint32_t begin, uint32_t end, uint32_t unwind);
+
+        ///<summary>
+        /// Adds an export.
+        ///</summary>
+        ///<param name="name"> The name, nullptr to export by ordinal only. </param>
+        ///<param name="rva">  The RVA of the function. </param>
+        ///<returns>
+        /// The index of the export in the function table (its ordinal minus the base).
+        ///</returns>
+        uint32_t add_export(const char* name, uint32_t rva);
+
+        ///<summary>
+        /// Adds a name for any index, even one past the function table.
+        ///</summary>
+        void add_export_name(const char* name, uint16_t index);
+
+        ///<summary>
+        /// Sets the ordinal of the first export (1 by default).
+        ///</summary>
+        void set_ordinal_base(uint32_t base) { _ordinalBase = base; }
+
+        ///<summary>
+        /// Sets the image base.
+        ///</summary>
+        void set_image_base(uint64_t base) { _imageBase = base; }
+
+        ///<summary>
+        /// Builds the file.
+        ///</summary>
+        std::vector<uint8_t> build() const;
+
+        ///<summary>
+        /// Builds the file and writes it.
+        ///</summary>
+        ///<param name="path"> The file path. </param>
+        ///<returns>
+        /// The status code.
+        ///</returns>
+        NTSTATUS write(const std::wstring& path) const;
+
+    private:
+        struct export_name
+        {
+            std::string name;
+            uint16_t    index;
+        };
+
+        uint64_t                                    _imageBase;
+        uint32_t                                    _ordinalBase;
+        std::vector<uint8_t>                        _text;
+        std::vector<uint8_t>                        _rdata;
+        std::vector<IMAGE_RUNTIME_FUNCTION_ENTRY>   _functions;
+        std::vector<uint32_t>                       _exports;   // Function RVAs, by index
+        std::vector<export_name>                    _names;
+    };
+}
@@ -0,0 +1,113 @@
+#include "test.hpp"
+
+#include <system/sampling_profiler.hpp>
+
+#include <algorithm>
+#include <set>
+
+using namespace resurgence;
+
+#define STACK_BASE      0x20000ull
+#define STACK_SIZE      0x1000
+#define LEAF_RIP        0x7FF700001000ull
+#define CALLER_RIP      0x7FF700002345ull
+
+//
+// Replays recorded threads: registers, and the stacks in a snapshot. No modules, so
+// every frame is unwound as a leaf.
+//
+class recorded_target : public system::sampling_target
+{
+public:
+    system::snapshot_unwind_memory  memory;
+    std::set<uint32_t>              locked;     // Threads that can't be suspended
+    std::set<uint32_t>              suspended;
+
+    void add_thread(uint32_t id, uint64_t rip, uint64_t rsp)
+    {
+        system::unwind_context context;
+        memset(&context, 0, sizeof(context));
+        context.rip = rip;
+        context.regs[4] = rsp;
+        _contexts.emplace_back(id, context);
+    }
+
+    NTSTATUS get_modules(std::vector<system::process_module>& modules) override
+    {
+        modules.clear();
+        return STATUS_SUCCESS;
+    }
+
+    NTSTATUS get_threads(std::vector<uint32_t>& threads) override
+    {
+        threads.clear();
+        for(auto& thread : _contexts)
+            threads.push_back(thread.first);
+        return STATUS_SUCCESS;
+    }
+
+    NTSTATUS suspend(uint32_t thread) override
+    {
+        if(locked.count(thread))
+            return STATUS_ACCESS_DENIED;
+        suspended.insert(thread);
+        return STATUS_SUCCESS;
+    }
+
+    NTSTATUS capture(uint32_t thread, system::unwind_context& context) override
+    {
+        CHECK(suspended.count(thread) == 1);
+        for(auto& recorded : _contexts) {
+            if(recorded.first == thread) {
+                context = recorded.second;
+                return STATUS_SUCCESS;
+            }
+        }
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    void resume(uint32_t thread) override
+    {
+        CHECK(suspended.erase(thread) == 1);
+    }
+
+    system::unwind_memory_source& get_memory() override { return memory; }
+
+    bool has_exited() override { return false; }
+
+private:
+    std::vector<std::pair<uint32_t, system::unwind_context>> _contexts;
+};
+
+TEST_CASE(sampling_profiler_samples_through_target)
+{
+    std::vector<uint64_t> stack(STACK_SIZE / 8, 0);
+    stack[0] = CALLER_RIP;
+
+    recorded_target target;
+    target.memory.add_region(STACK_BASE, stack.data(), STACK_SIZE);
+    target.add_thread(1, LEAF_RIP, STACK_BASE);
+    target.add_thread(2, LEAF_RIP, STACK_BASE);
+    target.locked.insert(2);
+
+    system::sampling_profiler profiler(target);
+    CHECK(NT_SUCCESS(profiler.sample()));
+    CHECK(NT_SUCCESS(profiler.sample()));
+
+    //
+    // Every thread suspended was resumed, the one that couldn't be is a failure
+    //
+    CHECK(target.suspended.empty());
+    auto overhead = profiler.get_overhead();
+    CHECK(overhead.samples == 2 && overhead.failures == 2);
+
+    //
+    // The instruction pointer is kept as is, the return address moved back into the call
+    //
+    auto& tree = profiler.get_tree();
+    auto& frames = tree.get_frames();
+    CHECK(tree.get_samples() == 2);
+    CHECK(frames.size() == 2);
+    CHECK(std::find(frames.begin(), frames.end(), LEAF_RIP) != frames.end());
+    CHECK(std::find(frames.begin(), frames.end(), CALLER_RIP - 1) != frames.end());
+}
@@ -0,0 +1,182 @@
+#include "test.hpp"
+#include "pe_builder.hpp"
+
+#include <system/stack_unwinder.hpp>
+#include <system/unwind_codes.hpp>
+
+using namespace resurgence;
+
+#define MODULE_BASE     0x7FF600000000ull
+#define MODULE_SIZE     0x30000
+#define STACK_BASE      0x20000ull
+#define STACK_SIZE      0x1000
+#define CALLER_RIP      0x7FF700001234ull   // Outside the module, unwound as a leaf
+#define RBX             3
+
+static uint16_t unwind_code(uint8_t offset, uint8_t op, uint8_t info)
+{
+    return static_cast<uint16_t>(offset | (op << 8) | (info << 12));
+}
+
+static std::vector<uint8_t> unwind_info(uint8_t flags, uint8_t prologSize, const std::vector<uint16_t>& codes)
+{
+    std::vector<uint8_t> info = { static_cast<uint8_t>(1 | (flags << 3)), prologSize, static_cast<uint8_t>(codes.size()), 0 };
+    for(auto code : codes) {
+        info.push_back(code & 0xFF);
+        info.push_back(code >> 8);
+    }
+    if(codes.size() & 1) {
+        info.push_back(0);
+        info.push_back(0);
+    }
+    return info;
+}
+
+//
+// A module with:
+//   outer     push rbx; sub rsp, 28h; nop x8; add rsp, 28h; pop rbx; ret
+//   fragment  nop x16, chained to outer (code moved out of it)
+//   handler   nop x16, starts with a machine frame (an interrupt or exception)
+//
+struct unwind_fixture
+{
+    std::wstring    path;
+    uint32_t        outer;
+    uint32_t        fragment;
+    uint32_t        handler;
+
+    unwind_fixture()
+    {
+        tests::pe_builder pe;
+
+        outer = pe.add_code({
+            0x53,                       // push rbx
+            0x48, 0x83, 0xEC, 0x28,     // sub rsp, 28h
+            0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
+            0x48, 0x83, 0xC4, 0x28,     // add rsp, 28h
+            0x5B,                       // pop rbx
+            0xC3                        // ret
+        });
+        fragment = pe.add_code(std::vector<uint8_t>(16, 0x90));
+        handler = pe.add_code(std::vector<uint8_t>(16, 0x90));
+
+        auto outerUnwind = pe.add_data(unwind_info(0, 5, {
+            unwind_code(5, UWOP_ALLOC_SMALL, (0x28 - 8) / 8),
+            unwind_code(1, UWOP_PUSH_NONVOL, RBX)
+        }));
+
+        IMAGE_RUNTIME_FUNCTION_ENTRY parent;
+        parent.BeginAddress = outer;
+        parent.EndAddress = outer + 19;
+        parent.UnwindInfoAddress = outerUnwind;
+
+        auto fragmentUnwind = unwind_info(UNWIND_FLAG_CHAININFO, 0, {});
+        fragmentUnwind.insert(fragmentUnwind.end(), reinterpret_cast<uint8_t*>(&parent), reinterpret_cast<uint8_t*>(&parent + 1));
+
+        auto handlerUnwind = pe.add_data(unwind_info(0, 0, { unwind_code(0, UWOP_PUSH_MACHFRAME, 0) }));
+
+        pe.add_function(outer, outer + 19, outerUnwind);
+        pe.add_function(fragment, fragment + 16, pe.add_data(fragmentUnwind));
+        pe.add_function(handler, handler + 16, handlerUnwind);
+
+        path = tests::get_temp_path(L"unwind_fixture.dll");
+        CHECK(NT_SUCCESS(pe.write(path)));
+    }
+};
+
+//
+// Unwinds a recorded stack: words[i] is at STACK_BASE + i * 8, rsp at STACK_BASE
+//
+static std::vector<system::unwind_frame> unwind(const unwind_fixture& fixture, uint32_t rip, const std::vector<uint64_t>& words)
+{
+    std::vector<uint64_t> stack(STACK_SIZE / 8, 0);
+    std::copy(words.begin(), words.end(), stack.begin());
+
+    system::snapshot_unwind_memory memory;
+    memory.add_region(STACK_BASE, stack.data(), STACK_SIZE);
+
+    system::stack_unwinder unwinder(memory);
+    CHECK(NT_SUCCESS(unwinder.add_module(MODULE_BASE, MODULE_SIZE, fixture.path)));
+
+    system::unwind_context context;
+    memset(&context, 0, sizeof(context));
+    context.rip = MODULE_BASE + rip;
+    context.regs[4] = STACK_BASE;
+
+    std::vector<system::unwind_frame> frames;
+    unwinder.unwind(context, frames);
+    return frames;
+}
+
+static bool has_caller(const std::vector<system::unwind_frame>& frames, uint64_t rip, uint64_t rsp)
+{
+    return frames.size() >= 2 && frames[1].rip == rip && frames[1].rsp == rsp;
+}
+
+TEST_CASE(unwind_function_body)
+{
+    unwind_fixture fixture;
+
+    //
+    // rbx at rsp + 28h, the return address above it
+    //
+    auto frames = unwind(fixture, fixture.outer + 6, { 0, 0, 0, 0, 0, 0x1111, CALLER_RIP });
+    CHECK(has_caller(frames, CALLER_RIP, STACK_BASE + 0x38));
+    CHECK(!frames[1].interrupted);
+
+    //
+    // The caller is a leaf outside any module, its return address is 0: the walk ends there
+    //
+    CHECK(frames.size() == 2);
+}
+
+TEST_CASE(unwind_prolog)
+{
+    unwind_fixture fixture;
+
+    //
+    // Nothing ran yet, then only the push
+    //
+    CHECK(has_caller(unwind(fixture, fixture.outer, { CALLER_RIP }), CALLER_RIP, STACK_BASE + 8));
+    CHECK(has_caller(unwind(fixture, fixture.outer + 1, { 0x1111, CALLER_RIP }), CALLER_RIP, STACK_BASE + 0x10));
+}
+
+TEST_CASE(unwind_epilog)
+{
+    unwind_fixture fixture;
+
+    //
+    // At the add the frame is whole, at the pop only rbx is left, at the ret nothing is
+    //
+    CHECK(has_caller(unwind(fixture, fixture.outer + 13, { 0, 0, 0, 0, 0, 0x1111, CALLER_RIP }), CALLER_RIP, STACK_BASE + 0x38));
+    CHECK(has_caller(unwind(fixture, fixture.outer + 17, { 0x1111, CALLER_RIP }), CALLER_RIP, STACK_BASE + 0x10));
+    CHECK(has_caller(unwind(fixture, fixture.outer + 18, { CALLER_RIP }), CALLER_RIP, STACK_BASE + 8));
+}
+
+TEST_CASE(unwind_chained_info)
+{
+    unwind_fixture fixture;
+
+    //
+    // The fragment runs with the frame of outer
+    //
+    auto frames = unwind(fixture, fixture.fragment + 4, { 0, 0, 0, 0, 0, 0x1111, CALLER_RIP });
+    CHECK(has_caller(frames, CALLER_RIP, STACK_BASE + 0x38));
+}
+
+TEST_CASE(unwind_machine_frame)
+{
+    unwind_fixture fixture;
+
+    //
+    // rip, cs, eflags, rsp, ss: the interrupted code gets the rsp of the frame, not rsp + 8
+    //
+    auto interrupted = STACK_BASE + 0x200;
+    auto frames = unwind(fixture, fixture.handler + 2, { CALLER_RIP, 0x33, 0x246, interrupted, 0x2B });
+    CHECK(has_caller(frames, CALLER_RIP, interrupted));
+
+    //
+    // The rip popped is the interrupted instruction, not a return address past a call
+    //
+    CHECK(frames[1].interrupted);
+}
@@ -0,0 +1,72 @@
+#include "test.hpp"
+
+#include <system/process.hpp>
+#include <system/symbols/symbol_system.hpp>
+
+#include <cstdio>
+
+using namespace resurgence;
+
+static void delete_directory(const std::wstring& directory)
+{
+    WIN32_FIND_DATAW data;
+
+    auto find = FindFirstFileW((directory + L"\\*").c_str(), &data);
+    if(find != INVALID_HANDLE_VALUE) {
+        do {
+            if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                DeleteFileW((directory + L"\\" + data.cFileName).c_str());
+        } while(FindNextFileW(find, &data));
+        FindClose(find);
+    }
+    RemoveDirectoryW(directory.c_str());
+}
+
+//
+// Resolves one address in every module of a process with the pdb backend, three times:
+// without a database, against an empty one (cold, the tables are built and saved) and
+// against the filled one (warm, no PDB is opened).
+//
+BENCHMARK(symbol_database, "[pid] [search path]")
+{
+    auto pid = args.empty() ? GetCurrentProcessId() : static_cast<uint32_t>(_wtoi(args[0].c_str()));
+    auto searchPath = args.size() > 1 ? args[1] : std::wstring();
+
+    system::process proc(pid);
+    auto modules = proc.modules()->get_all_modules();
+    if(modules.empty()) {
+        printf("No modules in process %u\n", pid);
+        return;
+    }
+
+    std::vector<uintptr_t> addresses;
+    for(auto& module : modules)
+        addresses.push_back(reinterpret_cast<uintptr_t>(module.get_base()) + module.get_size() / 2);
+
+    auto directory = tests::get_temp_path(L"symbol_database");
+    CreateDirectoryW(directory.c_str(), nullptr);
+
+    auto run = [&](const wchar_t* label, const std::wstring& database) {
+        system::symbol_system symbols(&proc, system::symbol_backend_pdb);
+        symbols.initialize();
+        symbols.set_search_path(searchPath);
+        symbols.set_database_path(database);
+
+        tests::stopwatch watch;
+        auto refs = symbols.resolve(addresses.data(), addresses.size());
+        auto elapsed = watch.elapsed_ms();
+
+        size_t found = 0;
+        for(auto& ref : refs) {
+            if(ref.has_symbol())
+                found++;
+        }
+        printf("%-12ws %10.3f ms, %zu of %zu modules with symbols\n", label, elapsed, found, refs.size());
+    };
+
+    run(L"no database", std::wstring());
+    run(L"cold", directory);
+    run(L"warm", directory);
+
+    delete_directory(directory);
+}
@@ -0,0 +1,67 @@
+#include "test.hpp"
+
+#include <system/process.hpp>
+#include <system/image_debug_info.hpp>
+#include <system/symbols/symbol_store_index.hpp>
+
+#include <cstdio>
+
+using namespace resurgence;
+
+//
+// Indexes a symbol store (or a directory of loose PDBs), then finds the PDB of every
+// module of a process: the debug directory of each module file is parsed and its
+// CodeView record looked up in the index.
+//
+BENCHMARK(symbol_store, "<store or pdb directory> [pid]")
+{
+    if(args.empty()) {
+        printf("usage: bench symbol_store <store or pdb directory> [pid]\n");
+        return;
+    }
+    auto pid = args.size() > 1 ? static_cast<uint32_t>(_wtoi(args[1].c_str())) : GetCurrentProcessId();
+
+    system::symbol_store_index index;
+
+    tests::stopwatch watch;
+    index.add_store(args[0]);
+    auto storeMs = watch.elapsed_ms();
+
+    watch.restart();
+    index.add_directory(args[0]);
+    auto directoryMs = watch.elapsed_ms();
+
+    printf("index        %10.3f ms store, %10.3f ms directory, %zu PDBs\n", storeMs, directoryMs, index.size());
+
+    system::process proc(pid);
+    auto modules = proc.modules()->get_all_modules();
+    if(modules.empty()) {
+        printf("No modules in process %u\n", pid);
+        return;
+    }
+
+    size_t parsed = 0, codeView = 0, found = 0;
+    double parseMs = 0, findMs = 0;
+    for(auto& module : modules) {
+        system::image_debug_info debug;
+
+        watch.restart();
+        auto status = debug.parse(module.get_path());
+        parseMs += watch.elapsed_ms();
+        if(!NT_SUCCESS(status))
+            continue;
+        parsed++;
+
+        if(!debug.has_pdb())
+            continue;
+        codeView++;
+
+        watch.restart();
+        if(index.find(debug))
+            found++;
+        findMs += watch.elapsed_ms();
+    }
+
+    printf("parse        %10.3f ms, %zu of %zu modules (%.1f us each)\n", parseMs, parsed, modules.size(), parseMs * 1000 / modules.size());
+    printf("find         %10.3f ms, %zu of %zu CodeView records found\n", findMs, found, codeView);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <headers.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace tests
+{
+    typedef void (*test_function)();
+    typedef void (*benchmark_function)(const std::vector<std::wstring>& args);
+
+    struct test_case
+    {
+        const char*     name;
+        test_function   run;
+    };
+
+    struct benchmark_case
+    {
+        const char*         name;
+        const char*         usage;      // The arguments, shown by "Tests bench"
+        benchmark_function  run;
+    };
+
+    std::vector<test_case>&         get_tests();
+    std::vector<benchmark_case>&    get_benchmarks();
+
+    struct test_registrar
+    {
+        test_registrar(const char* name, test_function run)
+        {
+            get_tests().push_back(test_case{name, run});
+        }
+    };
+
+    struct benchmark_registrar
+    {
+        benchmark_registrar(const char* name, const char* usage, benchmark_function run)
+        {
+            get_benchmarks().push_back(benchmark_case{name, usage, run});
+        }
+    };
+
+    ///<summary>
+    /// Records a failed check of the running test.
+    ///</summary>
+    void report_failure(const char* file, int line, const char* expression);
+
+    ///<summary>
+    /// Gets a path in the temporary directory, unique to this run.
+    ///</summary>
+    ///<param name="name"> The file name. </param>
+    std::wstring get_temp_path(const std::wstring& name);
+
+    ///<summary>
+    /// Measures elapsed time from its construction.
+    ///</summary>
+    class stopwatch
+    {
+    public:
+        stopwatch()
+            : _start(std::chrono::steady_clock::now())
+        {
+        }
+
+        void restart() { _start = std::chrono::steady_clock::now(); }
+
+        double elapsed_ms() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point _start;
+    };
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static tests::test_registrar name##_registrar(#name, name); \
+    static void name()
+
+#define BENCHMARK(name, usage) \
+    static void name(const std::vector<std::wstring>& args); \
+    static tests::benchmark_registrar name##_registrar(#name, usage, name); \
+    static void name(const std::vector<std::wstring>& args)
+
+#define CHECK(expression) \
+    do { if(!(expression)) tests::report_failure(__FILE__, __LINE__, #expression); } while(0)